@@ -0,0 +1,62 @@
+/*
+Copyright 2020 Michael Beckh
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "ApiHooks.h"
+
+#include <llamalog/llamalog.h>
+#include <m3c/exception.h>
+
+#include <detours.h>
+#include <windows.h>
+
+#include <exception>
+
+namespace systools::bench {
+
+ApiHooks::ApiHooks(const std::initializer_list<Hook> hooks)
+	: m_hooks(hooks) {
+	Commit(DetourAttach);
+}
+
+ApiHooks::~ApiHooks() noexcept {
+	try {
+		Commit(DetourDetach);
+	} catch (const std::exception& e) {
+		LOG_ERROR("Error removing detour: {}", e);
+	}
+}
+
+template <typename Function>
+void ApiHooks::Commit(Function function) {
+	LONG error = DetourTransactionBegin();
+	if (error != NO_ERROR) {
+		THROW(m3c::windows_exception(error), "DetourTransactionBegin");
+	}
+	error = DetourUpdateThread(GetCurrentThread());
+	for (auto it = m_hooks.begin(); error == NO_ERROR && it != m_hooks.end(); ++it) {
+		error = function(it->ppOriginal, it->pDetour);
+	}
+	if (error != NO_ERROR) {
+		DetourTransactionAbort();
+		THROW(m3c::windows_exception(error), "Detours");
+	}
+	error = DetourTransactionCommit();
+	if (error != NO_ERROR) {
+		THROW(m3c::windows_exception(error), "DetourTransactionCommit");
+	}
+}
+
+}  // namespace systools::bench
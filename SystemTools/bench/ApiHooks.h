@@ -0,0 +1,76 @@
+/*
+Copyright 2020 Michael Beckh
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include <windows.h>
+
+#include <atomic>
+#include <cstdint>
+#include <initializer_list>
+#include <vector>
+
+namespace systools::bench {
+
+/// @brief Replaces functions using Detours while in scope.
+class ApiHooks final {
+public:
+	/// @brief A function to replace.
+	struct Hook {
+		/// @brief The address of a variable holding the original function. It receives the trampoline for calling the
+		/// original function.
+		void** ppOriginal;
+		/// @brief The replacement.
+		void* pDetour;
+	};
+
+public:
+	explicit ApiHooks(std::initializer_list<Hook> hooks);
+	ApiHooks(const ApiHooks&) = delete;
+	ApiHooks(ApiHooks&&) = delete;
+	~ApiHooks() noexcept;
+
+public:
+	ApiHooks& operator=(const ApiHooks&) = delete;
+	ApiHooks& operator=(ApiHooks&&) = delete;
+
+private:
+	template <typename Function>
+	void Commit(Function function);
+
+private:
+	const std::vector<Hook> m_hooks;
+};
+
+/// @brief A detour which increments @p counter before calling the function in `*ppOriginal`.
+/// @details `ppOriginal` MUST point to a variable initialized with the function, e.g.
+/// `decltype(&CreateFileW) g_pCreateFileW = CreateFileW;`. Use `Get` to create the `Hook` for `ApiHooks`.
+template <auto ppOriginal, std::atomic_uint64_t& counter>
+struct CallCounter;
+
+template <typename R, typename... Args, R(WINAPI** ppOriginal)(Args...), std::atomic_uint64_t& counter>
+struct CallCounter<ppOriginal, counter> {
+	static R WINAPI Detour(Args... args) noexcept {
+		counter.fetch_add(1, std::memory_order_relaxed);
+		return (*ppOriginal)(args...);
+	}
+
+	[[nodiscard]] static ApiHooks::Hook Get() noexcept {
+		return {reinterpret_cast<void**>(ppOriginal), reinterpret_cast<void*>(&Detour)};  // NOLINT(cppcoreguidelines-pro-type-reinterpret-cast): Required by Detours API.
+	}
+};
+
+}  // namespace systools::bench
@@ -0,0 +1,186 @@
+/*
+Copyright 2020 Michael Beckh
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "ApiHooks.h"
+#include "BackupFileSystem_Fake.h"
+#include "BackupStrategy_Fake.h"
+#include "SimulatedStorage.h"
+#include "TreeGenerator.h"
+#include "systools/Backup.h"
+#include "systools/InstrumentedBackupStrategy.h"
+#include "systools/Path.h"
+
+#include <llamalog/llamalog.h>
+#include <m3c/exception.h>
+
+#include <benchmark/benchmark.h>
+#include <windows.h>
+#include <psapi.h>
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+namespace systools::bench {
+
+namespace {
+
+const Path kSourceVolume(LR"(\\?\Volume{00112233-4455-6677-8899-AABBCCDDEEF0}\)");
+const Path kTargetVolume(LR"(\\?\Volume{00112233-4455-6677-8899-AABBCCDDEEFA}\)");
+
+decltype(&AdjustTokenPrivileges) g_pAdjustTokenPrivileges = AdjustTokenPrivileges;
+
+/// @brief Replaces `AdjustTokenPrivileges` while in scope so that `Backup` runs without administrative rights.
+class PrivilegesFake final {
+public:
+	PrivilegesFake()
+		: m_hooks({{reinterpret_cast<void**>(&g_pAdjustTokenPrivileges), reinterpret_cast<void*>(&AdjustTokenPrivileges_Fake)}}) {  // NOLINT(cppcoreguidelines-pro-type-reinterpret-cast): Required by Detours API.
+		// empty
+	}
+
+private:
+	static BOOL WINAPI AdjustTokenPrivileges_Fake(HANDLE /* hToken */, BOOL /* disableAllPrivileges */, PTOKEN_PRIVILEGES /* pNewState */, DWORD /* bufferLength */, PTOKEN_PRIVILEGES /* pPreviousState */, PDWORD /* pReturnLength */) noexcept {
+		SetLastError(ERROR_SUCCESS);
+		return TRUE;
+	}
+
+private:
+	const ApiHooks m_hooks;
+};
+
+/// @brief Get the peak working set of the process.
+/// @details The value is never reset, i.e. it only reflects the current benchmark if it uses more memory than all
+/// benchmarks run before.
+[[nodiscard]] double GetPeakWorkingSetMegabytes() {
+	PROCESS_MEMORY_COUNTERS counters{};
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+		THROW(m3c::windows_exception(GetLastError()), "GetProcessMemoryInfo");
+	}
+	return static_cast<double>(counters.PeakWorkingSetSize) / (1024.0 * 1024.0);
+}
+
+/// @brief The device profiles selected by benchmark arguments.
+const std::array<const test::SimulatedStorage::Profile*, 3> kProfiles = {&test::SimulatedStorage::kHdd, &test::SimulatedStorage::kSsd, &test::SimulatedStorage::kUsb};
+
+/// @brief Run a backup of a generated tree using the fake file system.
+/// @details Reports the number of calls of the `BackupStrategy` per backup and the peak working set. If @p pStorage is
+/// set, the time on the virtual clock is reported as well.
+/// @param state The benchmark state.
+/// @param options The shape of the generated tree.
+/// @param incremental If `true` a previous backup exists, else all files are copied.
+/// @param pStorage An optional simulation of the devices for source and target.
+void RunBackup(benchmark::State& state, const TreeOptions& options, const bool incremental, test::SimulatedStorage* const pStorage = nullptr) {
+	const PrivilegesFake privilegesFake;
+	const Path src = kSourceVolume / L"data";
+	const Path ref = kTargetVolume / L"ref";
+	const Path dst = kTargetVolume / L"dst";
+
+	TreeStatistics tree;
+	std::uint64_t operations = 0;
+	std::chrono::nanoseconds simulated{0};
+	while (state.KeepRunning()) {
+		state.PauseTiming();
+		test::BackupFileSystem_Fake fileSystem;
+		tree = GenerateTree(fileSystem, src, incremental ? std::optional<Path>(ref / L"data") : std::nullopt, options);
+		std::optional<test::BackupStrategy_Fake> fakeStrategy;
+		if (pStorage) {
+			pStorage->Reset();
+			fakeStrategy.emplace(fileSystem, *pStorage);
+		} else {
+			fakeStrategy.emplace(fileSystem);
+		}
+		InstrumentedBackupStrategy strategy(*fakeStrategy);
+		Backup backup(strategy);
+		state.ResumeTiming();
+
+		const Backup::Statistics statistics = backup.CreateBackup({src}, ref, dst);
+
+		// file system and backup are destroyed outside of the measurement
+		state.PauseTiming();
+		benchmark::DoNotOptimize(statistics);
+		for (std::size_t i = 0; i < static_cast<std::size_t>(InstrumentedBackupStrategy::Operation::kCount); ++i) {
+			operations += strategy.GetHistogram(static_cast<InstrumentedBackupStrategy::Operation>(i)).GetCount();
+		}
+		if (pStorage) {
+			simulated += pStorage->GetTime();
+		}
+	}
+	state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() * tree.files));
+	state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations() * tree.bytes));
+	state.counters["folders"] = static_cast<double>(tree.directories);
+	state.counters["ops"] = static_cast<double>(operations) / static_cast<double>(state.iterations());
+	if (pStorage) {
+		state.counters["simulated_s"] = std::chrono::duration<double>(simulated).count() / static_cast<double>(state.iterations());
+	}
+	state.counters["peakMB"] = GetPeakWorkingSetMegabytes();
+}
+
+/// @brief Backup into an empty target. The arguments are depth, sub directories and files per directory.
+void Backup_Initial(benchmark::State& state) {
+	TreeOptions options;
+	options.depth = static_cast<std::uint32_t>(state.range(0));
+	options.directories = static_cast<std::uint32_t>(state.range(1));
+	options.files = static_cast<std::uint32_t>(state.range(2));
+	RunBackup(state, options, false);
+}
+BENCHMARK(Backup_Initial)
+	->Args({2, 4, 16})
+	->Args({3, 8, 32})
+	->Args({4, 8, 32});
+
+/// @brief Backup with a previous backup as reference. The arguments are depth, sub directories and files per directory
+/// followed by the percentages of changed, renamed and deleted files.
+void Backup_Incremental(benchmark::State& state) {
+	TreeOptions options;
+	options.depth = static_cast<std::uint32_t>(state.range(0));
+	options.directories = static_cast<std::uint32_t>(state.range(1));
+	options.files = static_cast<std::uint32_t>(state.range(2));
+	options.changedPercent = static_cast<std::uint32_t>(state.range(3));
+	options.renamedPercent = static_cast<std::uint32_t>(state.range(4));
+	options.deletedPercent = static_cast<std::uint32_t>(state.range(5));
+	RunBackup(state, options, true);
+}
+BENCHMARK(Backup_Incremental)
+	->Args({2, 4, 16, 5, 1, 1})
+	->Args({3, 8, 32, 0, 0, 0})
+	->Args({3, 8, 32, 5, 1, 1})
+	->Args({3, 8, 32, 50, 10, 10})
+	->Args({4, 8, 32, 5, 1, 1});
+
+/// @brief Incremental backup on simulated devices. The arguments are the profiles of the source and target device
+/// (0 = HDD, 1 = SSD, 2 = USB). The tree has 585 folders with 32 files each.
+void Backup_Simulated(benchmark::State& state) {
+	test::SimulatedStorage storage;
+	storage.AddDevice(kSourceVolume, *kProfiles.at(static_cast<std::size_t>(state.range(0))));
+	storage.AddDevice(kTargetVolume, *kProfiles.at(static_cast<std::size_t>(state.range(1))));
+
+	TreeOptions options;
+	options.depth = 3;
+	options.directories = 8;
+	options.files = 32;
+	RunBackup(state, options, true, &storage);
+}
+BENCHMARK(Backup_Simulated)
+	->Args({0, 0})
+	->Args({1, 0})
+	->Args({1, 1})
+	->Args({1, 2});
+
+}  // namespace
+
+}  // namespace systools::bench
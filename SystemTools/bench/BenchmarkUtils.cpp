@@ -0,0 +1,71 @@
+/*
+Copyright 2020 Michael Beckh
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "BenchmarkUtils.h"
+
+#include <llamalog/llamalog.h>
+#include <m3c/Handle.h>
+#include <m3c/exception.h>
+
+#include <windows.h>
+
+#include <string>
+
+namespace systools::bench {
+
+Path BenchmarkUtils::GetDirectory() {
+	std::wstring directory;
+	DWORD len = GetEnvironmentVariableW(L"SYSTOOLS_BENCH_DIRECTORY", nullptr, 0);
+	if (len) {
+		directory.resize(len);
+		len = GetEnvironmentVariableW(L"SYSTOOLS_BENCH_DIRECTORY", directory.data(), len);
+	} else {
+		len = GetTempPathW(0, nullptr);
+		if (!len) {
+			THROW(m3c::windows_exception(GetLastError()), "GetTempPath");
+		}
+		directory.resize(len);
+		len = GetTempPathW(len, directory.data());
+	}
+	if (!len || len >= directory.size()) {
+		THROW(m3c::windows_exception(GetLastError()), "GetDirectory");
+	}
+	directory.resize(len);
+	return Path(directory);
+}
+
+void BenchmarkUtils::EnablePrivilege(_In_z_ const wchar_t* const name) {
+	TOKEN_PRIVILEGES privileges;
+	privileges.PrivilegeCount = 1;
+	if (!LookupPrivilegeValueW(nullptr, name, &privileges.Privileges->Luid)) {
+		THROW(m3c::windows_exception(GetLastError()), "LookupPrivilegeValueW");
+	}
+	privileges.Privileges->Attributes = SE_PRIVILEGE_ENABLED;
+
+	HANDLE handle;  // NOLINT(cppcoreguidelines-init-variables): Initialized as out parameter.
+	if (!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES, &handle)) {
+		THROW(m3c::windows_exception(GetLastError()), "OpenProcessToken");
+	}
+
+	const m3c::Handle hToken(handle);
+	const BOOL result = AdjustTokenPrivileges(hToken, FALSE, &privileges, 0, nullptr, nullptr);
+	const DWORD lastError = GetLastError();
+	if (!result || lastError != ERROR_SUCCESS) {
+		THROW(m3c::windows_exception(lastError), "AdjustTokenPrivileges");
+	}
+}
+
+}  // namespace systools::bench
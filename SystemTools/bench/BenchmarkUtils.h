@@ -0,0 +1,42 @@
+/*
+Copyright 2020 Michael Beckh
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include "systools/Path.h"
+
+#include <sal.h>
+
+namespace systools::bench {
+
+class BenchmarkUtils {
+private:
+	BenchmarkUtils() noexcept = default;
+	~BenchmarkUtils() noexcept = default;
+
+public:
+	/// @brief Get the directory for files created by benchmarks.
+	/// @details Uses the environment variable `SYSTOOLS_BENCH_DIRECTORY` if set for measuring a particular device, else
+	/// the directory for temporary files.
+	static Path GetDirectory();
+
+	/// @brief Enable a privilege for the process, e.g. `SE_SECURITY_NAME`.
+	/// @details Throws an exception if the user does not hold the privilege, i.e. most privileges require running the
+	/// benchmark with administrative rights.
+	static void EnablePrivilege(_In_z_ const wchar_t* name);
+};
+
+}  // namespace systools::bench
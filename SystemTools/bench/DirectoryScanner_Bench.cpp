@@ -0,0 +1,239 @@
+/*
+Copyright 2020 Michael Beckh
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "ApiHooks.h"
+#include "BenchmarkUtils.h"
+#include "systools/DirectoryScanner.h"
+#include "systools/Path.h"
+
+#include <llamalog/llamalog.h>
+#include <m3c/Handle.h>
+#include <m3c/exception.h>
+
+#include <benchmark/benchmark.h>
+#include <fmt/xchar.h>
+#include <windows.h>
+#include <aclapi.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace systools::bench {
+
+namespace {
+
+std::atomic_uint64_t g_systemCalls;
+std::atomic_uint64_t g_allocations;
+
+decltype(&CreateFileW) g_pCreateFileW = CreateFileW;
+decltype(&CloseHandle) g_pCloseHandle = CloseHandle;
+decltype(&GetFileInformationByHandleEx) g_pGetFileInformationByHandleEx = GetFileInformationByHandleEx;
+decltype(&FindFirstStreamW) g_pFindFirstStreamW = FindFirstStreamW;
+decltype(&FindNextStreamW) g_pFindNextStreamW = FindNextStreamW;
+decltype(&FindClose) g_pFindClose = FindClose;
+decltype(&GetFileAttributesW) g_pGetFileAttributesW = GetFileAttributesW;
+decltype(&OpenFileById) g_pOpenFileById = OpenFileById;
+decltype(&GetSecurityInfo) g_pGetSecurityInfo = GetSecurityInfo;
+decltype(&GetNamedSecurityInfoW) g_pGetNamedSecurityInfoW = GetNamedSecurityInfoW;
+// HeapAlloc is forwarded to RtlAllocateHeap which also serves malloc, operator new and LocalAlloc
+decltype(&HeapAlloc) g_pHeapAlloc = HeapAlloc;
+
+/// @brief Counts the calls of all functions which `DirectoryScanner` uses for accessing the file system and all heap
+/// allocations of the process while in scope.
+class CallCounters final {
+public:
+	CallCounters()
+		: m_hooks({CallCounter<&g_pCreateFileW, g_systemCalls>::Get(),
+				   CallCounter<&g_pCloseHandle, g_systemCalls>::Get(),
+				   CallCounter<&g_pGetFileInformationByHandleEx, g_systemCalls>::Get(),
+				   CallCounter<&g_pFindFirstStreamW, g_systemCalls>::Get(),
+				   CallCounter<&g_pFindNextStreamW, g_systemCalls>::Get(),
+				   CallCounter<&g_pFindClose, g_systemCalls>::Get(),
+				   CallCounter<&g_pGetFileAttributesW, g_systemCalls>::Get(),
+				   CallCounter<&g_pOpenFileById, g_systemCalls>::Get(),
+				   CallCounter<&g_pGetSecurityInfo, g_systemCalls>::Get(),
+				   CallCounter<&g_pGetNamedSecurityInfoW, g_systemCalls>::Get(),
+				   CallCounter<&g_pHeapAlloc, g_allocations>::Get()}) {
+		// empty
+	}
+
+public:
+	[[nodiscard]] static std::uint64_t GetSystemCalls() noexcept {
+		return g_systemCalls.load(std::memory_order_relaxed);
+	}
+	[[nodiscard]] static std::uint64_t GetAllocations() noexcept {
+		return g_allocations.load(std::memory_order_relaxed);
+	}
+
+private:
+	const ApiHooks m_hooks;
+};
+
+/// @brief A directory tree on disk with empty files.
+/// @details The tree is deleted when the instance is destroyed.
+class DiskTree final {
+public:
+	DiskTree(const std::uint32_t depth, const std::uint32_t directories, const std::uint32_t files)
+		: m_depth(depth)
+		, m_directories(directories)
+		, m_files(files) {
+		try {
+			AddDirectory(BenchmarkUtils::GetDirectory() / fmt::format(L"SystemTools_Bench.{}", GetCurrentProcessId()), 0);
+		} catch (...) {
+			Delete();
+			throw;
+		}
+	}
+	DiskTree(const DiskTree&) = delete;
+	DiskTree(DiskTree&&) = delete;
+	~DiskTree() noexcept {
+		Delete();
+	}
+
+public:
+	DiskTree& operator=(const DiskTree&) = delete;
+	DiskTree& operator=(DiskTree&&) = delete;
+
+public:
+	[[nodiscard]] bool Matches(const std::uint32_t depth, const std::uint32_t directories, const std::uint32_t files) const noexcept {
+		return m_depth == depth && m_directories == directories && m_files == files;
+	}
+
+	/// @brief Get all directories of the tree including the root.
+	[[nodiscard]] const std::vector<Path>& GetDirectories() const noexcept {
+		return m_paths;
+	}
+
+private:
+	void AddDirectory(const Path& path, const std::uint32_t level) {
+		if (!CreateDirectoryW(path.c_str(), nullptr)) {
+			THROW(m3c::windows_exception(GetLastError()), "CreateDirectory {}", path);
+		}
+		m_paths.push_back(path);
+
+		for (std::uint32_t i = 0; i < m_files; ++i) {
+			const Path filePath = path / fmt::format(L"file-{:04}.dat", i);
+			const m3c::Handle hFile = CreateFileW(filePath.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_NEW, FILE_ATTRIBUTE_NORMAL, nullptr);
+			if (!hFile) {
+				THROW(m3c::windows_exception(GetLastError()), "CreateFile {}", filePath);
+			}
+		}
+		if (level < m_depth) {
+			for (std::uint32_t i = 0; i < m_directories; ++i) {
+				AddDirectory(path / fmt::format(L"dir-{:04}", i), level + 1);
+			}
+		}
+	}
+
+	void Delete() noexcept {
+		// children are always added after their parent
+		for (auto it = m_paths.crbegin(); it != m_paths.crend(); ++it) {
+			for (std::uint32_t i = 0; i < m_files; ++i) {
+				const Path filePath = *it / fmt::format(L"file-{:04}.dat", i);
+				if (!DeleteFileW(filePath.c_str()) && GetLastError() != ERROR_FILE_NOT_FOUND) {
+					LOG_ERROR("DeleteFile {}: {}", filePath, lg::LastError());
+				}
+			}
+			if (!RemoveDirectoryW(it->c_str())) {
+				LOG_ERROR("RemoveDirectory {}: {}", *it, lg::LastError());
+			}
+		}
+		m_paths.clear();
+	}
+
+private:
+	const std::uint32_t m_depth;
+	const std::uint32_t m_directories;
+	const std::uint32_t m_files;
+	std::vector<Path> m_paths;
+};
+
+/// @brief Get the tree for a benchmark.
+/// @details The tree is kept while the same benchmark is run repeatedly. At most one tree exists at any time.
+[[nodiscard]] const DiskTree& GetDiskTree(const std::uint32_t depth, const std::uint32_t directories, const std::uint32_t files) {
+	static std::optional<DiskTree> diskTree;
+	if (!diskTree || !diskTree->Matches(depth, directories, files)) {
+		diskTree.reset();
+		diskTree.emplace(depth, directories, files);
+	}
+	return *diskTree;
+}
+
+/// @brief Scan every directory of a tree on disk. The arguments are depth, sub directories and files per directory
+/// followed by the value of `DirectoryScanner::Flags`.
+/// @details Reports the calls of file system functions and heap allocations per entry. Both are counted for the whole
+/// process. The security flags require `SeSecurityPrivilege`, i.e. administrative rights.
+void DirectoryScanner_Scan(benchmark::State& state) {
+	const std::uint32_t depth = static_cast<std::uint32_t>(state.range(0));
+	const std::uint32_t directories = static_cast<std::uint32_t>(state.range(1));
+	const std::uint32_t files = static_cast<std::uint32_t>(state.range(2));
+	const DirectoryScanner::Flags flags = static_cast<DirectoryScanner::Flags>(state.range(3));
+	// reading the SACL requires the privilege
+	if ((static_cast<std::uint8_t>(flags) & static_cast<std::uint8_t>(DirectoryScanner::Flags::kFolderSecurity | DirectoryScanner::Flags::kFileSecurity)) != 0) {
+		try {
+			BenchmarkUtils::EnablePrivilege(SE_SECURITY_NAME);
+		} catch (const std::exception& e) {
+			state.SkipWithError(e.what());
+			return;
+		}
+	}
+
+	const DiskTree& tree = GetDiskTree(depth, directories, files);
+	DirectoryScanner scanner;
+
+	std::uint64_t entries = 0;
+	const CallCounters counters;
+	const std::uint64_t systemCalls = CallCounters::GetSystemCalls();
+	const std::uint64_t allocations = CallCounters::GetAllocations();
+	while (state.KeepRunning()) {
+		entries = 0;
+		for (const Path& path : tree.GetDirectories()) {
+			DirectoryScanner::Result scannedDirectories;
+			DirectoryScanner::Result scannedFiles;
+			scanner.Scan(path, scannedDirectories, scannedFiles, flags, kAcceptAllScannerFilter);
+			scanner.Wait();
+			entries += scannedDirectories.size() + scannedFiles.size();
+		}
+	}
+
+	const double total = static_cast<double>(state.iterations() * entries);
+	state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() * entries));
+	state.counters["entries"] = static_cast<double>(entries);
+	state.counters["syscalls"] = static_cast<double>(CallCounters::GetSystemCalls() - systemCalls) / total;
+	state.counters["allocs"] = static_cast<double>(CallCounters::GetAllocations() - allocations) / total;
+}
+BENCHMARK(DirectoryScanner_Scan)
+	// 585 folders with 32 files each
+	->Args({3, 8, 32, 0})
+	->Args({3, 8, 32, 1})
+	->Args({3, 8, 32, 2})
+	->Args({3, 8, 32, 3})
+	->Args({3, 8, 32, 4})
+	->Args({3, 8, 32, 5})
+	->Args({3, 8, 32, 6})
+	->Args({3, 8, 32, 7})
+	// a single large folder
+	->Args({0, 0, 10000, 0})
+	->Args({0, 0, 10000, 2});
+
+}  // namespace
+
+}  // namespace systools::bench
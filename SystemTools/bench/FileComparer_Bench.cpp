@@ -0,0 +1,254 @@
+/*
+Copyright 2020 Michael Beckh
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "BenchmarkUtils.h"
+#include "systools/FileComparer.h"
+#include "systools/Path.h"
+
+#include <llamalog/llamalog.h>
+#include <m3c/Handle.h>
+#include <m3c/exception.h>
+
+#include <benchmark/benchmark.h>
+#include <fmt/xchar.h>
+#include <windows.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace systools::bench {
+
+namespace {
+
+/// @brief The minimum number of bytes per file to compare in every iteration. Smaller files use several pairs.
+constexpr std::uint64_t kMinBytesPerIteration = 64ull * 1024 * 1024;
+
+/// @brief The maximum number of pairs of files for small sizes.
+constexpr std::uint64_t kMaxPairs = 256;
+
+/// @brief The size of the blocks used for writing the files.
+constexpr std::uint32_t kWriteBlockSize = 1024 * 1024;
+
+/// @brief Where the files differ.
+enum class Difference : std::uint_fast8_t {
+	kNone = 0,
+	kEarly = 1,
+	kLate = 2
+};
+
+/// @brief Pairs of files with the same content except for the selected difference.
+/// @details The files are deleted when the instance is destroyed.
+class FilePairs final {
+public:
+	FilePairs(const std::uint64_t size, const Difference difference)
+		: m_size(size)
+		, m_difference(difference) {
+		const Path directory = BenchmarkUtils::GetDirectory();
+		const std::uint64_t count = std::clamp<std::uint64_t>(kMinBytesPerIteration / std::max<std::uint64_t>(size, 1), 1, kMaxPairs);
+		m_paths.reserve(count * 2);
+
+		std::mt19937_64 random(static_cast<std::mt19937_64::result_type>(size));
+		std::vector<std::uint64_t> block(kWriteBlockSize / sizeof(std::uint64_t));
+		try {
+			for (std::uint64_t i = 0; i < count; ++i) {
+				std::generate(block.begin(), block.end(), std::ref(random));
+				m_paths.push_back(directory / fmt::format(L"SystemTools_Bench.{}.{}.src", GetCurrentProcessId(), i));
+				Write(m_paths.back(), block, std::nullopt);
+				m_paths.push_back(directory / fmt::format(L"SystemTools_Bench.{}.{}.cpy", GetCurrentProcessId(), i));
+				Write(m_paths.back(), block, difference == Difference::kNone ? std::nullopt : std::optional<std::uint64_t>(difference == Difference::kEarly ? 0 : size - 1));
+			}
+		} catch (...) {
+			Delete();
+			throw;
+		}
+	}
+	FilePairs(const FilePairs&) = delete;
+	FilePairs(FilePairs&&) = delete;
+	~FilePairs() noexcept {
+		Delete();
+	}
+
+public:
+	FilePairs& operator=(const FilePairs&) = delete;
+	FilePairs& operator=(FilePairs&&) = delete;
+
+public:
+	[[nodiscard]] bool Matches(const std::uint64_t size, const Difference difference) const noexcept {
+		return m_size == size && m_difference == difference;
+	}
+
+	[[nodiscard]] std::size_t GetCount() const noexcept {
+		return m_paths.size() / 2;
+	}
+
+	[[nodiscard]] const Path& GetSource(const std::size_t index) const noexcept {
+		return m_paths[index * 2];
+	}
+
+	[[nodiscard]] const Path& GetCopy(const std::size_t index) const noexcept {
+		return m_paths[index * 2 + 1];
+	}
+
+	/// @brief Remove all files from the system cache.
+	/// @details Opening a file without buffering makes the cache manager flush and purge the cached data of the file.
+	/// This is the closest equivalent of `posix_fadvise(POSIX_FADV_DONTNEED)` which does not require administrative
+	/// rights.
+	void Evict() const {
+		for (const Path& path : m_paths) {
+			const m3c::Handle hFile = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_NO_BUFFERING, nullptr);
+			if (!hFile) {
+				THROW(m3c::windows_exception(GetLastError()), "CreateFile {}", path);
+			}
+		}
+	}
+
+private:
+	/// @brief Write a file of `m_size` bytes by repeating @p block.
+	/// @param path The path of the file.
+	/// @param block The content. The first value is replaced by the offset in every block to prevent deduplication.
+	/// @param flip The offset of a byte which is inverted.
+	void Write(const Path& path, std::vector<std::uint64_t>& block, const std::optional<std::uint64_t> flip) const {
+		const m3c::Handle hFile = CreateFileW(path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_NEW, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (!hFile) {
+			THROW(m3c::windows_exception(GetLastError()), "CreateFile {}", path);
+		}
+		std::byte* const pData = reinterpret_cast<std::byte*>(block.data());  // NOLINT(cppcoreguidelines-pro-type-reinterpret-cast): Write raw data.
+		for (std::uint64_t offset = 0; offset < m_size; offset += kWriteBlockSize) {
+			const std::uint32_t size = static_cast<std::uint32_t>(std::min<std::uint64_t>(m_size - offset, kWriteBlockSize));
+			block[0] = offset;
+			const bool flipped = flip && *flip >= offset && *flip < offset + size;
+			if (flipped) {
+				pData[*flip - offset] = ~pData[*flip - offset];  // NOLINT(cppcoreguidelines-pro-bounds-pointer-arithmetic): Offset is in range.
+			}
+			DWORD bytesWritten;  // NOLINT(cppcoreguidelines-init-variables): Initialized as out parameter.
+			const BOOL result = WriteFile(hFile, pData, size, &bytesWritten, nullptr);
+			if (flipped) {
+				pData[*flip - offset] = ~pData[*flip - offset];  // NOLINT(cppcoreguidelines-pro-bounds-pointer-arithmetic): Offset is in range.
+			}
+			if (!result || bytesWritten != size) {
+				THROW(m3c::windows_exception(GetLastError()), "WriteFile {}", path);
+			}
+		}
+		// no dirty pages must be written back while measuring
+		if (!FlushFileBuffers(hFile)) {
+			THROW(m3c::windows_exception(GetLastError()), "FlushFileBuffers {}", path);
+		}
+	}
+
+	void Delete() noexcept {
+		for (const Path& path : m_paths) {
+			if (!DeleteFileW(path.c_str()) && GetLastError() != ERROR_FILE_NOT_FOUND) {
+				LOG_ERROR("DeleteFile {}: {}", path, lg::LastError());
+			}
+		}
+		m_paths.clear();
+	}
+
+private:
+	const std::uint64_t m_size;
+	const Difference m_difference;
+	std::vector<Path> m_paths;
+};
+
+/// @brief Get the files for a benchmark.
+/// @details Creating large files takes much longer than comparing them. Therefore the files are kept while the same
+/// benchmark is run repeatedly. At most one set of files exists at any time.
+/// @param size The size of every file.
+/// @param difference Where the files of a pair differ.
+/// @return The files.
+[[nodiscard]] const FilePairs& GetFilePairs(const std::uint64_t size, const Difference difference) {
+	static std::optional<FilePairs> filePairs;
+	if (!filePairs || !filePairs->Matches(size, difference)) {
+		filePairs.reset();
+		filePairs.emplace(size, difference);
+	}
+	return *filePairs;
+}
+
+/// @brief Compare pairs of files on disk. The arguments are the size of the files in KiB, the difference (0 = equal,
+/// 1 = first byte differs, 2 = last byte differs), the buffer size in KiB and 1 to evict the files from the system
+/// cache before every iteration.
+/// @details `FileComparer` always reads without buffering. Warm runs therefore measure cached file system metadata
+/// and device caches. Reports the time the comparer waited for the readers and the readers waited for a free buffer
+/// per pair of files.
+void FileComparer_Compare(benchmark::State& state) {
+	const std::uint64_t size = static_cast<std::uint64_t>(state.range(0)) * 1024;
+	const Difference difference = static_cast<Difference>(state.range(1));
+	const std::uint32_t bufferSize = static_cast<std::uint32_t>(state.range(2)) * 1024;
+	const bool cold = state.range(3) != 0;
+
+	const FilePairs& filePairs = GetFilePairs(size, difference);
+	const std::size_t count = filePairs.GetCount();
+
+	FileComparer comparer(bufferSize);
+	if (!cold) {
+		for (std::size_t i = 0; i < count; ++i) {
+			benchmark::DoNotOptimize(comparer.Compare(filePairs.GetSource(i), filePairs.GetCopy(i)));
+		}
+	}
+	comparer.ResetWaitTime();
+
+	while (state.KeepRunning()) {
+		if (cold) {
+			state.PauseTiming();
+			filePairs.Evict();
+			state.ResumeTiming();
+		}
+		for (std::size_t i = 0; i < count; ++i) {
+			const bool equal = comparer.Compare(filePairs.GetSource(i), filePairs.GetCopy(i));
+			benchmark::DoNotOptimize(equal);
+		}
+	}
+
+	const double pairs = static_cast<double>(state.iterations() * count);
+	state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() * count));
+	state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations() * count * size * 2));
+	state.counters["pairs"] = static_cast<double>(count);
+	state.counters["wait_us"] = std::chrono::duration<double, std::micro>(comparer.GetWaitTime()).count() / pairs;
+	state.counters["srcWait_us"] = std::chrono::duration<double, std::micro>(comparer.GetReaderWaitTime(0)).count() / pairs;
+	state.counters["cpyWait_us"] = std::chrono::duration<double, std::micro>(comparer.GetReaderWaitTime(1)).count() / pairs;
+}
+BENCHMARK(FileComparer_Compare)
+	// per file overhead
+	->Args({1, 0, 64, 0})
+	->Args({1, 0, 64, 1})
+	->Args({64, 0, 64, 0})
+	->Args({64, 0, 64, 1})
+	// buffer sizes
+	->Args({1024, 0, 4, 0})
+	->Args({1024, 0, 64, 0})
+	->Args({1024, 0, 64, 1})
+	->Args({1024, 0, 1024, 0})
+	->Args({1024, 1, 64, 0})
+	->Args({1024, 2, 64, 0})
+	// throughput
+	->Args({1024 * 1024, 0, 64, 0})
+	->Args({1024 * 1024, 0, 64, 1})
+	->Args({1024 * 1024, 0, 1024, 1})
+	->Args({1024 * 1024, 1, 64, 1})
+	->Args({1024 * 1024, 2, 64, 1})
+	->Args({10 * 1024 * 1024, 0, 1024, 1});
+
+}  // namespace
+
+}  // namespace systools::bench
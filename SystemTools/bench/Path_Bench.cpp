@@ -0,0 +1,128 @@
+/*
+Copyright 2020 Michael Beckh
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "systools/Path.h"
+
+#include <benchmark/benchmark.h>
+
+#include <compare>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace systools::bench {
+
+namespace {
+
+constexpr const wchar_t* kAscii = L"document-2020-final-version.txt";
+constexpr const wchar_t* kMixedCase = L"Document-2020-Final-Version.TXT";
+constexpr const wchar_t* kMixedCaseOther = L"DOCUMENT-2020-final-VERSION.txt";
+constexpr const wchar_t* kUnicode = L"\u00DCbersicht-\u00C4nderungen-Gr\u00F6\u00DFe-\u0141\u00F3d\u017A.txt";
+constexpr const wchar_t* kUnicodeOther = L"\u00FCBERSICHT-\u00E4NDERUNGEN-GR\u00D6\u00DFE-\u0142\u00D3D\u0179.TXT";
+
+void Compare(benchmark::State& state, const wchar_t* const lhs, const wchar_t* const rhs) {
+	const Filename a(lhs);
+	const Filename b(rhs);
+	while (state.KeepRunning()) {
+		const std::weak_ordering result = a <=> b;
+		benchmark::DoNotOptimize(result);
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+
+void Hash(benchmark::State& state, const wchar_t* const name) {
+	const Filename filename(name);
+	while (state.KeepRunning()) {
+		const std::size_t hash = std::hash<Filename>{}(filename);
+		benchmark::DoNotOptimize(hash);
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+
+//
+// Filename
+//
+
+void Filename_Compare_Ascii(benchmark::State& state) {
+	Compare(state, kAscii, kAscii);
+}
+BENCHMARK(Filename_Compare_Ascii);
+
+void Filename_Compare_MixedCase(benchmark::State& state) {
+	Compare(state, kMixedCase, kMixedCaseOther);
+}
+BENCHMARK(Filename_Compare_MixedCase);
+
+void Filename_Compare_Unicode(benchmark::State& state) {
+	Compare(state, kUnicode, kUnicodeOther);
+}
+BENCHMARK(Filename_Compare_Unicode);
+
+void Filename_Hash_Ascii(benchmark::State& state) {
+	Hash(state, kAscii);
+}
+BENCHMARK(Filename_Hash_Ascii);
+
+void Filename_Hash_MixedCase(benchmark::State& state) {
+	Hash(state, kMixedCase);
+}
+BENCHMARK(Filename_Hash_MixedCase);
+
+void Filename_Hash_Unicode(benchmark::State& state) {
+	Hash(state, kUnicode);
+}
+BENCHMARK(Filename_Hash_Unicode);
+
+//
+// Path
+//
+
+/// @brief Join a path with a file name. The argument is the number of directories of the base path.
+void Path_Join(benchmark::State& state) {
+	std::wstring base = LR"(C:\Users\Benchmark)";
+	for (std::int64_t i = 0; i < state.range(0); ++i) {
+		base += LR"(\directory)";
+	}
+	const Path path(base);
+	const Filename filename(kAscii);
+	while (state.KeepRunning()) {
+		const Path result = path / filename;
+		benchmark::DoNotOptimize(result);
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(Path_Join)->Args({0})->Args({8})->Args({32});
+
+/// @brief Get the parent of a path. The argument is the number of directories of the path.
+void Path_GetParent(benchmark::State& state) {
+	std::wstring base = LR"(C:\Users\Benchmark)";
+	for (std::int64_t i = 0; i < state.range(0); ++i) {
+		base += LR"(\directory)";
+	}
+	const Path path = Path(base) / kAscii;
+	while (state.KeepRunning()) {
+		const Path result = path.GetParent();
+		benchmark::DoNotOptimize(result);
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(Path_GetParent)->Args({0})->Args({8})->Args({32});
+
+}  // namespace
+
+}  // namespace systools::bench
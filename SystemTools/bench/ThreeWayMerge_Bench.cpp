@@ -0,0 +1,145 @@
+/*
+Copyright 2020 Michael Beckh
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "systools/Path.h"
+#include "systools/ThreeWayMerge.h"
+
+#include <benchmark/benchmark.h>
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <compare>
+#include <cstdint>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace systools::bench {
+
+namespace {
+
+struct Match {
+	Match(std::optional<Filename> src, std::optional<Filename> ref, std::optional<Filename> dst) noexcept
+		: src(std::move(src))
+		, ref(std::move(ref))
+		, dst(std::move(dst)) {
+	}
+
+	std::optional<Filename> src;
+	std::optional<Filename> ref;
+	std::optional<Filename> dst;
+};
+
+[[nodiscard]] int CompareName(const Filename& lhs, const Filename& rhs) {
+	const std::weak_ordering cmp = lhs <=> rhs;
+	return cmp < 0 ? -1 : (cmp == 0 ? 0 : 1);
+}
+
+[[nodiscard]] Filename MakeName(const std::int64_t index) {
+	return Filename(fmt::format(L"file-{:08}.dat", index));
+}
+
+/// @brief Create sorted listings as returned by a directory scan.
+/// @details The source contains @p size entries. Reference and destination contain the same number of entries of which
+/// @p overlap percent also exist in the source.
+/// @param size The number of entries in each listing.
+/// @param overlap The percentage of entries of reference and destination which also exist in the source.
+/// @param src Receives the source listing.
+/// @param ref Receives the listing of the reference copy.
+/// @param dst Receives the listing of the destination.
+void CreateListings(const std::int64_t size, const std::int64_t overlap, std::vector<Filename>& src, std::vector<Filename>& ref, std::vector<Filename>& dst) {
+	src.reserve(size);
+	ref.reserve(size);
+	dst.reserve(size);
+	for (std::int64_t i = 0; i < size; ++i) {
+		src.push_back(MakeName(i * 2));
+		// odd numbers never exist in the source
+		Filename name = MakeName(i % 100 < overlap ? i * 2 : i * 2 + 1);
+		ref.push_back(name);
+		dst.push_back(std::move(name));
+	}
+}
+
+/// @brief Merge listings of equal size. The arguments are the size of each listing and the overlap in percent.
+void ThreeWayMerge_Sorted(benchmark::State& state) {
+	std::vector<Filename> src;
+	std::vector<Filename> ref;
+	std::vector<Filename> dst;
+	CreateListings(state.range(0), state.range(1), src, ref, dst);
+
+	while (state.KeepRunning()) {
+		std::vector<Match> copy;
+		std::vector<Match> extra;
+		std::vector<Filename> unmatched;
+		ThreeWayMerge(src, ref, dst, copy, extra, unmatched, CompareName);
+		benchmark::DoNotOptimize(copy);
+		benchmark::DoNotOptimize(extra);
+		benchmark::DoNotOptimize(unmatched);
+	}
+	state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() * (src.size() + ref.size() + dst.size())));
+}
+BENCHMARK(ThreeWayMerge_Sorted)
+	->Args({1'000, 0})
+	->Args({1'000, 50})
+	->Args({1'000, 100})
+	->Args({10'000, 0})
+	->Args({10'000, 50})
+	->Args({10'000, 100})
+	->Args({100'000, 0})
+	->Args({100'000, 50})
+	->Args({100'000, 100})
+	->Args({1'000'000, 0})
+	->Args({1'000'000, 50})
+	->Args({1'000'000, 100});
+
+/// @brief Merge listings which are not sorted. The arguments are the size of each listing and the overlap in percent.
+void ThreeWayMerge_Unsorted(benchmark::State& state) {
+	std::vector<Filename> src;
+	std::vector<Filename> ref;
+	std::vector<Filename> dst;
+	CreateListings(state.range(0), state.range(1), src, ref, dst);
+	// reverse order is deterministic and defeats the check for sorted input
+	std::reverse(src.begin(), src.end());
+	std::reverse(ref.begin(), ref.end());
+	std::reverse(dst.begin(), dst.end());
+
+	while (state.KeepRunning()) {
+		// the input is sorted in place
+		state.PauseTiming();
+		std::vector<Filename> srcInput = src;
+		std::vector<Filename> refInput = ref;
+		std::vector<Filename> dstInput = dst;
+		state.ResumeTiming();
+
+		std::vector<Match> copy;
+		std::vector<Match> extra;
+		std::vector<Filename> unmatched;
+		ThreeWayMerge(std::move(srcInput), std::move(refInput), std::move(dstInput), copy, extra, unmatched, CompareName);
+		benchmark::DoNotOptimize(copy);
+		benchmark::DoNotOptimize(extra);
+		benchmark::DoNotOptimize(unmatched);
+	}
+	state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() * (src.size() + ref.size() + dst.size())));
+}
+BENCHMARK(ThreeWayMerge_Unsorted)
+	->Args({1'000, 50})
+	->Args({10'000, 50})
+	->Args({100'000, 50})
+	->Args({1'000'000, 50});
+
+}  // namespace
+
+}  // namespace systools::bench
@@ -0,0 +1,133 @@
+/*
+Copyright 2020 Michael Beckh
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "TreeGenerator.h"
+
+#include "BackupFileSystem_Fake.h"
+#include "systools/Path.h"
+
+#include <fmt/xchar.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <random>
+#include <string>
+#include <utility>
+
+namespace systools::bench {
+
+namespace {
+
+using Entry = test::BackupFileSystem_Fake::Entry;
+
+/// @brief Adds directories and files recursively.
+class TreeGenerator {
+public:
+	TreeGenerator(test::BackupFileSystem_Fake& fileSystem, const TreeOptions& options)
+		: m_fileSystem(fileSystem)
+		, m_options(options)
+		, m_random(options.seed)
+		, m_sizeDistribution(std::log(static_cast<double>(std::max<std::uint64_t>(options.medianFileSize, 1))), options.fileSizeSigma) {
+		// empty
+	}
+
+public:
+	void AddDirectory(const Path& src, const std::optional<Path>& ref, const std::uint32_t level, const bool root) {
+		Entry srcEntry(src.GetFilename(), true);
+		if (ref) {
+			Entry refEntry = srcEntry.CreateCopy();
+			refEntry.filename = ref->GetFilename().c_str();
+			m_fileSystem.Add(*ref, std::move(refEntry), root);
+		}
+		m_fileSystem.Add(src, std::move(srcEntry), root);
+		++m_statistics.directories;
+
+		for (std::uint32_t i = 0; i < m_options.files; ++i) {
+			AddFile(src, ref, fmt::format(L"file-{:04}.dat", i));
+		}
+		if (level < m_options.depth) {
+			for (std::uint32_t i = 0; i < m_options.directories; ++i) {
+				const std::wstring name = fmt::format(L"dir-{:04}", i);
+				AddDirectory(src / Filename(name), ref ? std::optional<Path>(*ref / Filename(name)) : std::nullopt, level + 1, false);
+			}
+		}
+	}
+
+	[[nodiscard]] const TreeStatistics& GetStatistics() const noexcept {
+		return m_statistics;
+	}
+
+private:
+	void AddFile(const Path& src, const std::optional<Path>& ref, const std::wstring& name) {
+		const Filename filename(name);
+		Entry srcEntry(filename, false);
+		srcEntry.size = GetFileSize();
+		srcEntry.content = fmt::format("{}", srcEntry.fileId);
+
+		if (ref) {
+			const std::uint32_t roll = m_percentDistribution(m_random);
+			if (roll < m_options.changedPercent) {
+				Entry refEntry = srcEntry.CreateCopy();
+				--refEntry.lastWriteTime;
+				refEntry.content = "changed";
+				m_fileSystem.Add(*ref / filename, std::move(refEntry));
+			} else if (roll < m_options.changedPercent + m_options.renamedPercent) {
+				Entry refEntry = srcEntry.CreateCopy();
+				const Filename refFilename(L"renamed-" + name);
+				refEntry.filename = refFilename.c_str();
+				m_fileSystem.Add(*ref / refFilename, std::move(refEntry));
+			} else if (roll < m_options.changedPercent + m_options.renamedPercent + m_options.deletedPercent) {
+				Entry refEntry = srcEntry.CreateCopy();
+				const Filename refFilename(L"deleted-" + name);
+				refEntry.filename = refFilename.c_str();
+				m_fileSystem.Add(*ref / refFilename, std::move(refEntry));
+				// the file only exists in the previous backup
+				return;
+			} else {
+				m_fileSystem.Add(*ref / filename, srcEntry.CreateCopy());
+			}
+		}
+		++m_statistics.files;
+		m_statistics.bytes += srcEntry.size;
+		m_fileSystem.Add(src / filename, std::move(srcEntry));
+	}
+
+	[[nodiscard]] std::uint64_t GetFileSize() {
+		const double size = std::round(m_sizeDistribution(m_random));
+		return size < static_cast<double>(std::numeric_limits<std::int64_t>::max()) ? static_cast<std::uint64_t>(size) : std::numeric_limits<std::int64_t>::max();
+	}
+
+private:
+	test::BackupFileSystem_Fake& m_fileSystem;
+	const TreeOptions& m_options;
+	std::mt19937 m_random;
+	std::lognormal_distribution<double> m_sizeDistribution;
+	std::uniform_int_distribution<std::uint32_t> m_percentDistribution{0, 99};
+	TreeStatistics m_statistics;
+};
+
+}  // namespace
+
+TreeStatistics GenerateTree(test::BackupFileSystem_Fake& fileSystem, const Path& src, const std::optional<Path>& ref, const TreeOptions& options) {
+	TreeGenerator generator(fileSystem, options);
+	generator.AddDirectory(src, ref, 0, true);
+	return generator.GetStatistics();
+}
+
+}  // namespace systools::bench
@@ -0,0 +1,70 @@
+/*
+Copyright 2020 Michael Beckh
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <optional>
+
+namespace systools {
+class Path;
+}  // namespace systools
+
+namespace systools::test {
+class BackupFileSystem_Fake;
+}  // namespace systools::test
+
+namespace systools::bench {
+
+/// @brief The shape of a generated directory tree.
+/// @details All percentages refer to the files of the reference copy, i.e. the previous backup.
+struct TreeOptions {
+	/// @brief The number of directory levels below the root.
+	std::uint32_t depth = 3;
+	/// @brief The number of sub directories in each directory above the deepest level.
+	std::uint32_t directories = 4;
+	/// @brief The number of files in each directory.
+	std::uint32_t files = 16;
+	/// @brief The median size of the log-normal distribution of file sizes.
+	std::uint64_t medianFileSize = 64 * 1024;
+	/// @brief The standard deviation of the logarithm of the file sizes.
+	double fileSizeSigma = 1.5;
+	/// @brief The percentage of files with modified contents in the source.
+	std::uint32_t changedPercent = 5;
+	/// @brief The percentage of files with a different name in the source.
+	std::uint32_t renamedPercent = 1;
+	/// @brief The percentage of files which no longer exist in the source.
+	std::uint32_t deletedPercent = 1;
+	/// @brief The seed of the random number generator. The same seed always creates the same tree.
+	std::uint32_t seed = 1234;
+};
+
+/// @brief The size of a generated source tree.
+struct TreeStatistics {
+	std::uint64_t directories = 0;
+	std::uint64_t files = 0;
+	std::uint64_t bytes = 0;
+};
+
+/// @brief Create a directory tree and optionally a previous backup of it in a fake file system.
+/// @param fileSystem The file system which receives the tree.
+/// @param src The root folder of the source tree. The folder MUST NOT exist.
+/// @param ref The root folder of the previous backup or `std::nullopt` to not create a backup. The folder MUST NOT exist.
+/// @param options The shape of the tree.
+/// @return The number of directories, files and bytes in the source tree.
+TreeStatistics GenerateTree(test::BackupFileSystem_Fake& fileSystem, const Path& src, const std::optional<Path>& ref, const TreeOptions& options);
+
+}  // namespace systools::bench
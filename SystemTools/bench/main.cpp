@@ -0,0 +1,39 @@
+/*
+Copyright 2020 Michael Beckh
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <llamalog/LogWriter.h>
+#include <llamalog/llamalog.h>
+
+#include <benchmark/benchmark.h>
+
+#include <memory>
+#include <utility>
+
+int main(int argc, char** argv) {
+	std::unique_ptr<lg::DebugWriter> writer = std::make_unique<lg::DebugWriter>(lg::Priority::kWarn);
+	lg::Initialize(std::move(writer));
+
+	benchmark::Initialize(&argc, argv);
+	if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+		lg::Shutdown();
+		return 1;
+	}
+	benchmark::RunSpecifiedBenchmarks();
+	benchmark::Shutdown();
+
+	lg::Shutdown();
+	return 0;
+}
@@ -18,10 +18,16 @@ limitations under the License.
 
 #pragma once
 
+#include <systools/BackupIndex.h>
 #include <systools/DirectoryScanner.h>
 #include <systools/FileComparer.h>
+#include <systools/FileVerifier.h>
+#include <systools/Path.h>
+#include <systools/Progress.h>
 
+#include <chrono>
 #include <cstdint>
+#include <memory>
 #include <optional>
 #include <vector>
 
@@ -57,6 +63,49 @@ public:
 			friend class Statistics;
 		};
 
+		/// @brief The time threads were blocked waiting for other threads.
+		class WaitTime {
+		public:
+			/// @brief Get the time the main thread waited for the scanner of the source.
+			[[nodiscard]] std::chrono::nanoseconds GetSourceScanner() const noexcept {
+				return m_srcScanner;
+			}
+			/// @brief Get the time the main thread waited for the scanner of the reference copy.
+			[[nodiscard]] std::chrono::nanoseconds GetReferenceScanner() const noexcept {
+				return m_refScanner;
+			}
+			/// @brief Get the time the main thread waited for the scanner of the destination.
+			[[nodiscard]] std::chrono::nanoseconds GetDestinationScanner() const noexcept {
+				return m_dstScanner;
+			}
+			/// @brief Get the time the main thread waited for the readers when comparing files.
+			[[nodiscard]] std::chrono::nanoseconds GetComparer() const noexcept {
+				return m_comparer;
+			}
+			/// @brief Get the time the reader of the source file waited for the main thread when comparing files.
+			[[nodiscard]] std::chrono::nanoseconds GetSourceReader() const noexcept {
+				return m_srcReader;
+			}
+			/// @brief Get the time the reader of the copy waited for the main thread when comparing files.
+			[[nodiscard]] std::chrono::nanoseconds GetCopyReader() const noexcept {
+				return m_cpyReader;
+			}
+			/// @brief Get the total time the main thread was blocked waiting for scanners and readers.
+			[[nodiscard]] std::chrono::nanoseconds GetMainThread() const noexcept {
+				return m_srcScanner + m_refScanner + m_dstScanner + m_comparer;
+			}
+
+		private:
+			std::chrono::nanoseconds m_srcScanner{0};
+			std::chrono::nanoseconds m_refScanner{0};
+			std::chrono::nanoseconds m_dstScanner{0};
+			std::chrono::nanoseconds m_comparer{0};
+			std::chrono::nanoseconds m_srcReader{0};
+			std::chrono::nanoseconds m_cpyReader{0};
+
+			friend class Backup;
+		};
+
 	public:
 		[[nodiscard]] std::uint64_t GetFolders() const noexcept;
 		[[nodiscard]] std::uint64_t GetFiles() const noexcept;
@@ -87,6 +136,15 @@ public:
 			return m_replaced;
 		}
 
+		/// @brief Get the copies which did not match the source when reading them again.
+		[[nodiscard]] const std::vector<Path>& GetVerificationFailed() const noexcept {
+			return m_verificationFailed;
+		}
+
+		[[nodiscard]] const WaitTime& GetWaitTime() const noexcept {
+			return m_waitTime;
+		}
+
 	private:
 		void OnAdd(const Match& match);
 		void OnUpdate(const Match& match);
@@ -116,6 +174,10 @@ public:
 		std::uint64_t m_bytesCreatedInHardLinks = 0;
 		std::uint64_t m_bytesCopied = 0;
 
+		std::vector<Path> m_verificationFailed;
+
+		WaitTime m_waitTime;
+
 		friend class Backup;
 	};
 
@@ -133,17 +195,106 @@ public:
 public:
 	Statistics CreateBackup(const std::vector<Path>& src, const Path& ref, const Path& dst);
 
+	/// @brief Read copied files again and compare them with the data read from the source.
+	/// @details Verification runs in the background while the backup continues. Files which are cloned or copied
+	/// including alternate data streams are not verified.
+	/// @param maxBytesPerSecond The maximum read rate for verification or 0 for no limit.
+	void EnableVerification(std::uint64_t maxBytesPerSecond);
+
+	/// @brief Report the progress in regular intervals while a backup is running.
+	/// @param interval The time between two reports.
+	/// @param callback A function which is called with the progress from a background thread.
+	void EnableProgress(std::chrono::milliseconds interval, ProgressReporter::Callback callback);
+
+	/// @brief Get the progress of the running or the last backup.
+	/// @details The function may be called from any thread.
+	[[nodiscard]] Progress::Snapshot GetProgress() const;
+
+	/// @brief Record a trace of scans, waits, compares, copies and directories for each backup.
+	/// @details The trace is written in the Chrome trace event format while the backup runs and completed when the backup
+	/// ends, also in case of an error.
+	/// @param path The path of the trace file.
+	void EnableTrace(Path path);
+
+	/// @brief Reuse copies of files and folders which were moved or renamed in the source since the last backup.
+	/// @details Each backup records the file ids of the source in an index. The index of the reference copy is used to
+	/// find the previous copy of any entry which exists in the source only. The copy is reused from the reference copy
+	/// or renamed if it is in the same folder of the destination. Contents of files are still compared before a copy is
+	/// reused.
+	/// @param previousIndex The path of the index of the reference copy. A missing file is treated as an empty index.
+	/// @param currentIndex The path where the index for the backup is written.
+	void EnableMoveDetection(Path previousIndex, Path currentIndex);
+
 private:
-	void CopyDirectories(const std::optional<Path>& optionalSrc, const std::optional<Path>& optionalRef, const Path& dst, const std::vector<Match>& directories);
+	/// @brief Pair files which exist in the source only with renamed files in destination or reference copy.
+	/// @details Files are paired if size and timestamps match and are unique within the chunk of the listing. A pairing is only a
+	/// candidate, contents are still verified before the file is reused. Directories are only paired by `MatchMoved`.
+	/// @param copy The entries which exist in the source.
+	/// @param extra The entries which exist in the destination only. Paired entries are removed.
+	/// @param unmatched The entries which exist in the reference copy only. Paired entries are moved into @p copy.
+	static void MatchRenamed(std::vector<Match>& copy, std::vector<Match>& extra, DirectoryScanner::Result& unmatched);
+
+	/// @brief Pair files and folders which exist in the source only with their previous copies using the index of the
+	/// reference copy.
+	/// @details A copy in the destination is only used if it is in the same chunk of the listing because other folders
+	/// and chunks of the destination might already have been processed. A copy in the reference copy may be anywhere in the tree. A pairing
+	/// is only a candidate, contents of files are still verified before the file is reused.
+	/// @param copy The entries which exist in the source.
+	/// @param extra The entries which exist in the destination only. Paired entries are removed.
+	/// @param parent The folder in the source.
+	void MatchMoved(std::vector<Match>& copy, std::vector<Match>& extra, const ScannedFile& parent);
+
+	/// @brief Scan a single entry of the reference copy.
+	/// @param path The path of the entry.
+	/// @return The entry or `std::nullopt` if it does not exist.
+	[[nodiscard]] std::optional<ScannedFile> ScanReference(const Path& path);
+
+	/// @brief Add the entries of a folder to the index of the backup.
+	/// @param parentId The file id of the folder in the source or all zero for the root of the backup.
+	/// @param entries The entries of the folder.
+	void UpdateIndex(const FILE_ID_128& parentId, const std::vector<Match>& entries);
+
+	/// @brief Copy the time spent waiting for scanners and readers to the statistics.
+	void UpdateWaitTime() noexcept;
+
+	/// @brief Compare and copy the files of a folder.
+	/// @param srcPath The folder in the source.
+	/// @param refPath The folder in the reference copy or `std::nullopt` if it does not exist.
+	/// @param dstPath The folder in the destination.
+	/// @param files The matched files which exist in the source.
+	void CopyFiles(const Path& srcPath, const std::optional<Path>& refPath, const Path& dstPath, const std::vector<Match>& files);
+
+	/// @brief Copy the contents of directories recursively.
+	/// @details The folders of all levels are passed as nodes which share their parents. Full paths are only created
+	/// for calling the strategy. Listings are merged in chunks while the scanners continue, so memory is bounded by the
+	/// size of the chunks and the subfolders of a folder.
+	/// @param src The node of the parent folder in the source or `nullptr` if @p directories exist in the destination only.
+	/// @param ref The node of the parent folder in the reference copy or `nullptr` if it does not exist.
+	/// @param dst The node of the parent folder in the destination.
+	/// @param directories The matched entries of the parent folder.
+	void CopyDirectories(const std::shared_ptr<const PathNode>& src, const std::shared_ptr<const PathNode>& ref, const std::shared_ptr<const PathNode>& dst, const std::vector<Match>& directories);
 
 private:
 	BackupStrategy& m_strategy;
 	DirectoryScanner m_srcScanner;
 	DirectoryScanner m_refScanner;
 	DirectoryScanner m_dstScanner;
+	/// @brief Scans single entries of the reference copy while the other scanners are busy or paused.
+	DirectoryScanner m_moveScanner;
 	FileComparer m_fileComparer;
+	std::optional<FileVerifier> m_fileVerifier;
 
 	Statistics m_statistics;
+	Progress m_progress;
+	std::chrono::milliseconds m_progressInterval{0};
+	ProgressReporter::Callback m_progressCallback;
+	std::optional<Path> m_tracePath;
+	std::optional<Path> m_previousIndexPath;
+	std::optional<Path> m_currentIndexPath;
+	std::optional<BackupIndex> m_previousIndex;
+	std::optional<BackupIndex> m_currentIndex;
+	/// @brief The root of the reference copy while a backup is running or `nullptr` if it does not exist.
+	std::shared_ptr<const PathNode> m_refRoot;
 	bool m_compareContents = true;
 	bool m_fileSecurity = true;
 };
@@ -0,0 +1,93 @@
+/*
+Copyright 2020 Michael Beckh
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+/// @file
+
+#pragma once
+
+#include "systools/DigestCatalog.h"
+#include "systools/Path.h"
+
+#include <windows.h>
+
+#include <cstddef>
+#include <unordered_map>
+#include <vector>
+
+namespace systools {
+
+/// @brief A persistent map from the file ids of the source to the location of their copies in a backup.
+/// @details Each entry stores the id of the parent folder and the name of the copy, so the location of a copy is found
+/// by following the parents up to a folder in the root of the backup. File ids are unique per volume only, i.e. a
+/// location is just a candidate which must be verified before the copy is used.
+class BackupIndex {
+public:
+	struct Entry {
+		/// @brief The file id of the parent folder in the source or all zero for folders in the root of the backup.
+		FILE_ID_128 parentId;
+		/// @brief The name of the copy in the backup.
+		Filename name;
+	};
+
+public:
+	/// @brief Create an index and load its content if @p path exists.
+	/// @param path The file where the index is stored.
+	explicit BackupIndex(Path path);
+	BackupIndex(const BackupIndex&) = delete;
+	BackupIndex(BackupIndex&&) = delete;
+	~BackupIndex() noexcept = default;
+
+public:
+	BackupIndex& operator=(const BackupIndex&) = delete;
+	BackupIndex& operator=(BackupIndex&&) = delete;
+
+public:
+	[[nodiscard]] std::size_t GetSize() const noexcept {
+		return m_entries.size();
+	}
+
+	/// @brief Get the entry for a file or folder.
+	/// @param fileId The file id in the source.
+	/// @return The entry or `nullptr` if the index does not contain the file or folder.
+	[[nodiscard]] const Entry* Find(const FILE_ID_128& fileId) const noexcept;
+
+	/// @brief Get the location of the copy of a file or folder.
+	/// @param fileId The file id in the source.
+	/// @return The names of the folders starting at the root of the backup followed by the name of the copy, or an empty
+	/// vector if the index does not contain the entry or one of its parents.
+	[[nodiscard]] std::vector<Filename> GetLocation(const FILE_ID_128& fileId) const;
+
+	/// @brief Add or replace the entry for a file or folder.
+	/// @param fileId The file id in the source.
+	/// @param entry The new entry.
+	void Set(const FILE_ID_128& fileId, Entry entry);
+
+	/// @brief Remove all entries.
+	void Clear() noexcept;
+
+	/// @brief Write the index to disk.
+	/// @details The data is written to a temporary file which then replaces the previous version.
+	void Save() const;
+
+private:
+	void Load();
+
+private:
+	const Path m_path;
+	std::unordered_map<FILE_ID_128, Entry, DigestCatalog::FileIdHash, DigestCatalog::FileIdEqual> m_entries;
+};
+
+}  // namespace systools
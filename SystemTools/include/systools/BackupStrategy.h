@@ -18,10 +18,16 @@ limitations under the License.
 
 #pragma once
 
+#include <systools/Digest.h>
 #include <systools/DirectoryScanner.h>
 
+#include <m3c/mutex.h>
+
 #include <windows.h>
 
+#include <cstdint>
+#include <optional>
+#include <string>
 #include <vector>
 
 #ifdef __clang_analyzer__
@@ -58,7 +64,9 @@ public:
 	virtual void SetAttributes(const Path& path, const ScannedFile& attributesSource) const = 0;
 	virtual void SetSecurity(const Path& path, const ScannedFile& securitySource) const = 0;
 	virtual void Rename(const Path& existingName, const Path& newName) const = 0;
-	virtual void Copy(const Path& source, const Path& target) const = 0;
+	virtual std::optional<Digest> Copy(const Path& source, const Path& target, const ScannedFile& sourceFile, bool calculateDigest) const = 0;
+	virtual bool Clone(const Path& source, const Path& target, const ScannedFile& sourceFile) const = 0;
+	virtual std::optional<std::uint64_t> Update(const Path& source, const Path& target, FileComparer& fileComparer) const = 0;
 	virtual void CreateHardLink(const Path& path, const Path& existing) const = 0;
 	virtual void Delete(const Path& path) const = 0;
 
@@ -113,7 +121,9 @@ public:
 	void SetAttributes(const Path& target, const ScannedFile& attributesSource) const final;
 	void SetSecurity(const Path& path, const ScannedFile& securitySource) const final;
 	void Rename(const Path& existingName, const Path& newName) const final;
-	void Copy(const Path& source, const Path& target) const final;
+	std::optional<Digest> Copy(const Path& source, const Path& target, const ScannedFile& sourceFile, bool calculateDigest) const final;
+	bool Clone(const Path& source, const Path& target, const ScannedFile& sourceFile) const final;
+	std::optional<std::uint64_t> Update(const Path& source, const Path& target, FileComparer& fileComparer) const final;
 	void CreateHardLink(const Path& path, const Path& existing) const final;
 	void Delete(const Path& path) const final;
 };
@@ -136,9 +146,29 @@ public:
 	void SetAttributes(const Path& path, const ScannedFile& attributesSource) const final;
 	void SetSecurity(const Path& path, const ScannedFile& securitySource) const final;
 	void Rename(const Path& existingName, const Path& newName) const final;
-	void Copy(const Path& source, const Path& target) const final;
+	std::optional<Digest> Copy(const Path& source, const Path& target, const ScannedFile& sourceFile, bool calculateDigest) const final;
+	bool Clone(const Path& source, const Path& target, const ScannedFile& sourceFile) const final;
+	std::optional<std::uint64_t> Update(const Path& source, const Path& target, FileComparer& fileComparer) const final;
 	void CreateHardLink(const Path& path, const Path& existing) const final;
 	void Delete(const Path& path) const final;
+
+private:
+	/// @brief The volume of the directory which was used last as source or target of a copy.
+	struct Volume {
+		std::wstring directory;
+		DWORD serialNumber = 0;
+		DWORD fileSystemFlags = 0;
+	};
+
+	/// @brief Check if both files are on the same volume with block cloning support.
+	/// @details The volume information is cached for the last source and target directory. All files of a directory
+	/// are copied in sequence, i.e. the volumes are queried once per directory and not for every file.
+	[[nodiscard]] bool CanClone(const Path& source, const Path& target) const;
+
+private:
+	mutable m3c::mutex m_volumeMutex;
+	mutable Volume m_sourceVolume;
+	mutable Volume m_targetVolume;
 };
 
 }  // namespace systools
@@ -0,0 +1,68 @@
+/*
+Copyright 2020 Michael Beckh
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+/// @file
+
+#pragma once
+
+#include <windows.h>
+#include <bcrypt.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace systools {
+
+class Path;
+
+/// @brief The SHA-256 digest of the content of a file.
+using Digest = std::array<std::byte, 32>;
+
+/// @brief Calculates a `Digest` from data passed in one or more blocks.
+class DigestBuilder {
+public:
+	DigestBuilder();
+	DigestBuilder(const DigestBuilder&) = delete;
+	DigestBuilder(DigestBuilder&&) = delete;
+	~DigestBuilder() noexcept;
+
+public:
+	DigestBuilder& operator=(const DigestBuilder&) = delete;
+	DigestBuilder& operator=(DigestBuilder&&) = delete;
+
+public:
+	/// @brief Add data to the digest.
+	/// @param data The data.
+	/// @param size The number of bytes in @p data.
+	void Update(const std::byte* data, std::uint32_t size);
+
+	/// @brief Get the digest of all data passed to `Update` and start a new calculation.
+	/// @return The digest.
+	[[nodiscard]] Digest Finish();
+
+private:
+	BCRYPT_HASH_HANDLE m_hHash = nullptr;
+};
+
+/// @brief Read a file using unbuffered I/O and calculate the digest of its content.
+/// @details Unbuffered reads bypass the cache, i.e. the data is read from the disk even if it was written recently.
+/// @param path The file.
+/// @param maxBytesPerSecond The maximum read rate or 0 for no limit.
+/// @return The digest.
+[[nodiscard]] Digest CalculateDigest(const Path& path, std::uint64_t maxBytesPerSecond = 0);
+
+}  // namespace systools
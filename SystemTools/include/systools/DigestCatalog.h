@@ -0,0 +1,94 @@
+/*
+Copyright 2020 Michael Beckh
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+/// @file
+
+#pragma once
+
+#include "systools/Digest.h"
+#include "systools/Path.h"
+
+#include <windows.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+
+namespace systools {
+
+/// @brief A persistent map from file ids to the digest of the file content.
+/// @details The catalog is bound to a single volume because file ids are unique per volume only.
+class DigestCatalog {
+public:
+	struct Entry {
+		/// @brief The size of the file when the digest was calculated.
+		std::uint64_t size;
+		/// @brief The last write time of the file when the digest was calculated.
+		std::int64_t lastWriteTime;
+		/// @brief The time when the content of the file was last verified against the digest.
+		std::int64_t lastVerified;
+		Digest digest;
+	};
+
+	/// @brief Hash function for using `FILE_ID_128` as a key in unordered containers.
+	struct FileIdHash {
+		[[nodiscard]] std::size_t operator()(const FILE_ID_128& fileId) const noexcept;
+	};
+	/// @brief Equality for using `FILE_ID_128` as a key in unordered containers.
+	struct FileIdEqual {
+		[[nodiscard]] bool operator()(const FILE_ID_128& lhs, const FILE_ID_128& rhs) const noexcept;
+	};
+
+public:
+	/// @brief Create a catalog and load its content if @p path exists.
+	/// @param path The file where the catalog is stored.
+	explicit DigestCatalog(Path path);
+	DigestCatalog(const DigestCatalog&) = delete;
+	DigestCatalog(DigestCatalog&&) = delete;
+	~DigestCatalog() noexcept = default;
+
+public:
+	DigestCatalog& operator=(const DigestCatalog&) = delete;
+	DigestCatalog& operator=(DigestCatalog&&) = delete;
+
+public:
+	[[nodiscard]] std::size_t GetSize() const noexcept {
+		return m_entries.size();
+	}
+
+	/// @brief Get the entry for a file.
+	/// @param fileId The id of the file.
+	/// @return The entry or `nullptr` if the catalog does not contain the file.
+	[[nodiscard]] const Entry* Find(const FILE_ID_128& fileId) const noexcept;
+
+	/// @brief Add or replace the entry for a file.
+	/// @param fileId The id of the file.
+	/// @param entry The new entry.
+	void Set(const FILE_ID_128& fileId, const Entry& entry);
+
+	/// @brief Write the catalog to disk.
+	/// @details The data is written to a temporary file which then replaces the previous version.
+	void Save() const;
+
+private:
+	void Load();
+
+private:
+	const Path m_path;
+	std::unordered_map<FILE_ID_128, Entry, FileIdHash, FileIdEqual> m_entries;
+};
+
+}  // namespace systools
@@ -26,6 +26,9 @@ limitations under the License.
 #include <windows.h>
 
 #include <atomic>
+#include <chrono>
+#include <compare>
+#include <cstddef>
 #include <cstdint>
 #include <cstring>
 #include <memory>
@@ -139,6 +142,18 @@ public:
 		return std::memcmp(&m_fileId, &other.m_fileId, sizeof(FILE_ID_128)) == 0;
 	}
 
+	/// @brief Compare the names of two files ignoring case.
+	/// @details Most names already differ in the collation prefix calculated when scanning. Only names with the same
+	/// prefix or with non-ASCII characters in the prefix are compared character by character.
+	/// @param other The other file.
+	/// @return The same result as `GetName() <=> other.GetName()`.
+	[[nodiscard]] std::weak_ordering CompareName(const ScannedFile& other) const {
+		if (m_collationPrefix != other.m_collationPrefix && m_collationPrefix && other.m_collationPrefix) {
+			return m_collationPrefix <=> other.m_collationPrefix;
+		}
+		return m_name <=> other.m_name;
+	}
+
 
 private:
 	Filename m_name;
@@ -149,6 +164,9 @@ private:
 	FILE_ID_128 m_fileId;
 	std::vector<Stream> m_streams;
 	Security m_security;
+	/// @brief The first characters of the name in upper case packed for ordering as an integer or 0 if any of them is
+	/// not an ASCII character.
+	std::uint64_t m_collationPrefix;
 };
 
 class __declspec(novtable) ScannerFilter {
@@ -199,9 +217,14 @@ public:
 		kDefault = 0,
 		kFolderSecurity = 1,
 		kFileSecurity = 2,
-		kFolderStreams = 4
+		kFolderStreams = 4,
+		/// @brief Pause the scan after a chunk of entries until `Continue` is called, see `IsPaused`.
+		kChunked = 8
 	};
 
+	/// @brief The minimum number of entries after which a scan with `Flags::kChunked` is paused.
+	static constexpr std::size_t kDefaultChunkSize = 0x10000;
+
 	[[nodiscard]] friend constexpr Flags operator|(const Flags a, const Flags b) noexcept {
 		return static_cast<Flags>(static_cast<std::uint8_t>(a) | static_cast<std::uint8_t>(b));
 	}
@@ -216,6 +239,9 @@ private:
 
 public:
 	DirectoryScanner();
+	/// @brief Create a scanner with a custom chunk size.
+	/// @param chunkSize The minimum number of entries after which a scan with `Flags::kChunked` is paused.
+	explicit DirectoryScanner(std::size_t chunkSize);
 	DirectoryScanner(const DirectoryScanner&) = delete;
 	DirectoryScanner(DirectoryScanner&&) = delete;
 	~DirectoryScanner() noexcept;
@@ -226,17 +252,47 @@ public:
 
 public:
 	void Scan(Path path, Result& directories, Result& files, Flags flags, const ScannerFilter& filter);
+
+	/// @brief Wait until the scan is complete or paused after a chunk of entries.
 	void Wait();
 
+	/// @brief Check if the scan is paused after a chunk of entries.
+	/// @details Only scans with `Flags::kChunked` are paused. The caller may take the entries out of the results before
+	/// calling `Continue` which appends the next entries. The folder stays open while the scan is paused.
+	/// @return `true` if the scan is paused, `false` if it is complete or no scan is running.
+	[[nodiscard]] bool IsPaused() const noexcept;
+
+	/// @brief Resume a paused scan.
+	void Continue();
+
+	/// @brief Stop a paused scan without reading the remaining entries.
+	/// @details The function returns immediately if the scan is not paused.
+	void Cancel();
+
+	/// @brief Get the time callers were blocked in `Wait` since the last call of `ResetWaitTime`.
+	[[nodiscard]] std::chrono::nanoseconds GetWaitTime() const noexcept {
+		return std::chrono::nanoseconds(m_waitTime.load(std::memory_order_relaxed));
+	}
+	void ResetWaitTime() noexcept {
+		m_waitTime.store(0, std::memory_order_relaxed);
+	}
+
 private:
 	void Run() noexcept;
 
+	/// @brief Wait on the scanner thread until the paused scan is continued.
+	/// @return `true` if the scan should go on, `false` if it is cancelled or the scanner shuts down.
+	[[nodiscard]] bool Pause();
+
 private:
+	const std::size_t m_chunkSize;
 	std::unique_ptr<Context> m_pContext;
 
 	m3c::mutex m_mutex;
 	m3c::condition_variable m_stateChanged;
 	std::atomic<State> m_state;
+	std::atomic<bool> m_cancel = false;
+	std::atomic<std::chrono::nanoseconds::rep> m_waitTime = 0;
 	std::thread m_thread;
 };
 
@@ -20,8 +20,12 @@ limitations under the License.
 
 #include <m3c/mutex.h>
 
+#include <windows.h>
+
 #include <atomic>
+#include <chrono>
 #include <cstdint>
+#include <optional>
 #include <thread>
 
 
@@ -35,8 +39,17 @@ private:
 
 	struct Context;
 
+public:
+	/// @brief The size of each of the two buffers used per file if no other value is set.
+	static constexpr std::uint32_t kDefaultBufferSize = 0x10000;
+
 public:
 	FileComparer();
+
+	/// @brief Create a new instance with a custom buffer size, e.g. for benchmarks.
+	/// @param bufferSize The target size of each buffer. The actual size is rounded down to a multiple of the alignment
+	/// required by the volumes but is at least one aligned chunk.
+	explicit FileComparer(std::uint32_t bufferSize);
 	FileComparer(const FileComparer&) = delete;
 	FileComparer(FileComparer&&) = delete;
 	~FileComparer() noexcept;
@@ -48,20 +61,49 @@ public:
 public:
 	bool Compare(const Path& src, const Path& cpy);
 
+	/// @brief Update @p cpy in place by writing only the blocks which differ from @p src.
+	/// @details The target is truncated or extended to the size of @p src. Attributes and timestamps are not modified.
+	/// If the update fails, @p cpy is deleted because its content is neither the old nor the new version.
+	/// @param src The source file.
+	/// @param cpy The outdated copy of the source file.
+	/// @return The number of bytes written or `std::nullopt` if @p cpy has more than one link and must not be modified.
+	std::optional<std::uint64_t> Update(const Path& src, const Path& cpy);
+
+	/// @brief Get the number of bytes per file which the last call of `Compare` has compared before returning.
+	/// @details The value is less than the file size if the files differ.
+	[[nodiscard]] std::uint64_t GetBytesCompared() const noexcept;
+
+	/// @brief Get the time the calling thread was blocked waiting for the reader threads since the last call of
+	/// `ResetWaitTime`.
+	[[nodiscard]] std::chrono::nanoseconds GetWaitTime() const noexcept;
+
+	/// @brief Get the time a reader thread was blocked waiting for a free buffer since the last call of `ResetWaitTime`.
+	/// @param index 0 for the thread reading the source, 1 for the thread reading the copy.
+	[[nodiscard]] std::chrono::nanoseconds GetReaderWaitTime(std::uint_fast8_t index) const noexcept;
+
+	void ResetWaitTime() noexcept;
+
 private:
+	bool Execute(const Path& src, const Path& cpy, HANDLE hTarget, std::uint64_t* pBytesWritten);
 	bool CompareFiles(Context& context);
+	void UpdateFiles(Context& context, std::uint64_t& bytesWritten);
+	void Abort();
 
 	void Run(std::uint_fast8_t index) noexcept;
 	void ReadFileContent(std::uint_fast8_t index) noexcept;
 
 private:
+	const std::uint32_t m_bufferSize;
 	Context* m_pContext;
 
 	m3c::mutex m_mutex;
 	m3c::condition_variable m_clients;
 	m3c::condition_variable m_master;
-	std::atomic<State> m_state[2];  // NOLINT(modernize-use-default-member-init): Keep code out of the header.
-	std::thread m_thread[2];        // NOLINT(modernize-use-default-member-init): Keep code out of the header.
+	std::uint64_t m_bytesCompared;
+	std::atomic<State> m_state[2];                                   // NOLINT(modernize-use-default-member-init): Keep code out of the header.
+	std::atomic<std::chrono::nanoseconds::rep> m_waitTime;           // NOLINT(modernize-use-default-member-init): Keep code out of the header.
+	std::atomic<std::chrono::nanoseconds::rep> m_readerWaitTime[2];  // NOLINT(modernize-use-default-member-init): Keep code out of the header.
+	std::thread m_thread[2];                                         // NOLINT(modernize-use-default-member-init): Keep code out of the header.
 };
 
 }  // namespace systools
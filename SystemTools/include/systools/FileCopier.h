@@ -0,0 +1,63 @@
+/*
+Copyright 2020 Michael Beckh
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+/// @file
+
+#pragma once
+
+#include "systools/Digest.h"
+
+#include <cstdint>
+
+namespace systools {
+
+class Path;
+
+/// @brief Copies the unnamed data stream of a file using unbuffered I/O with several requests in flight.
+/// @details Attributes, timestamps, security and alternate data streams are not copied.
+class FileCopier {
+public:
+	static constexpr std::uint32_t kDefaultBufferSize = 0x100000;
+	static constexpr std::uint8_t kDefaultQueueDepth = 4;
+
+public:
+	/// @brief Create a new instance.
+	/// @param bufferSize The target size of a single I/O request. The actual size is adjusted to the alignment requirements of the volumes.
+	/// @param queueDepth The maximum number of buffers in use at the same time. Must be at least 2.
+	explicit FileCopier(std::uint32_t bufferSize = kDefaultBufferSize, std::uint8_t queueDepth = kDefaultQueueDepth) noexcept;
+	FileCopier(const FileCopier&) = delete;
+	FileCopier(FileCopier&&) = delete;
+	~FileCopier() noexcept = default;
+
+public:
+	FileCopier& operator=(const FileCopier&) = delete;
+	FileCopier& operator=(FileCopier&&) = delete;
+
+public:
+	/// @brief Copy the content of @p src to a new file @p cpy.
+	/// @details The space for the target is allocated before copying. An incomplete target is deleted on error.
+	/// @param src The source file.
+	/// @param cpy The target which must not exist.
+	/// @param pDigest If not `nullptr`, receives the digest of the data while it is copied.
+	/// @return The number of bytes copied.
+	std::uint64_t Copy(const Path& src, const Path& cpy, Digest* pDigest);
+
+private:
+	const std::uint32_t m_bufferSize;
+	const std::uint8_t m_queueDepth;
+};
+
+}  // namespace systools
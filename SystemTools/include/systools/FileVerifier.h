@@ -0,0 +1,81 @@
+/*
+Copyright 2020 Michael Beckh
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+/// @file
+
+#pragma once
+
+#include "systools/Digest.h"
+#include "systools/Path.h"
+
+#include <m3c/mutex.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace systools {
+
+/// @brief Rereads copied files in a background thread and compares them with the digest calculated during the copy.
+/// @details Files are read using unbuffered I/O so that verification does not fill the cache with backup data. The
+/// thread runs with background priority and the read rate can be limited to leave bandwidth for copying.
+class FileVerifier {
+public:
+	/// @brief Create a new instance and start the background thread.
+	/// @param maxBytesPerSecond The maximum read rate or 0 for no limit.
+	explicit FileVerifier(std::uint64_t maxBytesPerSecond = 0);
+	FileVerifier(const FileVerifier&) = delete;
+	FileVerifier(FileVerifier&&) = delete;
+	~FileVerifier() noexcept;
+
+public:
+	FileVerifier& operator=(const FileVerifier&) = delete;
+	FileVerifier& operator=(FileVerifier&&) = delete;
+
+public:
+	/// @brief Queue a file for verification and return immediately.
+	/// @param path The file to verify.
+	/// @param digest The expected digest of the file content.
+	void Verify(const Path& path, const Digest& digest);
+
+	/// @brief Wait until all queued files are verified.
+	/// @return All files which could not be read or did not match the digest since the last call.
+	[[nodiscard]] std::vector<Path> Wait();
+
+	/// @brief Get the number of files which are queued or currently verified.
+	[[nodiscard]] std::size_t GetPending() const;
+
+private:
+	void Run() noexcept;
+	[[nodiscard]] bool VerifyFile(const Path& path, const Digest& digest);
+
+private:
+	const std::uint64_t m_maxBytesPerSecond;
+
+	mutable m3c::mutex m_mutex;
+	m3c::condition_variable m_worker;
+	m3c::condition_variable m_master;
+	std::deque<std::pair<Path, Digest>> m_queue;
+	std::vector<Path> m_failed;
+	bool m_busy = false;
+	bool m_shutdown = false;
+	std::thread m_thread;
+};
+
+}  // namespace systools
@@ -0,0 +1,121 @@
+/*
+Copyright 2020 Michael Beckh
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+/// @file
+
+#pragma once
+
+#include <systools/BackupStrategy.h>
+#include <systools/Digest.h>
+#include <systools/DirectoryScanner.h>
+#include <systools/LatencyHistogram.h>
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#ifdef __clang_analyzer__
+// Avoid collisions with Windows API defines
+#undef CreateDirectory
+#undef CreateHardLink
+#endif
+
+namespace systools {
+
+class Path;
+class FileComparer;
+
+/// @brief A `BackupStrategy` which forwards all calls to another strategy and records the duration of each call.
+/// @details `Scan` only measures the time for starting a scan, the time until the scan is finished is recorded for
+/// `WaitForScan`. Calls which throw an exception are recorded as well.
+class InstrumentedBackupStrategy final : public BackupStrategy {
+public:
+	enum class Operation : std::uint_fast8_t {
+		kExists,
+		kIsDirectory,
+		kCompare,
+		kCreateDirectory,
+		kCreateDirectoryRecursive,
+		kSetAttributes,
+		kSetSecurity,
+		kRename,
+		kCopy,
+		kClone,
+		kUpdate,
+		kCreateHardLink,
+		kDelete,
+		kScan,
+		kWaitForScan,
+		kCount  // NOLINT(readability-identifier-naming): Number of operations, not an operation.
+	};
+
+public:
+	/// @brief Create a new instance.
+	/// @param strategy The strategy which performs all operations.
+	explicit InstrumentedBackupStrategy(const BackupStrategy& strategy) noexcept;
+	InstrumentedBackupStrategy(const InstrumentedBackupStrategy&) = delete;
+	InstrumentedBackupStrategy(InstrumentedBackupStrategy&&) = delete;
+	virtual ~InstrumentedBackupStrategy() noexcept = default;
+
+public:
+	InstrumentedBackupStrategy& operator=(const InstrumentedBackupStrategy&) = delete;
+	InstrumentedBackupStrategy& operator=(InstrumentedBackupStrategy&&) = delete;
+
+public:
+	// Path Operations
+	[[nodiscard]] bool Exists(const Path& path) const final;
+	[[nodiscard]] bool IsDirectory(const Path& path) const final;
+
+	// File Operations
+	bool Compare(const Path& src, const Path& target, FileComparer& fileComparer) const final;
+	void CreateDirectory(const Path& path, const Path& templatePath, const ScannedFile& securitySource) const final;
+	void CreateDirectoryRecursive(const Path& path) const final;
+	void SetAttributes(const Path& path, const ScannedFile& attributesSource) const final;
+	void SetSecurity(const Path& path, const ScannedFile& securitySource) const final;
+	void Rename(const Path& existingName, const Path& newName) const final;
+	std::optional<Digest> Copy(const Path& source, const Path& target, const ScannedFile& sourceFile, bool calculateDigest) const final;
+	bool Clone(const Path& source, const Path& target, const ScannedFile& sourceFile) const final;
+	std::optional<std::uint64_t> Update(const Path& source, const Path& target, FileComparer& fileComparer) const final;
+	void CreateHardLink(const Path& path, const Path& existing) const final;
+	void Delete(const Path& path) const final;
+
+	// Scan Operations
+	void Scan(const Path& path, DirectoryScanner& scanner, std::vector<ScannedFile>& directories, std::vector<ScannedFile>& files, DirectoryScanner::Flags flags, const ScannerFilter& filter) const final;
+	void WaitForScan(DirectoryScanner& scanner) const final;
+
+public:
+	[[nodiscard]] const LatencyHistogram& GetHistogram(Operation operation) const noexcept {
+		return m_histograms[static_cast<std::size_t>(operation)];
+	}
+
+	[[nodiscard]] static const char* GetName(Operation operation) noexcept;
+
+	/// @brief Write count, total time and percentiles of all operations which have been called to the log.
+	void LogStatistics() const;
+
+private:
+	template <typename Function>
+	auto Measure(Operation operation, Function function) const;
+
+private:
+	const BackupStrategy& m_strategy;
+	mutable std::array<LatencyHistogram, static_cast<std::size_t>(Operation::kCount)> m_histograms;
+};
+
+}  // namespace systools
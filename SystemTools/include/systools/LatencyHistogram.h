@@ -0,0 +1,78 @@
+/*
+Copyright 2020 Michael Beckh
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+/// @file
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace systools {
+
+/// @brief A lock-free histogram of durations in the style of HDR histograms.
+/// @details Durations are counted in buckets with a relative width of at most 1/32, i.e. any percentile is reported
+/// with an error of about 3 %. Recording a value is a few relaxed atomic operations, so a single instance may be
+/// updated from multiple threads on hot paths.
+class LatencyHistogram final {
+public:
+	LatencyHistogram() noexcept = default;
+	LatencyHistogram(const LatencyHistogram&) = delete;
+	LatencyHistogram(LatencyHistogram&&) = delete;
+	~LatencyHistogram() noexcept = default;
+
+public:
+	LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+	LatencyHistogram& operator=(LatencyHistogram&&) = delete;
+
+public:
+	void Record(std::chrono::nanoseconds duration) noexcept;
+
+	[[nodiscard]] std::uint64_t GetCount() const noexcept {
+		return m_count.load(std::memory_order_relaxed);
+	}
+	[[nodiscard]] std::chrono::nanoseconds GetTotal() const noexcept {
+		return std::chrono::nanoseconds(m_total.load(std::memory_order_relaxed));
+	}
+	[[nodiscard]] std::chrono::nanoseconds GetMax() const noexcept {
+		return std::chrono::nanoseconds(m_max.load(std::memory_order_relaxed));
+	}
+
+	/// @brief Get the duration which is not exceeded by a share of all recorded durations.
+	/// @param percentile The share in percent, e.g. 99.9.
+	/// @return The upper bound of the bucket which holds the percentile or 0 if no values have been recorded.
+	[[nodiscard]] std::chrono::nanoseconds GetPercentile(double percentile) const noexcept;
+
+private:
+	static constexpr std::uint_fast8_t kSubBucketBits = 5;
+	static constexpr std::size_t kSubBuckets = 1U << kSubBucketBits;
+	/// @brief One group of buckets for small values and one for each further bit of a 64 bit value.
+	static constexpr std::size_t kBuckets = kSubBuckets * (64 - kSubBucketBits + 1);
+
+	[[nodiscard]] static std::size_t GetIndex(std::uint64_t value) noexcept;
+	[[nodiscard]] static std::uint64_t GetUpperBound(std::size_t index) noexcept;
+
+private:
+	std::array<std::atomic_uint64_t, kBuckets> m_buckets{};
+	std::atomic_uint64_t m_count = 0;
+	std::atomic_uint64_t m_total = 0;
+	std::atomic_uint64_t m_max = 0;
+};
+
+}  // namespace systools
@@ -28,9 +28,11 @@ limitations under the License.
 #include <cstddef>
 #include <cstdint>
 #include <functional>
+#include <memory>
 #include <string>
 #include <string_view>
 #include <utility>
+#include <variant>
 
 #ifndef SYSTOOLS_NO_INLINE
 #define SYSTOOLS_NO_INLINE
@@ -212,9 +214,12 @@ public:
 	Path(const Path& path, const std::wstring_view& sub)
 		: Path(path, sub.data(), sub.size()) {
 	}
-	Path(const Path& path, const Filename& sub)
-		: Path(path, sub.sv()) {
-	}
+	/// @brief Creates a new path from a @p path and a @p sub path.
+	/// @details A `Filename` is usually a single path component, e.g. from a directory listing. In this case it is
+	/// appended without calling the shell API for canonicalization.
+	/// @param path The `Path` object.
+	/// @param sub The file name to append.
+	Path(const Path& path, const Filename& sub);
 
 public:
 	~Path() noexcept = default;
@@ -308,8 +313,87 @@ public:
 	/// @return A hash value calculated based on the string value.
 	[[nodiscard]] std::size_t hash() const noexcept;  // NOLINT(readability-identifier-naming): Naming relates to STL types.
 
+private:
+	/// @brief Replace everything after the first @p size characters by a separator and @p filename.
+	/// @param size The length of the parent path.
+	/// @param filename A single path component which must be valid for appending without canonicalization.
+	void AppendFilename(std::size_t size, const std::wstring_view& filename);
+
 private:
 	string_type m_path;
+
+	friend class PathBuilder;
+	friend class PathNode;
+};
+
+/// @brief Creates the paths of the entries of a folder reusing the same buffer for all of them.
+class PathBuilder {
+public:
+	/// @brief Create a new instance.
+	/// @param parent The path of the folder.
+	explicit PathBuilder(const Path& parent)
+		: m_parent(parent)
+		, m_path(parent) {
+		// empty
+	}
+	PathBuilder(const PathBuilder&) = delete;
+	PathBuilder(PathBuilder&&) = delete;
+	~PathBuilder() noexcept = default;
+
+public:
+	PathBuilder& operator=(const PathBuilder&) = delete;
+	PathBuilder& operator=(PathBuilder&&) = delete;
+
+public:
+	/// @brief Get the path of an entry in the folder.
+	/// @param filename The name of the entry.
+	/// @return The path which is valid until the next call.
+	[[nodiscard]] const Path& GetChild(const Filename& filename);
+
+private:
+	const Path m_parent;
+	Path m_path;
+	/// @brief `true` if @p m_path does no longer start with @p m_parent.
+	bool m_replaced = false;
+};
+
+/// @brief A path stored as a reference to the node of the parent folder and a name.
+/// @details All entries of a tree share the nodes of their parent folders, i.e. common prefixes are stored only once.
+/// The full path is only created when required, e.g. for calling the Windows API.
+class PathNode {
+public:
+	/// @brief Create the root node of a tree.
+	/// @param root The path of the root folder.
+	explicit PathNode(Path root);
+
+	/// @brief Create a node for an entry of a folder.
+	/// @param parent The node of the folder.
+	/// @param name The name of the entry.
+	PathNode(std::shared_ptr<const PathNode> parent, Filename name);
+
+	PathNode(const PathNode&) = default;
+	PathNode(PathNode&&) noexcept = default;
+	~PathNode() noexcept = default;
+
+public:
+	PathNode& operator=(const PathNode&) = default;
+	PathNode& operator=(PathNode&&) noexcept = default;
+
+public:
+	/// @brief Get the node of the parent folder.
+	/// @return The parent or `nullptr` for the root node.
+	[[nodiscard]] const std::shared_ptr<const PathNode>& GetParent() const noexcept {
+		return m_parent;
+	}
+
+	/// @brief Create the full path.
+	/// @return The path.
+	[[nodiscard]] Path GetPath() const;
+
+private:
+	std::shared_ptr<const PathNode> m_parent;
+	/// @brief The root path for the root node, else the name of the entry.
+	std::variant<Path, Filename> m_name;
 };
 
 /// @brief Swap function.
@@ -0,0 +1,181 @@
+/*
+Copyright 2020 Michael Beckh
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+/// @file
+
+#pragma once
+
+#include <m3c/Handle.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <thread>
+
+namespace systools {
+
+/// @brief Thread-safe counters for the progress of a running backup.
+/// @details Counters are updated using relaxed atomic operations which makes updates cheap enough for every file. All
+/// functions may be called from any thread while the backup is running.
+class Progress final {
+public:
+	/// @brief A copy of the counters at a point in time.
+	class Snapshot {
+	public:
+		/// @brief Get the time since the start of the backup.
+		[[nodiscard]] std::chrono::steady_clock::duration GetElapsed() const noexcept {
+			return m_elapsed;
+		}
+		/// @brief Get the number of directories which have been processed.
+		[[nodiscard]] std::uint64_t GetDirectories() const noexcept {
+			return m_directories;
+		}
+		/// @brief Get the number of files which have been processed.
+		[[nodiscard]] std::uint64_t GetFiles() const noexcept {
+			return m_files;
+		}
+		/// @brief Get the number of files which have been deleted from the destination.
+		[[nodiscard]] std::uint64_t GetFilesDeleted() const noexcept {
+			return m_filesDeleted;
+		}
+		/// @brief Get the number of bytes of source files which have been compared to an existing copy.
+		/// @details Comparisons which stop at the first difference only count the bytes read until then.
+		[[nodiscard]] std::uint64_t GetBytesCompared() const noexcept {
+			return m_bytesCompared;
+		}
+		/// @brief Get the number of bytes which have been copied or written to update a copy.
+		[[nodiscard]] std::uint64_t GetBytesCopied() const noexcept {
+			return m_bytesCopied;
+		}
+		/// @brief Get the number of bytes of files which have been created as hard links.
+		[[nodiscard]] std::uint64_t GetBytesLinked() const noexcept {
+			return m_bytesLinked;
+		}
+		/// @brief Get the number of copied files which are waiting for verification.
+		[[nodiscard]] std::uint64_t GetVerificationPending() const noexcept {
+			return m_verificationPending;
+		}
+		/// @brief Get the rate of bytes compared, copied or linked since the previous snapshot.
+		/// @details The rate is only available for snapshots passed to the callback of a `ProgressReporter`.
+		[[nodiscard]] std::uint64_t GetBytesPerSecond() const noexcept {
+			return m_bytesPerSecond;
+		}
+
+	private:
+		std::chrono::steady_clock::duration m_elapsed{};
+		std::uint64_t m_directories = 0;
+		std::uint64_t m_files = 0;
+		std::uint64_t m_filesDeleted = 0;
+		std::uint64_t m_bytesCompared = 0;
+		std::uint64_t m_bytesCopied = 0;
+		std::uint64_t m_bytesLinked = 0;
+		std::uint64_t m_verificationPending = 0;
+		std::uint64_t m_bytesPerSecond = 0;
+
+		friend class Progress;
+		friend class ProgressReporter;
+	};
+
+public:
+	Progress() noexcept;
+	Progress(const Progress&) = delete;
+	Progress(Progress&&) = delete;
+	~Progress() noexcept = default;
+
+public:
+	Progress& operator=(const Progress&) = delete;
+	Progress& operator=(Progress&&) = delete;
+
+public:
+	/// @brief Set all counters to 0 and restart the elapsed time.
+	void Reset() noexcept;
+
+	/// @brief Count a directory which has been processed.
+	void OnDirectory() noexcept {
+		m_directories.fetch_add(1, std::memory_order_relaxed);
+	}
+	/// @brief Count a source file which has been processed.
+	void OnFile() noexcept {
+		m_files.fetch_add(1, std::memory_order_relaxed);
+	}
+	/// @brief Count a file which has been deleted from the destination.
+	void OnDelete() noexcept {
+		m_filesDeleted.fetch_add(1, std::memory_order_relaxed);
+	}
+	/// @brief Add the number of bytes which have actually been compared.
+	void OnCompare(const std::uint64_t bytes) noexcept {
+		m_bytesCompared.fetch_add(bytes, std::memory_order_relaxed);
+	}
+	/// @brief Add the number of bytes which have been copied or written.
+	void OnCopy(const std::uint64_t bytes) noexcept {
+		m_bytesCopied.fetch_add(bytes, std::memory_order_relaxed);
+	}
+	/// @brief Add the size of a file which has been created as a hard link.
+	void OnHardLink(const std::uint64_t bytes) noexcept {
+		m_bytesLinked.fetch_add(bytes, std::memory_order_relaxed);
+	}
+
+	/// @brief Get the current values of all counters.
+	/// @param verificationPending The number of files waiting for verification.
+	/// @return A copy of the counters. The values are not synchronized with each other.
+	[[nodiscard]] Snapshot GetSnapshot(std::uint64_t verificationPending = 0) const noexcept;
+
+private:
+	std::atomic<std::chrono::steady_clock::rep> m_start;
+	std::atomic_uint64_t m_directories = 0;
+	std::atomic_uint64_t m_files = 0;
+	std::atomic_uint64_t m_filesDeleted = 0;
+	std::atomic_uint64_t m_bytesCompared = 0;
+	std::atomic_uint64_t m_bytesCopied = 0;
+	std::atomic_uint64_t m_bytesLinked = 0;
+};
+
+/// @brief Passes snapshots of the progress to a callback in regular intervals using a background thread.
+/// @details A last snapshot is reported when the instance is destroyed.
+class ProgressReporter final {
+public:
+	using Source = std::function<Progress::Snapshot()>;
+	using Callback = std::function<void(const Progress::Snapshot&)>;
+
+public:
+	/// @brief Create a new instance and start the background thread.
+	/// @param source A function returning the current progress.
+	/// @param interval The time between two calls of @p callback.
+	/// @param callback A function which is called with the progress from the background thread.
+	ProgressReporter(Source source, std::chrono::milliseconds interval, Callback callback);
+	ProgressReporter(const ProgressReporter&) = delete;
+	ProgressReporter(ProgressReporter&&) = delete;
+	~ProgressReporter() noexcept;
+
+public:
+	ProgressReporter& operator=(const ProgressReporter&) = delete;
+	ProgressReporter& operator=(ProgressReporter&&) = delete;
+
+private:
+	void Run() noexcept;
+	void Report() noexcept;
+
+private:
+	const Source m_source;
+	const std::chrono::milliseconds m_interval;
+	const Callback m_callback;
+	Progress::Snapshot m_last;
+	m3c::Handle m_hShutdown;
+	std::thread m_thread;
+};
+
+}  // namespace systools
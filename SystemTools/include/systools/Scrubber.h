@@ -0,0 +1,93 @@
+/*
+Copyright 2020 Michael Beckh
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+/// @file
+
+#pragma once
+
+#include "systools/DirectoryScanner.h"
+#include "systools/Path.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace systools {
+
+class DigestCatalog;
+
+/// @brief Rereads the files of existing backups and compares them with the digests in a `DigestCatalog`.
+/// @details Files with more than one link are read only once. Files which are not yet in the catalog or which were
+/// modified since the digest was calculated are added to the catalog.
+class Scrubber {
+public:
+	class Statistics {
+	public:
+		[[nodiscard]] std::uint64_t GetFilesVerified() const noexcept {
+			return m_filesVerified;
+		}
+		[[nodiscard]] std::uint64_t GetFilesAdded() const noexcept {
+			return m_filesAdded;
+		}
+		[[nodiscard]] std::uint64_t GetFilesSkipped() const noexcept {
+			return m_filesSkipped;
+		}
+		[[nodiscard]] std::uint64_t GetBytesRead() const noexcept {
+			return m_bytesRead;
+		}
+		/// @brief Get the files which could not be read or did not match the digest.
+		[[nodiscard]] const std::vector<Path>& GetFailed() const noexcept {
+			return m_failed;
+		}
+
+	private:
+		std::uint64_t m_filesVerified = 0;
+		std::uint64_t m_filesAdded = 0;
+		std::uint64_t m_filesSkipped = 0;
+		std::uint64_t m_bytesRead = 0;
+		std::vector<Path> m_failed;
+
+		friend class Scrubber;
+	};
+
+public:
+	/// @brief Create a new instance.
+	/// @param catalog The catalog with the expected digests. The catalog is updated while scrubbing.
+	/// @param maxBytesPerSecond The maximum read rate or 0 for no limit.
+	Scrubber(DigestCatalog& catalog, std::uint64_t maxBytesPerSecond) noexcept;
+	Scrubber(const Scrubber&) = delete;
+	Scrubber(Scrubber&&) = delete;
+	~Scrubber() noexcept = default;
+
+public:
+	Scrubber& operator=(const Scrubber&) = delete;
+	Scrubber& operator=(Scrubber&&) = delete;
+
+public:
+	/// @brief Verify all files in a folder and its sub folders.
+	/// @details The catalog is saved regularly. To resume an interrupted run, pass the same value for
+	/// @p notVerifiedSince.
+	/// @param root The folder, e.g. the root folder of the backups on a disk.
+	/// @param notVerifiedSince Files which were verified at or after this time are skipped (as `FILETIME` ticks).
+	/// @return The results of the run.
+	Statistics Scrub(const Path& root, std::int64_t notVerifiedSince);
+
+private:
+	DigestCatalog& m_catalog;
+	const std::uint64_t m_maxBytesPerSecond;
+	DirectoryScanner m_scanner;
+};
+
+}  // namespace systools
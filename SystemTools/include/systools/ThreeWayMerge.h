@@ -19,32 +19,90 @@ limitations under the License.
 #pragma once
 
 #include <algorithm>
+#include <array>
 #include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <iterator>
 #include <optional>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 namespace systools {
 
-template <typename Src, typename Ref, typename Dst, typename Copy, typename Extra, typename Compare>
-void ThreeWayMerge(Src& src, Ref& ref, Dst& dst, Copy& copy, Extra& extra, Compare compare) {
-	static_assert(std::is_same_v<typename Src::value_type, typename Ref::value_type>);
-	static_assert(std::is_same_v<typename Src::value_type, typename Dst::value_type>);
-	static_assert(std::is_same_v<typename Copy::value_type, typename Extra::value_type>);
-	static_assert(std::is_invocable_r_v<int, Compare, const Src::value_type&, const Src::value_type&>);
+namespace internal {
 
-	const auto cmp = [compare](const Src::value_type& lhs, const Src::value_type& rhs) {
-		return compare(lhs, rhs) < 0;
-	};
-	std::sort(src.begin(), src.end(), cmp);
-	std::sort(ref.begin(), ref.end(), cmp);
-	std::sort(dst.begin(), dst.end(), cmp);
+/// @brief A sink for `ThreeWayMerge` which drops all entries which exist in the reference copy only.
+template <typename T>
+struct DiscardUnmatched {
+	using value_type = T;  // NOLINT(readability-identifier-naming): Follow naming of STL containers.
+
+	void push_back(const T& /* value */) const noexcept {  // NOLINT(readability-identifier-naming, readability-convert-member-functions-to-static): Follow naming of STL containers.
+		// empty
+	}
+};
+
+/// @brief Minimum number of entries for sorting a sequence on a separate thread.
+inline constexpr std::size_t kParallelSortThreshold = 8192;
+
+/// @brief Sort a sequence unless it is already sorted.
+/// @details Large sequences which require sorting are sorted asynchronously.
+/// @param container The sequence to sort.
+/// @param cmp A comparison function returning `true` if the first argument is less than the second.
+/// @return A `std::future` to wait for if the sequence is sorted asynchronously, else an empty `std::future`.
+template <typename T, typename Compare>
+[[nodiscard]] std::future<void> SortIfRequired(T& container, const Compare& cmp) {
+	// NTFS returns entries in collation order, so most sequences require no sorting at all
+	if (std::is_sorted(container.begin(), container.end(), cmp)) {
+		return {};
+	}
+	if (container.size() < kParallelSortThreshold) {
+		std::sort(container.begin(), container.end(), cmp);
+		return {};
+	}
+	return std::async(std::launch::async, [&container, &cmp]() {
+		std::sort(container.begin(), container.end(), cmp);
+	});
+}
+
+/// @brief Get an iterator which moves the entries out of a container passed as rvalue and copies them otherwise.
+/// @tparam T The deduced type of a forwarding reference to the container.
+/// @param it An iterator of the container.
+/// @return Either @p it or a `std::move_iterator` wrapping @p it.
+template <typename T, typename It>
+[[nodiscard]] auto MakeMergeIterator(It it) noexcept {
+	if constexpr (std::is_lvalue_reference_v<T>) {
+		return it;
+	} else {
+		return std::make_move_iterator(it);
+	}
+}
 
-	auto srcBegin = src.cbegin();
-	auto refBegin = ref.cbegin();
-	auto dstBegin = dst.cbegin();
+}  // namespace internal
 
-	const auto srcEnd = src.cend();
-	const auto refEnd = ref.cend();
-	const auto dstEnd = dst.cend();
+/// @brief Merge the already sorted entries of source, reference and destination.
+/// @details This is the merge step of `ThreeWayMerge`. Every range is traversed once, therefore input iterators are
+/// sufficient. All entries which exist in the reference copy only are added to @p unmatched. They are candidates for
+/// pairing with new entries in @p copy if a file has been renamed in the source.
+/// @param srcBegin The start of the sorted entries in the source.
+/// @param srcEnd The end of the sorted entries in the source.
+/// @param refBegin The start of the sorted entries in the reference copy.
+/// @param refEnd The end of the sorted entries in the reference copy.
+/// @param dstBegin The start of the sorted entries in the destination.
+/// @param dstEnd The end of the sorted entries in the destination.
+/// @param copy Receives all entries which exist in the source.
+/// @param extra Receives all entries which exist in the destination but not in the source.
+/// @param unmatched Receives all entries which exist in the reference copy only.
+/// @param compare A comparison function returning a value less than, equal to or greater than 0.
+template <typename SrcIt, typename RefIt, typename DstIt, typename Copy, typename Extra, typename Unmatched, typename Compare>
+void ThreeWayMergeSorted(SrcIt srcBegin, const SrcIt srcEnd, RefIt refBegin, const RefIt refEnd, DstIt dstBegin, const DstIt dstEnd, Copy& copy, Extra& extra, Unmatched& unmatched, const Compare& compare) {
+	static_assert(std::is_same_v<std::iter_value_t<SrcIt>, std::iter_value_t<RefIt>>);
+	static_assert(std::is_same_v<std::iter_value_t<SrcIt>, std::iter_value_t<DstIt>>);
+	static_assert(std::is_same_v<std::iter_value_t<SrcIt>, typename Unmatched::value_type>);
+	static_assert(std::is_same_v<typename Copy::value_type, typename Extra::value_type>);
+	static_assert(std::is_invocable_r_v<int, Compare, const std::iter_value_t<SrcIt>&, const std::iter_value_t<SrcIt>&>);
 
 	while (true) {
 		const bool hasSrc = srcBegin != srcEnd;
@@ -83,7 +141,8 @@ void ThreeWayMerge(Src& src, Ref& ref, Dst& dst, Copy& copy, Extra& extra, Compa
 			++dstBegin;
 		} else if (cmpSrcRef > 0 && cmpRefDst < 0) {
 			assert(hasRef);
-			// exists in reference copy only -> not relevant
+			// exists in reference copy only -> only relevant for detecting renames
+			unmatched.push_back(*refBegin);
 			++refBegin;
 		} else if (cmpSrcRef > 0 && cmpRefDst == 0) {
 			assert(cmpSrcDst > 0);
@@ -101,4 +160,206 @@ void ThreeWayMerge(Src& src, Ref& ref, Dst& dst, Copy& copy, Extra& extra, Compa
 	}
 }
 
+/// @brief Sort and merge the entries of source, reference and destination.
+/// @details Entries of containers passed as rvalue are moved into the results, else they are copied. All entries which exist in the reference copy only are added to @p unmatched. They are candidates for
+/// pairing with new entries in @p copy if a file has been renamed in the source.
+/// @param src The entries in the source.
+/// @param ref The entries in the reference copy.
+/// @param dst The entries in the destination.
+/// @param copy Receives all entries which exist in @p src.
+/// @param extra Receives all entries which exist in @p dst but not in @p src.
+/// @param unmatched Receives all entries which exist in @p ref only.
+/// @param compare A comparison function returning a value less than, equal to or greater than 0.
+template <typename Src, typename Ref, typename Dst, typename Copy, typename Extra, typename Unmatched, typename Compare>
+void ThreeWayMerge(Src&& src, Ref&& ref, Dst&& dst, Copy& copy, Extra& extra, Unmatched& unmatched, Compare compare) {
+	using value_type = typename std::remove_cvref_t<Src>::value_type;  // NOLINT(readability-identifier-naming): Follow naming of STL containers.
+	static_assert(std::is_same_v<value_type, typename std::remove_cvref_t<Ref>::value_type>);
+	static_assert(std::is_same_v<value_type, typename std::remove_cvref_t<Dst>::value_type>);
+	static_assert(std::is_same_v<value_type, typename Unmatched::value_type>);
+	static_assert(std::is_same_v<typename Copy::value_type, typename Extra::value_type>);
+	static_assert(std::is_invocable_r_v<int, Compare, const value_type&, const value_type&>);
+
+	const auto cmp = [compare](const value_type& lhs, const value_type& rhs) {
+		return compare(lhs, rhs) < 0;
+	};
+	{
+		// destructors of futures returned by std::async wait for completion even if an exception is thrown
+		std::future<void> srcSorted = internal::SortIfRequired(src, cmp);
+		std::future<void> refSorted = internal::SortIfRequired(ref, cmp);
+		std::future<void> dstSorted = internal::SortIfRequired(dst, cmp);
+		if (srcSorted.valid()) {
+			srcSorted.get();
+		}
+		if (refSorted.valid()) {
+			refSorted.get();
+		}
+		if (dstSorted.valid()) {
+			dstSorted.get();
+		}
+	}
+
+	ThreeWayMergeSorted(internal::MakeMergeIterator<Src>(src.begin()), internal::MakeMergeIterator<Src>(src.end()),
+						internal::MakeMergeIterator<Ref>(ref.begin()), internal::MakeMergeIterator<Ref>(ref.end()),
+						internal::MakeMergeIterator<Dst>(dst.begin()), internal::MakeMergeIterator<Dst>(dst.end()),
+						copy, extra, unmatched, compare);
+}
+
+template <typename Src, typename Ref, typename Dst, typename Copy, typename Extra, typename Compare>
+void ThreeWayMerge(Src&& src, Ref&& ref, Dst&& dst, Copy& copy, Extra& extra, Compare compare) {
+	internal::DiscardUnmatched<typename std::remove_cvref_t<Ref>::value_type> unmatched;
+	ThreeWayMerge(std::forward<Src>(src), std::forward<Ref>(ref), std::forward<Dst>(dst), copy, extra, unmatched, std::move(compare));
+}
+
+/// @brief Merge the entries of source, reference and destination which arrive in chunks while they are scanned.
+/// @details Every side must deliver its entries in ascending order, only the entries within a chunk are sorted if
+/// required. `Merge` emits all entries which cannot be matched by entries of later chunks, i.e. which are not greater
+/// than the last entry received from any side which is still open. Memory is bounded by the size of the chunks and not
+/// by the size of the listing as long as the caller only requests more entries for sides which are drained.
+/// @tparam T The type of the entries.
+/// @tparam Compare A comparison function returning a value less than, equal to or greater than 0.
+template <typename T, typename Compare = int (*)(const T&, const T&)>
+class ThreeWayMergeStream {
+public:
+	enum class Side : std::uint_fast8_t {
+		kSrc = 0,
+		kRef = 1,
+		kDst = 2
+	};
+
+public:
+	explicit ThreeWayMergeStream(Compare compare) noexcept(std::is_nothrow_move_constructible_v<Compare>)
+		: m_compare(std::move(compare)) {
+		static_assert(std::is_invocable_r_v<int, Compare, const T&, const T&>);
+	}
+	ThreeWayMergeStream(const ThreeWayMergeStream&) = delete;
+	ThreeWayMergeStream(ThreeWayMergeStream&&) = delete;
+	~ThreeWayMergeStream() noexcept = default;
+
+public:
+	ThreeWayMergeStream& operator=(const ThreeWayMergeStream&) = delete;
+	ThreeWayMergeStream& operator=(ThreeWayMergeStream&&) = delete;
+
+public:
+	/// @brief Add the next chunk of entries of a side.
+	/// @param side The side which delivered the entries.
+	/// @param chunk The entries. The vector is moved into the pending entries if possible.
+	/// @return `false` if the chunk contains an entry which is not greater than an entry already merged, i.e. the side
+	/// is not sorted. The chunk is not added in this case.
+	[[nodiscard]] bool Append(const Side side, std::vector<T>&& chunk) {
+		const std::size_t index = static_cast<std::size_t>(side);
+		assert(!m_closed[index]);
+		if (chunk.empty()) {
+			return true;
+		}
+
+		const auto cmp = [this](const T& lhs, const T& rhs) {
+			return m_compare(lhs, rhs) < 0;
+		};
+		if (std::future<void> sorted = internal::SortIfRequired(chunk, cmp); sorted.valid()) {
+			sorted.get();
+		}
+		if (m_merged.has_value() && m_compare(chunk.front(), *m_merged) <= 0) {
+			return false;
+		}
+
+		if (!m_last[index].has_value() || m_compare(*m_last[index], chunk.back()) < 0) {
+			m_last[index] = chunk.back();
+		}
+		std::vector<T>& pending = m_pending[index];
+		if (pending.empty()) {
+			pending = std::move(chunk);
+		} else {
+			const std::size_t size = pending.size();
+			pending.insert(pending.end(), std::make_move_iterator(chunk.begin()), std::make_move_iterator(chunk.end()));
+			if (cmp(pending[size], pending[size - 1])) {
+				std::inplace_merge(pending.begin(), pending.begin() + static_cast<std::ptrdiff_t>(size), pending.end(), cmp);
+			}
+		}
+		return true;
+	}
+
+	/// @brief Mark a side as complete.
+	/// @param side The side which has no more entries.
+	void Close(const Side side) noexcept {
+		m_closed[static_cast<std::size_t>(side)] = true;
+	}
+
+	/// @brief Check if all sides are complete.
+	/// @return `true` if all sides are closed.
+	[[nodiscard]] bool IsClosed() const noexcept {
+		return std::all_of(m_closed.cbegin(), m_closed.cend(), [](const bool closed) noexcept {
+			return closed;
+		});
+	}
+
+	/// @brief Check if more entries of a side are required before further entries can be merged.
+	/// @param side The side.
+	/// @return `true` if the side is open and all of its entries have been merged.
+	[[nodiscard]] bool NeedsMore(const Side side) const noexcept {
+		const std::size_t index = static_cast<std::size_t>(side);
+		return !m_closed[index] && m_pending[index].empty();
+	}
+
+	/// @brief Merge all pending entries which cannot be matched by entries of later chunks.
+	/// @details Entries are moved into the results. Entries which exist in the reference copy only are added to
+	/// @p unmatched.
+	/// @param copy Receives all entries which exist in the source.
+	/// @param extra Receives all entries which exist in the destination but not in the source.
+	/// @param unmatched Receives all entries which exist in the reference copy only.
+	template <typename Copy, typename Extra, typename Unmatched>
+	void Merge(Copy& copy, Extra& extra, Unmatched& unmatched) {
+		// entries up to the smallest last entry of all open sides are complete
+		const T* pLimit = nullptr;
+		for (std::size_t index = 0; index < kSides; ++index) {
+			if (m_closed[index]) {
+				continue;
+			}
+			if (!m_last[index].has_value()) {
+				// nothing is known about this side yet
+				return;
+			}
+			if (!pLimit || m_compare(*m_last[index], *pLimit) < 0) {
+				pLimit = &*m_last[index];
+			}
+		}
+
+		const auto cmp = [this](const T& lhs, const T& rhs) {
+			return m_compare(lhs, rhs) < 0;
+		};
+		std::array<typename std::vector<T>::iterator, kSides> end;
+		for (std::size_t index = 0; index < kSides; ++index) {
+			std::vector<T>& pending = m_pending[index];
+			end[index] = pLimit ? std::upper_bound(pending.begin(), pending.end(), *pLimit, cmp) : pending.end();
+		}
+		ThreeWayMergeSorted(std::make_move_iterator(m_pending[0].begin()), std::make_move_iterator(end[0]),
+							std::make_move_iterator(m_pending[1].begin()), std::make_move_iterator(end[1]),
+							std::make_move_iterator(m_pending[2].begin()), std::make_move_iterator(end[2]),
+							copy, extra, unmatched, m_compare);
+		if (pLimit) {
+			m_merged = *pLimit;
+		}
+		for (std::size_t index = 0; index < kSides; ++index) {
+			m_pending[index].erase(m_pending[index].begin(), end[index]);
+		}
+	}
+
+	template <typename Copy, typename Extra>
+	void Merge(Copy& copy, Extra& extra) {
+		internal::DiscardUnmatched<T> unmatched;
+		Merge(copy, extra, unmatched);
+	}
+
+private:
+	static constexpr std::size_t kSides = 3;
+
+	Compare m_compare;
+	/// @brief The entries of each side which have not been merged yet.
+	std::array<std::vector<T>, kSides> m_pending;
+	/// @brief The greatest entry received for each side.
+	std::array<std::optional<T>, kSides> m_last;
+	/// @brief The greatest entry which might have been merged.
+	std::optional<T> m_merged;
+	std::array<bool, kSides> m_closed = {};
+};
+
 }  // namespace systools
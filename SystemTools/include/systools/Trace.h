@@ -0,0 +1,88 @@
+/*
+Copyright 2020 Michael Beckh
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+/// @file
+
+#pragma once
+
+#include "systools/Path.h"
+
+#include <chrono>
+#include <cstddef>
+#include <string>
+
+namespace systools {
+
+/// @brief Records spans of work together with their thread and writes them as a trace.
+/// @details The trace uses the JSON format of Chrome's trace event profiler which can be opened in `chrome://tracing`
+/// or https://ui.perfetto.dev. Recording is disabled by default. While disabled, a `Span` costs a single relaxed load.
+/// Events are written to the file in batches of `kBatchSize` while recording, i.e. memory usage does not grow with the
+/// length of the trace. All functions are thread-safe.
+class Trace final {
+public:
+	/// @brief A span of work which is recorded as a complete event when the instance is destroyed.
+	/// @details A span is only recorded if tracing was enabled when the span was created.
+	class Span final {
+	public:
+		/// @brief Start a new span.
+		/// @param name The name of the span. The string MUST be a literal.
+		/// @param category The category of the span. The string MUST be a literal.
+		Span(const char* name, const char* category) noexcept;
+
+		/// @brief Start a new span with a path which is added as an argument of the event.
+		/// @param name The name of the span. The string MUST be a literal.
+		/// @param category The category of the span. The string MUST be a literal.
+		/// @param path The path which is processed in the span.
+		Span(const char* name, const char* category, const Path& path);
+
+		Span(const Span&) = delete;
+		Span(Span&&) = delete;
+		~Span() noexcept;
+
+	public:
+		Span& operator=(const Span&) = delete;
+		Span& operator=(Span&&) = delete;
+
+	private:
+		const char* const m_name;
+		const char* const m_category;
+		const bool m_enabled;
+		const std::chrono::steady_clock::time_point m_start;
+		std::wstring m_path;
+	};
+
+public:
+	/// @brief The maximum number of events which are kept in memory before they are written to the file.
+	static constexpr std::size_t kBatchSize = 1024;
+
+public:
+	Trace() = delete;
+
+public:
+	/// @brief Start recording to a file. A trace which is still recording is stopped first.
+	/// @param path The path of the output file. An existing file is overwritten.
+	static void Start(const Path& path);
+
+	/// @brief Stop recording and write all remaining events to the file.
+	/// @details Events of spans which end while the trace is stopped might be dropped.
+	static void Stop();
+
+	/// @brief Check if events are being recorded.
+	/// @return `true` if recording is enabled.
+	[[nodiscard]] static bool IsEnabled() noexcept;
+};
+
+}  // namespace systools
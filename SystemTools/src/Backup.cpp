@@ -18,10 +18,16 @@ limitations under the License.
 
 #include "systools/Backup.h"
 
+#include "systools/BackupIndex.h"
 #include "systools/BackupStrategy.h"
+#include "systools/Digest.h"
+#include "systools/DigestCatalog.h"
 #include "systools/DirectoryScanner.h"
+#include "systools/FileVerifier.h"
 #include "systools/Path.h"
+#include "systools/Progress.h"
 #include "systools/ThreeWayMerge.h"
+#include "systools/Trace.h"
 
 #include <llamalog/llamalog.h>
 #include <m3c/Handle.h>
@@ -32,13 +38,18 @@ limitations under the License.
 
 #include <algorithm>
 #include <cassert>
+#include <chrono>
 #include <compare>
 #include <cstddef>
 #include <exception>
 #include <functional>
+#include <iterator>
+#include <map>
+#include <memory>
 #include <optional>
 #include <stdexcept>
 #include <string_view>
+#include <tuple>
 #include <unordered_map>
 #include <unordered_set>
 #include <utility>
@@ -49,9 +60,12 @@ namespace systools {
 
 namespace {
 
+/// @brief Files smaller than this are always replaced by a full copy.
+constexpr std::uint64_t kMinimumSizeForUpdate = 64ULL * 1024 * 1024;
+
 int CompareName(const ScannedFile& lhs, const ScannedFile& rhs) {
 	// attributes are always updated for directories
-	const std::weak_ordering cmp = lhs.GetName() <=> rhs.GetName();
+	const std::weak_ordering cmp = lhs.CompareName(rhs);
 	return cmp < 0 ? -1 : cmp == 0 ? 0 : 1;
 }
 
@@ -71,6 +85,51 @@ bool SameSecurity(const ScannedFile& lhs, const ScannedFile& rhs) {
 	return lhs.GetSecurity() == rhs.GetSecurity();
 }
 
+/// @brief The properties which identify a file across a rename.
+using RenameKey = std::tuple<std::uint64_t, std::int64_t, std::int64_t>;
+
+RenameKey GetRenameKey(const ScannedFile& file) noexcept {
+	assert(!file.IsDirectory());
+	return {file.GetSize(), file.GetLastWriteTime(), file.GetCreationTime()};
+}
+
+/// @brief Check if an entry of a backup may be the previous copy of a moved file or folder.
+/// @details The timestamps of folders change when entries are added or removed, so only the creation time is checked.
+bool IsMoveCandidate(const ScannedFile& src, const ScannedFile& copy) {
+	if (src.IsDirectory() != copy.IsDirectory()) {
+		return false;
+	}
+	return src.IsDirectory() ? src.GetCreationTime() == copy.GetCreationTime() : SameAttributes(src, copy);
+}
+
+/// @brief Check if only the changed blocks of an outdated copy in the destination can be written.
+/// @details Not used if a hard link for an identical file in the reference copy might be created instead.
+/// Only an existing copy in the destination is updated, i.e. when a backup is repeated into the same folder. A file
+/// which has changed since the reference copy and does not exist in the destination is checked by
+/// `IsCloneUpdateCandidate`.
+bool IsUpdateCandidate(const ScannedFile& src, const std::optional<ScannedFile>& ref, const ScannedFile& dst) {
+	return src.GetSize() >= kMinimumSizeForUpdate
+		   && src.GetStreams().empty()
+		   && dst.GetStreams().empty()
+		   && !(dst.GetAttributes() & (BackupStrategy::kUnsupportedAttributesMask | FILE_ATTRIBUTE_READONLY))
+		   && !(ref.has_value() && (dst.IsHardLink(*ref) || SameAttributes(src, *ref)));
+}
+
+/// @brief Check if the reference copy of a changed file can be cloned and updated instead of copying the source.
+/// @details The clone shares the data blocks of the reference copy, so only the blocks which differ from the source are
+/// written. The strategy reports if the volume does not support cloning in which case the source is copied in full.
+bool IsCloneUpdateCandidate(const ScannedFile& src, const ScannedFile& ref) {
+	return src.GetSize() >= kMinimumSizeForUpdate
+		   && src.GetStreams().empty()
+		   && ref.GetStreams().empty()
+		   && !(ref.GetAttributes() & BackupStrategy::kUnsupportedAttributesMask);
+}
+
+/// @brief Create the full path of a node if it exists.
+std::optional<Path> GetPath(const std::shared_ptr<const PathNode>& node) {
+	return node ? std::optional<Path>(node->GetPath()) : std::nullopt;
+}
+
 constexpr std::size_t MaxOfDifferenceAndZero(const std::size_t minuend, const std::size_t subtrahend) noexcept {
 	return minuend > subtrahend ? minuend - subtrahend : 0;
 }
@@ -79,6 +138,8 @@ void WaitForScanNoThrow(BackupStrategy& strategy, DirectoryScanner& scanner) noe
 	try {
 		// if no operation is currently in progress, wait just happily returns
 		strategy.WaitForScan(scanner);
+		// a paused scan never ends on its own
+		scanner.Cancel();
 	} catch (const std::exception& e) {
 		// dtor has nothrow requirement
 		SLOG_ERROR("WaitForScan: {}", e);
@@ -107,9 +168,41 @@ struct Backup::Match final {
 	Match& operator=(const Match& match) = default;
 	Match& operator=(Match&& match) noexcept = default;
 
+	/// @brief Pair an entry which exists in the source only with a renamed copy in the destination.
+	/// @details This is the only way to add an entry with a different name. The copy is renamed before it is used.
+	/// @param renamed The stale entry in the destination.
+	void SetRenamedDst(ScannedFile&& renamed) noexcept {
+		assert(src.has_value() && !ref.has_value() && !dst.has_value());
+		assert(src->IsDirectory() == renamed.IsDirectory());
+		assert(src->GetName() != renamed.GetName());
+		dst = std::move(renamed);
+	}
+
+	/// @brief Pair a file which exists in the source only with a renamed file in the reference copy.
+	/// @details This is the only way to add an entry with a different name. The file is used as source for a hard link.
+	/// @param renamed The entry which exists in the reference copy only.
+	void SetRenamedRef(ScannedFile&& renamed) noexcept {
+		assert(src.has_value() && !ref.has_value() && !dst.has_value());
+		assert(!src->IsDirectory() && !renamed.IsDirectory());
+		assert(src->GetName() != renamed.GetName());
+		ref = std::move(renamed);
+	}
+
+	/// @brief Pair an entry which exists in the source only with its previous copy at another location of the reference copy.
+	/// @param moved The entry in the reference copy.
+	/// @param node The location of @p moved.
+	void SetMovedRef(ScannedFile&& moved, std::shared_ptr<const PathNode> node) noexcept {
+		assert(src.has_value() && !ref.has_value() && !dst.has_value());
+		assert(src->IsDirectory() == moved.IsDirectory());
+		ref = std::move(moved);
+		refNode = std::move(node);
+	}
+
 	std::optional<ScannedFile> src;
 	std::optional<ScannedFile> ref;
 	std::optional<ScannedFile> dst;
+	/// @brief The location of `ref` if it is not in the matching folder of the reference copy.
+	std::shared_ptr<const PathNode> refNode;
 };
 
 
@@ -193,6 +286,28 @@ Backup::Backup(BackupStrategy& strategy) noexcept
 	// empty
 }
 
+void Backup::EnableVerification(const std::uint64_t maxBytesPerSecond) {
+	m_fileVerifier.emplace(maxBytesPerSecond);
+}
+
+void Backup::EnableProgress(const std::chrono::milliseconds interval, ProgressReporter::Callback callback) {
+	m_progressInterval = interval;
+	m_progressCallback = std::move(callback);
+}
+
+Progress::Snapshot Backup::GetProgress() const {
+	return m_progress.GetSnapshot(m_fileVerifier ? m_fileVerifier->GetPending() : 0);
+}
+
+void Backup::EnableTrace(Path path) {
+	m_tracePath = std::move(path);
+}
+
+void Backup::EnableMoveDetection(Path previousIndex, Path currentIndex) {
+	m_previousIndexPath = std::move(previousIndex);
+	m_currentIndexPath = std::move(currentIndex);
+}
+
 Backup::Statistics Backup::CreateBackup(const std::vector<Path>& src, const Path& ref, const Path& dst) {
 	{
 		TOKEN_PRIVILEGES privileges;
@@ -217,11 +332,51 @@ Backup::Statistics Backup::CreateBackup(const std::vector<Path>& src, const Path
 
 	// reset statistics
 	m_statistics = Statistics();
+	m_progress.Reset();
+	m_srcScanner.ResetWaitTime();
+	m_refScanner.ResetWaitTime();
+	m_dstScanner.ResetWaitTime();
+	m_moveScanner.ResetWaitTime();
+	m_fileComparer.ResetWaitTime();
+	std::optional<ProgressReporter> progressReporter;
+	if (m_progressCallback) {
+		progressReporter.emplace([this]() {
+			return GetProgress();
+		},
+								 m_progressInterval, m_progressCallback);
+	}
+	if (m_tracePath) {
+		Trace::Start(*m_tracePath);
+	}
+	const auto writeTrace = m3c::finally([this]() noexcept {
+		if (m_tracePath) {
+			try {
+				Trace::Stop();
+			} catch (const std::exception& e) {
+				LOG_ERROR("Error writing trace to {}: {}", *m_tracePath, e);
+			}
+		}
+	});
+	if (m_fileVerifier) {
+		// discard results of a previous run which ended with an error
+		static_cast<void>(m_fileVerifier->Wait());
+	}
 	if (src.empty()) {
 		// nothing to do
 		return m_statistics;
 	}
 
+	if (m_previousIndexPath) {
+		m_previousIndex.emplace(*m_previousIndexPath);
+		m_currentIndex.emplace(*m_currentIndexPath);
+		m_currentIndex->Clear();
+	}
+	const auto releaseIndex = m3c::finally([this]() noexcept {
+		m_previousIndex.reset();
+		m_currentIndex.reset();
+		m_refRoot.reset();
+	});
+
 	// TODO: root folder
 	// TODO: ref and dst must be on same volume
 
@@ -281,6 +436,8 @@ Backup::Statistics Backup::CreateBackup(const std::vector<Path>& src, const Path
 		m_strategy.Scan(dst, m_dstScanner, dstDirectories, dstFiles, DirectoryScanner::Flags::kFolderSecurity, refdstFilter);
 	}
 
+	m_refRoot = refExists ? std::make_shared<const PathNode>(ref) : nullptr;
+	const std::shared_ptr<const PathNode> dstRoot = std::make_shared<const PathNode>(dst);
 	for (auto it = srcPaths.cbegin(), begin = it, end = srcPaths.cend(); it != end; ++it) {
 		const Path& srcParentPath = it->first;
 		const std::unordered_set<Filename>& filenames = it->second;
@@ -332,7 +489,8 @@ Backup::Statistics Backup::CreateBackup(const std::vector<Path>& src, const Path
 		std::vector<Match> extra;
 		copy.reserve(srcDirectories.size());
 		extra.reserve(MaxOfDifferenceAndZero(dstDirectories.size(), srcDirectories.size()));
-		ThreeWayMerge(srcDirectories, refDirectories, dstDirectories, copy, extra, CompareName);
+		// ref and dst are merged again for the next source parent
+		ThreeWayMerge(std::move(srcDirectories), refDirectories, dstDirectories, copy, extra, CompareName);
 		if (copy.size() != filenames.size() || std::any_of(copy.cbegin(), copy.cend(), [](const Match& match) noexcept {
 				return !match.src.has_value();
 			})) {
@@ -340,23 +498,382 @@ Backup::Statistics Backup::CreateBackup(const std::vector<Path>& src, const Path
 			assert(false);
 			THROW(std::exception(), "Something went wrong for folders in {}", srcParentPath);
 		}
-		CopyDirectories(srcParentPath, ref, dst, copy);
+		UpdateIndex(FILE_ID_128{}, copy);
+		CopyDirectories(std::make_shared<const PathNode>(srcParentPath), m_refRoot, dstRoot, copy);
 	}
 
+	if (m_fileVerifier) {
+		m_statistics.m_verificationFailed = m_fileVerifier->Wait();
+	}
+	if (m_currentIndex) {
+		m_currentIndex->Save();
+	}
+	UpdateWaitTime();
 	return m_statistics;
 }
 
-void Backup::CopyDirectories(const std::optional<Path>& optionalSrc, const std::optional<Path>& optionalRef, const Path& dst, const std::vector<Match>& directories) {
+void Backup::MatchRenamed(std::vector<Match>& copy, std::vector<Match>& extra, DirectoryScanner::Result& unmatched) {
+	// count entries which exist in source only, only keys which are unique are used for detecting renames
+	std::map<RenameKey, std::size_t> added;
+	for (const Match& match : copy) {
+		if (!match.ref.has_value() && !match.dst.has_value()) {
+			++added[GetRenameKey(*match.src)];
+		}
+	}
+	if (added.empty() || (extra.empty() && unmatched.empty())) {
+		return;
+	}
+
+	// an empty value marks a key which is not unique
+	const auto index = [](auto& candidates, const RenameKey& key, const std::size_t i) {
+		const auto [it, inserted] = candidates.try_emplace(key, i);
+		if (!inserted) {
+			it->second.reset();
+		}
+	};
+	std::map<RenameKey, std::optional<std::size_t>> extraCandidates;
+	for (std::size_t i = 0, max = extra.size(); i < max; ++i) {
+		index(extraCandidates, GetRenameKey(*extra[i].dst), i);
+	}
+	std::map<RenameKey, std::optional<std::size_t>> unmatchedCandidates;
+	for (std::size_t i = 0, max = unmatched.size(); i < max; ++i) {
+		index(unmatchedCandidates, GetRenameKey(unmatched[i]), i);
+	}
+
+	bool extraMatched = false;
+	for (Match& match : copy) {
+		if (match.ref.has_value() || match.dst.has_value()) {
+			continue;
+		}
+		const RenameKey key = GetRenameKey(*match.src);
+		if (added[key] != 1) {
+			continue;
+		}
+
+		// prefer renaming the copy in the destination over creating a hard link
+		if (const auto it = extraCandidates.find(key); it != extraCandidates.cend() && it->second.has_value() && SameAttributes(*match.src, *extra[*it->second].dst)) {
+			LOG_DEBUG("Detected rename from {} to {}", extra[*it->second].dst->GetName(), match.src->GetName());
+			match.SetRenamedDst(std::move(*extra[*it->second].dst));
+			extra[*it->second].dst.reset();
+			extraMatched = true;
+		} else if (const auto it = unmatchedCandidates.find(key); it != unmatchedCandidates.cend() && it->second.has_value() && SameAttributes(*match.src, unmatched[*it->second])) {
+			LOG_DEBUG("Detected rename from {} to {} in reference", unmatched[*it->second].GetName(), match.src->GetName());
+			match.SetRenamedRef(std::move(unmatched[*it->second]));
+		}
+	}
+
+	if (extraMatched) {
+		std::erase_if(extra, [](const Match& match) noexcept {
+			return !match.dst.has_value();
+		});
+	}
+}
+
+void Backup::MatchMoved(std::vector<Match>& copy, std::vector<Match>& extra, const ScannedFile& parent) {
+	assert(m_previousIndex.has_value());
+
+	bool extraMatched = false;
+	for (Match& match : copy) {
+		if (match.ref.has_value() || match.dst.has_value()) {
+			continue;
+		}
+		const FILE_ID_128& fileId = match.src->GetFileId();
+		const BackupIndex::Entry* const pEntry = m_previousIndex->Find(fileId);
+		if (!pEntry) {
+			// entry is new
+			continue;
+		}
+
+		// prefer renaming the copy in the destination over creating a hard link
+		if (DigestCatalog::FileIdEqual{}(pEntry->parentId, parent.GetFileId())) {
+			const auto it = std::find_if(extra.begin(), extra.end(), [pEntry](const Match& extraMatch) {
+				return extraMatch.dst.has_value() && extraMatch.dst->GetName() == pEntry->name;
+			});
+			if (it != extra.end() && IsMoveCandidate(*match.src, *it->dst)) {
+				LOG_DEBUG("Detected rename from {} to {}", it->dst->GetName(), match.src->GetName());
+				match.SetRenamedDst(std::move(*it->dst));
+				it->dst.reset();
+				extraMatched = true;
+				continue;
+			}
+		}
+
+		if (!m_refRoot) {
+			continue;
+		}
+		const std::vector<Filename> location = m_previousIndex->GetLocation(fileId);
+		if (location.empty()) {
+			continue;
+		}
+		std::shared_ptr<const PathNode> node = m_refRoot;
+		for (const Filename& name : location) {
+			node = std::make_shared<const PathNode>(std::move(node), name);
+		}
+		const Path path = node->GetPath();
+		if (std::optional<ScannedFile> moved = ScanReference(path); moved.has_value() && IsMoveCandidate(*match.src, *moved)) {
+			LOG_DEBUG("Detected move of {} from {} in reference", match.src->GetName(), path);
+			match.SetMovedRef(std::move(*moved), std::move(node));
+		}
+	}
+
+	if (extraMatched) {
+		std::erase_if(extra, [](const Match& match) noexcept {
+			return !match.dst.has_value();
+		});
+	}
+}
+
+std::optional<ScannedFile> Backup::ScanReference(const Path& path) {
+	if (!m_strategy.Exists(path)) {
+		return std::nullopt;
+	}
+
+	DirectoryScanner::Result directories;
+	DirectoryScanner::Result files;
+	const Filename filename = path.GetFilename();
+	const LambdaScannerFilter filter([&filename](const Filename& name) {
+		return name == filename;
+	});
+	m_strategy.Scan(path.GetParent(), m_moveScanner, directories, files, m_fileSecurity ? DirectoryScanner::Flags::kFileSecurity : DirectoryScanner::Flags::kDefault, filter);
+	m_strategy.WaitForScan(m_moveScanner);
+
+	if (!directories.empty()) {
+		return std::move(directories.front());
+	}
+	if (!files.empty()) {
+		return std::move(files.front());
+	}
+	return std::nullopt;
+}
+
+void Backup::UpdateIndex(const FILE_ID_128& parentId, const std::vector<Match>& entries) {
+	if (!m_currentIndex) {
+		return;
+	}
+	for (const Match& match : entries) {
+		// the copy always gets the name of the source
+		m_currentIndex->Set(match.src->GetFileId(), {.parentId = parentId, .name = match.src->GetName()});
+	}
+}
+
+void Backup::UpdateWaitTime() noexcept {
+	Statistics::WaitTime& waitTime = m_statistics.m_waitTime;
+	waitTime.m_srcScanner = m_srcScanner.GetWaitTime();
+	waitTime.m_refScanner = m_refScanner.GetWaitTime() + m_moveScanner.GetWaitTime();
+	waitTime.m_dstScanner = m_dstScanner.GetWaitTime();
+	waitTime.m_comparer = m_fileComparer.GetWaitTime();
+	waitTime.m_srcReader = m_fileComparer.GetReaderWaitTime(0);
+	waitTime.m_cpyReader = m_fileComparer.GetReaderWaitTime(1);
+}
+
+void Backup::CopyFiles(const Path& srcPath, const std::optional<Path>& refPath, const Path& dstPath, const std::vector<Match>& files) {
+	// all files share the same parent folders, so reuse the buffers for the paths
+	PathBuilder srcFilePaths(srcPath);
+	std::optional<PathBuilder> refFilePaths;
+	if (refPath.has_value()) {
+		refFilePaths.emplace(*refPath);
+	}
+	PathBuilder dstFilePaths(dstPath);
+	PathBuilder dstTargetFilePaths(dstPath);
+
+	// files which have been moved in the source may be anywhere in the reference copy
+	std::optional<Path> movedRefFile;
+	const auto getRefFile = [&refFilePaths, &movedRefFile](const Match& matchedFile) -> const Path& {
+		if (matchedFile.refNode) {
+			return movedRefFile.emplace(matchedFile.refNode->GetPath());
+		}
+		return refFilePaths->GetChild(matchedFile.ref->GetName());
+	};
+
+	// compare and copy files
+	for (const Match& matchedFile : files) {
+		m_progress.OnFile();
+		assert(matchedFile.src.has_value());
+
+		const Path& srcFile = srcFilePaths.GetChild(matchedFile.src->GetName());
+		if (matchedFile.src->GetAttributes() & BackupStrategy::kUnsupportedAttributesMask) {
+			THROW(std::exception(), "File has unsupported attributes {}: {}", matchedFile.src->GetAttributes(), srcFile);
+		}
+
+		const Path& dstTargetFile = dstTargetFilePaths.GetChild(matchedFile.src->GetName());
+
+		// check if dst is the same as src
+		if (matchedFile.dst.has_value()) {
+			const Path& dstFile = dstFilePaths.GetChild(matchedFile.dst->GetName());
+
+			if (!SameAttributes(*matchedFile.src, *matchedFile.dst)) {
+				// remove dst if it has changed attributes
+				LOG_DEBUG("File has changed, removing {}", dstFile);
+			} else if (matchedFile.dst->GetAttributes() & BackupStrategy::kUnsupportedAttributesMask) {
+				// remove dst if it has unsupported attributes
+				LOG_DEBUG("File has unsupported attributes {}, removing: {}", matchedFile.dst->GetAttributes(), dstFile);
+			} else {
+				// check if security must be updated
+				const bool differentSecurity = m_fileSecurity && !SameSecurity(*matchedFile.src, *matchedFile.dst);
+				if (differentSecurity && matchedFile.ref.has_value() && matchedFile.dst->IsHardLink(*matchedFile.ref)) {
+					// file is hard link, so changing security would modify copy in ref -> delete and create new
+					goto dstDifferent;
+				}
+
+				if (m_compareContents) {
+					// compare contents of src and dst
+					LOG_DEBUG("Compare files {} and {}", srcFile, dstFile);
+					const bool same = m_strategy.Compare(srcFile, dstFile, m_fileComparer);
+					m_progress.OnCompare(m_fileComparer.GetBytesCompared());
+					if (!same) {
+						goto dstDifferent;
+					}
+					const std::vector<ScannedFile::Stream>& srcStreams = matchedFile.src->GetStreams();
+					const std::vector<ScannedFile::Stream>& dstStreams = matchedFile.dst->GetStreams();
+					assert(srcStreams.size() == dstStreams.size());
+
+					for (std::size_t i = 0, max = srcStreams.size(); i < max; ++i) {
+						assert(srcStreams[i].GetName() == dstStreams[i].GetName());
+						const Path srcStreamName = srcFile + srcStreams[i].GetName();
+						const Path dstStreamName = dstFile + dstStreams[i].GetName();
+
+						LOG_DEBUG("Compare streams {} and {}", srcStreamName, dstStreamName);
+						const bool sameStream = m_strategy.Compare(srcStreamName, dstStreamName, m_fileComparer);
+						m_progress.OnCompare(m_fileComparer.GetBytesCompared());
+						if (!sameStream) {
+							goto dstDifferent;
+						}
+					}
+				}
+
+				if (matchedFile.src->GetName().IsSameStringAs(matchedFile.dst->GetName())) {
+					m_statistics.OnRetain(matchedFile);
+				} else {
+					// change case or file has been renamed in source
+					LOG_DEBUG("Rename {} to {}", dstFile, dstTargetFile);
+					m_strategy.Rename(dstFile, dstTargetFile);
+					m_statistics.OnUpdate(matchedFile);
+				}
+
+				// adjust security if required
+				if (differentSecurity) {
+					LOG_DEBUG("Update security of {}", dstTargetFile);
+					m_strategy.SetSecurity(dstTargetFile, *matchedFile.src);
+					m_statistics.OnSecurityUpdate(matchedFile);
+				}
+
+				continue;
+
+			dstDifferent:
+				// delete outdated copy in target
+				LOG_DEBUG("Delete file for replacement {}", dstFile);
+			}
+
+			// write changed blocks only for large files
+			if (IsUpdateCandidate(*matchedFile.src, matchedFile.ref, *matchedFile.dst)) {
+				LOG_DEBUG("Update file {} from {}", dstFile, srcFile);
+				if (const std::optional<std::uint64_t> bytesWritten = m_strategy.Update(srcFile, dstFile, m_fileComparer); bytesWritten.has_value()) {
+					if (!matchedFile.src->GetName().IsSameStringAs(matchedFile.dst->GetName())) {
+						LOG_DEBUG("Rename {} to {}", dstFile, dstTargetFile);
+						m_strategy.Rename(dstFile, dstTargetFile);
+					}
+					m_strategy.SetAttributes(dstTargetFile, *matchedFile.src);
+					m_statistics.OnUpdate(matchedFile);
+					m_statistics.OnCopy(*bytesWritten);
+					m_progress.OnCopy(*bytesWritten);
+
+					// updating keeps the security of the target
+					if (m_fileSecurity && !SameSecurity(*matchedFile.src, *matchedFile.dst)) {
+						LOG_DEBUG("Update security of {}", dstTargetFile);
+						m_strategy.SetSecurity(dstTargetFile, *matchedFile.src);
+						m_statistics.OnSecurityUpdate(matchedFile);
+					}
+					continue;
+				}
+			}
+
+			m_strategy.Delete(dstFile);
+			m_statistics.OnReplace(matchedFile);
+		} else {
+			m_statistics.OnAdd(matchedFile);
+		}
+
+		// check if ref is the same as src (if not same hard-link as dst)
+		if (matchedFile.ref.has_value() && SameAttributes(*matchedFile.src, *matchedFile.ref) && !(matchedFile.dst.has_value() && matchedFile.ref->IsHardLink(*matchedFile.dst)) && (!m_fileSecurity || SameSecurity(*matchedFile.src, *matchedFile.ref))) {
+			const Path& refFile = getRefFile(matchedFile);
+
+			if (m_compareContents) {
+				// compare contents of src and ref
+				LOG_DEBUG("Compare files {} and {}", srcFile, refFile);
+				const bool same = m_strategy.Compare(srcFile, refFile, m_fileComparer);
+				m_progress.OnCompare(m_fileComparer.GetBytesCompared());
+				if (!same) {
+					goto refDifferent;
+				}
+			}
+			assert(matchedFile.src->GetSize() == matchedFile.ref->GetSize());
+			// if same create hard link for ref in dst and continue
+			LOG_DEBUG("Create link from {} to {}", refFile, dstTargetFile);
+			{
+				const Trace::Span linkSpan("HardLink", "backup", dstTargetFile);
+				m_strategy.CreateHardLink(dstTargetFile, refFile);
+			}
+			m_statistics.OnHardLink(matchedFile.src->GetSize());
+			m_progress.OnHardLink(matchedFile.src->GetSize());
+			continue;
+		}
+	refDifferent:
+
+		// clone the outdated reference copy and write the changed blocks only for large files
+		if (matchedFile.ref.has_value() && IsCloneUpdateCandidate(*matchedFile.src, *matchedFile.ref)) {
+			const Path& refFile = getRefFile(matchedFile);
+
+			LOG_DEBUG("Clone file {} to {}", refFile, dstTargetFile);
+			const Trace::Span cloneSpan("Clone", "backup", dstTargetFile);
+			if (m_strategy.Clone(refFile, dstTargetFile, *matchedFile.ref)) {
+				LOG_DEBUG("Update file {} from {}", dstTargetFile, srcFile);
+				// the target is deleted if the update fails
+				if (const std::optional<std::uint64_t> bytesWritten = m_strategy.Update(srcFile, dstTargetFile, m_fileComparer); bytesWritten.has_value()) {
+					m_strategy.SetAttributes(dstTargetFile, *matchedFile.src);
+					m_statistics.OnCopy(*bytesWritten);
+					m_progress.OnCopy(*bytesWritten);
+
+					// the clone has the security of the reference copy
+					if (m_fileSecurity && !SameSecurity(*matchedFile.src, *matchedFile.ref)) {
+						LOG_DEBUG("Update security of {}", dstTargetFile);
+						m_strategy.SetSecurity(dstTargetFile, *matchedFile.src);
+					}
+					continue;
+				}
+				// the clone was not updated, replace it by a copy
+				m_strategy.Delete(dstTargetFile);
+			}
+		}
+
+		// copy src to dst
+		LOG_DEBUG("Copy file {} to {}", srcFile, dstTargetFile);
+		std::optional<Digest> digest;
+		{
+			const Trace::Span copySpan("Copy", "backup", srcFile);
+			digest = m_strategy.Copy(srcFile, dstTargetFile, *matchedFile.src, m_fileVerifier.has_value());
+		}
+		// copying does copy security, however we want the original attributes and file times
+		m_strategy.SetAttributes(dstTargetFile, *matchedFile.src);
+		m_statistics.OnCopy(matchedFile.src->GetSize());
+		m_progress.OnCopy(matchedFile.src->GetSize());
+		if (digest) {
+			m_fileVerifier->Verify(dstTargetFile, *digest);
+		}
+	}
+}
+
+void Backup::CopyDirectories(const std::shared_ptr<const PathNode>& src, const std::shared_ptr<const PathNode>& ref, const std::shared_ptr<const PathNode>& dst, const std::vector<Match>& directories) {
 	assert(!directories.empty());
 	constexpr std::size_t kReserveDirectories = 64;
 	constexpr std::size_t kReserveFiles = 256;
+	using Side = ThreeWayMergeStream<ScannedFile>::Side;
 
 	std::optional<std::size_t> idx[2];
 
-	std::optional<Path> srcPath[2];
-	std::optional<Path> refPath[2];
-	std::optional<Path> dstPath[2];
-	std::optional<Path> dstTargetPath[2];
+	std::shared_ptr<const PathNode> srcNode[2];
+	std::shared_ptr<const PathNode> refNode[2];
+	std::shared_ptr<const PathNode> dstNode[2];
+	std::shared_ptr<const PathNode> dstTargetNode[2];
 
 	DirectoryScanner::Result srcDirectories[2];
 	DirectoryScanner::Result refDirectories[2];
@@ -366,6 +883,11 @@ void Backup::CopyDirectories(const std::optional<Path>& optionalSrc, const std::
 	DirectoryScanner::Result refFiles[2];
 	DirectoryScanner::Result dstFiles[2];
 
+	// a listing which does not fit into a single chunk is scanned again and read in chunks
+	bool rescan[2] = {false, false};
+	// the next directory is scanned after the listing of the current directory is complete
+	bool deferred = false;
+
 	// Ensure that all asynchronous operations on local variables are finished before stack unwind
 	const auto waitForAsync = m3c::finally([this]() noexcept {
 		WaitForScanNoThrow(m_strategy, m_srcScanner);
@@ -373,17 +895,55 @@ void Backup::CopyDirectories(const std::optional<Path>& optionalSrc, const std::
 		WaitForScanNoThrow(m_strategy, m_dstScanner);
 	});
 
+	const DirectoryScanner::Flags fileSecurity = m_fileSecurity ? DirectoryScanner::Flags::kFileSecurity : DirectoryScanner::Flags::kDefault;
+	const auto scan = [this, fileSecurity, &srcNode, &refNode, &dstNode, &srcDirectories, &refDirectories, &dstDirectories, &srcFiles, &refFiles, &dstFiles](const std::uint_fast8_t scanIndex) {
+		if (srcNode[scanIndex]) {
+			m_strategy.Scan(srcNode[scanIndex]->GetPath(), m_srcScanner, srcDirectories[scanIndex], srcFiles[scanIndex],
+							DirectoryScanner::Flags::kFolderSecurity | fileSecurity | DirectoryScanner::Flags::kFolderStreams | DirectoryScanner::Flags::kChunked, kAcceptAllScannerFilter);
+		}
+		if (refNode[scanIndex]) {
+			m_strategy.Scan(refNode[scanIndex]->GetPath(), m_refScanner, refDirectories[scanIndex], refFiles[scanIndex],
+							fileSecurity | DirectoryScanner::Flags::kChunked, kAcceptAllScannerFilter);
+		}
+		if (dstNode[scanIndex]) {
+			m_strategy.Scan(dstNode[scanIndex]->GetPath(), m_dstScanner, dstDirectories[scanIndex], dstFiles[scanIndex],
+							DirectoryScanner::Flags::kFolderSecurity | fileSecurity | DirectoryScanner::Flags::kChunked, kAcceptAllScannerFilter);
+		}
+	};
+
+	// the scanners are required for the subdirectories of the current directory, so a paused scan is not kept
+	const auto waitForScan = [this, &rescan, &srcDirectories, &refDirectories, &dstDirectories, &srcFiles, &refFiles, &dstFiles](const std::uint_fast8_t scanIndex) {
+		m_strategy.WaitForScan(m_srcScanner);
+		m_strategy.WaitForScan(m_refScanner);
+		m_strategy.WaitForScan(m_dstScanner);
+		if (m_srcScanner.IsPaused() || m_refScanner.IsPaused() || m_dstScanner.IsPaused()) {
+			m_srcScanner.Cancel();
+			m_refScanner.Cancel();
+			m_dstScanner.Cancel();
+
+			srcDirectories[scanIndex].clear();
+			refDirectories[scanIndex].clear();
+			dstDirectories[scanIndex].clear();
+
+			srcFiles[scanIndex].clear();
+			refFiles[scanIndex].clear();
+			dstFiles[scanIndex].clear();
+			rescan[scanIndex] = true;
+		}
+	};
+
 	// loop requires one iteration more then directories.size()!
 	for (std::size_t index = 0, maxIndex = directories.size(); index <= maxIndex; ++index) {
 		// scan next directory
 		if (index < maxIndex) {
 			const std::uint_fast8_t scanIndex = index & 1;
 			assert(!idx[scanIndex].has_value());
+			assert(!rescan[scanIndex]);
 
-			assert(!srcPath[scanIndex].has_value());
-			assert(!refPath[scanIndex].has_value());
-			assert(!dstPath[scanIndex].has_value());
-			assert(!dstTargetPath[scanIndex].has_value());
+			assert(!srcNode[scanIndex]);
+			assert(!refNode[scanIndex]);
+			assert(!dstNode[scanIndex]);
+			assert(!dstTargetNode[scanIndex]);
 
 			assert(srcDirectories[scanIndex].empty());
 			assert(refDirectories[scanIndex].empty());
@@ -397,151 +957,249 @@ void Backup::CopyDirectories(const std::optional<Path>& optionalSrc, const std::
 			const Match& match = directories[index];
 
 			if (match.src.has_value()) {
-				assert(optionalSrc.has_value());
-				srcPath[scanIndex] = *optionalSrc / match.src->GetName();
-				dstTargetPath[scanIndex] = dst / match.src->GetName();
+				assert(src);
+				srcNode[scanIndex] = std::make_shared<const PathNode>(src, match.src->GetName());
+				dstTargetNode[scanIndex] = std::make_shared<const PathNode>(dst, match.src->GetName());
 				if (match.src->GetAttributes() & BackupStrategy::kUnsupportedAttributesMask) {
-					THROW(std::exception(), "Directory has unsupported attributes {}: {}", match.src->GetAttributes(), *srcPath[scanIndex]);
+					THROW(std::exception(), "Directory has unsupported attributes {}: {}", match.src->GetAttributes(), srcNode[scanIndex]->GetPath());
 				}
 
 				srcDirectories[scanIndex].reserve(kReserveDirectories);
 				srcFiles[scanIndex].reserve(kReserveFiles);
-				m_strategy.Scan(*srcPath[scanIndex], m_srcScanner, srcDirectories[scanIndex], srcFiles[scanIndex],
-								DirectoryScanner::Flags::kFolderSecurity | (m_fileSecurity ? DirectoryScanner::Flags::kFileSecurity : DirectoryScanner::Flags::kDefault) | DirectoryScanner::Flags::kFolderStreams, kAcceptAllScannerFilter);
 			}
 			if (match.ref.has_value()) {
-				assert(optionalRef.has_value());
-				refPath[scanIndex] = *optionalRef / match.ref->GetName();
+				assert(ref || match.refNode);
+				refNode[scanIndex] = match.refNode ? match.refNode : std::make_shared<const PathNode>(ref, match.ref->GetName());
 				if (match.ref->GetAttributes() & BackupStrategy::kUnsupportedAttributesMask) {
-					THROW(std::exception(), "Directory has unsupported attributes {}: {}", match.ref->GetAttributes(), *refPath[scanIndex]);
+					THROW(std::exception(), "Directory has unsupported attributes {}: {}", match.ref->GetAttributes(), refNode[scanIndex]->GetPath());
 				}
 
 				refDirectories[scanIndex].reserve(kReserveDirectories);
 				refFiles[scanIndex].reserve(kReserveFiles);
-				m_strategy.Scan(*refPath[scanIndex], m_refScanner, refDirectories[scanIndex], refFiles[scanIndex],
-								m_fileSecurity ? DirectoryScanner::Flags::kFileSecurity : DirectoryScanner::Flags::kDefault, kAcceptAllScannerFilter);
 			}
 			if (match.dst.has_value()) {
-				dstPath[scanIndex] = dst / match.dst->GetName();
+				dstNode[scanIndex] = std::make_shared<const PathNode>(dst, match.dst->GetName());
 				if (match.dst->GetAttributes() & BackupStrategy::kUnsupportedAttributesMask) {
-					THROW(std::exception(), "Directory has unsupported attributes {}: {}", match.dst->GetAttributes(), *dstPath[scanIndex]);
+					THROW(std::exception(), "Directory has unsupported attributes {}: {}", match.dst->GetAttributes(), dstNode[scanIndex]->GetPath());
 				}
 
 				dstDirectories[scanIndex].reserve(kReserveDirectories);
 				dstFiles[scanIndex].reserve(kReserveFiles);
-				m_strategy.Scan(*dstPath[scanIndex], m_dstScanner, dstDirectories[scanIndex], dstFiles[scanIndex],
-								DirectoryScanner::Flags::kFolderSecurity | (m_fileSecurity ? DirectoryScanner::Flags::kFileSecurity : DirectoryScanner::Flags::kDefault), kAcceptAllScannerFilter);
+			}
+
+			if (index && rescan[scanIndex ^ 1]) {
+				// scanners will read the listing of the previous directory in chunks
+				deferred = true;
+			} else {
+				scan(scanIndex);
 			}
 		}
 
 		// wait and continue for first iteration
 		if (!index) {
-			m_strategy.WaitForScan(m_srcScanner);
-			m_strategy.WaitForScan(m_refScanner);
-			m_strategy.WaitForScan(m_dstScanner);
+			waitForScan(0);
 			continue;
 		}
 
 		// Calculate delta while next entries are scanned
 		const std::uint_fast8_t readIndex = (index & 1) ^ 1;  // == (index - 1) & 1;
+		// full paths are only created for calling the strategy
+		const std::optional<Path> srcPath = GetPath(srcNode[readIndex]);
+		const std::optional<Path> refPath = GetPath(refNode[readIndex]);
+		const std::optional<Path> dstPath = GetPath(dstNode[readIndex]);
+		const std::optional<Path> dstTargetPath = GetPath(dstTargetNode[readIndex]);
+		const Trace::Span span("Directory", "backup", dstTargetPath.has_value() ? *dstTargetPath : *dstPath);
 
-		std::vector<Match> copyDirectories;
-		std::vector<Match> extraDirectories;
-		// Heuristics for sizing the lists
-		copyDirectories.reserve(srcDirectories[readIndex].size());
-		extraDirectories.reserve(MaxOfDifferenceAndZero(dstDirectories[readIndex].size(), srcDirectories[readIndex].size()));
-
-		ThreeWayMerge(srcDirectories[readIndex], refDirectories[readIndex], dstDirectories[readIndex], copyDirectories, extraDirectories, CompareName);
-
-		srcDirectories[readIndex].clear();
-		refDirectories[readIndex].clear();
-		dstDirectories[readIndex].clear();
-		// shrink structures if they got too big
-		if (srcDirectories[readIndex].capacity() > kReserveDirectories * 2) {
-			srcDirectories[readIndex].shrink_to_fit();
-		}
-		if (refDirectories[readIndex].capacity() > kReserveDirectories * 2) {
-			refDirectories[readIndex].shrink_to_fit();
-		}
-		if (dstDirectories[readIndex].capacity() > kReserveDirectories * 2) {
-			dstDirectories[readIndex].shrink_to_fit();
+		assert(idx[readIndex].has_value());
+		const Match& match = directories[*idx[readIndex]];
+		assert(srcPath.has_value() == match.src.has_value());
+		assert(refPath.has_value() == match.ref.has_value());
+		assert(dstPath.has_value() == match.dst.has_value());
+		assert(dstTargetPath.has_value() == srcPath.has_value());
+
+		const bool chunked = rescan[readIndex];
+		if (chunked) {
+			scan(readIndex);
+			m_strategy.WaitForScan(m_srcScanner);
+			m_strategy.WaitForScan(m_refScanner);
+			m_strategy.WaitForScan(m_dstScanner);
+			rescan[readIndex] = false;
 		}
 
-		std::vector<Match> copyFiles;
-		std::vector<Match> extraFiles;
-		// Heuristics for sizing the lists
-		copyFiles.reserve(srcFiles[readIndex].size());
-		extraFiles.reserve(MaxOfDifferenceAndZero(dstFiles[readIndex].size(), srcFiles[readIndex].size()));
-
-		ThreeWayMerge(srcFiles[readIndex], refFiles[readIndex], dstFiles[readIndex], copyFiles, extraFiles, CompareName);
+		if (match.src.has_value()) {
+			if (!match.src->GetStreams().empty()) {
+				// not yet implemented
+				THROW(std::domain_error("streams for directories are not (yet) supported"));
+			}
 
-		srcFiles[readIndex].clear();
-		refFiles[readIndex].clear();
-		dstFiles[readIndex].clear();
-		// shrink structures if they got too big
-		if (srcFiles[readIndex].capacity() > kReserveFiles * 2) {
-			srcFiles[readIndex].shrink_to_fit();
+			if (!match.dst.has_value()) {
+				// CreateDirectory
+				LOG_DEBUG("Create directory {}", *dstTargetPath);
+				m_strategy.CreateDirectory(*dstTargetPath, *srcPath, *match.src);
+				m_statistics.OnAdd(match);
+			}
 		}
-		if (refFiles[readIndex].capacity() > kReserveFiles * 2) {
-			refFiles[readIndex].shrink_to_fit();
+		// an existing directory is renamed after its listing is complete because the scanner keeps it open
+		const std::optional<Path>& dstCurrentPath = match.dst.has_value() ? dstPath : dstTargetPath;
+
+		// merge the listing while the scanners continue, memory is bounded by the size of the chunks
+		ThreeWayMergeStream<ScannedFile> listing(CompareName);
+		const auto read = [&listing, chunked](const Side side, const DirectoryScanner& scanner, DirectoryScanner::Result& scannedDirectories, DirectoryScanner::Result& scannedFiles, const Path& path) {
+			// directories and files are merged as one listing because an entry may have changed its type
+			DirectoryScanner::Result chunk = std::move(scannedFiles);
+			chunk.insert(chunk.end(), std::make_move_iterator(scannedDirectories.begin()), std::make_move_iterator(scannedDirectories.end()));
+			scannedFiles.clear();
+			scannedDirectories.clear();
+			if (!listing.Append(side, std::move(chunk))) {
+				THROW(std::exception(), "Entries of {} are not sorted", path);
+			}
+			if (!chunked || !scanner.IsPaused()) {
+				listing.Close(side);
+			}
+		};
+		if (srcPath.has_value()) {
+			read(Side::kSrc, m_srcScanner, srcDirectories[readIndex], srcFiles[readIndex], *srcPath);
+		} else {
+			listing.Close(Side::kSrc);
+		}
+		if (refPath.has_value()) {
+			read(Side::kRef, m_refScanner, refDirectories[readIndex], refFiles[readIndex], *refPath);
+		} else {
+			listing.Close(Side::kRef);
 		}
-		if (dstFiles[readIndex].capacity() > kReserveFiles * 2) {
-			dstFiles[readIndex].shrink_to_fit();
+		if (dstPath.has_value()) {
+			read(Side::kDst, m_dstScanner, dstDirectories[readIndex], dstFiles[readIndex], *dstPath);
+		} else {
+			listing.Close(Side::kDst);
 		}
 
-		// wait for disk activity to end
-		m_strategy.WaitForScan(m_srcScanner);
-		m_strategy.WaitForScan(m_refScanner);
-		m_strategy.WaitForScan(m_dstScanner);
+		std::vector<Match> copyDirectories;
+		std::vector<Match> extraDirectories;
+		// files which replace a directory of the same name are copied after the directory has been removed
+		std::vector<Match> replacingFiles;
+		while (true) {
+			std::vector<Match> copy;
+			std::vector<Match> extra;
+			DirectoryScanner::Result unmatched;
+			listing.Merge(copy, extra, unmatched);
+
+			std::vector<Match> chunkCopyDirectories;
+			std::vector<Match> chunkExtraDirectories;
+			std::vector<Match> copyFiles;
+			std::vector<Match> extraFiles;
+			for (Match& entry : copy) {
+				const bool directory = entry.src->IsDirectory();
+				if (entry.ref.has_value() && entry.ref->IsDirectory() != directory) {
+					// an entry of the reference copy which is not stale in the destination may be a renamed file
+					if (!entry.ref->IsDirectory() && !(entry.dst.has_value() && !entry.dst->IsDirectory())) {
+						unmatched.push_back(std::move(*entry.ref));
+					}
+					entry.ref.reset();
+				}
+				bool replacing = false;
+				if (entry.dst.has_value() && entry.dst->IsDirectory() != directory) {
+					replacing = entry.dst->IsDirectory();
+					(replacing ? chunkExtraDirectories : extraFiles).emplace_back(std::nullopt, std::nullopt, std::move(*entry.dst));
+					entry.dst.reset();
+				}
+				(directory ? chunkCopyDirectories : (replacing ? replacingFiles : copyFiles)).push_back(std::move(entry));
+			}
+			for (Match& entry : extra) {
+				(entry.dst->IsDirectory() ? chunkExtraDirectories : extraFiles).push_back(std::move(entry));
+			}
+			// directories are not paired by size and timestamps because these do not identify them, see MatchMoved
+			std::erase_if(unmatched, [](const ScannedFile& file) noexcept {
+				return file.IsDirectory();
+			});
+			MatchRenamed(copyFiles, extraFiles, unmatched);
 
-		assert(idx[readIndex].has_value());
-		const Match& match = directories[*idx[readIndex]];
-		assert(srcPath[readIndex].has_value() == match.src.has_value());
-		assert(refPath[readIndex].has_value() == match.ref.has_value());
-		assert(dstPath[readIndex].has_value() == match.dst.has_value());
-		assert(dstTargetPath[readIndex].has_value() == srcPath[readIndex].has_value());
+			if (match.src.has_value()) {
+				if (m_previousIndex) {
+					MatchMoved(chunkCopyDirectories, chunkExtraDirectories, *match.src);
+					MatchMoved(copyFiles, extraFiles, *match.src);
+				}
+				UpdateIndex(match.src->GetFileId(), chunkCopyDirectories);
+				UpdateIndex(match.src->GetFileId(), copyFiles);
+			}
 
-		// remove stale entries from destination
-		if (match.dst.has_value()) {
+			// remove stale files from destination
 			for (const Match& extraFile : extraFiles) {
-				const Path dstFile = *dstPath[readIndex] / extraFile.dst->GetName();
+				const Path dstFile = *dstCurrentPath / extraFile.dst->GetName();
 				LOG_DEBUG("Delete file {}", dstFile);
 				m_strategy.Delete(dstFile);
+				m_progress.OnDelete();
 				m_statistics.OnRemove(extraFile);
 			}
-			extraFiles.clear();
-			extraFiles.shrink_to_fit();  // reclaim memory
 
-			if (!extraDirectories.empty()) {
-				CopyDirectories(std::nullopt, std::nullopt, *dstPath[readIndex], extraDirectories);
-				extraDirectories.clear();
+			if (!copyFiles.empty()) {
+				CopyFiles(*srcPath, refPath, *dstCurrentPath, copyFiles);
 			}
-			extraDirectories.shrink_to_fit();  // reclaim memory
 
-			if (!match.src.has_value()) {
-				// DeleteDirectory
-				LOG_DEBUG("Remove directory {}", *dstPath[readIndex]);
-				m_strategy.Delete(*dstPath[readIndex]);
-				m_statistics.OnRemove(match);
+			// directories are processed after all files
+			copyDirectories.insert(copyDirectories.end(), std::make_move_iterator(chunkCopyDirectories.begin()), std::make_move_iterator(chunkCopyDirectories.end()));
+			extraDirectories.insert(extraDirectories.end(), std::make_move_iterator(chunkExtraDirectories.begin()), std::make_move_iterator(chunkExtraDirectories.end()));
+
+			if (listing.IsClosed()) {
+				break;
 			}
-		}
 
-		if (match.src.has_value()) {
-			if (!match.src->GetStreams().empty()) {
-				// not yet implemented
-				THROW(std::domain_error("streams for directories are not (yet) supported"));
+			// only continue the sides which are behind, the others keep their entries until the listing catches up
+			const bool srcMore = listing.NeedsMore(Side::kSrc);
+			const bool refMore = listing.NeedsMore(Side::kRef);
+			const bool dstMore = listing.NeedsMore(Side::kDst);
+			assert(srcMore || refMore || dstMore);
+			if (srcMore) {
+				m_srcScanner.Continue();
+			}
+			if (refMore) {
+				m_refScanner.Continue();
+			}
+			if (dstMore) {
+				m_dstScanner.Continue();
 			}
+			if (srcMore) {
+				m_strategy.WaitForScan(m_srcScanner);
+				read(Side::kSrc, m_srcScanner, srcDirectories[readIndex], srcFiles[readIndex], *srcPath);
+			}
+			if (refMore) {
+				m_strategy.WaitForScan(m_refScanner);
+				read(Side::kRef, m_refScanner, refDirectories[readIndex], refFiles[readIndex], *refPath);
+			}
+			if (dstMore) {
+				m_strategy.WaitForScan(m_dstScanner);
+				read(Side::kDst, m_dstScanner, dstDirectories[readIndex], dstFiles[readIndex], *dstPath);
+			}
+		}
 
-			if (!match.dst.has_value()) {
-				// CreateDirectory
-				LOG_DEBUG("Create directory {}", *dstTargetPath[readIndex]);
-				m_strategy.CreateDirectory(*dstTargetPath[readIndex], *srcPath[readIndex], *match.src);
-				m_statistics.OnAdd(match);
-			} else {
-				if (!srcPath[readIndex]->GetFilename().IsSameStringAs(dstPath[readIndex]->GetFilename())) {
-					assert(srcPath[readIndex]->GetFilename() == dstPath[readIndex]->GetFilename());
-					LOG_DEBUG("Rename directory {} to {}", *dstPath[readIndex], *dstTargetPath[readIndex]);
-					m_strategy.Rename(*dstPath[readIndex], *dstTargetPath[readIndex]);
+		if (deferred) {
+			scan(index & 1);
+			deferred = false;
+		}
+		if (index < maxIndex) {
+			// wait for disk activity to end
+			waitForScan(index & 1);
+		}
+
+		// remove stale directories from destination
+		if (!extraDirectories.empty()) {
+			CopyDirectories(nullptr, nullptr, dstNode[readIndex], extraDirectories);
+			extraDirectories.clear();
+		}
+		extraDirectories.shrink_to_fit();  // reclaim memory
+
+		if (match.dst.has_value() && !match.src.has_value()) {
+			// DeleteDirectory
+			LOG_DEBUG("Remove directory {}", *dstPath);
+			m_strategy.Delete(*dstPath);
+			m_statistics.OnRemove(match);
+		}
+
+		if (match.src.has_value()) {
+			if (match.dst.has_value()) {
+				if (!match.src->GetName().IsSameStringAs(match.dst->GetName())) {
+					// change case or directory has been renamed in source
+					LOG_DEBUG("Rename directory {} to {}", *dstPath, *dstTargetPath);
+					m_strategy.Rename(*dstPath, *dstTargetPath);
 					m_statistics.OnUpdate(match);
 				} else if (!SameAttributes(*match.src, *match.dst)) {
 					// distinguish changes in source data from technical changes because of copying files
@@ -553,139 +1211,32 @@ void Backup::CopyDirectories(const std::optional<Path>& optionalSrc, const std::
 
 				// adjust security if required
 				if (!SameSecurity(*match.src, *match.dst)) {
-					LOG_DEBUG("Update security of {}", *dstTargetPath[readIndex]);
-					m_strategy.SetSecurity(*dstTargetPath[readIndex], *match.src);
+					LOG_DEBUG("Update security of {}", *dstTargetPath);
+					m_strategy.SetSecurity(*dstTargetPath, *match.src);
 					m_statistics.OnSecurityUpdate(match);
 				}
 			}
-		}
 
-		// compare and copy files
-		for (const Match& matchedFile : copyFiles) {
-			assert(match.src.has_value());
-			assert(matchedFile.src.has_value());
-
-			const Path srcFile = *srcPath[readIndex] / matchedFile.src->GetName();
-			if (matchedFile.src->GetAttributes() & BackupStrategy::kUnsupportedAttributesMask) {
-				THROW(std::exception(), "File has unsupported attributes {}: {}", matchedFile.src->GetAttributes(), srcFile);
-			}
-
-			const Path dstTargetFile = *dstTargetPath[readIndex] / matchedFile.src->GetName();
-
-			// check if dst is the same as src
-			if (matchedFile.dst.has_value()) {
-				const Path dstFile = *dstPath[readIndex] / matchedFile.dst->GetName();
-
-				if (!SameAttributes(*matchedFile.src, *matchedFile.dst)) {
-					// remove dst if it has changed attributes
-					LOG_DEBUG("File has changed, removing {}", dstFile);
-				} else if (matchedFile.dst->GetAttributes() & BackupStrategy::kUnsupportedAttributesMask) {
-					// remove dst if it has unsupported attributes
-					LOG_DEBUG("File has unsupported attributes {}, removing: {}", matchedFile.dst->GetAttributes(), dstFile);
-				} else {
-					// check if security must be updated
-					const bool differentSecurity = m_fileSecurity && !SameSecurity(*matchedFile.src, *matchedFile.dst);
-					if (differentSecurity && matchedFile.dst->IsHardLink(*matchedFile.ref)) {
-						// file is hard link, so changing security would modify copy in ref -> delete and create new
-						goto dstDifferent;
-					}
-
-					if (m_compareContents) {
-						// compare contents of src and dst
-						LOG_DEBUG("Compare files {} and {}", srcFile, dstFile);
-						if (!m_strategy.Compare(srcFile, dstFile, m_fileComparer)) {
-							goto dstDifferent;
-						}
-						const std::vector<ScannedFile::Stream>& srcStreams = matchedFile.src->GetStreams();
-						const std::vector<ScannedFile::Stream>& dstStreams = matchedFile.dst->GetStreams();
-						assert(srcStreams.size() == dstStreams.size());
-
-						for (std::size_t i = 0, max = srcStreams.size(); i < max; ++i) {
-							assert(srcStreams[i].GetName() == dstStreams[i].GetName());
-							const Path srcStreamName = srcFile + srcStreams[i].GetName();
-							const Path dstStreamName = dstFile + dstStreams[i].GetName();
-
-							LOG_DEBUG("Compare streams {} and {}", srcStreamName, dstStreamName);
-							if (!m_strategy.Compare(srcStreamName, dstStreamName, m_fileComparer)) {
-								goto dstDifferent;
-							}
-						}
-					}
-
-					if (matchedFile.src->GetName().IsSameStringAs(matchedFile.dst->GetName())) {
-						m_statistics.OnRetain(matchedFile);
-					} else {
-						assert(matchedFile.src->GetName() == matchedFile.dst->GetName());
-						// change case
-						LOG_DEBUG("Rename {} to {}", dstFile, dstTargetFile);
-						m_strategy.Rename(dstFile, dstTargetFile);
-						m_statistics.OnUpdate(matchedFile);
-					}
-
-					// adjust security if required
-					if (differentSecurity) {
-						LOG_DEBUG("Update security of {}", dstTargetFile);
-						m_strategy.SetSecurity(dstTargetFile, *matchedFile.src);
-						m_statistics.OnSecurityUpdate(matchedFile);
-					}
-
-					continue;
-
-				dstDifferent:
-					// delete outdated copy in target
-					LOG_DEBUG("Delete file for replacement {}", dstFile);
-				}
-				m_strategy.Delete(dstFile);
-				m_statistics.OnReplace(matchedFile);
-			} else {
-				m_statistics.OnAdd(matchedFile);
-			}
-
-			// check if ref is the same as src (if not same hard-link as dst)
-			if (matchedFile.ref.has_value() && SameAttributes(*matchedFile.src, *matchedFile.ref) && !(matchedFile.dst.has_value() && matchedFile.ref->IsHardLink(*matchedFile.dst)) && (!m_fileSecurity || SameSecurity(*matchedFile.src, *matchedFile.ref))) {
-				const Path refFile = *refPath[readIndex] / matchedFile.ref->GetName();
-
-				if (m_compareContents) {
-					// compare contents of src and ref
-					LOG_DEBUG("Compare files {} and {}", srcFile, refFile);
-					if (!m_strategy.Compare(srcFile, refFile, m_fileComparer)) {
-						goto refDifferent;
-					}
-				}
-				assert(matchedFile.src->GetSize() == matchedFile.ref->GetSize());
-				// if same create hard link for ref in dst and continue
-				LOG_DEBUG("Create link from {} to {}", refFile, dstTargetFile);
-				m_strategy.CreateHardLink(dstTargetFile, refFile);
-				m_statistics.OnHardLink(matchedFile.src->GetSize());
-				continue;
+			if (!copyDirectories.empty()) {
+				CopyDirectories(srcNode[readIndex], refNode[readIndex], dstTargetNode[readIndex], copyDirectories);
 			}
-		refDifferent:
 
-			// copy src to dst
-			LOG_DEBUG("Copy file {} to {}", srcFile, dstTargetFile);
-			m_strategy.Copy(srcFile, dstTargetFile);
-			// copying does copy attributes and security, however we want the original file times
-			m_strategy.SetAttributes(dstTargetFile, *matchedFile.src);
-			m_statistics.OnCopy(matchedFile.src->GetSize());
-		}
-		copyFiles.clear();
-		copyFiles.shrink_to_fit();
-
-		if (match.src.has_value()) {
-			if (!copyDirectories.empty()) {
-				CopyDirectories(srcPath[readIndex], refPath[readIndex], *dstTargetPath[readIndex], copyDirectories);
+			if (!replacingFiles.empty()) {
+				UpdateIndex(match.src->GetFileId(), replacingFiles);
+				CopyFiles(*srcPath, refPath, *dstTargetPath, replacingFiles);
 			}
 
 			// UpdateDirectoryAttributes (after any copy operations might have modified the timestamps)
-			m_strategy.SetAttributes(*dstTargetPath[readIndex], *match.src);
+			m_strategy.SetAttributes(*dstTargetPath, *match.src);
 		}
 
 		// mark data as "processed"
+		m_progress.OnDirectory();
 		idx[readIndex].reset();
-		srcPath[readIndex].reset();
-		refPath[readIndex].reset();
-		dstPath[readIndex].reset();
-		dstTargetPath[readIndex].reset();
+		srcNode[readIndex].reset();
+		refNode[readIndex].reset();
+		dstNode[readIndex].reset();
+		dstTargetNode[readIndex].reset();
 	}
 }
 
@@ -0,0 +1,245 @@
+/*
+Copyright 2020 Michael Beckh
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+/// @file
+
+#include "systools/BackupIndex.h"
+
+#include "systools/Path.h"
+
+#include <llamalog/llamalog.h>
+#include <m3c/Handle.h>
+#include <m3c/exception.h>
+
+#include <windows.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <limits>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace systools {
+
+namespace {
+
+constexpr std::uint32_t kMagic = 0x49425453;  // "STBI"
+constexpr std::uint32_t kVersion = 1;
+
+#pragma pack(push, 1)
+struct FileHeader {
+	std::uint32_t magic;
+	std::uint32_t version;
+	std::uint64_t count;
+};
+
+/// @brief An entry in the file, followed by `nameLength` characters of the name.
+struct FileEntry {
+	FILE_ID_128 fileId;
+	FILE_ID_128 parentId;
+	std::uint16_t nameLength;
+};
+#pragma pack(pop)
+
+/// @brief The maximum number of bytes for a single call of `ReadFile` or `WriteFile`.
+constexpr std::size_t kMaxChunkSize = 0x1000000;
+
+/// @brief Check if a file id is all zero, i.e. the entry is in the root of the backup.
+/// @param fileId The file id.
+/// @return `true` if all bytes are zero.
+bool IsRoot(const FILE_ID_128& fileId) noexcept {
+	return std::all_of(std::cbegin(fileId.Identifier), std::cend(fileId.Identifier), [](const BYTE b) noexcept {
+		return b == 0;
+	});
+}
+
+/// @brief Read exactly @p size bytes from a file.
+/// @param hFile The file.
+/// @param path The path of the file for error messages.
+/// @param pData The buffer receiving the data.
+/// @param size The number of bytes to read.
+void Read(const HANDLE hFile, const Path& path, std::byte* pData, std::size_t size) {
+	while (size) {
+		const DWORD chunkSize = static_cast<DWORD>(std::min(size, kMaxChunkSize));
+		DWORD bytesRead;  // NOLINT(cppcoreguidelines-init-variables): Initialized as out parameter.
+		if (!ReadFile(hFile, pData, chunkSize, &bytesRead, nullptr)) {
+			THROW(m3c::windows_exception(GetLastError()), "ReadFile {}", path);
+		}
+		if (bytesRead != chunkSize) {
+			THROW(std::exception(), "Backup index {} is truncated", path);
+		}
+		pData += bytesRead;  // NOLINT(cppcoreguidelines-pro-bounds-pointer-arithmetic): Advance in buffer.
+		size -= bytesRead;
+	}
+}
+
+/// @brief Write all data to a file.
+/// @param hFile The file.
+/// @param path The path of the file for error messages.
+/// @param pData The data to write.
+/// @param size The number of bytes to write.
+void Write(const HANDLE hFile, const Path& path, const std::byte* pData, std::size_t size) {
+	while (size) {
+		const DWORD chunkSize = static_cast<DWORD>(std::min(size, kMaxChunkSize));
+		DWORD bytesWritten;  // NOLINT(cppcoreguidelines-init-variables): Initialized as out parameter.
+		if (!WriteFile(hFile, pData, chunkSize, &bytesWritten, nullptr)) {
+			THROW(m3c::windows_exception(GetLastError()), "WriteFile {}", path);
+		}
+		if (bytesWritten != chunkSize) {
+			THROW(m3c::windows_exception(ERROR_WRITE_FAULT), "WriteFile {}: Wrote {} of {} bytes", path, bytesWritten, chunkSize);
+		}
+		pData += bytesWritten;  // NOLINT(cppcoreguidelines-pro-bounds-pointer-arithmetic): Advance in buffer.
+		size -= bytesWritten;
+	}
+}
+
+}  // namespace
+
+BackupIndex::BackupIndex(Path path)
+	: m_path(std::move(path)) {
+	if (m_path.Exists()) {
+		Load();
+	}
+}
+
+const BackupIndex::Entry* BackupIndex::Find(const FILE_ID_128& fileId) const noexcept {
+	const auto it = m_entries.find(fileId);
+	return it == m_entries.cend() ? nullptr : &it->second;
+}
+
+std::vector<Filename> BackupIndex::GetLocation(const FILE_ID_128& fileId) const {
+	std::vector<Filename> location;
+	const FILE_ID_128* pFileId = &fileId;
+	// guard against cycles in a corrupt or outdated index
+	for (std::size_t depth = 0; depth < m_entries.size(); ++depth) {
+		const auto it = m_entries.find(*pFileId);
+		if (it == m_entries.cend()) {
+			return {};
+		}
+		location.push_back(it->second.name);
+		if (IsRoot(it->second.parentId)) {
+			std::reverse(location.begin(), location.end());
+			return location;
+		}
+		pFileId = &it->second.parentId;
+	}
+	return {};
+}
+
+void BackupIndex::Set(const FILE_ID_128& fileId, Entry entry) {
+	m_entries.insert_or_assign(fileId, std::move(entry));
+}
+
+void BackupIndex::Clear() noexcept {
+	m_entries.clear();
+}
+
+void BackupIndex::Load() {
+	const m3c::Handle hFile = CreateFileW(m_path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (!hFile) {
+		THROW(m3c::windows_exception(GetLastError()), "CreateFile {}", m_path);
+	}
+
+	LARGE_INTEGER fileSize;  // NOLINT(cppcoreguidelines-pro-type-member-init): Initialized as out parameter.
+	if (!GetFileSizeEx(hFile, &fileSize)) {
+		THROW(m3c::windows_exception(GetLastError()), "GetFileSizeEx {}", m_path);
+	}
+	const std::uint64_t size = static_cast<std::uint64_t>(fileSize.QuadPart);
+	if (size < sizeof(FileHeader) || size > std::numeric_limits<std::size_t>::max()) {
+		THROW(std::exception(), "{} is not a backup index", m_path);
+	}
+
+	std::vector<std::byte> data(static_cast<std::size_t>(size));
+	Read(hFile, m_path, data.data(), data.size());
+
+	FileHeader header;  // NOLINT(cppcoreguidelines-pro-type-member-init): Initialized by memcpy.
+	std::memcpy(&header, data.data(), sizeof(header));
+	if (header.magic != kMagic || header.version != kVersion) {
+		THROW(std::exception(), "{} is not a backup index", m_path);
+	}
+	// never trust the count for allocating memory
+	if (header.count > (data.size() - sizeof(FileHeader)) / sizeof(FileEntry)) {
+		THROW(std::exception(), "Backup index {} has {} bytes for {} entries", m_path, size, header.count);
+	}
+
+	m_entries.reserve(static_cast<std::size_t>(header.count));
+	std::size_t offset = sizeof(header);
+	for (std::uint64_t i = 0; i < header.count; ++i) {
+		if (data.size() - offset < sizeof(FileEntry)) {
+			THROW(std::exception(), "Backup index {} is truncated", m_path);
+		}
+		FileEntry fileEntry;  // NOLINT(cppcoreguidelines-pro-type-member-init): Initialized by memcpy.
+		std::memcpy(&fileEntry, &data[offset], sizeof(fileEntry));
+		offset += sizeof(fileEntry);
+
+		const std::size_t nameSize = fileEntry.nameLength * sizeof(wchar_t);
+		if (!fileEntry.nameLength || data.size() - offset < nameSize) {
+			THROW(std::exception(), "Backup index {} is truncated", m_path);
+		}
+		std::wstring name(fileEntry.nameLength, L'\0');
+		std::memcpy(name.data(), &data[offset], nameSize);
+		offset += nameSize;
+
+		m_entries.insert_or_assign(fileEntry.fileId, Entry{.parentId = fileEntry.parentId, .name = Filename(std::move(name))});
+	}
+	if (offset != data.size()) {
+		THROW(std::exception(), "Backup index {} has {} bytes for {} entries", m_path, size, header.count);
+	}
+	LOG_DEBUG("Loaded {} entries from {}", m_entries.size(), m_path);
+}
+
+void BackupIndex::Save() const {
+	std::size_t size = sizeof(FileHeader);
+	for (const auto& [fileId, entry] : m_entries) {
+		size += sizeof(FileEntry) + entry.name.size() * sizeof(wchar_t);
+	}
+
+	std::vector<std::byte> data(size);
+	const FileHeader header = {.magic = kMagic, .version = kVersion, .count = m_entries.size()};
+	std::memcpy(data.data(), &header, sizeof(header));
+	std::size_t offset = sizeof(header);
+	for (const auto& [fileId, entry] : m_entries) {
+		// NTFS limits names to 255 characters
+		const FileEntry fileEntry = {.fileId = fileId, .parentId = entry.parentId, .nameLength = static_cast<std::uint16_t>(entry.name.size())};
+		std::memcpy(&data[offset], &fileEntry, sizeof(fileEntry));
+		offset += sizeof(fileEntry);
+		std::memcpy(&data[offset], entry.name.c_str(), entry.name.size() * sizeof(wchar_t));
+		offset += entry.name.size() * sizeof(wchar_t);
+	}
+
+	// keep the previous version until the new one is complete
+	const Path tempPath = m_path + L".tmp";
+	{
+		const m3c::Handle hFile = CreateFileW(tempPath.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (!hFile) {
+			THROW(m3c::windows_exception(GetLastError()), "CreateFile {}", tempPath);
+		}
+		Write(hFile, tempPath, data.data(), data.size());
+		if (!FlushFileBuffers(hFile)) {
+			THROW(m3c::windows_exception(GetLastError()), "FlushFileBuffers {}", tempPath);
+		}
+	}
+	if (!MoveFileExW(tempPath.c_str(), m_path.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+		THROW(m3c::windows_exception(GetLastError()), "MoveFileEx {} to {}", tempPath, m_path);
+	}
+	LOG_DEBUG("Saved {} entries to {}", m_entries.size(), m_path);
+}
+
+}  // namespace systools
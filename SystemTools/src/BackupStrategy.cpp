@@ -20,23 +20,178 @@ limitations under the License.
 
 #include "systools/DirectoryScanner.h"
 #include "systools/FileComparer.h"
+#include "systools/FileCopier.h"
 #include "systools/Path.h"
 
 #include <llamalog/llamalog.h>
 #include <m3c/Handle.h>
 #include <m3c/com_ptr.h>
 #include <m3c/exception.h>
+#include <m3c/mutex.h>
 
 #include <accctrl.h>
 #include <aclapi.h>
 #include <objbase.h>
 #include <shellapi.h>
 #include <shobjidl.h>
+#include <winioctl.h>
 
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
 #include <memory>
+#include <optional>
+#include <tuple>
+#include <utility>
 
 namespace systools {
 
+namespace {
+
+const auto kLocalFreeDelete = [](void* ptr) noexcept {
+	if (LocalFree(ptr)) {
+		SLOG_ERROR("LocalFree: {}", lg::LastError());
+	}
+};
+
+/// @brief The security information which is copied from the source, i.e. the same as for `WritingBackupStrategy::SetSecurity`.
+constexpr SECURITY_INFORMATION kSecurityInformation = ATTRIBUTE_SECURITY_INFORMATION | DACL_SECURITY_INFORMATION | GROUP_SECURITY_INFORMATION | LABEL_SECURITY_INFORMATION | OWNER_SECURITY_INFORMATION | SACL_SECURITY_INFORMATION | SCOPE_SECURITY_INFORMATION;
+
+/// @brief The maximum number of bytes cloned in a single call.
+constexpr std::uint64_t kMaxCloneSize = 1ULL << 30;
+
+/// @brief Files of at least this size are copied using `FileCopier`, smaller ones using `CopyFileEx`.
+/// @details The default is the size where `FileCopier` has all requests in flight.
+constexpr std::uint64_t kMinimumSizeForFileCopier = static_cast<std::uint64_t>(FileCopier::kDefaultBufferSize) * FileCopier::kDefaultQueueDepth;
+
+/// @brief Get the serial number and file system flags of the volume where a directory is stored.
+std::pair<DWORD, DWORD> GetVolumeInformation(const Path& path) {
+	const m3c::Handle hDirectory = CreateFileW(path.c_str(), FILE_READ_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, nullptr);
+	if (!hDirectory) {
+		THROW(m3c::windows_exception(GetLastError()), "CreateFile {}", path);
+	}
+
+	DWORD serialNumber;     // NOLINT(cppcoreguidelines-init-variables): Initialized as out parameter.
+	DWORD fileSystemFlags;  // NOLINT(cppcoreguidelines-init-variables): Initialized as out parameter.
+	if (!GetVolumeInformationByHandleW(hDirectory, nullptr, 0, &serialNumber, nullptr, &fileSystemFlags, nullptr, 0)) {
+		THROW(m3c::windows_exception(GetLastError()), "GetVolumeInformationByHandle {}", path);
+	}
+	return {serialNumber, fileSystemFlags};
+}
+
+/// @brief Copy a file by sharing the data blocks of the source.
+/// @details Only the unnamed data stream is cloned. Both files must be on the same volume with block cloning support.
+/// The length is read from the opened source which is not shared for writing, so the file cannot change while it is
+/// cloned. An exception is thrown if the length is different from @p scannedSize.
+/// @param source The file to clone.
+/// @param target The name of the clone.
+/// @param scannedSize The size of @p source when it was scanned.
+/// @return `false` if the file cannot be cloned and must be copied instead. No target file exists in this case.
+bool CloneFile(const Path& source, const Path& target, const std::uint64_t scannedSize) {
+	const m3c::Handle hSource = CreateFileW(source.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (!hSource) {
+		THROW(m3c::windows_exception(GetLastError()), "CreateFile {}", source);
+	}
+
+	FILE_STANDARD_INFO fileStandardInfo;
+	if (!GetFileInformationByHandleEx(hSource, FileStandardInfo, &fileStandardInfo, sizeof(fileStandardInfo))) {
+		THROW(m3c::windows_exception(GetLastError()), "GetFileInformationByHandleEx {}", source);
+	}
+	const std::uint64_t size = static_cast<std::uint64_t>(fileStandardInfo.EndOfFile.QuadPart);
+	if (size != scannedSize) {
+		THROW(std::exception(), "{} changed while copying", source);
+	}
+
+	FSCTL_GET_INTEGRITY_INFORMATION_BUFFER integrityInformation;
+	DWORD bytesReturned;  // NOLINT(cppcoreguidelines-init-variables): Initialized as out parameter.
+	if (!DeviceIoControl(hSource, FSCTL_GET_INTEGRITY_INFORMATION, nullptr, 0, &integrityInformation, sizeof(integrityInformation), &bytesReturned, nullptr)) {
+		THROW(m3c::windows_exception(GetLastError()), "DeviceIoControl {}", source);
+	}
+
+	const m3c::Handle hTarget = CreateFileW(target.c_str(), GENERIC_READ | GENERIC_WRITE | DELETE, 0, nullptr, CREATE_NEW, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (!hTarget) {
+		THROW(m3c::windows_exception(GetLastError()), "CreateFile {}", target);
+	}
+
+	// remove the incomplete target when the handle is closed
+	const auto deleteTarget = [&hTarget, &target]() {
+		FILE_DISPOSITION_INFO fileDispositionInfo = {.DeleteFile = TRUE};
+		if (!SetFileInformationByHandle(hTarget, FileDispositionInfo, &fileDispositionInfo, sizeof(fileDispositionInfo))) {
+			LOG_ERROR("SetFileInformationByHandle {}: {}", target, lg::LastError());
+		}
+	};
+
+	try {
+		// source and target must use the same integrity settings
+		if (integrityInformation.ChecksumAlgorithm != CHECKSUM_TYPE_NONE) {
+			FSCTL_SET_INTEGRITY_INFORMATION_BUFFER setIntegrityInformation = {.ChecksumAlgorithm = integrityInformation.ChecksumAlgorithm, .Reserved = 0, .Flags = integrityInformation.Flags};
+			if (!DeviceIoControl(hTarget, FSCTL_SET_INTEGRITY_INFORMATION, &setIntegrityInformation, sizeof(setIntegrityInformation), nullptr, 0, &bytesReturned, nullptr)) {
+				THROW(m3c::windows_exception(GetLastError()), "DeviceIoControl {}", target);
+			}
+		}
+
+		FILE_END_OF_FILE_INFO fileEndOfFileInfo = {.EndOfFile = {.QuadPart = static_cast<std::int64_t>(size)}};
+		if (!SetFileInformationByHandle(hTarget, FileEndOfFileInfo, &fileEndOfFileInfo, sizeof(fileEndOfFileInfo))) {
+			THROW(m3c::windows_exception(GetLastError()), "SetFileInformationByHandle {}", target);
+		}
+
+		// the range must be a multiple of the cluster size, but may extend beyond the end of file
+		const std::uint64_t clusterSize = integrityInformation.ClusterSizeInBytes;
+		for (std::uint64_t offset = 0; offset < size;) {
+			const std::uint64_t byteCount = std::min(kMaxCloneSize, (size - offset + clusterSize - 1) / clusterSize * clusterSize);
+			DUPLICATE_EXTENTS_DATA duplicateExtentsData = {.FileHandle = hSource, .SourceFileOffset = {.QuadPart = static_cast<std::int64_t>(offset)}, .TargetFileOffset = {.QuadPart = static_cast<std::int64_t>(offset)}, .ByteCount = {.QuadPart = static_cast<std::int64_t>(byteCount)}};
+			if (!DeviceIoControl(hTarget, FSCTL_DUPLICATE_EXTENTS_TO_FILE, &duplicateExtentsData, sizeof(duplicateExtentsData), nullptr, 0, &bytesReturned, nullptr)) {
+				const DWORD lastError = GetLastError();
+				if (!offset && (lastError == ERROR_NOT_SUPPORTED || lastError == ERROR_INVALID_FUNCTION)) {
+					LOG_DEBUG("Cloning not supported for {}, falling back to copy", target);
+					deleteTarget();
+					return false;
+				}
+				THROW(m3c::windows_exception(lastError), "DeviceIoControl {} to {}", source, target);
+			}
+			offset += byteCount;
+		}
+	} catch (...) {
+		deleteTarget();
+		throw;
+	}
+	return true;
+}
+
+/// @brief Copy owner, group, DACL and SACL of a file to its copy.
+/// @details `FileCopier` and `CloneFile` create the target with default security while `CopyFileEx` applies its own
+/// rules. Setting the security explicitly after every copy ensures that a copy has the same security regardless of the
+/// method used. The security is only read from @p source if @p sourceFile was scanned without it. The target is deleted
+/// if the security cannot be copied.
+void CopySecurity(const Path& source, const Path& target, const ScannedFile& sourceFile) {
+	try {
+		ScannedFile::Security security = sourceFile.GetSecurity();
+		if (!security.pSecurityDescriptor) {
+			PSECURITY_DESCRIPTOR pSecurityDescriptor;  // NOLINT(cppcoreguidelines-init-variables): Initialized as out parameter.
+			const DWORD result = GetNamedSecurityInfoW(source.c_str(), SE_FILE_OBJECT, kSecurityInformation, &security.pOwner, &security.pGroup, &security.pDacl, &security.pSacl, &pSecurityDescriptor);
+			if (result != ERROR_SUCCESS) {
+				THROW(m3c::windows_exception(result), "GetNamedSecurityInfoW {}", source);
+			}
+			security.pSecurityDescriptor.reset(pSecurityDescriptor, kLocalFreeDelete);
+		}
+
+		// for some reason, the first argument to SetNamedSecurityInfoW is _writable_
+		Path::string_type writablePath(target.sv());
+		const DWORD result = SetNamedSecurityInfoW(writablePath.data(), SE_FILE_OBJECT, kSecurityInformation | UNPROTECTED_DACL_SECURITY_INFORMATION | UNPROTECTED_SACL_SECURITY_INFORMATION, security.pOwner, security.pGroup, security.pDacl, security.pSacl);
+		if (result != ERROR_SUCCESS) {
+			THROW(m3c::windows_exception(result), "SetNamedSecurityInfoW {}", target);
+		}
+	} catch (...) {
+		if (!DeleteFileW(target.c_str())) {
+			LOG_ERROR("DeleteFile {}: {}", target, lg::LastError());
+		}
+		throw;
+	}
+}
+
+}  // namespace
+
 //
 // BaseBackupStrategy
 //
@@ -81,7 +236,19 @@ void DryRunBackupStrategy::SetSecurity(const Path& /* path */, const ScannedFile
 void DryRunBackupStrategy::Rename(const Path& /* existingName */, const Path& /* newName */) const {
 }
 
-void DryRunBackupStrategy::Copy(const Path& /* source */, const Path& /* target */) const {
+std::optional<Digest> DryRunBackupStrategy::Copy(const Path& /* source */, const Path& /* target */, const ScannedFile& /* sourceFile */, bool /* calculateDigest */) const {
+	// nothing to verify
+	return std::nullopt;
+}
+
+bool DryRunBackupStrategy::Clone(const Path& /* source */, const Path& /* target */, const ScannedFile& /* sourceFile */) const {
+	// report as not supported, i.e. the file is copied instead
+	return false;
+}
+
+std::optional<std::uint64_t> DryRunBackupStrategy::Update(const Path& /* source */, const Path& /* target */, FileComparer& /* fileComparer */) const {
+	// report as a full copy
+	return std::nullopt;
 }
 
 void DryRunBackupStrategy::CreateHardLink(const Path& /* path */, const Path& /* existing */) const {
@@ -143,11 +310,10 @@ void WritingBackupStrategy::SetAttributes(const Path& path, const ScannedFile& a
 }
 
 void WritingBackupStrategy::SetSecurity(const Path& path, const ScannedFile& securitySource) const {
-	constexpr SECURITY_INFORMATION kSecurityInformation = ATTRIBUTE_SECURITY_INFORMATION | DACL_SECURITY_INFORMATION | GROUP_SECURITY_INFORMATION | LABEL_SECURITY_INFORMATION | OWNER_SECURITY_INFORMATION | SACL_SECURITY_INFORMATION | SCOPE_SECURITY_INFORMATION | UNPROTECTED_DACL_SECURITY_INFORMATION | UNPROTECTED_SACL_SECURITY_INFORMATION;
 	// for some reason, the first argument to SetNamedSecurityInfoW is _writable_
 	Path::string_type writablePath(path.sv());
 	const ScannedFile::Security& security = securitySource.GetSecurity();
-	const DWORD result = SetNamedSecurityInfoW(writablePath.data(), SE_FILE_OBJECT, kSecurityInformation, security.pOwner, security.pGroup, security.pDacl, security.pSacl);
+	const DWORD result = SetNamedSecurityInfoW(writablePath.data(), SE_FILE_OBJECT, kSecurityInformation | UNPROTECTED_DACL_SECURITY_INFORMATION | UNPROTECTED_SACL_SECURITY_INFORMATION, security.pOwner, security.pGroup, security.pDacl, security.pSacl);
 	if (result != ERROR_SUCCESS) {
 		THROW(m3c::windows_exception(result), "SetNamedSecurityInfoW {}", path);
 	}
@@ -169,13 +335,65 @@ void WritingBackupStrategy::Rename(const Path& existingName, const Path& newName
 	}
 }
 
-void WritingBackupStrategy::Copy(const Path& source, const Path& target) const {
+bool WritingBackupStrategy::CanClone(const Path& source, const Path& target) const {
+	const auto getVolume = [](const Path& directory, Volume& volume) -> const Volume& {
+		if (volume.directory != directory.sv()) {
+			std::tie(volume.serialNumber, volume.fileSystemFlags) = GetVolumeInformation(directory);
+			volume.directory = directory.sv();
+		}
+		return volume;
+	};
+
+	const m3c::scoped_lock lock(m_volumeMutex);
+	const Volume& targetVolume = getVolume(target.GetParent(), m_targetVolume);
+	if (!(targetVolume.fileSystemFlags & FILE_SUPPORTS_BLOCK_REFCOUNTING)) {
+		return false;
+	}
+	return getVolume(source.GetParent(), m_sourceVolume).serialNumber == targetVolume.serialNumber;
+}
+
+std::optional<Digest> WritingBackupStrategy::Copy(const Path& source, const Path& target, const ScannedFile& sourceFile, const bool calculateDigest) const {
+	// a clone shares the data blocks of the source, there is no data to verify
+	if (Clone(source, target, sourceFile)) {
+		return std::nullopt;
+	}
+
+	// alternate data streams are only copied by CopyFileEx
+	if (sourceFile.GetStreams().empty() && (calculateDigest || sourceFile.GetSize() >= kMinimumSizeForFileCopier)) {
+		FileCopier fileCopier;
+		if (!calculateDigest) {
+			fileCopier.Copy(source, target, nullptr);
+			CopySecurity(source, target, sourceFile);
+			return std::nullopt;
+		}
+		Digest digest;  // NOLINT(cppcoreguidelines-pro-type-member-init): Initialized as out parameter.
+		fileCopier.Copy(source, target, &digest);
+		CopySecurity(source, target, sourceFile);
+		return digest;
+	}
+
 	BOOL cancel = FALSE;
 	//COPYFILE2_EXTENDED_PARAMETERS params = {sizeof(params), COPY_FILE_FAIL_IF_EXISTS | COPY_FILE_NO_BUFFERING, &cancel, nullptr, nullptr};
 	//COM_HR(CopyFile2(source.c_str(), target.c_str(), &params), "CopyFile2 {} to {}", source, target);
 	if (!CopyFileEx(source.c_str(), target.c_str(), nullptr, nullptr, &cancel, COPY_FILE_FAIL_IF_EXISTS | COPY_FILE_NO_BUFFERING)) {
 		THROW(m3c::windows_exception(GetLastError()), "CopyFileEx {} to {}", source, target);
 	}
+	CopySecurity(source, target, sourceFile);
+	return std::nullopt;
+}
+
+bool WritingBackupStrategy::Clone(const Path& source, const Path& target, const ScannedFile& sourceFile) const {
+	// alternate data streams are only copied by CopyFileEx
+	if (!sourceFile.GetStreams().empty() || !CanClone(source, target) || !CloneFile(source, target, sourceFile.GetSize())) {
+		return false;
+	}
+	LOG_DEBUG("Cloned {} to {}", source, target);
+	CopySecurity(source, target, sourceFile);
+	return true;
+}
+
+std::optional<std::uint64_t> WritingBackupStrategy::Update(const Path& source, const Path& target, FileComparer& fileComparer) const {
+	return fileComparer.Update(source, target);
 }
 
 void WritingBackupStrategy::CreateHardLink(const Path& path, const Path& existing) const {
@@ -0,0 +1,110 @@
+/*
+Copyright 2020 Michael Beckh
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+/// @file
+
+#include "systools/Digest.h"
+
+#include "systools/Path.h"
+#include "systools/Volume.h"
+
+#include <llamalog/llamalog.h>
+#include <m3c/Handle.h>
+#include <m3c/exception.h>
+
+#include <windows.h>
+#include <bcrypt.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <thread>
+
+namespace systools {
+
+namespace {
+
+constexpr std::uint32_t kTargetBufferSize = 0x100000;
+
+}  // namespace
+
+DigestBuilder::DigestBuilder() {
+	// a reusable hash object is reset by BCryptFinishHash
+	COM_HR(HRESULT_FROM_NT(BCryptCreateHash(BCRYPT_SHA256_ALG_HANDLE, &m_hHash, nullptr, 0, nullptr, 0, BCRYPT_HASH_REUSABLE_FLAG)), "BCryptCreateHash");
+}
+
+DigestBuilder::~DigestBuilder() noexcept {
+	if (const NTSTATUS status = BCryptDestroyHash(m_hHash); !BCRYPT_SUCCESS(status)) {
+		LOG_ERROR("BCryptDestroyHash: {:#x}", static_cast<std::uint32_t>(status));
+	}
+}
+
+void DigestBuilder::Update(const std::byte* const data, const std::uint32_t size) {
+	// BCryptHashData does not modify the input despite the missing const
+	COM_HR(HRESULT_FROM_NT(BCryptHashData(m_hHash, const_cast<PUCHAR>(reinterpret_cast<const UCHAR*>(data)), size, 0)), "BCryptHashData");  // NOLINT(cppcoreguidelines-pro-type-const-cast, cppcoreguidelines-pro-type-reinterpret-cast): Required by API.
+}
+
+Digest DigestBuilder::Finish() {
+	Digest digest;  // NOLINT(cppcoreguidelines-pro-type-member-init): Initialized as out parameter.
+	COM_HR(HRESULT_FROM_NT(BCryptFinishHash(m_hHash, reinterpret_cast<PUCHAR>(digest.data()), static_cast<ULONG>(digest.size()), 0)), "BCryptFinishHash");  // NOLINT(cppcoreguidelines-pro-type-reinterpret-cast): Required by API.
+	return digest;
+}
+
+Digest CalculateDigest(const Path& path, const std::uint64_t maxBytesPerSecond) {
+	Volume volume(path);
+	const std::align_val_t alignment = volume.GetUnbufferedMemoryAlignment();
+	const std::uint32_t chunkSize = std::max(volume.GetUnbufferedFileOffsetAlignment(), static_cast<std::uint32_t>(alignment));
+	const std::uint32_t bufferSize = kTargetBufferSize / chunkSize * chunkSize;
+
+	const auto deleter = [bufferSize, alignment](void* const p) noexcept {
+		operator delete[](p, bufferSize, alignment);
+	};
+	const std::unique_ptr<std::byte[], decltype(deleter)> buffer(static_cast<std::byte*>(operator new[](bufferSize, alignment)), deleter);
+
+	// do not block other operations on the file
+	const m3c::Handle hFile = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_NO_BUFFERING | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (!hFile) {
+		THROW(m3c::windows_exception(GetLastError()), "CreateFile {}", path);
+	}
+
+	LOG_TRACE("Reading {} with buffer size {}", path, bufferSize);
+
+	DigestBuilder digestBuilder;
+	const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	std::uint64_t bytesTotal = 0;
+	while (true) {
+		DWORD bytesRead;  // NOLINT(cppcoreguidelines-init-variables): Initialized as out parameter.
+		if (!ReadFile(hFile, buffer.get(), bufferSize, &bytesRead, nullptr)) {
+			THROW(m3c::windows_exception(GetLastError()), "ReadFile {}", path);
+		}
+		if (!bytesRead) {
+			break;
+		}
+		digestBuilder.Update(buffer.get(), bytesRead);
+		bytesTotal += bytesRead;
+
+		if (maxBytesPerSecond) {
+			const std::chrono::steady_clock::time_point due = start + std::chrono::microseconds(bytesTotal * 1'000'000 / maxBytesPerSecond);
+			std::this_thread::sleep_until(due);
+		}
+	}
+	return digestBuilder.Finish();
+}
+
+}  // namespace systools
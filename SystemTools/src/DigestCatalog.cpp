@@ -0,0 +1,193 @@
+/*
+Copyright 2020 Michael Beckh
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+/// @file
+
+#include "systools/DigestCatalog.h"
+
+#include "systools/Path.h"
+
+#include <llamalog/llamalog.h>
+#include <m3c/Handle.h>
+#include <m3c/exception.h>
+
+#include <windows.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace systools {
+
+namespace {
+
+constexpr std::uint32_t kMagic = 0x43445453;  // "STDC"
+constexpr std::uint32_t kVersion = 1;
+
+#pragma pack(push, 1)
+struct FileHeader {
+	std::uint32_t magic;
+	std::uint32_t version;
+	std::uint64_t count;
+};
+
+struct FileEntry {
+	FILE_ID_128 fileId;
+	DigestCatalog::Entry entry;
+};
+#pragma pack(pop)
+
+/// @brief The maximum number of bytes for a single call of `ReadFile` or `WriteFile`.
+constexpr std::size_t kMaxChunkSize = 0x1000000;
+
+/// @brief Read exactly @p size bytes from a file.
+/// @param hFile The file.
+/// @param path The path of the file for error messages.
+/// @param pData The buffer receiving the data.
+/// @param size The number of bytes to read.
+void Read(const HANDLE hFile, const Path& path, std::byte* pData, std::size_t size) {
+	while (size) {
+		const DWORD chunkSize = static_cast<DWORD>(std::min(size, kMaxChunkSize));
+		DWORD bytesRead;  // NOLINT(cppcoreguidelines-init-variables): Initialized as out parameter.
+		if (!ReadFile(hFile, pData, chunkSize, &bytesRead, nullptr)) {
+			THROW(m3c::windows_exception(GetLastError()), "ReadFile {}", path);
+		}
+		if (bytesRead != chunkSize) {
+			THROW(std::exception(), "Digest catalog {} is truncated", path);
+		}
+		pData += bytesRead;  // NOLINT(cppcoreguidelines-pro-bounds-pointer-arithmetic): Advance in buffer.
+		size -= bytesRead;
+	}
+}
+
+/// @brief Write all data to a file.
+/// @param hFile The file.
+/// @param path The path of the file for error messages.
+/// @param pData The data to write.
+/// @param size The number of bytes to write.
+void Write(const HANDLE hFile, const Path& path, const std::byte* pData, std::size_t size) {
+	while (size) {
+		const DWORD chunkSize = static_cast<DWORD>(std::min(size, kMaxChunkSize));
+		DWORD bytesWritten;  // NOLINT(cppcoreguidelines-init-variables): Initialized as out parameter.
+		if (!WriteFile(hFile, pData, chunkSize, &bytesWritten, nullptr)) {
+			THROW(m3c::windows_exception(GetLastError()), "WriteFile {}", path);
+		}
+		if (bytesWritten != chunkSize) {
+			THROW(m3c::windows_exception(ERROR_WRITE_FAULT), "WriteFile {}: Wrote {} of {} bytes", path, bytesWritten, chunkSize);
+		}
+		pData += bytesWritten;  // NOLINT(cppcoreguidelines-pro-bounds-pointer-arithmetic): Advance in buffer.
+		size -= bytesWritten;
+	}
+}
+
+}  // namespace
+
+std::size_t DigestCatalog::FileIdHash::operator()(const FILE_ID_128& fileId) const noexcept {
+	// file ids are mostly sequential, the string hash provides proper distribution
+	return std::hash<std::string_view>{}(std::string_view(reinterpret_cast<const char*>(fileId.Identifier), sizeof(fileId.Identifier)));  // NOLINT(cppcoreguidelines-pro-type-reinterpret-cast): Hash the raw bytes.
+}
+
+bool DigestCatalog::FileIdEqual::operator()(const FILE_ID_128& lhs, const FILE_ID_128& rhs) const noexcept {
+	return std::memcmp(&lhs, &rhs, sizeof(FILE_ID_128)) == 0;
+}
+
+DigestCatalog::DigestCatalog(Path path)
+	: m_path(std::move(path)) {
+	if (m_path.Exists()) {
+		Load();
+	}
+}
+
+const DigestCatalog::Entry* DigestCatalog::Find(const FILE_ID_128& fileId) const noexcept {
+	const auto it = m_entries.find(fileId);
+	return it == m_entries.cend() ? nullptr : &it->second;
+}
+
+void DigestCatalog::Set(const FILE_ID_128& fileId, const Entry& entry) {
+	m_entries.insert_or_assign(fileId, entry);
+}
+
+void DigestCatalog::Load() {
+	const m3c::Handle hFile = CreateFileW(m_path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (!hFile) {
+		THROW(m3c::windows_exception(GetLastError()), "CreateFile {}", m_path);
+	}
+
+	LARGE_INTEGER fileSize;  // NOLINT(cppcoreguidelines-pro-type-member-init): Initialized as out parameter.
+	if (!GetFileSizeEx(hFile, &fileSize)) {
+		THROW(m3c::windows_exception(GetLastError()), "GetFileSizeEx {}", m_path);
+	}
+	const std::uint64_t size = static_cast<std::uint64_t>(fileSize.QuadPart);
+	if (size < sizeof(FileHeader)) {
+		THROW(std::exception(), "{} is not a digest catalog", m_path);
+	}
+
+	FileHeader header;  // NOLINT(cppcoreguidelines-pro-type-member-init): Initialized as out parameter.
+	Read(hFile, m_path, reinterpret_cast<std::byte*>(&header), sizeof(header));  // NOLINT(cppcoreguidelines-pro-type-reinterpret-cast): Read raw data.
+	if (header.magic != kMagic || header.version != kVersion) {
+		THROW(std::exception(), "{} is not a digest catalog", m_path);
+	}
+	// never trust the count for allocating memory
+	if (header.count != (size - sizeof(FileHeader)) / sizeof(FileEntry) || (size - sizeof(FileHeader)) % sizeof(FileEntry) != 0) {
+		THROW(std::exception(), "Digest catalog {} has {} bytes for {} entries", m_path, size, header.count);
+	}
+
+	std::vector<FileEntry> entries(static_cast<std::size_t>(header.count));
+	Read(hFile, m_path, reinterpret_cast<std::byte*>(entries.data()), entries.size() * sizeof(FileEntry));  // NOLINT(cppcoreguidelines-pro-type-reinterpret-cast): Read raw data.
+
+	m_entries.reserve(entries.size());
+	for (const FileEntry& fileEntry : entries) {
+		m_entries.insert_or_assign(fileEntry.fileId, fileEntry.entry);
+	}
+	LOG_DEBUG("Loaded {} entries from {}", m_entries.size(), m_path);
+}
+
+void DigestCatalog::Save() const {
+	std::vector<std::byte> data(sizeof(FileHeader) + m_entries.size() * sizeof(FileEntry));
+	const FileHeader header = {.magic = kMagic, .version = kVersion, .count = m_entries.size()};
+	std::memcpy(data.data(), &header, sizeof(header));
+	std::size_t offset = sizeof(header);
+	for (const auto& [fileId, entry] : m_entries) {
+		const FileEntry fileEntry = {.fileId = fileId, .entry = entry};
+		std::memcpy(&data[offset], &fileEntry, sizeof(fileEntry));
+		offset += sizeof(fileEntry);
+	}
+
+	// keep the previous version until the new one is complete
+	const Path tempPath = m_path + L".tmp";
+	{
+		const m3c::Handle hFile = CreateFileW(tempPath.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (!hFile) {
+			THROW(m3c::windows_exception(GetLastError()), "CreateFile {}", tempPath);
+		}
+		Write(hFile, tempPath, data.data(), data.size());
+		if (!FlushFileBuffers(hFile)) {
+			THROW(m3c::windows_exception(GetLastError()), "FlushFileBuffers {}", tempPath);
+		}
+	}
+	if (!MoveFileExW(tempPath.c_str(), m_path.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+		THROW(m3c::windows_exception(GetLastError()), "MoveFileEx {} to {}", tempPath, m_path);
+	}
+	LOG_DEBUG("Saved {} entries to {}", m_entries.size(), m_path);
+}
+
+}  // namespace systools
@@ -19,6 +19,7 @@ limitations under the License.
 #include "systools/DirectoryScanner.h"
 
 #include "systools/Path.h"
+#include "systools/Trace.h"
 
 #include <llamalog/llamalog.h>
 #include <m3c/Handle.h>
@@ -32,11 +33,15 @@ limitations under the License.
 #include <algorithm>
 #include <atomic>
 #include <cassert>
+#include <chrono>
 #include <cstddef>
 #include <cstdint>
 #include <exception>
+#include <functional>
+#include <memory>
 #include <stdexcept>
 #include <string>
+#include <string_view>
 #include <utility>
 #include <vector>
 
@@ -54,13 +59,103 @@ const auto kLocalFreeDelete = [](void* ptr) noexcept {
 	return (static_cast<std::uint8_t>(test) & static_cast<std::uint8_t>(value)) == static_cast<std::uint8_t>(test);
 }
 
-void ScanDirectory(const Path& path, DirectoryScanner::Result& directories, DirectoryScanner::Result& files, const DirectoryScanner::Flags flags, const ScannerFilter& filter) {
+/// @brief Get the alternate data streams of a file or directory from its handle.
+/// @details Streams share the attributes of the file, so @p attributes is used for all of them.
+/// @param hFile The handle of the file or directory.
+/// @param filePath The path of the file or directory, only used for error messages.
+/// @param attributes The attributes of the file or directory.
+/// @param streams The vector receiving the streams.
+void GetStreams(const m3c::Handle& hFile, const Path& filePath, const ULONG attributes, std::vector<ScannedFile::Stream>& streams) {
+	DWORD size = 0x1000;  // 4 KB is sufficient for all but files with a lot of streams
+	std::unique_ptr<std::byte[]> streamInfo;
+	while (true) {
+		streamInfo = std::make_unique<std::byte[]>(size);
+		if (GetFileInformationByHandleEx(hFile, FileStreamInfo, streamInfo.get(), size)) {
+			break;
+		}
+		const DWORD lastError = GetLastError();
+		if (lastError == ERROR_HANDLE_EOF) {
+			// no streams, e.g. for a directory
+			return;
+		}
+		if (lastError != ERROR_MORE_DATA && lastError != ERROR_INSUFFICIENT_BUFFER) {
+			THROW(m3c::windows_exception(lastError), "GetFileInformationByHandleEx {}", filePath);
+		}
+		size *= 2;
+	}
+
+	constexpr std::wstring_view kDefaultStream = L"::$DATA";
+	const FILE_STREAM_INFO* pCurrent = reinterpret_cast<FILE_STREAM_INFO*>(streamInfo.get());
+	while (true) {
+		const std::size_t length = pCurrent->StreamNameLength / sizeof(WCHAR);
+		// the unnamed stream is the content of the file itself
+		if (std::wstring_view(pCurrent->StreamName, length) != kDefaultStream) {
+			assert(pCurrent->StreamName[1] != L':');
+			streams.emplace_back(ScannedFile::Stream::name_type(pCurrent->StreamName, length), pCurrent->StreamSize, attributes);
+		}
+		if (!pCurrent->NextEntryOffset) {
+			break;
+		}
+		pCurrent = reinterpret_cast<const FILE_STREAM_INFO*>(reinterpret_cast<std::uintptr_t>(pCurrent) + pCurrent->NextEntryOffset);
+	}
+}
+
+/// @brief Get the alternate data streams of a file or directory by its path.
+/// @details Fallback for file systems which do not support opening files by id.
+/// @param filePath The path of the file or directory.
+/// @param directory `true` if @p filePath is a directory.
+/// @param attributes The attributes of the file or directory.
+/// @param streams The vector receiving the streams.
+void GetStreamsByPath(const Path& filePath, const bool directory, const ULONG attributes, std::vector<ScannedFile::Stream>& streams) {
+	WIN32_FIND_STREAM_DATA stream;
+	const m3c::FindHandle hFind = FindFirstStreamW(filePath.c_str(), FindStreamInfoStandard, &stream, 0);
+	if (!hFind) {
+		if (const DWORD lastError = GetLastError(); lastError != ERROR_HANDLE_EOF) {
+			THROW(m3c::windows_exception(lastError), "FindFirstStreamW {}", filePath);
+		}
+		return;
+	}
+
+	// do process first stream for directories
+	if (directory) {
+		// jump into loop, bypassing FindNextStreamW once
+		goto findLoop;
+	}
+	while (FindNextStreamW(hFind, &stream)) {
+	findLoop:
+		assert(stream.cStreamName[1] != L':');
+		streams.emplace_back(ScannedFile::Stream::name_type(stream.cStreamName), stream.StreamSize, attributes);
+	}
+	if (const DWORD lastError = GetLastError(); lastError != ERROR_HANDLE_EOF) {
+		THROW(m3c::windows_exception(lastError), "FindNextStreamW {}", filePath);
+	}
+}
+
+/// @brief Read the entries of a folder.
+/// @param path The path of the folder.
+/// @param directories Receives the folders.
+/// @param files Receives the files.
+/// @param flags The options for the scan.
+/// @param filter Entries are only added if accepted by the filter.
+/// @param chunkSize The minimum number of entries after which @p pause is called if the scan uses `Flags::kChunked`.
+/// @param pause A function which waits until the scan may continue and returns `false` if it is cancelled.
+void ScanDirectory(const Path& path, DirectoryScanner::Result& directories, DirectoryScanner::Result& files, const DirectoryScanner::Flags flags, const ScannerFilter& filter, const std::size_t chunkSize, const std::function<bool()>& pause) {
 	const m3c::Handle hDirectory = CreateFileW(path.c_str(), FILE_READ_ATTRIBUTES | FILE_LIST_DIRECTORY | FILE_READ_DATA | FILE_READ_EA, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, nullptr);
 	if (!hDirectory) {
 		THROW(m3c::windows_exception(GetLastError()), "CreateFile {}", path);
 	}
 
+	const bool chunked = DirectoryScanner::Flags::kChunked < flags;
+	std::size_t count = 0;
 	while (true) {
+		// pause only between two calls to keep the position in the folder
+		if (chunked && count >= chunkSize) {
+			if (!pause()) {
+				return;
+			}
+			count = 0;
+		}
+
 		constexpr std::size_t kSize = 0x40000;  // 256 KB
 		std::unique_ptr<std::byte[]> dirInfo = std::make_unique<std::byte[]>(kSize);
 		if (!GetFileInformationByHandleEx(hDirectory, FileIdExtdDirectoryInfo, dirInfo.get(), kSize)) {
@@ -86,49 +181,51 @@ void ScanDirectory(const Path& path, DirectoryScanner::Result& directories, Dire
 					goto next;
 				}
 
-				std::vector<ScannedFile::Stream> streams;
-				// get streams
-				if (!directory || DirectoryScanner::Flags::kFolderStreams < flags) {
-					WIN32_FIND_STREAM_DATA stream;
-					const m3c::FindHandle hFind = FindFirstStreamW(filePath.c_str(), FindStreamInfoStandard, &stream, 0);
-					if (!hFind) {
-						if (const DWORD lastError = GetLastError(); lastError != ERROR_HANDLE_EOF) {
-							THROW(m3c::windows_exception(lastError), "FindFirstStreamW {}", filePath);
+				const bool readStreams = !directory || DirectoryScanner::Flags::kFolderStreams < flags;
+				const bool readSecurity = (directory && DirectoryScanner::Flags::kFolderSecurity < flags) || (!directory && DirectoryScanner::Flags::kFileSecurity < flags);
+
+				// open by id using the directory as volume hint instead of resolving the full path again
+				m3c::Handle hFile;
+				if (readStreams || readSecurity) {
+					FILE_ID_DESCRIPTOR fileIdDescriptor;
+					fileIdDescriptor.dwSize = sizeof(fileIdDescriptor);
+					fileIdDescriptor.Type = ExtendedFileIdType;
+					fileIdDescriptor.ExtendedFileId = pCurrent->FileId;
+					hFile = OpenFileById(hDirectory, &fileIdDescriptor, FILE_READ_ATTRIBUTES | (readSecurity ? READ_CONTROL | ACCESS_SYSTEM_SECURITY : 0), FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, FILE_FLAG_BACKUP_SEMANTICS);
+					if (!hFile) {
+						// file systems without extended file ids, e.g. FAT or some network shares, fall back to the path
+						if (const DWORD lastError = GetLastError(); lastError != ERROR_INVALID_PARAMETER && lastError != ERROR_NOT_SUPPORTED) {
+							THROW(m3c::windows_exception(lastError), "OpenFileById {}", filePath);
 						}
+					}
+				}
+
+				std::vector<ScannedFile::Stream> streams;
+				if (readStreams) {
+					if (hFile) {
+						GetStreams(hFile, filePath, pCurrent->FileAttributes, streams);
 					} else {
-						// do process first stream for directories
-						if (directory) {
-							// jump into loop, bypassing FindNextStreamW once
-							goto findLoop;
-						}
-						while (FindNextStreamW(hFind, &stream)) {
-						findLoop:
-							assert(stream.cStreamName[1] != L':');
-
-							ScannedFile::Stream::name_type streamName(stream.cStreamName);
-							const Path streamPath = filePath + streamName;
-							const DWORD streamAttributes = GetFileAttributesW(streamPath.c_str());
-							if (streamAttributes == INVALID_FILE_ATTRIBUTES) {
-								THROW(m3c::windows_exception(GetLastError()), "GetFileAttributesW {}", streamPath);
-							}
-							streams.emplace_back(std::move(streamName), stream.StreamSize, streamAttributes);
-						}
-						if (const DWORD lastError = GetLastError(); lastError != ERROR_HANDLE_EOF) {
-							THROW(m3c::windows_exception(lastError), "FindNextStreamW {}", filePath);
-						}
+						GetStreamsByPath(filePath, directory, pCurrent->FileAttributes, streams);
 					}
 				}
 
 				ScannedFile scannedFile(std::move(name), pCurrent->EndOfFile, pCurrent->CreationTime, pCurrent->LastWriteTime, pCurrent->FileAttributes, pCurrent->FileId, std::move(streams));
 
 				// get security info _after_ filter
-				if ((directory && DirectoryScanner::Flags::kFolderSecurity < flags) || (!directory && DirectoryScanner::Flags::kFileSecurity < flags)) {
+				if (readSecurity) {
 					constexpr SECURITY_INFORMATION kSecurityInformation = ATTRIBUTE_SECURITY_INFORMATION | DACL_SECURITY_INFORMATION | GROUP_SECURITY_INFORMATION | LABEL_SECURITY_INFORMATION | OWNER_SECURITY_INFORMATION | PROTECTED_DACL_SECURITY_INFORMATION | PROTECTED_SACL_SECURITY_INFORMATION | SACL_SECURITY_INFORMATION | SCOPE_SECURITY_INFORMATION;
 					ScannedFile::Security& security = scannedFile.GetSecurity();
 					PSECURITY_DESCRIPTOR pSecurityDescriptor;  // NOLINT(cppcoreguidelines-init-variables): Initialized as out parameter.
-					const DWORD result = GetNamedSecurityInfoW(filePath.c_str(), SE_FILE_OBJECT, kSecurityInformation, &security.pOwner, &security.pGroup, &security.pDacl, &security.pSacl, &pSecurityDescriptor);
-					if (result != ERROR_SUCCESS) {
-						THROW(m3c::windows_exception(result), "GetNamedSecurityInfoW {}", filePath);
+					if (hFile) {
+						const DWORD result = GetSecurityInfo(hFile, SE_FILE_OBJECT, kSecurityInformation, &security.pOwner, &security.pGroup, &security.pDacl, &security.pSacl, &pSecurityDescriptor);
+						if (result != ERROR_SUCCESS) {
+							THROW(m3c::windows_exception(result), "GetSecurityInfo {}", filePath);
+						}
+					} else {
+						const DWORD result = GetNamedSecurityInfoW(filePath.c_str(), SE_FILE_OBJECT, kSecurityInformation, &security.pOwner, &security.pGroup, &security.pDacl, &security.pSacl, &pSecurityDescriptor);
+						if (result != ERROR_SUCCESS) {
+							THROW(m3c::windows_exception(result), "GetNamedSecurityInfoW {}", filePath);
+						}
 					}
 					security.pSecurityDescriptor.reset(pSecurityDescriptor, kLocalFreeDelete);
 				}
@@ -138,6 +235,7 @@ void ScanDirectory(const Path& path, DirectoryScanner::Result& directories, Dire
 				} else {
 					files.push_back(std::move(scannedFile));
 				}
+				++count;
 			}
 		next:
 			if (!pCurrent->NextEntryOffset) {
@@ -237,6 +335,29 @@ void ScanDirectory(const Path& path, DirectoryScanner::Result& directories, Dire
 	return true;
 }
 
+/// @brief Get an integer which orders names in the same way as case-insensitive comparison of `Filename`s.
+/// @details The upper case versions of the first 4 characters are stored in the integer with the first character in
+/// the highest bits. Shorter names are padded with 0 which sorts before all other characters.
+/// @param name The name of the file.
+/// @return The prefix or 0 if the prefix contains a non-ASCII character which requires locale-independent case folding.
+[[nodiscard]] std::uint64_t GetCollationPrefix(const Filename& name) noexcept {
+	constexpr std::size_t kPrefixLength = sizeof(std::uint64_t) / sizeof(wchar_t);
+
+	const std::wstring_view str = name.sv();
+	std::uint64_t prefix = 0;
+	for (std::size_t i = 0; i < kPrefixLength; ++i) {
+		wchar_t ch = i < str.size() ? str[i] : L'\0';
+		if (ch >= 0x80) {
+			return 0;
+		}
+		if (ch >= L'a' && ch <= L'z') {
+			ch -= L'a' - L'A';
+		}
+		prefix = (prefix << (sizeof(wchar_t) * 8)) | ch;
+	}
+	return prefix;
+}
+
 }  // namespace
 
 
@@ -251,7 +372,8 @@ ScannedFile::ScannedFile(Filename&& name, const LARGE_INTEGER size, const LARGE_
 	, m_lastWriteTime(lastWriteTime.QuadPart)
 	, m_attributes(attributes)
 	, m_fileId(fileId)
-	, m_streams(std::move(streams)) {
+	, m_streams(std::move(streams))
+	, m_collationPrefix(GetCollationPrefix(m_name)) {
 	assert(size.QuadPart >= 0);
 	std::sort(
 		m_streams.begin(), m_streams.end(), [](const Stream& lhs, const Stream& rhs) noexcept {
@@ -323,7 +445,8 @@ struct DirectoryScanner::Context final {
 
 enum class DirectoryScanner::State : std::uint_fast8_t { kIdle = 1,
 														 kRunning = 2,
-														 kShutdown = 4 };
+														 kShutdown = 4,
+														 kPaused = 8 };
 
 
 //
@@ -331,12 +454,19 @@ enum class DirectoryScanner::State : std::uint_fast8_t { kIdle = 1,
 //
 
 DirectoryScanner::DirectoryScanner()
-	: m_state(State::kIdle)
+	: DirectoryScanner(kDefaultChunkSize) {
+	// empty
+}
+
+DirectoryScanner::DirectoryScanner(const std::size_t chunkSize)
+	: m_chunkSize(chunkSize)
+	, m_state(State::kIdle)
 	, m_thread(
 		  [](DirectoryScanner* const pScanner) noexcept {
 			  pScanner->Run();
 		  },
 		  this) {
+	assert(chunkSize);
 }
 
 DirectoryScanner::~DirectoryScanner() noexcept {
@@ -357,6 +487,7 @@ void DirectoryScanner::Scan(Path path, Result& directories, Result& files, const
 	assert(m_state.load(std::memory_order_acquire) == State::kIdle);
 
 	m_pContext = std::make_unique<Context>(path, directories, files, flags, filter);
+	m_cancel.store(false, std::memory_order_relaxed);
 	std::atomic_thread_fence(std::memory_order_release);
 
 	{
@@ -367,12 +498,15 @@ void DirectoryScanner::Scan(Path path, Result& directories, Result& files, const
 }
 
 void DirectoryScanner::Wait() {
+	const Trace::Span span("WaitForScan", "scanner");
 	State state;
 	{
+		const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
 		m3c::shared_lock lock(m_mutex);
 		while ((state = m_state.load(std::memory_order_acquire)) == State::kRunning) {
 			m_stateChanged.wait(lock);
 		}
+		m_waitTime.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count(), std::memory_order_relaxed);
 	}
 
 	if (state == State::kShutdown) {
@@ -380,6 +514,10 @@ void DirectoryScanner::Wait() {
 	}
 
 	std::atomic_thread_fence(std::memory_order_acquire);
+	if (state == State::kPaused) {
+		// the context is still in use
+		return;
+	}
 	if (m_pContext && m_pContext->exceptionPtr) {
 		std::exception_ptr exceptionPtr = m_pContext->exceptionPtr;
 		m_pContext.reset();
@@ -388,6 +526,49 @@ void DirectoryScanner::Wait() {
 	m_pContext.reset();
 }
 
+bool DirectoryScanner::IsPaused() const noexcept {
+	return m_state.load(std::memory_order_acquire) == State::kPaused;
+}
+
+void DirectoryScanner::Continue() {
+	assert(m_state.load(std::memory_order_acquire) == State::kPaused);
+
+	std::atomic_thread_fence(std::memory_order_release);
+	{
+		m3c::scoped_lock lock(m_mutex);
+		m_state.store(State::kRunning, std::memory_order_release);
+	}
+	m_stateChanged.notify_one();
+}
+
+void DirectoryScanner::Cancel() {
+	if (!IsPaused()) {
+		return;
+	}
+	m_cancel.store(true, std::memory_order_relaxed);
+	Continue();
+	Wait();
+}
+
+bool DirectoryScanner::Pause() {
+	std::atomic_thread_fence(std::memory_order_release);
+	{
+		m3c::scoped_lock lock(m_mutex);
+		m_state.store(State::kPaused, std::memory_order_release);
+	}
+	m_stateChanged.notify_one();
+
+	State state;
+	{
+		m3c::shared_lock lock(m_mutex);
+		while ((state = m_state.load(std::memory_order_acquire)) == State::kPaused) {
+			m_stateChanged.wait(lock);
+		}
+	}
+	std::atomic_thread_fence(std::memory_order_acquire);
+	return state == State::kRunning && !m_cancel.load(std::memory_order_relaxed);
+}
+
 void DirectoryScanner::Run() noexcept {
 	while (true) {
 		State state;
@@ -404,7 +585,10 @@ void DirectoryScanner::Run() noexcept {
 
 		std::atomic_thread_fence(std::memory_order_acquire);
 		try {
-			ScanDirectory(m_pContext->path, m_pContext->directories, m_pContext->files, m_pContext->flags, m_pContext->filter);
+			const Trace::Span span("Scan", "scanner", m_pContext->path);
+			ScanDirectory(m_pContext->path, m_pContext->directories, m_pContext->files, m_pContext->flags, m_pContext->filter, m_chunkSize, [this]() {
+				return Pause();
+			});
 		} catch (...) {
 			m_pContext->exceptionPtr = std::current_exception();
 		}
@@ -412,7 +596,10 @@ void DirectoryScanner::Run() noexcept {
 		std::atomic_thread_fence(std::memory_order_release);
 		{
 			m3c::scoped_lock lock(m_mutex);
-			m_state.store(State::kIdle, std::memory_order_release);
+			// do not overwrite a shutdown while the scan was paused
+			if (m_state.load(std::memory_order_acquire) == State::kRunning) {
+				m_state.store(State::kIdle, std::memory_order_release);
+			}
 		}
 
 		m_stateChanged.notify_one();
@@ -24,27 +24,35 @@ limitations under the License.
 #include <m3c/mutex.h>
 
 #include <systools/Path.h>
+#include <systools/Trace.h>
 #include <systools/Volume.h>
 
 #include <windows.h>
 
+#include <algorithm>
 #include <atomic>
 #include <cassert>
+#include <chrono>
 #include <cstddef>
 #include <cstring>
 #include <exception>
 #include <memory>
 #include <new>
 #include <numeric>
+#include <optional>
 #include <type_traits>
 
 namespace systools {
 
 namespace {
 
-constexpr std::uint32_t kTargetBufferSize = 0x10000;
 constexpr std::uint32_t kThreadDone = 0xFFFFFFFF;
 
+/// @brief Add the time since @p start to a counter of wait time.
+void AddWaitTime(std::atomic<std::chrono::nanoseconds::rep>& waitTime, const std::chrono::steady_clock::time_point start) noexcept {
+	waitTime.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count(), std::memory_order_relaxed);
+}
+
 }  // namespace
 
 enum class FileComparer::State : std::uint_fast8_t { kIdle = 1,
@@ -54,15 +62,26 @@ enum class FileComparer::State : std::uint_fast8_t { kIdle = 1,
 
 struct FileComparer::Context {
 	const std::uint_fast32_t bufferSize;
+	const std::uint_fast32_t chunkSize;
 	const Path* path[2];
+	const HANDLE hTarget;
 	std::byte* buffer[2][2];
 	std::atomic_uint_fast32_t size[2][2];
 	std::exception_ptr exceptionPtr[2];
 };
 
-// NOLINTNEXTLINE(cppcoreguidelines-pro-type-member-init): m_pContext is initialized when actually comparing.
 FileComparer::FileComparer()
-	: m_state{State::kIdle, State::kIdle}
+	: FileComparer(kDefaultBufferSize) {
+	// empty
+}
+
+// NOLINTNEXTLINE(cppcoreguidelines-pro-type-member-init): m_pContext is initialized when actually comparing.
+FileComparer::FileComparer(const std::uint32_t bufferSize)
+	: m_bufferSize(bufferSize)
+	, m_state{State::kIdle, State::kIdle}
+	, m_bytesCompared(0)
+	, m_waitTime(0)
+	, m_readerWaitTime{0, 0}
 	, m_thread{std::thread(
 				   [](FileComparer* const pComparer) noexcept {
 					   pComparer->Run(0);
@@ -96,8 +115,67 @@ FileComparer::~FileComparer() noexcept {
 }
 
 bool FileComparer::Compare(const Path& src, const Path& cpy) {
+	return Execute(src, cpy, nullptr, nullptr);
+}
+
+std::optional<std::uint64_t> FileComparer::Update(const Path& src, const Path& cpy) {
+	// open for writing before the reader thread opens the file
+	const m3c::Handle hTarget = CreateFileW(cpy.c_str(), GENERIC_WRITE | FILE_READ_ATTRIBUTES | DELETE, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_NO_BUFFERING | FILE_FLAG_WRITE_THROUGH, nullptr);
+	if (!hTarget) {
+		THROW(m3c::windows_exception(GetLastError()), "CreateFile {}", cpy);
+	}
+
+	FILE_STANDARD_INFO fileStandardInfo;
+	if (!GetFileInformationByHandleEx(hTarget, FileStandardInfo, &fileStandardInfo, sizeof(fileStandardInfo))) {
+		THROW(m3c::windows_exception(GetLastError()), "GetFileInformationByHandleEx {}", cpy);
+	}
+	if (fileStandardInfo.NumberOfLinks != 1) {
+		// other links would see the modified data
+		LOG_DEBUG("{} has {} links, skipping update", cpy, fileStandardInfo.NumberOfLinks);
+		return std::nullopt;
+	}
+
+	std::uint64_t bytesWritten = 0;
+	try {
+		Execute(src, cpy, hTarget, &bytesWritten);
+	} catch (...) {
+		LOG_TRACE("Error updating {} from {}", cpy, src);
+		// a partially updated copy is neither the old nor the new content, remove it when the handle is closed
+		FILE_DISPOSITION_INFO fileDispositionInfo = {.DeleteFile = TRUE};
+		if (!SetFileInformationByHandle(hTarget, FileDispositionInfo, &fileDispositionInfo, sizeof(fileDispositionInfo))) {
+			LOG_ERROR("SetFileInformationByHandle {}: {}", cpy, lg::LastError());
+		}
+		throw;
+	}
+	return bytesWritten;
+}
+
+std::uint64_t FileComparer::GetBytesCompared() const noexcept {
+	return m_bytesCompared;
+}
+
+std::chrono::nanoseconds FileComparer::GetWaitTime() const noexcept {
+	return std::chrono::nanoseconds(m_waitTime.load(std::memory_order_relaxed));
+}
+
+std::chrono::nanoseconds FileComparer::GetReaderWaitTime(const std::uint_fast8_t index) const noexcept {
+	assert(index < 2);
+	return std::chrono::nanoseconds(m_readerWaitTime[index].load(std::memory_order_relaxed));
+}
+
+void FileComparer::ResetWaitTime() noexcept {
+	m_waitTime.store(0, std::memory_order_relaxed);
+	m_readerWaitTime[0].store(0, std::memory_order_relaxed);
+	m_readerWaitTime[1].store(0, std::memory_order_relaxed);
+}
+
+bool FileComparer::Execute(const Path& src, const Path& cpy, const HANDLE hTarget, std::uint64_t* const pBytesWritten) {
 	assert(m_state[0].load(std::memory_order_acquire) == State::kIdle);
 	assert(m_state[1].load(std::memory_order_acquire) == State::kIdle);
+	assert(!hTarget == !pBytesWritten);
+	m_bytesCompared = 0;
+
+	const Trace::Span span(hTarget ? "Update" : "Compare", "comparer", src);
 
 	//
 	// set up the buffer with property alignment
@@ -105,11 +183,12 @@ bool FileComparer::Compare(const Path& src, const Path& cpy) {
 	Volume srcVolume(src);
 	Volume cpyVolume(cpy);
 
-	const std::align_val_t srcAlignment = srcVolume.GetUnbufferedMemoryAlignment();
 	const std::align_val_t cpyAlignment = cpyVolume.GetUnbufferedMemoryAlignment();
+	// when updating, the source buffer is written to the copy
+	const std::align_val_t srcAlignment = hTarget ? std::max(srcVolume.GetUnbufferedMemoryAlignment(), cpyAlignment) : srcVolume.GetUnbufferedMemoryAlignment();
 	const std::uint_fast32_t chunkSize = std::lcm(std::lcm(std::lcm(srcVolume.GetUnbufferedFileOffsetAlignment(), cpyVolume.GetUnbufferedFileOffsetAlignment()), static_cast<std::uint32_t>(srcAlignment)), static_cast<std::uint32_t>(cpyAlignment));
 
-	const std::uint_fast32_t bufferSize = static_cast<std::uint32_t>(kTargetBufferSize / chunkSize) * chunkSize;
+	const std::uint_fast32_t bufferSize = std::max(static_cast<std::uint32_t>(m_bufferSize / chunkSize), 1u) * chunkSize;
 	const std::size_t allocationSize = static_cast<std::size_t>(bufferSize) * 2;
 
 	const auto srcDeleter = [allocationSize, srcAlignment](void* const p) noexcept {
@@ -125,7 +204,9 @@ bool FileComparer::Compare(const Path& src, const Path& cpy) {
 
 	Context context = {
 		bufferSize,
+		chunkSize,
 		{std::addressof(src), std::addressof(cpy)},
+		hTarget,
 		{{&srcBuffer[0], &cpyBuffer[0]},
 		 {&srcBuffer[bufferSize], &cpyBuffer[bufferSize]}}};
 	m_pContext = &context;
@@ -140,25 +221,38 @@ bool FileComparer::Compare(const Path& src, const Path& cpy) {
 
 	bool result;  //NOLINT(cppcoreguidelines-init-variables): result is initialized in try block.
 	try {
-		result = CompareFiles(context);
+		if (hTarget) {
+			UpdateFiles(context, *pBytesWritten);
+			result = true;
+		} else {
+			result = CompareFiles(context);
+		}
 	} catch (...) {
 		LOG_TRACE("Error comparing files {} and {}", cpy, src);
+		// threads might still wait for free buffers if the error happened in the main thread
+		Abort();
 		{
+			const Trace::Span waitSpan("WaitForThreads", "comparer");
+			const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
 			m3c::shared_lock lock(m_mutex);
 			while (m_state[0].load(std::memory_order_acquire) != State::kIdle || m_state[1].load(std::memory_order_acquire) != State::kIdle) {
 				LOG_TRACE("Waiting for threads");
 				m_master.wait(lock);
 			}
+			AddWaitTime(m_waitTime, start);
 		}
 		throw;
 	}
 
 	{
+		const Trace::Span waitSpan("WaitForThreads", "comparer");
+		const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
 		m3c::shared_lock lock(m_mutex);
 		while (m_state[0].load(std::memory_order_acquire) != State::kIdle || m_state[1].load(std::memory_order_acquire) != State::kIdle) {
 			LOG_TRACE("Waiting for threads");
 			m_master.wait(lock);
 		}
+		AddWaitTime(m_waitTime, start);
 	}
 
 	LOG_TRACE("Files {} and {} are {}equal", cpy, src, result ? "" : "not ");
@@ -170,11 +264,13 @@ bool FileComparer::CompareFiles(Context& context) {
 	while (true) {
 		// wait for data being available
 		{
+			const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
 			m3c::shared_lock lock(m_mutex);
 			while ((!context.size[readIndex][0].load(std::memory_order_acquire) || !context.size[readIndex][1].load(std::memory_order_acquire)) && (m_state[0].load(std::memory_order_acquire) == State::kRunning || m_state[1].load(std::memory_order_acquire) == State::kRunning)) {
 				LOG_TRACE("Waiting for data");
 				m_master.wait(lock);
 			}
+			AddWaitTime(m_waitTime, start);
 		}
 		std::atomic_thread_fence(std::memory_order_acquire);
 
@@ -190,16 +286,7 @@ bool FileComparer::CompareFiles(Context& context) {
 		const std::uint_fast32_t size = context.size[readIndex][0].load(std::memory_order_relaxed);
 		if (size != context.size[readIndex][1].load(std::memory_order_relaxed)) {
 			LOG_TRACE("Files differ in size for buffer {}: {} / {}, aborting", readIndex, size, context.size[readIndex][1].load(std::memory_order_relaxed));
-			{
-				m3c::scoped_lock lock(m_mutex);
-				if (m_state[0].load(std::memory_order_acquire) == State::kRunning) {
-					m_state[0].store(State::kAbort, std::memory_order_release);
-				}
-				if (m_state[1].load(std::memory_order_acquire) == State::kRunning) {
-					m_state[1].store(State::kAbort, std::memory_order_release);
-				}
-			}
-			m_clients.notify_all();
+			Abort();
 			return false;
 		}
 
@@ -213,18 +300,10 @@ bool FileComparer::CompareFiles(Context& context) {
 		}
 
 		assert(size <= context.bufferSize);
+		m_bytesCompared += size;
 		if (std::memcmp(context.buffer[readIndex][0], context.buffer[readIndex][1], size) != 0) {
 			LOG_TRACE("Files differ in buffer {}", readIndex);
-			{
-				m3c::scoped_lock lock(m_mutex);
-				if (m_state[0].load(std::memory_order_acquire) == State::kRunning) {
-					m_state[0].store(State::kAbort, std::memory_order_release);
-				}
-				if (m_state[1].load(std::memory_order_acquire) == State::kRunning) {
-					m_state[1].store(State::kAbort, std::memory_order_release);
-				}
-			}
-			m_clients.notify_all();
+			Abort();
 			return false;
 		}
 
@@ -240,6 +319,92 @@ bool FileComparer::CompareFiles(Context& context) {
 	}
 }
 
+void FileComparer::UpdateFiles(Context& context, std::uint64_t& bytesWritten) {
+	std::uint_fast8_t readIndex = 0;
+	std::uint64_t offset = 0;
+	bool cpyEof = false;
+	while (true) {
+		// wait for data being available, the copy might end before the source
+		{
+			const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			m3c::shared_lock lock(m_mutex);
+			while ((!context.size[readIndex][0].load(std::memory_order_acquire) || (!cpyEof && !context.size[readIndex][1].load(std::memory_order_acquire))) && (m_state[0].load(std::memory_order_acquire) == State::kRunning || m_state[1].load(std::memory_order_acquire) == State::kRunning)) {
+				LOG_TRACE("Waiting for data");
+				m_master.wait(lock);
+			}
+			AddWaitTime(m_waitTime, start);
+		}
+		std::atomic_thread_fence(std::memory_order_acquire);
+
+		// check for errors
+		if (context.exceptionPtr[0] || context.exceptionPtr[1]) {
+			const std::uint_fast8_t errorIndex = context.exceptionPtr[0] ? 0 : 1;
+			LOG_TRACE("Error in thread {}", errorIndex);
+			assert(context.exceptionPtr[errorIndex]);
+			std::rethrow_exception(context.exceptionPtr[errorIndex]);
+			__assume(false);
+		}
+
+		const std::uint_fast32_t size = context.size[readIndex][0].load(std::memory_order_relaxed);
+		const std::uint_fast32_t cpySize = cpyEof ? kThreadDone : context.size[readIndex][1].load(std::memory_order_relaxed);
+		cpyEof = cpySize == kThreadDone;
+
+		// done
+		if (size == kThreadDone) {
+			LOG_TRACE("Received EOF in buffer {}, setting size to {}", readIndex, offset);
+			Abort();
+
+			FILE_END_OF_FILE_INFO fileEndOfFileInfo = {.EndOfFile = {.QuadPart = static_cast<std::int64_t>(offset)}};
+			if (!SetFileInformationByHandle(context.hTarget, FileEndOfFileInfo, &fileEndOfFileInfo, sizeof(fileEndOfFileInfo))) {
+				THROW(m3c::windows_exception(GetLastError()), "SetFileInformationByHandle {}", *context.path[1]);
+			}
+			return;
+		}
+
+		assert(size && size <= context.bufferSize);
+		if (size != cpySize || std::memcmp(context.buffer[readIndex][0], context.buffer[readIndex][1], size) != 0) {
+			// unbuffered writes must be a multiple of the sector size, a partial last block is truncated afterwards
+			const DWORD writeSize = static_cast<DWORD>((size + context.chunkSize - 1) / context.chunkSize * context.chunkSize);
+			assert(writeSize <= context.bufferSize);
+
+			LOG_TRACE("Writing buffer {} at offset {}", readIndex, offset);
+			OVERLAPPED overlapped{};
+			overlapped.Offset = static_cast<DWORD>(offset);
+			overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+			DWORD written;  // NOLINT(cppcoreguidelines-init-variables): Initialized as out parameter.
+			if (!WriteFile(context.hTarget, context.buffer[readIndex][0], writeSize, &written, &overlapped)) {
+				THROW(m3c::windows_exception(GetLastError()), "WriteFile {}", *context.path[1]);
+			}
+			bytesWritten += size;
+		} else {
+			LOG_TRACE("Data in buffer {} is equal", readIndex);
+		}
+		offset += size;
+
+		{
+			m3c::scoped_lock lock(m_mutex);
+			context.size[readIndex][0].store(0, std::memory_order_release);
+			context.size[readIndex][1].store(0, std::memory_order_release);
+		}
+		m_clients.notify_all();
+
+		readIndex ^= 1;
+	}
+}
+
+void FileComparer::Abort() {
+	{
+		m3c::scoped_lock lock(m_mutex);
+		if (m_state[0].load(std::memory_order_acquire) == State::kRunning) {
+			m_state[0].store(State::kAbort, std::memory_order_release);
+		}
+		if (m_state[1].load(std::memory_order_acquire) == State::kRunning) {
+			m_state[1].store(State::kAbort, std::memory_order_release);
+		}
+	}
+	m_clients.notify_all();
+}
+
 void FileComparer::Run(const std::uint_fast8_t index) noexcept {
 	LOG_TRACE("Thread {} started", index);
 	while (true) {
@@ -276,18 +441,24 @@ void FileComparer::Run(const std::uint_fast8_t index) noexcept {
 void FileComparer::ReadFileContent(const std::uint_fast8_t index) noexcept {
 	std::uint_fast8_t writeIndex = 0;
 	try {
-		const m3c::Handle hFile = CreateFileW(m_pContext->path[index]->c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_NO_BUFFERING, nullptr);
+		// a single span for the whole file, waits are reported by GetReaderWaitTime
+		const Trace::Span span("Read", "comparer", *m_pContext->path[index]);
+		// the copy is written and deleted on errors by the main thread when updating
+		const DWORD shareMode = index && m_pContext->hTarget ? FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE : FILE_SHARE_READ;
+		const m3c::Handle hFile = CreateFileW(m_pContext->path[index]->c_str(), GENERIC_READ, shareMode, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_NO_BUFFERING, nullptr);
 		if (!hFile) {
 			THROW(m3c::windows_exception(GetLastError()), "CreateFile {}", m_pContext->path[index]);
 		}
 
 		while (true) {
 			{
+				const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
 				m3c::shared_lock lock(m_mutex);
 				while (m_pContext->size[writeIndex][index].load(std::memory_order_acquire) && m_state[index].load(std::memory_order_acquire) == State::kRunning) {
 					LOG_TRACE("Thread {} waiting for free buffer {}", index, writeIndex);
 					m_clients.wait(lock);
 				}
+				AddWaitTime(m_readerWaitTime[index], start);
 			}
 			if (m_state[index].load(std::memory_order_relaxed) != State::kRunning) {
 				LOG_TRACE("Thread {} received stop signal", index);
@@ -0,0 +1,240 @@
+/*
+Copyright 2020 Michael Beckh
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+/// @file
+
+#include "systools/FileCopier.h"
+
+#include "systools/Digest.h"
+#include "systools/Path.h"
+#include "systools/Volume.h"
+
+#include <llamalog/llamalog.h>
+#include <m3c/Handle.h>
+#include <m3c/exception.h>
+
+#include <windows.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <numeric>
+#include <optional>
+#include <utility>
+
+namespace systools {
+
+namespace {
+
+/// @brief A buffer and the state of the I/O request using it.
+struct IoRequest {
+	OVERLAPPED overlapped;
+	m3c::Handle hEvent;
+	std::byte* buffer;
+	/// @brief The handle of the pending request or `nullptr` if no request is pending.
+	HANDLE hFile;
+};
+
+void StartRead(IoRequest& request, const HANDLE hFile, const std::uint64_t offset, const DWORD size, const Path& path) {
+	assert(!request.hFile);
+	request.overlapped = {};
+	request.overlapped.Offset = static_cast<DWORD>(offset);
+	request.overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+	request.overlapped.hEvent = request.hEvent;
+	if (!ReadFile(hFile, request.buffer, size, nullptr, &request.overlapped)) {
+		if (const DWORD lastError = GetLastError(); lastError != ERROR_IO_PENDING) {
+			THROW(m3c::windows_exception(lastError), "ReadFile {}", path);
+		}
+	}
+	request.hFile = hFile;
+}
+
+void StartWrite(IoRequest& request, const HANDLE hFile, const std::uint64_t offset, const DWORD size, const Path& path) {
+	assert(!request.hFile);
+	request.overlapped = {};
+	request.overlapped.Offset = static_cast<DWORD>(offset);
+	request.overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+	request.overlapped.hEvent = request.hEvent;
+	if (!WriteFile(hFile, request.buffer, size, nullptr, &request.overlapped)) {
+		if (const DWORD lastError = GetLastError(); lastError != ERROR_IO_PENDING) {
+			THROW(m3c::windows_exception(lastError), "WriteFile {}", path);
+		}
+	}
+	request.hFile = hFile;
+}
+
+DWORD WaitForRequest(IoRequest& request, const Path& path) {
+	assert(request.hFile);
+	DWORD bytesTransferred;  // NOLINT(cppcoreguidelines-init-variables): Initialized as out parameter.
+	if (!GetOverlappedResult(std::exchange(request.hFile, nullptr), &request.overlapped, &bytesTransferred, TRUE)) {
+		if (const DWORD lastError = GetLastError(); lastError != ERROR_HANDLE_EOF) {
+			THROW(m3c::windows_exception(lastError), "GetOverlappedResult {}", path);
+		}
+		return 0;
+	}
+	return bytesTransferred;
+}
+
+/// @brief Cancel all pending requests and wait until the buffers are no longer used.
+void CancelRequests(IoRequest* const requests, const std::uint_fast8_t count) noexcept {
+	for (std::uint_fast8_t i = 0; i < count; ++i) {
+		IoRequest& request = requests[i];
+		if (!request.hFile) {
+			continue;
+		}
+		if (!CancelIoEx(request.hFile, &request.overlapped) && GetLastError() != ERROR_NOT_FOUND) {
+			LOG_ERROR("CancelIoEx: {}", lg::LastError());
+		}
+		DWORD bytesTransferred;  // NOLINT(cppcoreguidelines-init-variables): Initialized as out parameter.
+		GetOverlappedResult(std::exchange(request.hFile, nullptr), &request.overlapped, &bytesTransferred, TRUE);
+	}
+}
+
+}  // namespace
+
+FileCopier::FileCopier(const std::uint32_t bufferSize, const std::uint8_t queueDepth) noexcept
+	: m_bufferSize(bufferSize)
+	, m_queueDepth(queueDepth) {
+	assert(queueDepth >= 2);
+}
+
+std::uint64_t FileCopier::Copy(const Path& src, const Path& cpy, Digest* const pDigest) {
+	Volume srcVolume(src);
+	Volume cpyVolume(cpy);
+
+	// the same buffer is used for reading and writing
+	const std::align_val_t alignment = std::max(srcVolume.GetUnbufferedMemoryAlignment(), cpyVolume.GetUnbufferedMemoryAlignment());
+	const std::uint32_t chunkSize = std::lcm(std::lcm(srcVolume.GetUnbufferedFileOffsetAlignment(), cpyVolume.GetUnbufferedFileOffsetAlignment()), static_cast<std::uint32_t>(alignment));
+
+	const m3c::Handle hSource = CreateFileW(src.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_NO_BUFFERING | FILE_FLAG_OVERLAPPED | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (!hSource) {
+		THROW(m3c::windows_exception(GetLastError()), "CreateFile {}", src);
+	}
+
+	FILE_STANDARD_INFO fileStandardInfo;
+	if (!GetFileInformationByHandleEx(hSource, FileStandardInfo, &fileStandardInfo, sizeof(fileStandardInfo))) {
+		THROW(m3c::windows_exception(GetLastError()), "GetFileInformationByHandleEx {}", src);
+	}
+	const std::uint64_t size = static_cast<std::uint64_t>(fileStandardInfo.EndOfFile.QuadPart);
+
+	const m3c::Handle hTarget = CreateFileW(cpy.c_str(), GENERIC_WRITE | DELETE, 0, nullptr, CREATE_NEW, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_NO_BUFFERING | FILE_FLAG_OVERLAPPED, nullptr);
+	if (!hTarget) {
+		THROW(m3c::windows_exception(GetLastError()), "CreateFile {}", cpy);
+	}
+
+	std::optional<DigestBuilder> digestBuilder;
+	if (pDigest) {
+		digestBuilder.emplace();
+	}
+
+	try {
+		// reserve the space in one go to prevent fragmentation
+		FILE_ALLOCATION_INFO fileAllocationInfo = {.AllocationSize = fileStandardInfo.EndOfFile};
+		if (!SetFileInformationByHandle(hTarget, FileAllocationInfo, &fileAllocationInfo, sizeof(fileAllocationInfo))) {
+			THROW(m3c::windows_exception(GetLastError()), "SetFileInformationByHandle {}", cpy);
+		}
+
+		// small files do not need the full buffer
+		const std::uint64_t alignedSize = (size + chunkSize - 1) / chunkSize * chunkSize;
+		const std::uint32_t bufferSize = static_cast<std::uint32_t>(std::min<std::uint64_t>(std::max(m_bufferSize / chunkSize, 1u) * chunkSize, alignedSize));
+		const std::uint_fast8_t requestCount = bufferSize ? static_cast<std::uint_fast8_t>(std::min<std::uint64_t>(m_queueDepth, (alignedSize + bufferSize - 1) / bufferSize)) : 0;
+
+		LOG_TRACE("Copying {} to {} with {} buffers of size {}, file offset alignment {} and memory alignment {}", src, cpy, requestCount, bufferSize, chunkSize, alignment);
+
+		const std::size_t allocationSize = static_cast<std::size_t>(bufferSize) * requestCount;
+		const auto deleter = [allocationSize, alignment](void* const p) noexcept {
+			operator delete[](p, allocationSize, alignment);
+		};
+		const std::unique_ptr<std::byte[], decltype(deleter)> buffer(requestCount ? static_cast<std::byte*>(operator new[](allocationSize, alignment)) : nullptr, deleter);
+
+		// requests must not move while pending
+		const std::unique_ptr<IoRequest[]> requests = std::make_unique<IoRequest[]>(requestCount);
+		for (std::uint_fast8_t i = 0; i < requestCount; ++i) {
+			requests[i].hEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+			if (!requests[i].hEvent) {
+				THROW(m3c::windows_exception(GetLastError()), "CreateEvent");
+			}
+			requests[i].buffer = &buffer[static_cast<std::size_t>(bufferSize) * i];
+		}
+
+		try {
+			std::uint64_t readOffset = 0;
+			const auto startNextRead = [&readOffset, size, bufferSize, &hSource, &src](IoRequest& request) {
+				if (readOffset < size) {
+					StartRead(request, hSource, readOffset, bufferSize, src);
+					readOffset += bufferSize;
+				}
+			};
+
+			for (std::uint_fast8_t i = 0; i < requestCount; ++i) {
+				startNextRead(requests[i]);
+			}
+
+			// data is written in the order it is read, a buffer is refilled when its write has completed
+			IoRequest* pPrevious = nullptr;
+			std::uint_fast8_t index = 0;
+			for (std::uint64_t offset = 0; offset < size; index = (index + 1) % requestCount) {
+				IoRequest& request = requests[index];
+				const DWORD bytesRead = WaitForRequest(request, src);
+				if (bytesRead != std::min<std::uint64_t>(bufferSize, size - offset)) {
+					THROW(std::exception(), "{} changed while copying", src);
+				}
+				if (digestBuilder) {
+					digestBuilder->Update(request.buffer, bytesRead);
+				}
+
+				// unbuffered writes must be a multiple of the sector size, a partial last block is truncated afterwards
+				StartWrite(request, hTarget, offset, (bytesRead + chunkSize - 1) / chunkSize * chunkSize, cpy);
+				offset += bytesRead;
+
+				if (pPrevious) {
+					WaitForRequest(*pPrevious, cpy);
+					startNextRead(*pPrevious);
+				}
+				pPrevious = &request;
+			}
+			if (pPrevious) {
+				WaitForRequest(*pPrevious, cpy);
+			}
+		} catch (...) {
+			CancelRequests(requests.get(), requestCount);
+			throw;
+		}
+
+		FILE_END_OF_FILE_INFO fileEndOfFileInfo = {.EndOfFile = fileStandardInfo.EndOfFile};
+		if (!SetFileInformationByHandle(hTarget, FileEndOfFileInfo, &fileEndOfFileInfo, sizeof(fileEndOfFileInfo))) {
+			THROW(m3c::windows_exception(GetLastError()), "SetFileInformationByHandle {}", cpy);
+		}
+	} catch (...) {
+		LOG_TRACE("Error copying {} to {}", src, cpy);
+		// remove the incomplete copy when the handle is closed
+		FILE_DISPOSITION_INFO fileDispositionInfo = {.DeleteFile = TRUE};
+		if (!SetFileInformationByHandle(hTarget, FileDispositionInfo, &fileDispositionInfo, sizeof(fileDispositionInfo))) {
+			LOG_ERROR("SetFileInformationByHandle {}: {}", cpy, lg::LastError());
+		}
+		throw;
+	}
+
+	if (pDigest) {
+		*pDigest = digestBuilder->Finish();
+	}
+	return size;
+}
+
+}  // namespace systools
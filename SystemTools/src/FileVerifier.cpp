@@ -0,0 +1,141 @@
+/*
+Copyright 2020 Michael Beckh
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+/// @file
+
+#include "systools/FileVerifier.h"
+
+#include "systools/Digest.h"
+#include "systools/Path.h"
+
+#include <llamalog/llamalog.h>
+#include <m3c/mutex.h>
+
+#include <windows.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <optional>
+#include <thread>
+#include <utility>
+
+namespace systools {
+
+FileVerifier::FileVerifier(const std::uint64_t maxBytesPerSecond)
+	: m_maxBytesPerSecond(maxBytesPerSecond)
+	, m_thread([](FileVerifier* const pVerifier) noexcept {
+		pVerifier->Run();
+	},
+			   this) {
+}
+
+FileVerifier::~FileVerifier() noexcept {
+	{
+		LOG_TRACE("Sending shutdown");
+		m3c::scoped_lock lock(m_mutex);
+		m_shutdown = true;
+	}
+	m_worker.notify_one();
+
+	try {
+		m_thread.join();
+	} catch (const std::exception& e) {
+		LOG_ERROR("thread.join: {}", e);
+	}
+}
+
+void FileVerifier::Verify(const Path& path, const Digest& digest) {
+	{
+		m3c::scoped_lock lock(m_mutex);
+		m_queue.emplace_back(path, digest);
+	}
+	m_worker.notify_one();
+}
+
+std::vector<Path> FileVerifier::Wait() {
+	{
+		m3c::shared_lock lock(m_mutex);
+		while (!m_queue.empty() || m_busy) {
+			LOG_TRACE("Waiting for verification");
+			m_master.wait(lock);
+		}
+	}
+	// only the caller adds to the queue, i.e. it is still empty
+	m3c::scoped_lock lock(m_mutex);
+	return std::exchange(m_failed, {});
+}
+
+std::size_t FileVerifier::GetPending() const {
+	m3c::shared_lock lock(m_mutex);
+	return m_queue.size() + (m_busy ? 1 : 0);
+}
+
+void FileVerifier::Run() noexcept {
+	// lowers both CPU and I/O priority
+	if (!SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_BEGIN)) {
+		LOG_WARN("SetThreadPriority: {}", lg::LastError());
+	}
+
+	while (true) {
+		std::optional<std::pair<Path, Digest>> entry;
+		{
+			m3c::shared_lock lock(m_mutex);
+			while (m_queue.empty() && !m_shutdown) {
+				m_worker.wait(lock);
+			}
+		}
+		{
+			// the queue is modified under an exclusive lock only
+			m3c::scoped_lock lock(m_mutex);
+			if (m_shutdown) {
+				break;
+			}
+			if (m_queue.empty()) {
+				continue;
+			}
+			entry.emplace(std::move(m_queue.front()));
+			m_queue.pop_front();
+			m_busy = true;
+		}
+
+		bool result;  // NOLINT(cppcoreguidelines-init-variables): result is initialized in try block.
+		try {
+			result = VerifyFile(entry->first, entry->second);
+			if (!result) {
+				LOG_ERROR("Verification failed for {}", entry->first);
+			}
+		} catch (const std::exception& e) {
+			LOG_ERROR("Error verifying {}: {}", entry->first, e);
+			result = false;
+		}
+
+		{
+			m3c::scoped_lock lock(m_mutex);
+			if (!result) {
+				m_failed.push_back(std::move(entry->first));
+			}
+			m_busy = false;
+		}
+		m_master.notify_all();
+	}
+}
+
+bool FileVerifier::VerifyFile(const Path& path, const Digest& digest) {
+	return CalculateDigest(path, m_maxBytesPerSecond) == digest;
+}
+
+}  // namespace systools
@@ -0,0 +1,204 @@
+/*
+Copyright 2020 Michael Beckh
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+/// @file
+
+#include "systools/InstrumentedBackupStrategy.h"
+
+#include "systools/BackupStrategy.h"
+#include "systools/Digest.h"
+#include "systools/DirectoryScanner.h"
+#include "systools/LatencyHistogram.h"
+#include "systools/Path.h"  // IWYU pragma: keep
+
+#include <llamalog/llamalog.h>
+#include <m3c/finally.h>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#ifdef __clang_analyzer__
+// Avoid collisions with Windows API defines
+#undef CreateDirectory
+#undef CreateHardLink
+#endif
+
+namespace systools {
+
+InstrumentedBackupStrategy::InstrumentedBackupStrategy(const BackupStrategy& strategy) noexcept
+	: m_strategy(strategy) {
+	// empty
+}
+
+template <typename Function>
+auto InstrumentedBackupStrategy::Measure(const Operation operation, Function function) const {
+	const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	const auto record = m3c::finally([this, operation, start]() noexcept {
+		m_histograms[static_cast<std::size_t>(operation)].Record(std::chrono::steady_clock::now() - start);
+	});
+	return function();
+}
+
+bool InstrumentedBackupStrategy::Exists(const Path& path) const {
+	return Measure(Operation::kExists, [this, &path]() {
+		return m_strategy.Exists(path);
+	});
+}
+
+bool InstrumentedBackupStrategy::IsDirectory(const Path& path) const {
+	return Measure(Operation::kIsDirectory, [this, &path]() {
+		return m_strategy.IsDirectory(path);
+	});
+}
+
+bool InstrumentedBackupStrategy::Compare(const Path& src, const Path& target, FileComparer& fileComparer) const {
+	return Measure(Operation::kCompare, [this, &src, &target, &fileComparer]() {
+		return m_strategy.Compare(src, target, fileComparer);
+	});
+}
+
+void InstrumentedBackupStrategy::CreateDirectory(const Path& path, const Path& templatePath, const ScannedFile& securitySource) const {
+	Measure(Operation::kCreateDirectory, [this, &path, &templatePath, &securitySource]() {
+		m_strategy.CreateDirectory(path, templatePath, securitySource);
+	});
+}
+
+void InstrumentedBackupStrategy::CreateDirectoryRecursive(const Path& path) const {
+	Measure(Operation::kCreateDirectoryRecursive, [this, &path]() {
+		m_strategy.CreateDirectoryRecursive(path);
+	});
+}
+
+void InstrumentedBackupStrategy::SetAttributes(const Path& path, const ScannedFile& attributesSource) const {
+	Measure(Operation::kSetAttributes, [this, &path, &attributesSource]() {
+		m_strategy.SetAttributes(path, attributesSource);
+	});
+}
+
+void InstrumentedBackupStrategy::SetSecurity(const Path& path, const ScannedFile& securitySource) const {
+	Measure(Operation::kSetSecurity, [this, &path, &securitySource]() {
+		m_strategy.SetSecurity(path, securitySource);
+	});
+}
+
+void InstrumentedBackupStrategy::Rename(const Path& existingName, const Path& newName) const {
+	Measure(Operation::kRename, [this, &existingName, &newName]() {
+		m_strategy.Rename(existingName, newName);
+	});
+}
+
+std::optional<Digest> InstrumentedBackupStrategy::Copy(const Path& source, const Path& target, const ScannedFile& sourceFile, const bool calculateDigest) const {
+	return Measure(Operation::kCopy, [this, &source, &target, &sourceFile, calculateDigest]() {
+		return m_strategy.Copy(source, target, sourceFile, calculateDigest);
+	});
+}
+
+bool InstrumentedBackupStrategy::Clone(const Path& source, const Path& target, const ScannedFile& sourceFile) const {
+	return Measure(Operation::kClone, [this, &source, &target, &sourceFile]() {
+		return m_strategy.Clone(source, target, sourceFile);
+	});
+}
+
+std::optional<std::uint64_t> InstrumentedBackupStrategy::Update(const Path& source, const Path& target, FileComparer& fileComparer) const {
+	return Measure(Operation::kUpdate, [this, &source, &target, &fileComparer]() {
+		return m_strategy.Update(source, target, fileComparer);
+	});
+}
+
+void InstrumentedBackupStrategy::CreateHardLink(const Path& path, const Path& existing) const {
+	Measure(Operation::kCreateHardLink, [this, &path, &existing]() {
+		m_strategy.CreateHardLink(path, existing);
+	});
+}
+
+void InstrumentedBackupStrategy::Delete(const Path& path) const {
+	Measure(Operation::kDelete, [this, &path]() {
+		m_strategy.Delete(path);
+	});
+}
+
+void InstrumentedBackupStrategy::Scan(const Path& path, DirectoryScanner& scanner, std::vector<ScannedFile>& directories, std::vector<ScannedFile>& files, const DirectoryScanner::Flags flags, const ScannerFilter& filter) const {
+	Measure(Operation::kScan, [this, &path, &scanner, &directories, &files, flags, &filter]() {
+		m_strategy.Scan(path, scanner, directories, files, flags, filter);
+	});
+}
+
+void InstrumentedBackupStrategy::WaitForScan(DirectoryScanner& scanner) const {
+	Measure(Operation::kWaitForScan, [this, &scanner]() {
+		m_strategy.WaitForScan(scanner);
+	});
+}
+
+const char* InstrumentedBackupStrategy::GetName(const Operation operation) noexcept {
+	switch (operation) {
+	case Operation::kExists:
+		return "Exists";
+	case Operation::kIsDirectory:
+		return "IsDirectory";
+	case Operation::kCompare:
+		return "Compare";
+	case Operation::kCreateDirectory:
+		return "CreateDirectory";
+	case Operation::kCreateDirectoryRecursive:
+		return "CreateDirectoryRecursive";
+	case Operation::kSetAttributes:
+		return "SetAttributes";
+	case Operation::kSetSecurity:
+		return "SetSecurity";
+	case Operation::kRename:
+		return "Rename";
+	case Operation::kCopy:
+		return "Copy";
+	case Operation::kClone:
+		return "Clone";
+	case Operation::kUpdate:
+		return "Update";
+	case Operation::kCreateHardLink:
+		return "CreateHardLink";
+	case Operation::kDelete:
+		return "Delete";
+	case Operation::kScan:
+		return "Scan";
+	case Operation::kWaitForScan:
+		return "WaitForScan";
+	case Operation::kCount:
+		break;
+	}
+	return "";
+}
+
+void InstrumentedBackupStrategy::LogStatistics() const {
+	using std::chrono::duration_cast;
+	using std::chrono::microseconds;
+	using std::chrono::milliseconds;
+
+	for (std::size_t i = 0; i < m_histograms.size(); ++i) {
+		const LatencyHistogram& histogram = m_histograms[i];
+		if (!histogram.GetCount()) {
+			continue;
+		}
+		LOG_INFO("{}: count={} total={}ms p50={}us p90={}us p99={}us p99.9={}us max={}us", GetName(static_cast<Operation>(i)), histogram.GetCount(),
+				 duration_cast<milliseconds>(histogram.GetTotal()).count(),
+				 duration_cast<microseconds>(histogram.GetPercentile(50)).count(), duration_cast<microseconds>(histogram.GetPercentile(90)).count(),
+				 duration_cast<microseconds>(histogram.GetPercentile(99)).count(), duration_cast<microseconds>(histogram.GetPercentile(99.9)).count(),
+				 duration_cast<microseconds>(histogram.GetMax()).count());
+	}
+}
+
+}  // namespace systools
@@ -0,0 +1,83 @@
+/*
+Copyright 2020 Michael Beckh
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+/// @file
+
+#include "systools/LatencyHistogram.h"
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+namespace systools {
+
+void LatencyHistogram::Record(const std::chrono::nanoseconds duration) noexcept {
+	const std::uint64_t value = duration.count() > 0 ? static_cast<std::uint64_t>(duration.count()) : 0;
+	m_buckets[GetIndex(value)].fetch_add(1, std::memory_order_relaxed);
+	m_count.fetch_add(1, std::memory_order_relaxed);
+	m_total.fetch_add(value, std::memory_order_relaxed);
+
+	std::uint64_t max = m_max.load(std::memory_order_relaxed);
+	while (value > max && !m_max.compare_exchange_weak(max, value, std::memory_order_relaxed)) {
+		// retry with updated value of max
+	}
+}
+
+std::chrono::nanoseconds LatencyHistogram::GetPercentile(const double percentile) const noexcept {
+	const std::uint64_t count = GetCount();
+	if (!count) {
+		return std::chrono::nanoseconds(0);
+	}
+	const std::uint64_t max = m_max.load(std::memory_order_relaxed);
+	const std::uint64_t rank = std::max<std::uint64_t>(static_cast<std::uint64_t>(std::ceil(static_cast<double>(count) * percentile / 100)), 1);
+
+	std::uint64_t sum = 0;
+	for (std::size_t i = 0; i < kBuckets; ++i) {
+		sum += m_buckets[i].load(std::memory_order_relaxed);
+		if (sum >= rank) {
+			return std::chrono::nanoseconds(std::min(GetUpperBound(i), max));
+		}
+	}
+	// buckets might be updated concurrently
+	return std::chrono::nanoseconds(max);
+}
+
+std::size_t LatencyHistogram::GetIndex(const std::uint64_t value) noexcept {
+	if (value < kSubBuckets) {
+		return static_cast<std::size_t>(value);
+	}
+	// each group holds the values with the same highest bit, divided into kSubBuckets buckets
+	const std::uint_fast8_t shift = static_cast<std::uint_fast8_t>(std::bit_width(value) - 1 - kSubBucketBits);
+	return static_cast<std::size_t>((shift + 1) * kSubBuckets + ((value >> shift) - kSubBuckets));
+}
+
+std::uint64_t LatencyHistogram::GetUpperBound(const std::size_t index) noexcept {
+	if (index < kSubBuckets) {
+		return index;
+	}
+	const std::uint_fast8_t shift = static_cast<std::uint_fast8_t>(index / kSubBuckets - 1);
+	const std::uint64_t next = kSubBuckets + index % kSubBuckets + 1;
+	if (shift + std::bit_width(next) > 64) {
+		return std::numeric_limits<std::uint64_t>::max();
+	}
+	return (next << shift) - 1;
+}
+
+}  // namespace systools
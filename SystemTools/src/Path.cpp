@@ -31,13 +31,27 @@ limitations under the License.
 #include <strsafe.h>
 #include <windows.h>
 
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include <algorithm>
 #include <cassert>
+#include <compare>
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
 #include <cwchar>
-#include <exception>
 #include <memory>
+#include <optional>
 #include <string>
+#include <string_view>
+#include <utility>
+#include <variant>
+#include <vector>
+
+/// @brief Declaration from `ntifs.h`. Used by `CompareStringOrdinal` for mapping characters to upper case.
+extern "C" NTSYSAPI WCHAR NTAPI RtlUpcaseUnicodeChar(WCHAR SourceCharacter);  // NOLINT(readability-identifier-naming): Windows API.
 
 namespace systools {
 
@@ -46,7 +60,62 @@ namespace {
 /// @brief The length of the prefix for long paths (not including the trailing 0 character).
 constexpr std::size_t kPrefixLen = (sizeof(LR"(\\?\)") - 1) / sizeof(wchar_t);
 
-std::weak_ordering CompareFilenames(const wchar_t* file0, std::size_t size0, const wchar_t* file1, std::size_t size1) {
+/// @brief Map the ASCII characters `a` to `z` to upper case as `CompareStringOrdinal` does when ignoring case.
+[[nodiscard]] constexpr wchar_t FoldAscii(const wchar_t ch) noexcept {
+	return ch >= L'a' && ch <= L'z' ? static_cast<wchar_t>(ch - (L'a' - L'A')) : ch;
+}
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+/// @brief Map the ASCII characters `a` to `z` in 8 UTF-16 code units to upper case.
+[[nodiscard]] inline __m128i FoldAscii(const __m128i chars) noexcept {
+	const __m128i isLower = _mm_and_si128(_mm_cmpgt_epi16(chars, _mm_set1_epi16(L'a' - 1)), _mm_cmplt_epi16(chars, _mm_set1_epi16(L'z' + 1)));
+	return _mm_sub_epi16(chars, _mm_and_si128(isLower, _mm_set1_epi16(L'a' - L'A')));
+}
+#endif
+
+/// @brief Compare two strings ignoring case if both contain only ASCII characters.
+/// @details The result has the same ordering as `CompareStringOrdinal`.
+/// @return The result or `std::nullopt` if a non-ASCII character is found before the strings differ.
+[[nodiscard]] std::optional<std::weak_ordering> CompareAscii(const wchar_t* const file0, const std::size_t size0, const wchar_t* const file1, const std::size_t size1) noexcept {
+	const std::size_t size = std::min(size0, size1);
+	std::size_t i = 0;
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+	const __m128i nonAsciiMask = _mm_set1_epi16(static_cast<short>(0xFF80u));
+	for (; i + 8 <= size; i += 8) {
+		const __m128i chars0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(file0 + i));  // NOLINT(cppcoreguidelines-pro-type-reinterpret-cast): Unaligned load of 8 code units.
+		const __m128i chars1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(file1 + i));  // NOLINT(cppcoreguidelines-pro-type-reinterpret-cast): Unaligned load of 8 code units.
+		if (_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(_mm_or_si128(chars0, chars1), nonAsciiMask), _mm_setzero_si128())) != 0xFFFF) {
+			// let the scalar loop find out if the strings differ before the first non-ASCII character
+			break;
+		}
+		const int equal = _mm_movemask_epi8(_mm_cmpeq_epi16(FoldAscii(chars0), FoldAscii(chars1)));
+		if (equal != 0xFFFF) {
+			unsigned long index;  // NOLINT(cppcoreguidelines-init-variables): Initialized as out parameter.
+			_BitScanForward(&index, static_cast<unsigned long>(~equal & 0xFFFF));
+			i += index / sizeof(wchar_t);
+			return FoldAscii(file0[i]) <=> FoldAscii(file1[i]);
+		}
+	}
+#endif
+	for (; i < size; ++i) {
+		if ((file0[i] | file1[i]) >= 0x80) {
+			return std::nullopt;
+		}
+		if (const wchar_t ch0 = FoldAscii(file0[i]), ch1 = FoldAscii(file1[i]); ch0 != ch1) {
+			return ch0 <=> ch1;
+		}
+	}
+	return size0 <=> size1;
+}
+
+/// @brief Compare two strings ignoring case using the same ordering as `CompareStringOrdinal`.
+/// @details Case folding of ASCII characters is done inline. `CompareStringOrdinal` is only called for strings
+/// containing other characters.
+std::weak_ordering CompareFilenames(const wchar_t* const file0, const std::size_t size0, const wchar_t* const file1, const std::size_t size1) {
+	if (const std::optional<std::weak_ordering> result = CompareAscii(file0, size0, file1, size1); result) {
+		return *result;
+	}
+
 	const int cmp = CompareStringOrdinal(file0, static_cast<int>(size0), file1, static_cast<int>(size1), TRUE);
 	if (cmp == CSTR_LESS_THAN) {
 		return std::weak_ordering::less;
@@ -62,78 +131,81 @@ std::weak_ordering CompareFilenames(const wchar_t* file0, std::size_t size0, con
 
 template <std::uint16_t kSize0, std::uint16_t kSize1>
 std::weak_ordering CompareFilenames(const m3c::lazy_wstring<kSize0>& file0, const m3c::lazy_wstring<kSize1>& file1) {
-	const int cmp = CompareStringOrdinal(file0.c_str(), static_cast<int>(file0.size()), file1.c_str(), static_cast<int>(file1.size()), TRUE);
-	if (cmp == CSTR_LESS_THAN) {
-		return std::weak_ordering::less;
-	}
-	if (cmp == CSTR_EQUAL) {
-		return std::weak_ordering::equivalent;
-	}
-	if (cmp == CSTR_GREATER_THAN) {
-		return std::weak_ordering::greater;
-	}
-	THROW(m3c::windows_exception(GetLastError()), "CompareStringOrdinal {} / {}", file0, file1);
+	return CompareFilenames(file0.c_str(), file0.size(), file1.c_str(), file1.size());
 }
 
-[[nodiscard]] std::size_t GetCaseInsensitiveHash(const wchar_t* str, std::size_t length) noexcept {
-	if (!length) {
-		return 0;
-	}
+/// @brief Map a character to upper case in the same way as `CompareStringOrdinal` when ignoring case.
+[[nodiscard]] inline wchar_t FoldCharacter(const wchar_t ch) noexcept {
+	return ch < 0x80 ? FoldAscii(ch) : RtlUpcaseUnicodeChar(ch);
+}
 
-	const int size = static_cast<int>(length);
-	if (size <= MAX_PATH) {
-		wchar_t buffer[MAX_PATH];
-		if (const int len = LCMapStringW(LOCALE_SYSTEM_DEFAULT, LCMAP_LOWERCASE, str, size, buffer, MAX_PATH); len) {
-			int h;  // NOLINT(cppcoreguidelines-init-variables): Initialized as out parameter.
-			if (LCMapStringW(LOCALE_SYSTEM_DEFAULT, LCMAP_HASH, buffer, len, reinterpret_cast<wchar_t*>(&h), static_cast<int>(sizeof(h)))) {
-				return h;
-			}
+/// @brief Combine a hash value with the next 4 characters.
+[[nodiscard]] constexpr std::uint64_t CombineHash(const std::uint64_t hash, const std::uint64_t characters) noexcept {
+	// FNV-1a operating on 64 bit values instead of bytes
+	return (hash ^ characters) * 0x100000001B3u;
+}
+
+/// @brief Calculate a hash value which is the same for all strings which are equal when ignoring case.
+/// @details The characters are mapped to upper case and combined in groups of 4. The result does not depend on
+/// whether a group is processed by the vectorized or by the scalar loop.
+[[nodiscard]] std::size_t GetCaseInsensitiveHash(const wchar_t* const str, const std::size_t length) noexcept {
+	std::uint64_t hash = 0xCBF29CE484222325u;
+	std::size_t i = 0;
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+	const __m128i nonAsciiMask = _mm_set1_epi16(static_cast<short>(0xFF80u));
+	for (; i + 8 <= length; i += 8) {
+		const __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(str + i));  // NOLINT(cppcoreguidelines-pro-type-reinterpret-cast): Unaligned load of 8 code units.
+		if (_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(chars, nonAsciiMask), _mm_setzero_si128())) != 0xFFFF) {
+			break;
 		}
-	} else {
-		const std::unique_ptr<wchar_t[]> buffer = std::make_unique<wchar_t[]>(size);
-		if (const int len = LCMapStringW(LOCALE_SYSTEM_DEFAULT, LCMAP_LOWERCASE, str, size, buffer.get(), size); len) {
-			int h;  // NOLINT(cppcoreguidelines-init-variables): Initialized as out parameter.
-			if (LCMapStringW(LOCALE_SYSTEM_DEFAULT, LCMAP_HASH, buffer.get(), len, reinterpret_cast<wchar_t*>(&h), static_cast<int>(sizeof(h)))) {
-				return h;
-			}
+		alignas(__m128i) std::uint64_t folded[2];
+		_mm_store_si128(reinterpret_cast<__m128i*>(folded), FoldAscii(chars));  // NOLINT(cppcoreguidelines-pro-type-reinterpret-cast): Store 8 code units.
+		hash = CombineHash(CombineHash(hash, folded[0]), folded[1]);
+	}
+#endif
+	for (; i < length; i += 4) {
+		std::uint64_t folded = 0;
+		for (std::size_t j = 0; j < 4 && i + j < length; ++j) {
+			folded |= static_cast<std::uint64_t>(static_cast<std::uint16_t>(FoldCharacter(str[i + j]))) << (j * 16);
 		}
+		hash = CombineHash(hash, folded);
 	}
 
-	// die if function fails because error is really severe and could corrupt all data
-	SLOG_FATAL("LCMapStringW {}: {}", str, lg::LastError());
-	assert(false);
-	std::terminate();
+	// final mix from MurmurHash3 because FNV does not propagate changes to the lower bits
+	hash ^= length;
+	hash ^= hash >> 33;
+	hash *= 0xFF51AFD7ED558CCDu;
+	hash ^= hash >> 33;
+	hash *= 0xC4CEB9FE1A85EC53u;
+	hash ^= hash >> 33;
+	return static_cast<std::size_t>(hash);
 }
 
 template <std::uint16_t kSize>
 [[nodiscard]] std::size_t GetCaseInsensitiveHash(const m3c::basic_lazy_string<kSize, wchar_t>& str) noexcept {
-	if (str.empty()) {
-		return 0;
-	}
+	return GetCaseInsensitiveHash(str.c_str(), str.size());
+}
 
-	const int size = static_cast<int>(str.size());
-	if (size <= MAX_PATH) {
-		wchar_t buffer[MAX_PATH];
-		if (const int len = LCMapStringW(LOCALE_SYSTEM_DEFAULT, LCMAP_LOWERCASE, str.c_str(), size, buffer, MAX_PATH); len) {
-			int h;  // NOLINT(cppcoreguidelines-init-variables): Initialized as out parameter.
-			if (LCMapStringW(LOCALE_SYSTEM_DEFAULT, LCMAP_HASH, buffer, len, reinterpret_cast<wchar_t*>(&h), static_cast<int>(sizeof(h)))) {
-				return h;
-			}
-		}
-	} else {
-		const std::unique_ptr<wchar_t[]> buffer = std::make_unique<wchar_t[]>(size);
-		if (const int len = LCMapStringW(LOCALE_SYSTEM_DEFAULT, LCMAP_LOWERCASE, str.c_str(), size, buffer.get(), size); len) {
-			int h;  // NOLINT(cppcoreguidelines-init-variables): Initialized as out parameter.
-			if (LCMapStringW(LOCALE_SYSTEM_DEFAULT, LCMAP_HASH, buffer.get(), len, reinterpret_cast<wchar_t*>(&h), static_cast<int>(sizeof(h)))) {
-				return h;
-			}
-		}
-	}
+/// @brief Check if a filename can be appended to a path without canonicalization.
+/// @details This is true for a single path component which does not end with characters which might be stripped by the
+/// shell API.
+/// @param filename The filename to append.
+[[nodiscard]] bool IsSimpleFilename(const std::wstring_view& filename) noexcept {
+	return !filename.empty() && filename.back() != L'.' && filename.back() != L' ' && filename.find_first_of(LR"(\/:)") == std::wstring_view::npos;
+}
+
+/// @brief Check if a path of a particular length can be created without adding the prefix for long paths.
+/// @param path The parent path which is already canonical.
+/// @param size The length of the result.
+[[nodiscard]] bool IsSimpleLength(const std::wstring_view& path, const std::size_t size) noexcept {
+	return path.starts_with(LR"(\\?\)") || size + kPrefixLen < MAX_PATH;
+}
 
-	// die if function fails because error is really severe and could corrupt all data
-	SLOG_FATAL("LCMapStringW {}: {}", str, lg::LastError());
-	assert(false);
-	std::terminate();
+/// @brief Check if a filename can be appended to a path without canonicalization.
+/// @param path The parent path which is already canonical.
+/// @param filename The filename to append.
+[[nodiscard]] bool IsSimpleAppend(const std::wstring_view& path, const std::wstring_view& filename) noexcept {
+	return IsSimpleFilename(filename) && IsSimpleLength(path, path.size() + 1 + filename.size());
 }
 
 }  // namespace
@@ -256,6 +328,19 @@ Path::Path(const Path& path, const wchar_t* sub, std::size_t subSize) {
 	m_path.resize(pEnd - m_path.data() + (*pEnd ? 1 : 0));
 }
 
+Path::Path(const Path& path, const Filename& sub) {
+	const std::wstring_view filename = sub.sv();
+	if (!IsSimpleAppend(path.sv(), filename)) {
+		*this = Path(path, sub.c_str(), filename.size());
+		return;
+	}
+
+	const std::size_t size = path.size();
+	m_path.resize(size + 1 + filename.size());
+	std::memcpy(m_path.data(), path.c_str(), size * sizeof(wchar_t));
+	AppendFilename(size, filename);
+}
+
 std::weak_ordering Path::operator<=>(const Path& path) const {
 	return CompareFilenames(m_path.c_str(), m_path.size(), path.c_str(), path.size());
 }
@@ -363,6 +448,17 @@ Path Path::operator+(const Filename& append) const {
 	return result;
 }
 
+void Path::AppendFilename(const std::size_t size, const std::wstring_view& filename) {
+	assert(size);
+	// root paths keep their trailing backslash
+	const std::size_t separator = m_path.c_str()[size - 1] == L'\\' ? 0 : 1;
+	m_path.resize(size + separator + filename.size());
+
+	wchar_t* const pBuffer = m_path.data();
+	pBuffer[size] = L'\\';
+	std::memcpy(pBuffer + size + separator, filename.data(), filename.size() * sizeof(wchar_t));
+}
+
 bool Path::Exists() const {
 	if (GetFileAttributesW(m_path.c_str()) != INVALID_FILE_ATTRIBUTES) {
 		return true;
@@ -532,6 +628,74 @@ std::size_t Path::hash() const noexcept {  // NOLINT(readability-identifier-nami
 	return GetCaseInsensitiveHash(m_path.c_str(), m_path.size());
 }
 
+
+const Path& PathBuilder::GetChild(const Filename& filename) {
+	if (!IsSimpleAppend(m_parent.sv(), filename.sv())) {
+		m_path = Path(m_parent, filename);
+		m_replaced = true;
+		return m_path;
+	}
+	if (m_replaced) {
+		m_path = m_parent;
+		m_replaced = false;
+	}
+	m_path.AppendFilename(m_parent.size(), filename.sv());
+	return m_path;
+}
+
+
+PathNode::PathNode(Path root)
+	: m_name(std::move(root)) {
+	// empty
+}
+
+PathNode::PathNode(std::shared_ptr<const PathNode> parent, Filename name)
+	: m_parent(std::move(parent))
+	, m_name(std::move(name)) {
+	assert(m_parent);
+}
+
+Path PathNode::GetPath() const {
+	std::vector<const Filename*> names;
+	const PathNode* pNode = this;
+	for (; pNode->m_parent; pNode = pNode->m_parent.get()) {
+		names.push_back(&std::get<Filename>(pNode->m_name));
+	}
+	const Path& root = std::get<Path>(pNode->m_name);
+
+	std::size_t size = root.size();
+	bool simple = true;
+	for (const Filename* const pName : names) {
+		size += 1 + pName->sv().size();
+		simple = simple && IsSimpleFilename(pName->sv());
+	}
+
+	Path result(root);
+	if (!simple || !IsSimpleLength(root.sv(), size)) {
+		for (auto it = names.crbegin(); it != names.crend(); ++it) {
+			result /= **it;
+		}
+		return result;
+	}
+
+	// write the result at once instead of copying the prefix for every level
+	result.m_path.resize(size);
+	wchar_t* pBuffer = result.m_path.data() + root.size();
+	if (!names.empty() && root.sv().back() == L'\\') {
+		// root paths keep their trailing backslash
+		--pBuffer;
+	}
+	for (auto it = names.crbegin(); it != names.crend(); ++it) {
+		const std::wstring_view name = (*it)->sv();
+		*pBuffer++ = L'\\';
+		std::memcpy(pBuffer, name.data(), name.size() * sizeof(wchar_t));
+		pBuffer += name.size();
+	}
+	result.m_path.resize(pBuffer - result.m_path.data());
+	return result;
+}
+
+
 llamalog::LogLine& operator<<(llamalog::LogLine& logLine, const Filename& filename) {
 	return logLine << filename.sv();
 }
@@ -0,0 +1,119 @@
+/*
+Copyright 2020 Michael Beckh
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+/// @file
+
+#include "systools/Progress.h"
+
+#include <llamalog/llamalog.h>
+#include <m3c/exception.h>
+
+#include <windows.h>
+
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <utility>
+
+namespace systools {
+
+Progress::Progress() noexcept
+	: m_start(std::chrono::steady_clock::now().time_since_epoch().count()) {
+	// empty
+}
+
+void Progress::Reset() noexcept {
+	m_start.store(std::chrono::steady_clock::now().time_since_epoch().count(), std::memory_order_relaxed);
+	m_directories.store(0, std::memory_order_relaxed);
+	m_files.store(0, std::memory_order_relaxed);
+	m_filesDeleted.store(0, std::memory_order_relaxed);
+	m_bytesCompared.store(0, std::memory_order_relaxed);
+	m_bytesCopied.store(0, std::memory_order_relaxed);
+	m_bytesLinked.store(0, std::memory_order_relaxed);
+}
+
+Progress::Snapshot Progress::GetSnapshot(const std::uint64_t verificationPending) const noexcept {
+	Snapshot snapshot;
+	snapshot.m_elapsed = std::chrono::steady_clock::now().time_since_epoch() - std::chrono::steady_clock::duration(m_start.load(std::memory_order_relaxed));
+	snapshot.m_directories = m_directories.load(std::memory_order_relaxed);
+	snapshot.m_files = m_files.load(std::memory_order_relaxed);
+	snapshot.m_filesDeleted = m_filesDeleted.load(std::memory_order_relaxed);
+	snapshot.m_bytesCompared = m_bytesCompared.load(std::memory_order_relaxed);
+	snapshot.m_bytesCopied = m_bytesCopied.load(std::memory_order_relaxed);
+	snapshot.m_bytesLinked = m_bytesLinked.load(std::memory_order_relaxed);
+	snapshot.m_verificationPending = verificationPending;
+	return snapshot;
+}
+
+ProgressReporter::ProgressReporter(Source source, const std::chrono::milliseconds interval, Callback callback)
+	: m_source(std::move(source))
+	, m_interval(interval)
+	, m_callback(std::move(callback))
+	, m_hShutdown(CreateEventW(nullptr, TRUE, FALSE, nullptr)) {
+	if (!m_hShutdown) {
+		THROW(m3c::windows_exception(GetLastError()), "CreateEvent");
+	}
+	m_thread = std::thread([](ProgressReporter* const pReporter) noexcept {
+		pReporter->Run();
+	},
+						   this);
+}
+
+ProgressReporter::~ProgressReporter() noexcept {
+	if (!SetEvent(m_hShutdown)) {
+		LOG_ERROR("SetEvent: {}", lg::LastError());
+	}
+
+	try {
+		m_thread.join();
+	} catch (const std::exception& e) {
+		LOG_ERROR("thread.join: {}", e);
+	}
+
+	// report final state
+	Report();
+}
+
+void ProgressReporter::Run() noexcept {
+	while (true) {
+		const DWORD result = WaitForSingleObject(m_hShutdown, static_cast<DWORD>(m_interval.count()));
+		if (result != WAIT_TIMEOUT) {
+			if (result == WAIT_FAILED) {
+				LOG_ERROR("WaitForSingleObject: {}", lg::LastError());
+			}
+			break;
+		}
+		Report();
+	}
+}
+
+void ProgressReporter::Report() noexcept {
+	try {
+		Progress::Snapshot snapshot = m_source();
+		const std::uint64_t bytes = snapshot.m_bytesCompared + snapshot.m_bytesCopied + snapshot.m_bytesLinked;
+		const std::uint64_t lastBytes = m_last.m_bytesCompared + m_last.m_bytesCopied + m_last.m_bytesLinked;
+		const std::chrono::microseconds duration = std::chrono::duration_cast<std::chrono::microseconds>(snapshot.m_elapsed - m_last.m_elapsed);
+		if (duration.count() > 0 && bytes >= lastBytes) {
+			snapshot.m_bytesPerSecond = (bytes - lastBytes) * 1'000'000 / static_cast<std::uint64_t>(duration.count());
+		}
+		m_callback(snapshot);
+		m_last = snapshot;
+	} catch (const std::exception& e) {
+		LOG_ERROR("Error reporting progress: {}", e);
+	}
+}
+
+}  // namespace systools
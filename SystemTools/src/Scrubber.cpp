@@ -0,0 +1,139 @@
+/*
+Copyright 2020 Michael Beckh
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+/// @file
+
+#include "systools/Scrubber.h"
+
+#include "systools/BackupStrategy.h"
+#include "systools/Digest.h"
+#include "systools/DigestCatalog.h"
+#include "systools/DirectoryScanner.h"
+#include "systools/Path.h"
+
+#include <llamalog/llamalog.h>
+
+#include <windows.h>
+
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace systools {
+
+namespace {
+
+/// @brief The catalog is saved after reading this number of bytes to limit the work lost when interrupted.
+constexpr std::uint64_t kSaveInterval = 4ULL * 1024 * 1024 * 1024;
+
+std::int64_t GetCurrentTime() noexcept {
+	FILETIME fileTime;  // NOLINT(cppcoreguidelines-pro-type-member-init): Initialized as out parameter.
+	GetSystemTimeAsFileTime(&fileTime);
+	return static_cast<std::int64_t>((static_cast<std::uint64_t>(fileTime.dwHighDateTime) << 32) | fileTime.dwLowDateTime);
+}
+
+}  // namespace
+
+Scrubber::Scrubber(DigestCatalog& catalog, const std::uint64_t maxBytesPerSecond) noexcept
+	: m_catalog(catalog)
+	, m_maxBytesPerSecond(maxBytesPerSecond) {
+	// empty
+}
+
+Scrubber::Statistics Scrubber::Scrub(const Path& root, const std::int64_t notVerifiedSince) {
+	Statistics statistics;
+	std::unordered_set<FILE_ID_128, DigestCatalog::FileIdHash, DigestCatalog::FileIdEqual> visited;
+	std::uint64_t bytesSinceSave = 0;
+
+	// share the common prefixes of all folders which are not yet scanned
+	std::vector<std::shared_ptr<const PathNode>> pending;
+	pending.push_back(std::make_shared<const PathNode>(root));
+	while (!pending.empty()) {
+		const std::shared_ptr<const PathNode> node = std::move(pending.back());
+		pending.pop_back();
+		const Path path = node->GetPath();
+
+		DirectoryScanner::Result directories;
+		DirectoryScanner::Result files;
+		m_scanner.Scan(path, directories, files, DirectoryScanner::Flags::kDefault, kAcceptAllScannerFilter);
+		m_scanner.Wait();
+
+		for (const ScannedFile& directory : directories) {
+			// never follow links out of the backup
+			if (!(directory.GetAttributes() & FILE_ATTRIBUTE_REPARSE_POINT)) {
+				pending.push_back(std::make_shared<const PathNode>(node, directory.GetName()));
+			}
+		}
+
+		PathBuilder filePaths(path);
+		for (const ScannedFile& file : files) {
+			if (file.GetAttributes() & BackupStrategy::kUnsupportedAttributesMask) {
+				LOG_DEBUG("Skipping {} with attributes {:#x}", filePaths.GetChild(file.GetName()), file.GetAttributes());
+				continue;
+			}
+			// hard links in different backups share the same data
+			if (!visited.insert(file.GetFileId()).second) {
+				continue;
+			}
+
+			const DigestCatalog::Entry* const pEntry = m_catalog.Find(file.GetFileId());
+			if (pEntry && pEntry->lastVerified >= notVerifiedSince && pEntry->size == file.GetSize() && pEntry->lastWriteTime == file.GetLastWriteTime()) {
+				++statistics.m_filesSkipped;
+				continue;
+			}
+
+			const Path& filePath = filePaths.GetChild(file.GetName());
+			const std::int64_t now = GetCurrentTime();
+			Digest digest;  // NOLINT(cppcoreguidelines-pro-type-member-init): Initialized in try block.
+			try {
+				digest = CalculateDigest(filePath, m_maxBytesPerSecond);
+			} catch (const std::exception& e) {
+				LOG_ERROR("Error reading {}: {}", filePath, e);
+				statistics.m_failed.push_back(filePath);
+				continue;
+			}
+			statistics.m_bytesRead += file.GetSize();
+			bytesSinceSave += file.GetSize();
+
+			if (!pEntry || pEntry->size != file.GetSize() || pEntry->lastWriteTime != file.GetLastWriteTime()) {
+				// a modified file is a new version, not a corruption
+				LOG_DEBUG("Adding {} to catalog", filePath);
+				m_catalog.Set(file.GetFileId(), {.size = file.GetSize(), .lastWriteTime = file.GetLastWriteTime(), .lastVerified = now, .digest = digest});
+				++statistics.m_filesAdded;
+			} else if (digest == pEntry->digest) {
+				m_catalog.Set(file.GetFileId(), {.size = pEntry->size, .lastWriteTime = pEntry->lastWriteTime, .lastVerified = now, .digest = pEntry->digest});
+				++statistics.m_filesVerified;
+			} else {
+				// keep the entry so that the file is checked again in the next run
+				LOG_ERROR("Content of {} does not match the digest", filePath);
+				statistics.m_failed.push_back(filePath);
+			}
+
+			if (bytesSinceSave >= kSaveInterval) {
+				m_catalog.Save();
+				bytesSinceSave = 0;
+			}
+		}
+	}
+
+	m_catalog.Save();
+	return statistics;
+}
+
+}  // namespace systools
@@ -0,0 +1,261 @@
+/*
+Copyright 2020 Michael Beckh
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+/// @file
+
+#include "systools/Trace.h"
+
+#include "systools/Path.h"
+
+#include <llamalog/llamalog.h>
+#include <m3c/Handle.h>
+#include <m3c/exception.h>
+#include <m3c/mutex.h>
+#include <m3c/string_encode.h>
+
+#include <fmt/core.h>
+
+#include <windows.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <iterator>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace systools {
+
+namespace {
+
+/// @brief A complete event of the trace.
+struct Event {
+	const char* name;
+	const char* category;
+	DWORD threadId;
+	std::chrono::steady_clock::time_point start;
+	std::chrono::steady_clock::duration duration;
+	std::wstring path;
+};
+
+/// @brief The shared state of the trace.
+struct State {
+	std::atomic_bool enabled = false;
+	/// @brief Protects `start` and `events`.
+	m3c::mutex mutex;
+	std::chrono::steady_clock::time_point start;
+	std::vector<Event> events;
+	/// @brief Protects `hFile`, `path` and `empty`. Never acquired while holding `mutex`.
+	m3c::mutex fileMutex;
+	m3c::Handle hFile;
+	std::optional<Path> path;
+	bool empty = true;
+};
+
+/// @brief The maximum number of bytes in a single call to `WriteFile`.
+constexpr std::size_t kMaxWriteSize = 0x100000;
+
+/// @brief Append a string to JSON output escaping all characters as required.
+/// @param json The JSON output.
+/// @param value The UTF-8 encoded string value.
+void AppendEscaped(std::string& json, const std::string_view& value) {
+	for (const char ch : value) {
+		switch (ch) {
+		case '"':
+			json += R"(\")";
+			break;
+		case '\\':
+			json += R"(\\)";
+			break;
+		default:
+			if (static_cast<unsigned char>(ch) < 0x20) {
+				fmt::format_to(std::back_inserter(json), "\\u{:04x}", static_cast<unsigned char>(ch));
+			} else {
+				json += ch;
+			}
+		}
+	}
+}
+
+/// @brief Write data to a file.
+/// @param hFile The handle of the file.
+/// @param path The path of the file for error messages.
+/// @param data The data to write.
+void Write(const HANDLE hFile, const Path& path, std::string_view data) {
+	while (!data.empty()) {
+		const DWORD size = static_cast<DWORD>(std::min(data.size(), kMaxWriteSize));
+		DWORD bytesWritten;  // NOLINT(cppcoreguidelines-init-variables): Initialized as out parameter.
+		if (!WriteFile(hFile, data.data(), size, &bytesWritten, nullptr)) {
+			THROW(m3c::windows_exception(GetLastError()), "WriteFile {}", path);
+		}
+		if (!bytesWritten) {
+			THROW(m3c::windows_exception(ERROR_WRITE_FAULT), "WriteFile {}: No data written", path);
+		}
+		data.remove_prefix(bytesWritten);
+	}
+}
+
+/// @brief Write events to the file of the trace.
+/// @details Events are dropped if the trace was stopped in the meantime.
+/// @param state The shared state of the trace.
+/// @param events The events to write.
+/// @param start The start of the trace.
+void WriteEvents(State& state, const std::vector<Event>& events, const std::chrono::steady_clock::time_point start) {
+	const DWORD processId = GetCurrentProcessId();
+
+	m3c::scoped_lock lock(state.fileMutex);
+	if (!state.hFile) {
+		return;
+	}
+
+	std::string json;
+	for (const Event& event : events) {
+		if (!state.empty || !json.empty()) {
+			json += ',';
+		}
+
+		json += R"({"name":")";
+		AppendEscaped(json, event.name);
+		json += R"(","cat":")";
+		AppendEscaped(json, event.category);
+		fmt::format_to(std::back_inserter(json), R"(","ph":"X","ts":{},"dur":{},"pid":{},"tid":{})",
+					   std::chrono::duration_cast<std::chrono::microseconds>(event.start - start).count(),
+					   std::chrono::duration_cast<std::chrono::microseconds>(event.duration).count(),
+					   processId, event.threadId);
+		if (!event.path.empty()) {
+			json += R"(,"args":{"path":")";
+			AppendEscaped(json, m3c::EncodeUtf8(event.path.c_str(), event.path.size()));
+			json += R"("})";
+		}
+		json += '}';
+	}
+	Write(state.hFile, *state.path, json);
+	state.empty = state.empty && json.empty();
+}
+
+}  // namespace
+
+//
+// Trace::Span
+//
+
+Trace::Span::Span(const char* const name, const char* const category) noexcept
+	: m_name(name)
+	, m_category(category)
+	, m_enabled(Trace::IsEnabled())
+	, m_start(m_enabled ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point()) {
+	// empty
+}
+
+Trace::Span::Span(const char* const name, const char* const category, const Path& path)
+	: Span(name, category) {
+	if (m_enabled) {
+		m_path = path.sv();
+	}
+}
+
+Trace::Span::~Span() noexcept {
+	if (!m_enabled) {
+		return;
+	}
+	const std::chrono::steady_clock::duration duration = std::chrono::steady_clock::now() - m_start;
+	try {
+		State& state = GetState();
+		std::vector<Event> batch;
+		std::chrono::steady_clock::time_point start;
+		{
+			m3c::scoped_lock lock(state.mutex);
+			// events of spans which outlive a restart of the trace are dropped
+			if (!state.enabled.load(std::memory_order_relaxed) || m_start < state.start) {
+				return;
+			}
+			state.events.push_back({m_name, m_category, GetCurrentThreadId(), m_start, duration, std::move(m_path)});
+			if (state.events.size() < kBatchSize) {
+				return;
+			}
+			batch.swap(state.events);
+			start = state.start;
+		}
+		// write outside of the lock to not block other threads
+		WriteEvents(state, batch, start);
+	} catch (const std::exception& e) {
+		LOG_ERROR("Error recording span {}: {}", m_name, e);
+	}
+}
+
+//
+// Trace
+//
+
+void Trace::Start(const Path& path) {
+	Stop();
+
+	State& state = GetState();
+	{
+		m3c::scoped_lock lock(state.fileMutex);
+		m3c::Handle hFile = CreateFileW(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (!hFile) {
+			THROW(m3c::windows_exception(GetLastError()), "CreateFile {}", path);
+		}
+		Write(hFile, path, R"({"traceEvents":[)");
+		state.hFile = std::move(hFile);
+		state.path.emplace(path);
+		state.empty = true;
+	}
+	{
+		m3c::scoped_lock lock(state.mutex);
+		state.events.clear();
+		state.start = std::chrono::steady_clock::now();
+	}
+	state.enabled.store(true, std::memory_order_relaxed);
+}
+
+void Trace::Stop() {
+	State& state = GetState();
+	std::vector<Event> events;
+	std::chrono::steady_clock::time_point start;
+	{
+		m3c::scoped_lock lock(state.mutex);
+		state.enabled.store(false, std::memory_order_relaxed);
+		events.swap(state.events);
+		start = state.start;
+	}
+
+	WriteEvents(state, events, start);
+
+	m3c::scoped_lock lock(state.fileMutex);
+	if (!state.hFile) {
+		return;
+	}
+	// close the file even if writing fails
+	const m3c::Handle hFile = std::move(state.hFile);
+	const Path path = *std::move(state.path);
+	state.path.reset();
+	Write(hFile, path, R"(],"displayTimeUnit":"ms"})");
+	LOG_DEBUG("Saved trace to {}", path);
+}
+
+bool Trace::IsEnabled() noexcept {
+	return GetState().enabled.load(std::memory_order_relaxed);
+}
+
+}  // namespace systools
@@ -21,6 +21,7 @@ limitations under the License.
 
 #include <llamalog/llamalog.h>
 #include <m3c/lazy_string.h>
+#include <m3c/mutex.h>
 #include <m3c/string_encode.h>
 
 #include <algorithm>
@@ -32,9 +33,12 @@ limitations under the License.
 #include <limits>
 #include <memory>
 #include <new>
+#include <optional>
 #include <random>
 #include <string_view>
+#include <unordered_map>
 #include <utility>
+#include <vector>
 
 #ifdef __clang_analyzer__
 // Avoid collisions with Windows API defines
@@ -46,8 +50,8 @@ namespace systools::test {
 
 namespace {
 
-std::mt19937 g_random(1234U);
-std::uniform_int_distribution g_sizeDistribution(10, 200);
+thread_local std::mt19937 g_random(1234U);
+thread_local std::uniform_int_distribution g_sizeDistribution(10, 200);
 
 class FakeFileSystemException : public std::exception {
 	// empty
@@ -127,58 +131,76 @@ BackupFileSystem_Fake::Entry BackupFileSystem_Fake::Entry::CreateCopy() const {
 }
 
 BackupFileSystem_Fake::BackupFileSystem_Fake() {
-	m_files.max_load_factor(0.75f);
-	m_files.reserve(16000);
+	m_keys.max_load_factor(0.75f);
+	m_keys.reserve(1024);
+
+	m_children.max_load_factor(0.75f);
+	m_children.reserve(16000);
 
-	m_directories.max_load_factor(0.75f);
-	m_directories.reserve(16000);
+	m_links.max_load_factor(0.75f);
+	m_links.reserve(16000);
 }
 
 void BackupFileSystem_Fake::Add(Path path, Entry entry, const bool root) {
-	Add(std::move(path), path.GetParent(), std::move(entry), root);
+	m3c::scoped_lock lock(m_mutex);
+	AddUnlocked(path, std::move(entry), root);
 }
 
-void BackupFileSystem_Fake::Add(Path path, Path parent, Entry entry, const bool root) {
-	if (root) {
-		if (parent != path && !Exists(parent)) {
-			Add(parent, Entry(parent.GetFilename(), true), true);
-		}
-	} else {
-		if (parent == path) {
+void BackupFileSystem_Fake::AddUnlocked(const Path& path, Entry entry, const bool root) {
+	const Path parent = path.GetParent();
+	if (parent == path) {
+		if (!root) {
 			THROW(FakeFileSystemException(), "{} must be root", path);
 		}
-		if (!IsDirectory(parent)) {
-			THROW(FakeFileSystemException(), "parent {} is not a directory for {}", parent, path);
+		if (Find(path) != kNoNode) {
+			THROW(FakeFileSystemException(), "{} is duplicate", path);
 		}
+		m_roots.emplace_back(path, Insert(kNoNode, path.GetFilename(), std::move(entry)));
+		return;
 	}
 
-	std::unordered_set<Path>& directory = m_directories[std::move(parent)];
-	if (directory.empty()) {
-		directory.max_load_factor(0.75f);
-		directory.reserve(256);
-	}
-	if (!directory.insert(path).second) {
-		THROW(FakeFileSystemException(), "{} is duplicate in {}", path, path.GetParent());
-	}
-	if (!m_files.insert({std::move(path), std::move(entry)}).second) {
-		THROW(FakeFileSystemException(), "{} is duplicate", path);
+	if (root && Find(parent) == kNoNode) {
+		AddUnlocked(parent, Entry(parent.GetFilename(), true), true);
 	}
+	Insert(GetDirectory(parent, path), path.GetFilename(), std::move(entry));
 }
 
-const std::unordered_map<Path, BackupFileSystem_Fake::Entry>& BackupFileSystem_Fake::GetFiles() const noexcept {
+std::unordered_map<Path, BackupFileSystem_Fake::Entry> BackupFileSystem_Fake::GetFiles() const {
+	m3c::scoped_lock lock(m_mutex);
+	if (m_filesValid) {
+		return m_files;
+	}
+
+	m_files.clear();
+	m_files.max_load_factor(0.75f);
+	m_files.reserve(m_nodes.size() - m_freeNodes.size());
+
+	std::vector<std::pair<Path, NodeId>> pending(m_roots);
+	while (!pending.empty()) {
+		auto [path, id] = std::move(pending.back());
+		pending.pop_back();
+
+		const Node& node = m_nodes[id];
+		for (const NodeId child : node.children) {
+			pending.emplace_back(path / m_names[m_nodes[child].name], child);
+		}
+		m_files.emplace(std::move(path), node.entry);
+	}
+	m_filesValid = true;
 	return m_files;
 }
 
 void BackupFileSystem_Fake::Dump() {
+	const std::unordered_map<Path, Entry> files = GetFiles();
 	std::vector<Path> paths;
-	paths.reserve(m_files.size());
-	for (auto it : m_files) {
-		paths.emplace_back(it.first.GetParent() / it.second.filename);
+	paths.reserve(files.size());
+	for (const auto& [path, entry] : files) {
+		paths.emplace_back(path.GetParent() / entry.filename);
 	}
 	std::sort(paths.begin(), paths.end());
 
 	for (const Path& path : paths) {
-		const Entry& entry = m_files[path];
+		const Entry& entry = files.at(path);
 		std::cout << std::setw(10) << std::hex << entry.creationTime;
 		std::cout << " ";
 		std::cout << std::setw(10) << std::hex << entry.lastWriteTime;
@@ -203,15 +225,18 @@ void BackupFileSystem_Fake::Dump() {
 }
 
 bool BackupFileSystem_Fake::Exists(const Path& path) const {
-	return m_files.contains(path);
+	m3c::shared_lock lock(m_mutex);
+	return Find(path) != kNoNode;
 }
 
 bool BackupFileSystem_Fake::IsDirectory(const Path& path) const {
-	auto it = m_files.find(path);
-	if (it == m_files.end()) {
-		THROW(FakeFileSystemException(), "{} not found", path);
-	}
-	return it->second.IsDirectory();
+	m3c::shared_lock lock(m_mutex);
+	return m_nodes[Get(path)].entry.IsDirectory();
+}
+
+std::uint64_t BackupFileSystem_Fake::GetSize(const Path& path) const {
+	m3c::shared_lock lock(m_mutex);
+	return m_nodes[Get(path)].entry.size;
 }
 
 [[nodiscard]] BackupFileSystem_Fake::content_type BackupFileSystem_Fake::ReadFile(const Path& path) const {
@@ -219,13 +244,14 @@ bool BackupFileSystem_Fake::IsDirectory(const Path& path) const {
 	const std::size_t pos = str.find_first_of(L':');
 
 	if (pos == decltype(str)::npos) {
-		if (IsDirectory(path)) {
+		const Entry& entry = m_nodes[Get(path)].entry;
+		if (entry.IsDirectory()) {
 			THROW(FakeFileSystemException(), "{} is a directory", path);
 		}
-		return m_files.at(path).content;
+		return entry.content;
 	}
 
-	const Entry& entry = m_files.at(Path(str.substr(0, pos)));
+	const Entry& entry = m_nodes[Get(Path(str.substr(0, pos)))].entry;
 	const std::wstring_view streamName = str.substr(pos);
 
 	for (const Entry::Stream& stream : entry.streams) {
@@ -238,138 +264,295 @@ bool BackupFileSystem_Fake::IsDirectory(const Path& path) const {
 }
 
 bool BackupFileSystem_Fake::Compare(const Path& src, const Path& target) const {
+	m3c::shared_lock lock(m_mutex);
 	return ReadFile(src) == ReadFile(target);
 }
 
 void BackupFileSystem_Fake::CreateDirectory(const Path& path, const Path& templatePath, const ScannedFile& securitySource) {
-	if (!IsDirectory(templatePath)) {
+	m3c::scoped_lock lock(m_mutex);
+	const NodeId templateId = Get(templatePath);
+	if (!m_nodes[templateId].entry.IsDirectory()) {
 		THROW(FakeFileSystemException(), "{} is not a directory", templatePath);
 	}
-	Path parent = path.GetParent();
-	if (!IsDirectory(parent)) {
-		THROW(FakeFileSystemException(), "{} is not a directory for {}", parent, path);
-	}
+	const NodeId parent = GetDirectory(path.GetParent(), path);
 
-	Entry entry = m_files.at(templatePath);
-	entry.creationTime = ++m_timestamp;
-	entry.lastWriteTime = m_timestamp;
+	Entry entry = m_nodes[templateId].entry;
+	entry.creationTime = entry.lastWriteTime = ++m_timestamp;
 	entry.filename = path.GetFilename().c_str();
 	entry.fileId = ++m_fileId;
 	entry.streams.clear();
 	entry.security = *reinterpret_cast<const security_type*>(securitySource.GetSecurity().pSecurityDescriptor.get());
-	Add(path, std::move(parent), std::move(entry), false);
+	Insert(parent, path.GetFilename(), std::move(entry));
 }
 
 void BackupFileSystem_Fake::CreateDirectoryRecursive(const Path& path) {
+	m3c::scoped_lock lock(m_mutex);
+	CreateDirectoryRecursiveUnlocked(path);
+}
+
+BackupFileSystem_Fake::NodeId BackupFileSystem_Fake::CreateDirectoryRecursiveUnlocked(const Path& path) {
 	const Path parent = path.GetParent();
 	if (parent == path) {
 		THROW(FakeFileSystemException(), "root is missing for {}", path);
 	}
-	if (!Exists(parent)) {
-		CreateDirectoryRecursive(parent);
+	NodeId parentId = Find(parent);
+	if (parentId == kNoNode) {
+		parentId = CreateDirectoryRecursiveUnlocked(parent);
 	}
-	if (!IsDirectory(parent)) {
+	if (!m_nodes[parentId].entry.IsDirectory()) {
 		THROW(FakeFileSystemException(), "{} is not a directory for {}", parent, path);
 	}
 
-	Add(path, std::move(parent), Entry(path.GetFilename(), true), false);
+	return Insert(parentId, path.GetFilename(), Entry(path.GetFilename(), true));
 }
 
 void BackupFileSystem_Fake::SetAttributes(const Path& path, const ScannedFile& attributesSource) {
-	Entry& entry = m_files.at(path);
+	m3c::scoped_lock lock(m_mutex);
+	Entry& entry = m_nodes[Get(path)].entry;
 	entry.creationTime = attributesSource.GetCreationTime();
 	entry.lastWriteTime = attributesSource.GetLastWriteTime();
 	entry.attributes = (entry.attributes & ~BackupStrategy::kCopyAttributeMask) | (attributesSource.GetAttributes() & BackupStrategy::kCopyAttributeMask);
+	m_filesValid = false;
 }
 
 void BackupFileSystem_Fake::SetSecurity(const Path& path, const ScannedFile& securitySource) {
-	Entry& entry = m_files.at(path);
+	m3c::scoped_lock lock(m_mutex);
+	Entry& entry = m_nodes[Get(path)].entry;
 	entry.security = *reinterpret_cast<const security_type*>(securitySource.GetSecurity().pSecurityDescriptor.get());
+	m_filesValid = false;
 }
 
 void BackupFileSystem_Fake::Rename(const Path& existingName, const Path& newName) {
-	const Path parent = newName.GetParent();
-	if (!IsDirectory(parent)) {
-		THROW(FakeFileSystemException(), "{} is not a directory for {}", parent, newName);
-	}
+	m3c::scoped_lock lock(m_mutex);
+	const NodeId parent = GetDirectory(newName.GetParent(), newName);
 
-	auto node = m_files.extract(existingName);
-	if (node.empty()) {
+	const NodeId id = Find(existingName);
+	if (id == kNoNode) {
 		THROW(FakeFileSystemException(), "{} does not exist", existingName);
 	}
-	node.key() = newName;
-	node.mapped().filename = newName.GetFilename().c_str();
-	if (!m_files.insert(std::move(node)).inserted) {
+	if (m_nodes[id].parent == kNoNode) {
+		THROW(FakeFileSystemException(), "{} is root", existingName);
+	}
+	// renaming to a name which only differs in case finds the same node
+	if (const NodeId existing = Find(newName); existing != kNoNode && existing != id) {
 		THROW(FakeFileSystemException(), "{} already exists", newName);
-	};
-
-	if (m_directories.at(parent).erase(existingName) != 1) {
-		THROW(FakeFileSystemException(), "{} does not exist in {}", existingName, parent);
 	}
 
-	std::unordered_set<Path>& directory = m_directories[newName.GetParent()];
-	if (!directory.insert(newName).second) {
-		THROW(FakeFileSystemException(), "{} already exists in {}", newName, newName.GetParent());
-	}
+	Unlink(id);
+	const Filename filename = newName.GetFilename();
+	m_nodes[id].entry.filename = filename.c_str();
+	Link(id, parent, filename);
 }
 
 void BackupFileSystem_Fake::Copy(const Path& source, const Path& target) {
-	if (IsDirectory(source)) {
+	m3c::scoped_lock lock(m_mutex);
+	const NodeId sourceId = Get(source);
+	if (m_nodes[sourceId].entry.IsDirectory()) {
 		THROW(FakeFileSystemException(), "{} is a directory", source);
 	}
-	const Path parent = target.GetParent();
-	if (!IsDirectory(parent)) {
-		THROW(FakeFileSystemException(), "{} is not a directory for {}", parent, target);
-	}
+	const NodeId parent = GetDirectory(target.GetParent(), target);
 
-	Entry entry = m_files.at(source);
+	Entry entry = m_nodes[sourceId].entry;
 	entry.creationTime = ++m_timestamp;
 	entry.filename = target.GetFilename().c_str();
 	entry.fileId = ++m_fileId;
-	Add(target, std::move(parent), std::move(entry), false);
+	Insert(parent, target.GetFilename(), std::move(entry));
 }
 
-void BackupFileSystem_Fake::CreateHardLink(const Path& path, const Path& existing) {
-	const Path parent = path.GetParent();
-	if (!IsDirectory(parent)) {
-		THROW(FakeFileSystemException(), "{} is not a directory for {}", parent, path);
+std::optional<std::uint64_t> BackupFileSystem_Fake::Update(const Path& source, const Path& target) {
+	m3c::scoped_lock lock(m_mutex);
+	const Entry& sourceEntry = m_nodes[Get(source)].entry;
+	if (sourceEntry.IsDirectory()) {
+		THROW(FakeFileSystemException(), "{} is a directory", source);
+	}
+	Entry& entry = m_nodes[Get(target)].entry;
+	if (entry.IsDirectory()) {
+		THROW(FakeFileSystemException(), "{} is a directory", target);
+	}
+
+	if (m_links.at(entry.fileId) > 1) {
+		return std::nullopt;
 	}
-	if (IsDirectory(existing)) {
+
+	const std::uint64_t bytesWritten = entry.content == sourceEntry.content ? 0 : sourceEntry.size;
+	entry.size = sourceEntry.size;
+	entry.lastWriteTime = ++m_timestamp;
+	entry.content = sourceEntry.content;
+	m_filesValid = false;
+	return bytesWritten;
+}
+
+void BackupFileSystem_Fake::CreateHardLink(const Path& path, const Path& existing) {
+	m3c::scoped_lock lock(m_mutex);
+	const NodeId parent = GetDirectory(path.GetParent(), path);
+	const NodeId existingId = Get(existing);
+	if (m_nodes[existingId].entry.IsDirectory()) {
 		THROW(FakeFileSystemException(), "{} is a directory", existing);
 	}
 
-	Entry entry = m_files.at(existing);
+	Entry entry = m_nodes[existingId].entry;
 	entry.filename = path.GetFilename().c_str();
-	Add(path, std::move(parent), std::move(entry), false);
+	Insert(parent, path.GetFilename(), std::move(entry));
 }
 
 void BackupFileSystem_Fake::Delete(const Path& path) {
-	if (m_files.erase(path) != 1) {
+	m3c::scoped_lock lock(m_mutex);
+	const NodeId id = Find(path);
+	if (id == kNoNode) {
 		THROW(FakeFileSystemException(), "error removing {}", path);
 	}
-	if (m_directories.at(path.GetParent()).erase(path) != 1) {
-		THROW(FakeFileSystemException(), "{} does not exist in {}", path, path.GetParent());
+	Node& node = m_nodes[id];
+	if (!node.children.empty()) {
+		THROW(FakeFileSystemException(), "{} is not empty", path);
 	}
+
+	if (node.parent == kNoNode) {
+		std::erase_if(m_roots, [id](const std::pair<Path, NodeId>& root) noexcept {
+			return root.second == id;
+		});
+	} else {
+		Unlink(id);
+	}
+	if (const auto it = m_links.find(node.entry.fileId); --it->second == 0) {
+		m_links.erase(it);
+	}
+	// release the memory without constructing a new Entry which would consume a timestamp and file id
+	node.entry.filename.clear();
+	node.entry.filename.shrink_to_fit();
+	node.entry.content = content_type();
+	node.entry.streams.clear();
+	node.entry.streams.shrink_to_fit();
+	node.entry.security = security_type();
+	node.children.shrink_to_fit();
+	m_freeNodes.push_back(id);
+	m_filesValid = false;
 }
 
 void BackupFileSystem_Fake::Scan(const Path& path, std::vector<ScannedFile>& directories, std::vector<ScannedFile>& files, DirectoryScanner::Flags /* flags */, const ScannerFilter& filter) const {
-	if (!IsDirectory(path)) {
+	m3c::shared_lock lock(m_mutex);
+	const Node& node = m_nodes[Get(path)];
+	if (!node.entry.IsDirectory()) {
 		THROW(FakeFileSystemException(), "{} is not a directory", path);
 	}
-	const auto it = m_directories.find(path);
-	if (it != m_directories.end()) {
-		for (const Path& pathEntry : it->second) {
-			const BackupFileSystem_Fake::Entry& entry = m_files.at(pathEntry);
+	for (const NodeId child : node.children) {
+		const BackupFileSystem_Fake::Entry& entry = m_nodes[child].entry;
+		if (filter.Accept(Filename(entry.filename))) {
 			ScannedFile_Fake fakeFile(entry);
-			if (filter.Accept(Filename(entry.filename))) {
-				if (entry.IsDirectory()) {
-					directories.push_back(std::move(fakeFile));
-				} else {
-					files.push_back(std::move(fakeFile));
-				}
+			if (entry.IsDirectory()) {
+				directories.push_back(std::move(fakeFile));
+			} else {
+				files.push_back(std::move(fakeFile));
+			}
+		}
+	}
+}
+
+BackupFileSystem_Fake::NodeId BackupFileSystem_Fake::Find(const Path& path) const {
+	const std::wstring_view str = path.sv();
+	for (const auto& [rootPath, rootId] : m_roots) {
+		const std::wstring_view root = rootPath.sv();
+		if (str.size() < root.size() || CompareStringOrdinal(str.data(), static_cast<int>(root.size()), root.data(), static_cast<int>(root.size()), TRUE) != CSTR_EQUAL) {
+			continue;
+		}
+		std::wstring_view remaining = str.substr(root.size());
+		if (!remaining.empty() && root.back() != L'\\') {
+			if (remaining.front() != L'\\') {
+				// root is only a prefix of the first name
+				continue;
 			}
+			remaining.remove_prefix(1);
+		}
+
+		NodeId id = rootId;
+		while (!remaining.empty() && id != kNoNode) {
+			const std::size_t pos = remaining.find(L'\\');
+			id = FindChild(id, remaining.substr(0, pos));
+			remaining = pos == std::wstring_view::npos ? std::wstring_view() : remaining.substr(pos + 1);
 		}
+		if (id != kNoNode) {
+			return id;
+		}
+	}
+	return kNoNode;
+}
+
+BackupFileSystem_Fake::NodeId BackupFileSystem_Fake::FindChild(const NodeId parent, const std::wstring_view name) const {
+	const auto key = m_keys.find(Filename(name));
+	if (key == m_keys.end()) {
+		return kNoNode;
+	}
+	const auto it = m_children.find(GetChildKey(parent, key->second));
+	return it == m_children.end() ? kNoNode : it->second;
+}
+
+BackupFileSystem_Fake::NodeId BackupFileSystem_Fake::Get(const Path& path) const {
+	const NodeId id = Find(path);
+	if (id == kNoNode) {
+		THROW(FakeFileSystemException(), "{} not found", path);
+	}
+	return id;
+}
+
+BackupFileSystem_Fake::NodeId BackupFileSystem_Fake::GetDirectory(const Path& path, const Path& child) const {
+	const NodeId id = Find(path);
+	if (id == kNoNode || !m_nodes[id].entry.IsDirectory()) {
+		THROW(FakeFileSystemException(), "{} is not a directory for {}", path, child);
+	}
+	return id;
+}
+
+BackupFileSystem_Fake::NodeId BackupFileSystem_Fake::Insert(const NodeId parent, const Filename& name, Entry entry) {
+	if (parent != kNoNode && FindChild(parent, name.sv()) != kNoNode) {
+		THROW(FakeFileSystemException(), "{} is duplicate", name);
+	}
+
+	++m_links[entry.fileId];
+	NodeId id;  // NOLINT(cppcoreguidelines-init-variables): Initialized in both branches.
+	if (m_freeNodes.empty()) {
+		id = static_cast<NodeId>(m_nodes.size());
+		// a default constructed Entry would consume a timestamp and file id
+		m_nodes.push_back(Node{.entry = std::move(entry)});
+	} else {
+		id = m_freeNodes.back();
+		m_freeNodes.pop_back();
+		m_nodes[id].entry = std::move(entry);
 	}
+	Link(id, parent, name);
+	return id;
+}
+
+void BackupFileSystem_Fake::Link(const NodeId id, const NodeId parent, const Filename& name) {
+	const auto [it, inserted] = m_keys.try_emplace(name, static_cast<NameId>(m_names.size()));
+	if (inserted) {
+		m_names.push_back(name);
+	}
+	Node& node = m_nodes[id];
+	node.parent = parent;
+	node.key = it->second;
+	if (m_names[node.key].IsSameStringAs(name)) {
+		node.name = node.key;
+	} else {
+		node.name = static_cast<NameId>(m_names.size());
+		m_names.push_back(name);
+	}
+
+	if (parent != kNoNode) {
+		m_children.emplace(GetChildKey(parent, node.key), id);
+		m_nodes[parent].children.push_back(id);
+	}
+	m_filesValid = false;
+}
+
+void BackupFileSystem_Fake::Unlink(const NodeId id) {
+	const Node& node = m_nodes[id];
+	m_children.erase(GetChildKey(node.parent, node.key));
+
+	std::vector<NodeId>& siblings = m_nodes[node.parent].children;
+	const auto it = std::find(siblings.begin(), siblings.end(), id);
+	assert(it != siblings.end());
+	*it = siblings.back();
+	siblings.pop_back();
+	m_filesValid = false;
 }
 
 }  // namespace systools::test
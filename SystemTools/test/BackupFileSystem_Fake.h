@@ -20,14 +20,18 @@ limitations under the License.
 #include "systools/Path.h"
 
 #include <m3c/lazy_string.h>
+#include <m3c/mutex.h>
 
 #include <windows.h>
 
+#include <atomic>
 #include <cstdint>
+#include <deque>
 #include <functional>
+#include <optional>
 #include <string>
+#include <string_view>
 #include <unordered_map>
-#include <unordered_set>
 #include <vector>
 
 #ifdef __clang_analyzer__
@@ -58,6 +62,9 @@ public:
 		Entry(const Entry&) = default;
 		Entry(Entry&&) noexcept = default;
 
+		Entry& operator=(const Entry&) = default;
+		Entry& operator=(Entry&&) noexcept = default;
+
 		[[nodiscard]] bool operator==(const Entry& oth) const noexcept;
 
 		[[nodiscard]] bool IsDirectory() const;
@@ -79,16 +86,44 @@ public:
 private:
 	class ScannedFile_Fake;
 
+	using NodeId = std::uint32_t;
+	using NameId = std::uint32_t;
+
+	static constexpr NodeId kNoNode = ~NodeId{0};
+
+	/// @brief A file or directory. Nodes are never moved in memory, deleted nodes are reused.
+	struct Node {
+		Entry entry;
+		NodeId parent;
+		/// @brief The case-insensitive name used for looking up the node in its parent.
+		NameId key;
+		/// @brief The name including its case as used when creating or renaming the node.
+		NameId name;
+		std::vector<NodeId> children;
+	};
+
 public:
 	BackupFileSystem_Fake();
+	BackupFileSystem_Fake(const BackupFileSystem_Fake&) = delete;
+	BackupFileSystem_Fake(BackupFileSystem_Fake&&) = delete;
+	~BackupFileSystem_Fake() noexcept = default;
+
+public:
+	BackupFileSystem_Fake& operator=(const BackupFileSystem_Fake&) = delete;
+	BackupFileSystem_Fake& operator=(BackupFileSystem_Fake&&) = delete;
 
 public:
 	void Add(Path path, Entry entry, bool root = false);
-	const std::unordered_map<Path, Entry>& GetFiles() const noexcept;
+
+	/// @brief Get all files and directories by path.
+	/// @details The map is cached until the next modification. A copy is returned so that the result stays valid if
+	/// the file system is modified afterwards, e.g. by another thread.
+	[[nodiscard]] std::unordered_map<Path, Entry> GetFiles() const;
 	void Dump();
 
 	bool Exists(const Path& path) const;
 	bool IsDirectory(const Path& path) const;
+	std::uint64_t GetSize(const Path& path) const;
 
 	bool Compare(const Path& src, const Path& target) const;
 	void CreateDirectory(const Path& path, const Path& templatePath, const ScannedFile& securitySource);
@@ -97,21 +132,51 @@ public:
 	void SetSecurity(const Path& path, const ScannedFile& securitySource);
 	void Rename(const Path& existingName, const Path& newName);
 	void Copy(const Path& source, const Path& target);
+	std::optional<std::uint64_t> Update(const Path& source, const Path& target);
 	void CreateHardLink(const Path& path, const Path& existing);
 	void Delete(const Path& path);
 
 	void Scan(const Path& path, std::vector<ScannedFile>& directories, std::vector<ScannedFile>& files, DirectoryScanner::Flags flags, const ScannerFilter& filter) const;
 
 private:
-	void Add(Path path, Path parent, Entry entry, bool root);
+	// All private functions require the caller to hold the lock.
+	void AddUnlocked(const Path& path, Entry entry, bool root);
+	NodeId CreateDirectoryRecursiveUnlocked(const Path& path);
 	[[nodiscard]] content_type ReadFile(const Path& path) const;
 
-private:
-	std::unordered_map<Path, Entry> m_files;
-	std::unordered_map<Path, std::unordered_set<Path>> m_directories;
+	[[nodiscard]] NodeId Find(const Path& path) const;
+	[[nodiscard]] NodeId FindChild(NodeId parent, std::wstring_view name) const;
+	[[nodiscard]] NodeId Get(const Path& path) const;
+	[[nodiscard]] NodeId GetDirectory(const Path& path, const Path& child) const;
 
-	inline static std::int64_t m_timestamp = 0;
-	inline static std::uint64_t m_fileId = 0;
+	NodeId Insert(NodeId parent, const Filename& name, Entry entry);
+	void Link(NodeId id, NodeId parent, const Filename& name);
+	void Unlink(NodeId id);
+
+	[[nodiscard]] static std::uint64_t GetChildKey(const NodeId parent, const NameId key) noexcept {
+		return (static_cast<std::uint64_t>(parent) << 32u) | key;
+	}
+
+private:
+	std::deque<Node> m_nodes;
+	std::vector<NodeId> m_freeNodes;
+	std::vector<std::pair<Path, NodeId>> m_roots;
+
+	/// @brief All names by their index. Names are never removed.
+	std::vector<Filename> m_names;
+	/// @brief The index of the first name in `m_names` which is equal when ignoring case.
+	std::unordered_map<Filename, NameId> m_keys;
+	/// @brief The child nodes for a combination of parent node and name key.
+	std::unordered_map<std::uint64_t, NodeId> m_children;
+	/// @brief The number of links for each file id.
+	std::unordered_map<std::uint64_t, std::uint32_t> m_links;
+
+	mutable m3c::mutex m_mutex;
+	mutable std::unordered_map<Path, Entry> m_files;
+	mutable bool m_filesValid = false;
+
+	inline static std::atomic<std::int64_t> m_timestamp = 0;
+	inline static std::atomic<std::uint64_t> m_fileId = 0;
 
 	friend Entry;
 };
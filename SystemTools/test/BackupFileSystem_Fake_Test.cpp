@@ -0,0 +1,167 @@
+/*
+Copyright 2020 Michael Beckh
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "BackupFileSystem_Fake.h"
+
+#include "systools/DirectoryScanner.h"
+#include "systools/Path.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <optional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace systools::test {
+
+namespace t = testing;
+
+namespace {
+
+const Path kRoot(LR"(\\?\Volume{00112233-4455-6677-8899-AABBCCDDEEF0}\)");
+
+BackupFileSystem_Fake::Entry Directory(const wchar_t* const name) {
+	return BackupFileSystem_Fake::Entry(Filename(name), true);
+}
+
+BackupFileSystem_Fake::Entry File(const wchar_t* const name) {
+	return BackupFileSystem_Fake::Entry(Filename(name), false);
+}
+
+}  // namespace
+
+TEST(BackupFileSystem_Fake_Test, Rename_Directory_MoveChildren) {
+	BackupFileSystem_Fake fileSystem;
+	fileSystem.Add(kRoot / L"dir", Directory(L"dir"), true);
+	fileSystem.Add(kRoot / L"dir" / L"file", File(L"file"));
+	fileSystem.Add(kRoot / L"dir" / L"sub", Directory(L"sub"));
+	fileSystem.Add(kRoot / L"dir" / L"sub" / L"nested", File(L"nested"));
+
+	fileSystem.Rename(kRoot / L"dir", kRoot / L"moved");
+
+	EXPECT_FALSE(fileSystem.Exists(kRoot / L"dir"));
+	EXPECT_FALSE(fileSystem.Exists(kRoot / L"dir" / L"file"));
+	EXPECT_FALSE(fileSystem.Exists(kRoot / L"dir" / L"sub" / L"nested"));
+	EXPECT_TRUE(fileSystem.IsDirectory(kRoot / L"moved"));
+	EXPECT_TRUE(fileSystem.Exists(kRoot / L"moved" / L"file"));
+	EXPECT_TRUE(fileSystem.IsDirectory(kRoot / L"moved" / L"sub"));
+	EXPECT_TRUE(fileSystem.Exists(kRoot / L"moved" / L"sub" / L"nested"));
+
+	const std::unordered_map<Path, BackupFileSystem_Fake::Entry> files = fileSystem.GetFiles();
+	EXPECT_THAT(files, t::Not(t::Contains(t::Key(kRoot / L"dir"))));
+	ASSERT_THAT(files, t::Contains(t::Key(kRoot / L"moved")));
+	EXPECT_EQ(L"moved", files.at(kRoot / L"moved").filename);
+	EXPECT_THAT(files, t::Contains(t::Key(kRoot / L"moved" / L"sub" / L"nested")));
+}
+
+TEST(BackupFileSystem_Fake_Test, Delete_NotEmpty_ThrowException) {
+	BackupFileSystem_Fake fileSystem;
+	fileSystem.Add(kRoot / L"dir", Directory(L"dir"), true);
+	fileSystem.Add(kRoot / L"dir" / L"file", File(L"file"));
+
+	EXPECT_THROW(fileSystem.Delete(kRoot / L"dir"), std::exception);
+
+	EXPECT_TRUE(fileSystem.IsDirectory(kRoot / L"dir"));
+	EXPECT_TRUE(fileSystem.Exists(kRoot / L"dir" / L"file"));
+}
+
+TEST(BackupFileSystem_Fake_Test, Delete_File_ReuseNodeWithoutConsumingFileId) {
+	BackupFileSystem_Fake fileSystem;
+	fileSystem.Add(kRoot / L"dir", Directory(L"dir"), true);
+	fileSystem.Add(kRoot / L"dir" / L"file", File(L"file"));
+	const BackupFileSystem_Fake::Entry before = File(L"before");
+
+	fileSystem.Delete(kRoot / L"dir" / L"file");
+	fileSystem.Add(kRoot / L"dir" / L"new", File(L"new"));
+	const BackupFileSystem_Fake::Entry after = File(L"after");
+
+	// only the entry for "new" is created in between
+	EXPECT_EQ(before.fileId + 2, after.fileId);
+	const std::unordered_map<Path, BackupFileSystem_Fake::Entry> files = fileSystem.GetFiles();
+	EXPECT_THAT(files, t::Not(t::Contains(t::Key(kRoot / L"dir" / L"file"))));
+	ASSERT_THAT(files, t::Contains(t::Key(kRoot / L"dir" / L"new")));
+	EXPECT_EQ(before.fileId + 1, files.at(kRoot / L"dir" / L"new").fileId);
+}
+
+TEST(BackupFileSystem_Fake_Test, CreateHardLink_Update_CountLinks) {
+	BackupFileSystem_Fake fileSystem;
+	fileSystem.Add(kRoot / L"dir", Directory(L"dir"), true);
+	BackupFileSystem_Fake::Entry source = File(L"source");
+	source.content = "changed";
+	fileSystem.Add(kRoot / L"dir" / L"source", std::move(source));
+	fileSystem.Add(kRoot / L"dir" / L"file", File(L"file"));
+
+	fileSystem.CreateHardLink(kRoot / L"dir" / L"link", kRoot / L"dir" / L"file");
+	fileSystem.CreateHardLink(kRoot / L"dir" / L"other", kRoot / L"dir" / L"file");
+
+	const std::unordered_map<Path, BackupFileSystem_Fake::Entry> files = fileSystem.GetFiles();
+	EXPECT_EQ(files.at(kRoot / L"dir" / L"file").fileId, files.at(kRoot / L"dir" / L"link").fileId);
+	EXPECT_EQ(files.at(kRoot / L"dir" / L"file").fileId, files.at(kRoot / L"dir" / L"other").fileId);
+
+	// files with more than one link are not modified in place
+	EXPECT_EQ(std::nullopt, fileSystem.Update(kRoot / L"dir" / L"source", kRoot / L"dir" / L"file"));
+	fileSystem.Delete(kRoot / L"dir" / L"link");
+	EXPECT_EQ(std::nullopt, fileSystem.Update(kRoot / L"dir" / L"source", kRoot / L"dir" / L"file"));
+	fileSystem.Delete(kRoot / L"dir" / L"other");
+
+	EXPECT_EQ(fileSystem.GetSize(kRoot / L"dir" / L"source"), fileSystem.Update(kRoot / L"dir" / L"source", kRoot / L"dir" / L"file"));
+	EXPECT_TRUE(fileSystem.Compare(kRoot / L"dir" / L"source", kRoot / L"dir" / L"file"));
+}
+
+TEST(BackupFileSystem_Fake_Test, Scan_ConcurrentAdd_ReturnConsistentResult) {
+	constexpr std::size_t kFiles = 2000;
+	BackupFileSystem_Fake fileSystem;
+	fileSystem.Add(kRoot / L"dir", Directory(L"dir"), true);
+
+	std::atomic_bool done = false;
+	std::thread writer([&fileSystem, &done]() {
+		for (std::size_t i = 0; i < kFiles; ++i) {
+			const std::wstring name = L"file" + std::to_wstring(i);
+			fileSystem.Add(kRoot / L"dir" / name, File(name.c_str()));
+		}
+		done = true;
+	});
+
+	std::size_t previous = 0;
+	while (true) {
+		const bool last = done;
+		std::vector<ScannedFile> directories;
+		std::vector<ScannedFile> files;
+		fileSystem.Scan(kRoot / L"dir", directories, files, DirectoryScanner::Flags::kDefault, kAcceptAllScannerFilter);
+		const std::size_t count = fileSystem.GetFiles().size();
+
+		EXPECT_THAT(directories, t::IsEmpty());
+		EXPECT_THAT(files, t::SizeIs(t::AllOf(t::Ge(previous), t::Le(kFiles))));
+		// root and directory are included in the map
+		EXPECT_THAT(count, t::AllOf(t::Ge(files.size() + 2), t::Le(kFiles + 2)));
+		previous = files.size();
+		if (last) {
+			break;
+		}
+	}
+	writer.join();
+
+	EXPECT_EQ(kFiles, previous);
+}
+
+}  // namespace systools::test
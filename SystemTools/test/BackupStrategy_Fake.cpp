@@ -0,0 +1,182 @@
+/*
+Copyright 2020 Michael Beckh
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "BackupStrategy_Fake.h"
+
+#include "BackupFileSystem_Fake.h"
+#include "SimulatedStorage.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#ifdef __clang_analyzer__
+// Avoid collisions with Windows API defines
+#undef CreateDirectory
+#undef CreateHardLink
+#endif
+
+namespace systools::test {
+
+namespace {
+
+/// @brief The number of bytes transferred for reading or writing the metadata of a file.
+constexpr std::uint64_t kMetadataSize = 4096;
+
+/// @brief The number of bytes transferred for every entry when scanning a directory.
+constexpr std::uint64_t kDirectoryEntrySize = 128;
+
+}  // namespace
+
+BackupStrategy_Fake::BackupStrategy_Fake(BackupFileSystem_Fake& fileSystem) noexcept
+	: m_fileSystem(fileSystem) {
+	// empty
+}
+
+BackupStrategy_Fake::BackupStrategy_Fake(BackupFileSystem_Fake& fileSystem, SimulatedStorage& storage) noexcept
+	: m_fileSystem(fileSystem)
+	, m_pStorage(&storage) {
+	// empty
+}
+
+bool BackupStrategy_Fake::Exists(const Path& path) const {
+	if (m_pStorage) {
+		m_pStorage->Execute(path, kMetadataSize);
+	}
+	return m_fileSystem.Exists(path);
+}
+
+bool BackupStrategy_Fake::IsDirectory(const Path& path) const {
+	if (m_pStorage) {
+		m_pStorage->Execute(path, kMetadataSize);
+	}
+	return m_fileSystem.IsDirectory(path);
+}
+
+bool BackupStrategy_Fake::Compare(const Path& src, const Path& target, FileComparer& /* fileComparer */) const {
+	if (m_pStorage) {
+		// both files are read in parallel
+		const std::chrono::nanoseconds srcComplete = m_pStorage->Submit(src, m_fileSystem.GetSize(src));
+		const std::chrono::nanoseconds targetComplete = m_pStorage->Submit(target, m_fileSystem.GetSize(target));
+		m_pStorage->WaitUntil(std::max(srcComplete, targetComplete));
+	}
+	return m_fileSystem.Compare(src, target);
+}
+
+void BackupStrategy_Fake::CreateDirectory(const Path& path, const Path& templatePath, const ScannedFile& securitySource) const {
+	if (m_pStorage) {
+		m_pStorage->Execute(path, kMetadataSize);
+	}
+	m_fileSystem.CreateDirectory(path, templatePath, securitySource);
+}
+
+void BackupStrategy_Fake::CreateDirectoryRecursive(const Path& path) const {
+	if (m_pStorage) {
+		m_pStorage->Execute(path, kMetadataSize);
+	}
+	m_fileSystem.CreateDirectoryRecursive(path);
+}
+
+void BackupStrategy_Fake::SetAttributes(const Path& path, const ScannedFile& attributesSource) const {
+	if (m_pStorage) {
+		m_pStorage->Execute(path, kMetadataSize);
+	}
+	m_fileSystem.SetAttributes(path, attributesSource);
+}
+
+void BackupStrategy_Fake::SetSecurity(const Path& path, const ScannedFile& securitySource) const {
+	if (m_pStorage) {
+		m_pStorage->Execute(path, kMetadataSize);
+	}
+	m_fileSystem.SetSecurity(path, securitySource);
+}
+
+void BackupStrategy_Fake::Rename(const Path& existingName, const Path& newName) const {
+	if (m_pStorage) {
+		m_pStorage->Execute(newName, kMetadataSize);
+	}
+	m_fileSystem.Rename(existingName, newName);
+}
+
+std::optional<Digest> BackupStrategy_Fake::Copy(const Path& source, const Path& target, const ScannedFile& /* sourceFile */, const bool /* calculateDigest */) const {
+	if (m_pStorage) {
+		// reading and writing overlap
+		const std::uint64_t size = m_fileSystem.GetSize(source);
+		const std::chrono::nanoseconds readComplete = m_pStorage->Submit(source, size);
+		const std::chrono::nanoseconds writeComplete = m_pStorage->Submit(target, size + kMetadataSize);
+		m_pStorage->WaitUntil(std::max(readComplete, writeComplete));
+	}
+	m_fileSystem.Copy(source, target);
+	return std::nullopt;
+}
+
+bool BackupStrategy_Fake::Clone(const Path& source, const Path& target, const ScannedFile& /* sourceFile */) const {
+	if (m_pStorage) {
+		// a clone only writes metadata
+		m_pStorage->Execute(target, kMetadataSize);
+	}
+	m_fileSystem.Copy(source, target);
+	return true;
+}
+
+std::optional<std::uint64_t> BackupStrategy_Fake::Update(const Path& source, const Path& target, FileComparer& /* fileComparer */) const {
+	if (m_pStorage) {
+		const std::chrono::nanoseconds sourceComplete = m_pStorage->Submit(source, m_fileSystem.GetSize(source));
+		const std::chrono::nanoseconds targetComplete = m_pStorage->Submit(target, m_fileSystem.GetSize(target));
+		m_pStorage->WaitUntil(std::max(sourceComplete, targetComplete));
+	}
+	const std::optional<std::uint64_t> bytesWritten = m_fileSystem.Update(source, target);
+	if (m_pStorage && bytesWritten) {
+		m_pStorage->Execute(target, *bytesWritten + kMetadataSize);
+	}
+	return bytesWritten;
+}
+
+void BackupStrategy_Fake::CreateHardLink(const Path& path, const Path& existing) const {
+	if (m_pStorage) {
+		m_pStorage->Execute(path, kMetadataSize);
+	}
+	m_fileSystem.CreateHardLink(path, existing);
+}
+
+void BackupStrategy_Fake::Delete(const Path& path) const {
+	if (m_pStorage) {
+		m_pStorage->Execute(path, kMetadataSize);
+	}
+	m_fileSystem.Delete(path);
+}
+
+void BackupStrategy_Fake::Scan(const Path& path, DirectoryScanner& scanner, std::vector<ScannedFile>& directories, std::vector<ScannedFile>& files, const DirectoryScanner::Flags flags, const ScannerFilter& filter) const {
+	const std::size_t count = directories.size() + files.size();
+	m_fileSystem.Scan(path, directories, files, flags, filter);
+	if (m_pStorage) {
+		const std::uint64_t entries = directories.size() + files.size() - count;
+		m_scans[&scanner] = m_pStorage->Submit(path, kMetadataSize + entries * kDirectoryEntrySize);
+	}
+}
+
+void BackupStrategy_Fake::WaitForScan(DirectoryScanner& scanner) const {
+	// scanning is synchronous, only the virtual clock must be advanced
+	if (const auto it = m_scans.find(&scanner); it != m_scans.end()) {
+		m_pStorage->WaitUntil(it->second);
+		m_scans.erase(it);
+	}
+}
+
+}  // namespace systools::test
@@ -0,0 +1,91 @@
+/*
+Copyright 2020 Michael Beckh
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include "systools/BackupStrategy.h"
+#include "systools/Digest.h"
+#include "systools/DirectoryScanner.h"
+
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+#ifdef __clang_analyzer__
+// Avoid collisions with Windows API defines
+#undef CreateDirectory
+#undef CreateHardLink
+#endif
+
+namespace systools {
+class FileComparer;
+class Path;
+}  // namespace systools
+
+namespace systools::test {
+
+class BackupFileSystem_Fake;
+class SimulatedStorage;
+
+/// @brief A `BackupStrategy` which performs all operations on a `BackupFileSystem_Fake`.
+/// @details Other than `BackupStrategy_Mock` this class has no mocking overhead which makes it suitable for benchmarks.
+/// `Copy` never calculates a digest, `Clone` always succeeds and scans run synchronously.
+/// If a `SimulatedStorage` is set, every operation advances its virtual clock by the time the operation would take on
+/// the devices. Scans only complete in virtual time when `WaitForScan` is called and may overlap with other operations.
+class BackupStrategy_Fake final : public BackupStrategy {
+public:
+	explicit BackupStrategy_Fake(BackupFileSystem_Fake& fileSystem) noexcept;
+	BackupStrategy_Fake(BackupFileSystem_Fake& fileSystem, SimulatedStorage& storage) noexcept;
+	BackupStrategy_Fake(const BackupStrategy_Fake&) = delete;
+	BackupStrategy_Fake(BackupStrategy_Fake&&) = delete;
+	virtual ~BackupStrategy_Fake() noexcept = default;
+
+public:
+	BackupStrategy_Fake& operator=(const BackupStrategy_Fake&) = delete;
+	BackupStrategy_Fake& operator=(BackupStrategy_Fake&&) = delete;
+
+public:
+	// Path Operations
+	[[nodiscard]] bool Exists(const Path& path) const final;
+	[[nodiscard]] bool IsDirectory(const Path& path) const final;
+
+	// File Operations
+	bool Compare(const Path& src, const Path& target, FileComparer& fileComparer) const final;
+	void CreateDirectory(const Path& path, const Path& templatePath, const ScannedFile& securitySource) const final;
+	void CreateDirectoryRecursive(const Path& path) const final;
+	void SetAttributes(const Path& path, const ScannedFile& attributesSource) const final;
+	void SetSecurity(const Path& path, const ScannedFile& securitySource) const final;
+	void Rename(const Path& existingName, const Path& newName) const final;
+	std::optional<Digest> Copy(const Path& source, const Path& target, const ScannedFile& sourceFile, bool calculateDigest) const final;
+	bool Clone(const Path& source, const Path& target, const ScannedFile& sourceFile) const final;
+	std::optional<std::uint64_t> Update(const Path& source, const Path& target, FileComparer& fileComparer) const final;
+	void CreateHardLink(const Path& path, const Path& existing) const final;
+	void Delete(const Path& path) const final;
+
+	// Scan Operations
+	void Scan(const Path& path, DirectoryScanner& scanner, std::vector<ScannedFile>& directories, std::vector<ScannedFile>& files, DirectoryScanner::Flags flags, const ScannerFilter& filter) const final;
+	void WaitForScan(DirectoryScanner& scanner) const final;
+
+private:
+	BackupFileSystem_Fake& m_fileSystem;
+	SimulatedStorage* const m_pStorage = nullptr;
+	/// @brief The virtual completion time of all scans which have not yet been waited for.
+	mutable std::unordered_map<const DirectoryScanner*, std::chrono::nanoseconds> m_scans;
+};
+
+}  // namespace systools::test
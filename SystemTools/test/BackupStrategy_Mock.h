@@ -17,11 +17,14 @@ limitations under the License.
 #pragma once
 
 #include "systools/BackupStrategy.h"
+#include "systools/Digest.h"
 #include "systools/DirectoryScanner.h"
 #include "systools/FileComparer.h"  // IWYU pragma: keep
 
 #include <gmock/gmock.h>
 
+#include <cstdint>
+#include <optional>
 #include <vector>
 
 #ifdef __clang_analyzer__
@@ -53,7 +56,9 @@ public:
 	MOCK_METHOD(void, SetAttributes, (const Path& target, const ScannedFile& attributesSource), (const, override));
 	MOCK_METHOD(void, SetSecurity, (const Path& path, const ScannedFile& securitySource), (const, override));
 	MOCK_METHOD(void, Rename, (const Path& existingName, const Path& newName), (const, override));
-	MOCK_METHOD(void, Copy, (const Path& source, const Path& target), (const, override));
+	MOCK_METHOD(std::optional<Digest>, Copy, (const Path& source, const Path& target, const ScannedFile& sourceFile, bool calculateDigest), (const, override));
+	MOCK_METHOD(bool, Clone, (const Path& source, const Path& target, const ScannedFile& sourceFile), (const, override));
+	MOCK_METHOD(std::optional<std::uint64_t>, Update, (const Path& source, const Path& target, FileComparer& fileComparer), (const, override));
 	MOCK_METHOD(void, CreateHardLink, (const Path& path, const Path& existing), (const, override));
 	MOCK_METHOD(void, Delete, (const Path& path), (const, override));
 
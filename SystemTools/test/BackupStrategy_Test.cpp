@@ -19,6 +19,7 @@ limitations under the License.
 #include "TestUtils.h"
 #include "systools/DirectoryScanner.h"
 #include "systools/FileComparer.h"
+#include "systools/FileCopier.h"
 #include "systools/Path.h"
 
 #include <llamalog/llamalog.h>
@@ -33,9 +34,11 @@ limitations under the License.
 #include <aclapi.h>
 #include <detours_gmock.h>
 #include <objidl.h>
+#include <sddl.h>
 #include <shobjidl.h>
 #include <strsafe.h>
 #include <windows.h>
+#include <winioctl.h>
 
 #include <algorithm>
 #include <atomic>
@@ -45,11 +48,13 @@ limitations under the License.
 #include <exception>
 #include <memory>
 #include <new>
+#include <optional>
 #include <ostream>
 #include <stdexcept>
 #include <string>
 #include <system_error>
 #include <tuple>
+#include <utility>
 #include <vector>
 
 #ifdef __clang_analyzer__
@@ -71,6 +76,39 @@ ACTION_P(Assert, msg) {
 	throw std::exception(msg);
 }
 
+#pragma warning(suppress : 4100)
+ACTION_P(VolumeFlags, flags) {
+	*arg3 = 0x12345678;
+	*arg5 = flags;
+	return TRUE;
+}
+
+ACTION(NoSecurity) {
+	*arg3 = nullptr;
+	*arg4 = nullptr;
+	*arg5 = nullptr;
+	*arg6 = nullptr;
+	*arg7 = LocalAlloc(LMEM_FIXED, 1);
+	return ERROR_SUCCESS;
+}
+
+ACTION_P(EndOfFile, size) {
+	static_cast<FILE_STANDARD_INFO*>(arg2)->EndOfFile.QuadPart = size;
+	return TRUE;
+}
+
+ScannedFile CreateScannedFile(const std::int64_t size, const bool hasAlternateStreams) {
+	const LARGE_INTEGER fileSize{.QuadPart = size};
+	const LARGE_INTEGER creationTime{.QuadPart = 100};
+	const LARGE_INTEGER lastWriteTime{.QuadPart = 300};
+	const FILE_ID_128 fileId = {};
+	std::vector<ScannedFile::Stream> streams;
+	if (hasAlternateStreams) {
+		streams.emplace_back(L":foo:$DATA", LARGE_INTEGER{.QuadPart = 7}, FILE_ATTRIBUTE_NORMAL);
+	}
+	return ScannedFile(Filename(L"src"), fileSize, creationTime, lastWriteTime, FILE_ATTRIBUTE_NORMAL, fileId, std::move(streams));
+}
+
 #pragma warning(suppress : 4100)
 MATCHER_P(PathIs, path, "") {
 	static_assert(std::is_convertible_v<arg_type, const Path&>);
@@ -158,6 +196,18 @@ void PrintTo(const FileMode fileMode, std::ostream* const os) {
 		(LPCWSTR lpExistingFileName, LPCWSTR lpNewFileName, LPPROGRESS_ROUTINE lpProgressRoutine, LPVOID lpData, LPBOOL pbCancel, DWORD dwCopyFlags),                                              \
 		(lpExistingFileName, lpNewFileName, lpProgressRoutine, lpData, pbCancel, dwCopyFlags),                                                                                                     \
 		dtgm::SetLastErrorAndReturn(ERROR_FILE_INVALID, FALSE));                                                                                                                                   \
+	fn_(8, BOOL, WINAPI, GetVolumeInformationByHandleW,                                                                                                                                            \
+		(HANDLE hFile, LPWSTR lpVolumeNameBuffer, DWORD nVolumeNameSize, LPDWORD lpVolumeSerialNumber, LPDWORD lpMaximumComponentLength, LPDWORD lpFileSystemFlags, LPWSTR lpFileSystemNameBuffer, DWORD nFileSystemNameSize), \
+		(hFile, lpVolumeNameBuffer, nVolumeNameSize, lpVolumeSerialNumber, lpMaximumComponentLength, lpFileSystemFlags, lpFileSystemNameBuffer, nFileSystemNameSize),                           \
+		dtgm::SetLastErrorAndReturn(ERROR_FILE_INVALID, FALSE));                                                                                                                                   \
+	fn_(8, BOOL, WINAPI, DeviceIoControl,                                                                                                                                                          \
+		(HANDLE hDevice, DWORD dwIoControlCode, LPVOID lpInBuffer, DWORD nInBufferSize, LPVOID lpOutBuffer, DWORD nOutBufferSize, LPDWORD lpBytesReturned, LPOVERLAPPED lpOverlapped),           \
+		(hDevice, dwIoControlCode, lpInBuffer, nInBufferSize, lpOutBuffer, nOutBufferSize, lpBytesReturned, lpOverlapped),                                                                         \
+		dtgm::SetLastErrorAndReturn(ERROR_FILE_INVALID, FALSE));                                                                                                                                   \
+	fn_(8, DWORD, WINAPI, GetNamedSecurityInfoW,                                                                                                                                                   \
+		(LPCWSTR pObjectName, SE_OBJECT_TYPE ObjectType, SECURITY_INFORMATION SecurityInfo, PSID * ppsidOwner, PSID * ppsidGroup, PACL * ppDacl, PACL * ppSacl, PSECURITY_DESCRIPTOR * ppSecurityDescriptor), \
+		(pObjectName, ObjectType, SecurityInfo, ppsidOwner, ppsidGroup, ppDacl, ppSacl, ppSecurityDescriptor),                                                                                   \
+		t::Return(ERROR_FILE_INVALID));                                                                                                                                                            \
 	fn_(7, DWORD, WINAPI, SetNamedSecurityInfoW,                                                                                                                                                   \
 		(LPWSTR pObjectName, SE_OBJECT_TYPE ObjectType, SECURITY_INFORMATION SecurityInfo, PSID psidOwner, PSID psidGroup, PACL pDacl, PACL pSacl),                                                \
 		(pObjectName, ObjectType, SecurityInfo, psidOwner, psidGroup, pDacl, pSacl),                                                                                                               \
@@ -195,11 +245,15 @@ void PrintTo(const FileMode fileMode, std::ostream* const os) {
 		(),                           \
 		Assert("Path::ForceDelete"));
 
-#define FILE_COMPARER_FUNCTIONS(fn_)        \
-	fn_(FileComparer, 2, bool, Compare,     \
-		(const Path& src, const Path& cpy), \
-		(src, cpy),                         \
-		Assert("FileComparer::Compare"));
+#define FILE_COMPARER_FUNCTIONS(fn_)                          \
+	fn_(FileComparer, 2, bool, Compare,                       \
+		(const Path& src, const Path& cpy),                   \
+		(src, cpy),                                           \
+		Assert("FileComparer::Compare"));                     \
+	fn_(FileComparer, 2, std::optional<std::uint64_t>, Update, \
+		(const Path& src, const Path& cpy),                   \
+		(src, cpy),                                           \
+		Assert("FileComparer::Update"));
 
 #define DIRECTORY_SCANNER_FUNCTIONS(fn_)                                                                                                                   \
 	fn_(                                                                                                                                                   \
@@ -329,6 +383,82 @@ protected:
 	const Path kTempFileRenamed = TestUtils::GetTempDirectory() / L"23220209-1205-1000-8000-0000001001.1.test";
 };
 
+class BackupStrategy_CopyTest : public t::Test {
+protected:
+	void SetUp() override {
+		// reading the SACL requires the privilege
+		const m3c::Handle hToken = [] {
+			HANDLE handle;
+			if (!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES, &handle)) {
+				THROW(m3c::windows_exception(GetLastError()), "OpenProcessToken");
+			}
+			return handle;
+		}();
+		TOKEN_PRIVILEGES privileges = {.PrivilegeCount = 1};
+		ASSERT_TRUE(LookupPrivilegeValueW(nullptr, SE_SECURITY_NAME, &privileges.Privileges->Luid));
+		privileges.Privileges->Attributes = SE_PRIVILEGE_ENABLED;
+		ASSERT_TRUE(AdjustTokenPrivileges(hToken, FALSE, &privileges, 0, nullptr, nullptr));
+		if (GetLastError() == ERROR_NOT_ALL_ASSIGNED) {
+			GTEST_SKIP() << "SeSecurityPrivilege is not available";
+		}
+
+		ASSERT_NO_FATAL_FAILURE(CreateFileWithSecurity(kTempFile, 5000));
+		ASSERT_NO_FATAL_FAILURE(CreateFileWithSecurity(kTempFileLarge, static_cast<std::size_t>(FileCopier::kDefaultBufferSize) * FileCopier::kDefaultQueueDepth));
+	}
+
+	void TearDown() override {
+		for (const Path& path : {kTempFile, kTempFileCopy, kTempFileLarge, kTempFileLargeCopy}) {
+			if (path.Exists()) {
+				path.ForceDelete();
+			}
+		}
+	}
+
+protected:
+	static void CreateFileWithSecurity(const Path& path, const std::size_t size) {
+		// an explicit entry which the copy does not inherit from the directory
+		PSECURITY_DESCRIPTOR pSecurityDescriptor;
+		ASSERT_TRUE(ConvertStringSecurityDescriptorToSecurityDescriptorW(kSddl, SDDL_REVISION_1, &pSecurityDescriptor, nullptr));
+		SECURITY_ATTRIBUTES securityAttributes = {.nLength = sizeof(SECURITY_ATTRIBUTES), .lpSecurityDescriptor = pSecurityDescriptor, .bInheritHandle = FALSE};
+		const m3c::Handle hFile = CreateFileW(path.c_str(), GENERIC_WRITE, 0, &securityAttributes, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+		LocalFree(pSecurityDescriptor);
+		ASSERT_TRUE(hFile);
+
+		const std::string data(size, 'x');
+		DWORD bytesWritten;
+		ASSERT_TRUE(WriteFile(hFile, data.data(), static_cast<DWORD>(data.size()), &bytesWritten, nullptr));
+		ASSERT_EQ(data.size(), bytesWritten);
+	}
+
+	static std::wstring GetSddl(const Path& path) {
+		constexpr SECURITY_INFORMATION kSecurityInformation = DACL_SECURITY_INFORMATION | GROUP_SECURITY_INFORMATION | OWNER_SECURITY_INFORMATION;
+		PSECURITY_DESCRIPTOR pSecurityDescriptor;
+		const DWORD result = GetNamedSecurityInfoW(path.c_str(), SE_FILE_OBJECT, kSecurityInformation, nullptr, nullptr, nullptr, nullptr, &pSecurityDescriptor);
+		if (result != ERROR_SUCCESS) {
+			THROW(m3c::windows_exception(result), "GetNamedSecurityInfoW {}", path);
+		}
+		wchar_t* pSddl;
+		const BOOL converted = ConvertSecurityDescriptorToStringSecurityDescriptorW(pSecurityDescriptor, SDDL_REVISION_1, kSecurityInformation, &pSddl, nullptr);
+		const DWORD lastError = GetLastError();
+		LocalFree(pSecurityDescriptor);
+		if (!converted) {
+			THROW(m3c::windows_exception(lastError), "ConvertSecurityDescriptorToStringSecurityDescriptorW {}", path);
+		}
+		std::wstring sddl(pSddl);
+		LocalFree(pSddl);
+		return sddl;
+	}
+
+protected:
+	static constexpr const wchar_t* kSddl = L"D:(A;;FR;;;BG)";
+	static constexpr const wchar_t* kAce = L"(A;;FR;;;BG)";
+
+	const Path kTempFile = TestUtils::GetTempDirectory() / L"23220209-1205-1000-8000-0000001002.0.test";
+	const Path kTempFileCopy = TestUtils::GetTempDirectory() / L"23220209-1205-1000-8000-0000001002.1.test";
+	const Path kTempFileLarge = TestUtils::GetTempDirectory() / L"23220209-1205-1000-8000-0000001002.2.test";
+	const Path kTempFileLargeCopy = TestUtils::GetTempDirectory() / L"23220209-1205-1000-8000-0000001002.3.test";
+};
+
 namespace {
 
 using StrategyTypes = t::Types<DryRunBackupStrategy, WritingBackupStrategy>;
@@ -900,14 +1030,278 @@ TYPED_TEST(BackupStrategy_Test, Rename_ErrorRenaming_TryUsingShell) {
 TYPED_TEST(BackupStrategy_Test, Copy_Call_Return) {
 	const Path src(this->m_name);
 	const Path dst(this->m_parent + LR"(\foo)");
+	const ScannedFile file = CreateScannedFile(5000, true);
 
 	if constexpr (!std::is_same_v<TypeParam, DryRunBackupStrategy>) {
 		EXPECT_CALL(this->m_win32, CopyFileEx(t::StrEq(src.c_str()), t::StrEq(dst.c_str()), t::_, t::_, t::_, t::_))
 			.WillOnce(t::Return(TRUE));
+		EXPECT_CALL(this->m_win32, GetNamedSecurityInfoW(t::StrEq(src.c_str()), SE_FILE_OBJECT, t::_, DTGM_ARG5))
+			.WillOnce(NoSecurity());
+		EXPECT_CALL(this->m_win32, SetNamedSecurityInfoW(t::StrEq(dst.c_str()), SE_FILE_OBJECT, DTGM_ARG5))
+			.WillOnce(t::Return(ERROR_SUCCESS));
 	}
 
 	TypeParam strategy;
-	strategy.Copy(src, dst);
+	EXPECT_EQ(std::nullopt, strategy.Copy(src, dst, file, false));
+}
+
+TYPED_TEST(BackupStrategy_Test, Copy_BlockCloning_DuplicateExtents) {
+	if constexpr (std::is_same_v<TypeParam, DryRunBackupStrategy>) {
+		// no need to check function which is never called
+		return;
+	} else {
+		const Path src(this->m_name);
+		const Path dst(this->m_parent + LR"(\foo)");
+		const Path parent(this->m_parent);
+		const ScannedFile file = CreateScannedFile(5000, false);
+
+		// handles are closed by the function under test
+		const HANDLE hTargetParent = CreateMutexW(nullptr, FALSE, nullptr);
+		const HANDLE hSourceParent = CreateMutexW(nullptr, FALSE, nullptr);
+		const HANDLE hTarget = CreateMutexW(nullptr, FALSE, nullptr);
+		ASSERT_NE(nullptr, hTargetParent);
+		ASSERT_NE(nullptr, hSourceParent);
+		ASSERT_NE(nullptr, hTarget);
+
+		std::int64_t byteCount = 0;
+		EXPECT_CALL(this->m_path, GetParent())
+			.WillOnce(dtgm::WithAssert(&this->m_path, &dst, t::Return(parent)))
+			.WillOnce(dtgm::WithAssert(&this->m_path, &src, t::Return(parent)));
+		EXPECT_CALL(this->m_win32, CreateFileW(t::StrEq(parent.c_str()), DTGM_ARG6))
+			.WillOnce(t::Return(hTargetParent))
+			.WillOnce(t::Return(hSourceParent));
+		EXPECT_CALL(this->m_win32, GetVolumeInformationByHandleW(hTargetParent, DTGM_ARG7))
+			.WillOnce(VolumeFlags(FILE_SUPPORTS_BLOCK_REFCOUNTING));
+		EXPECT_CALL(this->m_win32, GetVolumeInformationByHandleW(hSourceParent, DTGM_ARG7))
+			.WillOnce(VolumeFlags(FILE_SUPPORTS_BLOCK_REFCOUNTING));
+		EXPECT_CALL(this->m_win32, GetFileInformationByHandleEx(this->m_hFile.get(), FileStandardInfo, DTGM_ARG2))
+			.WillOnce(EndOfFile(5000));
+		EXPECT_CALL(this->m_win32, DeviceIoControl(this->m_hFile.get(), FSCTL_GET_INTEGRITY_INFORMATION, DTGM_ARG6))
+			.WillOnce([](t::Unused, t::Unused, t::Unused, t::Unused, LPVOID lpOutBuffer, t::Unused, t::Unused, t::Unused) {
+				*static_cast<FSCTL_GET_INTEGRITY_INFORMATION_BUFFER*>(lpOutBuffer) = {.ChecksumAlgorithm = CHECKSUM_TYPE_NONE, .Reserved = 0, .Flags = 0, .ChecksumChunkSizeInBytes = 0, .ClusterSizeInBytes = 4096};
+				return TRUE;
+			});
+		EXPECT_CALL(this->m_win32, CreateFileW(t::StrEq(dst.c_str()), t::_, t::_, t::_, CREATE_NEW, t::_, t::_))
+			.WillOnce(t::Return(hTarget));
+		EXPECT_CALL(this->m_win32, SetFileInformationByHandle(hTarget, FileEndOfFileInfo, t::_, t::_))
+			.WillOnce(t::Return(TRUE));
+		EXPECT_CALL(this->m_win32, DeviceIoControl(hTarget, FSCTL_DUPLICATE_EXTENTS_TO_FILE, DTGM_ARG6))
+			.WillOnce([&byteCount](t::Unused, t::Unused, LPVOID lpInBuffer, t::Unused, t::Unused, t::Unused, t::Unused, t::Unused) {
+				byteCount = static_cast<const DUPLICATE_EXTENTS_DATA*>(lpInBuffer)->ByteCount.QuadPart;
+				return TRUE;
+			});
+
+		const PSID pOwner = reinterpret_cast<PSID>(11);
+		const PSID pGroup = reinterpret_cast<PSID>(13);
+		const PACL pDacl = reinterpret_cast<PACL>(17);
+		const PACL pSacl = reinterpret_cast<PACL>(19);
+		EXPECT_CALL(this->m_win32, GetNamedSecurityInfoW(t::StrEq(src.c_str()), SE_FILE_OBJECT, t::_, DTGM_ARG5))
+			.WillOnce([pOwner, pGroup, pDacl, pSacl](t::Unused, t::Unused, t::Unused, PSID* ppsidOwner, PSID* ppsidGroup, PACL* ppDacl, PACL* ppSacl, PSECURITY_DESCRIPTOR* ppSecurityDescriptor) {
+				*ppsidOwner = pOwner;
+				*ppsidGroup = pGroup;
+				*ppDacl = pDacl;
+				*ppSacl = pSacl;
+				*ppSecurityDescriptor = LocalAlloc(LMEM_FIXED, 1);
+				return ERROR_SUCCESS;
+			});
+		EXPECT_CALL(this->m_win32, SetNamedSecurityInfoW(t::StrEq(dst.c_str()), SE_FILE_OBJECT, t::_, pOwner, pGroup, pDacl, pSacl))
+			.WillOnce(t::Return(ERROR_SUCCESS));
+
+		TypeParam strategy;
+		EXPECT_EQ(std::nullopt, strategy.Copy(src, dst, file, true));
+
+		EXPECT_EQ(8192, byteCount);
+	}
+}
+
+TYPED_TEST(BackupStrategy_Test, Copy_BlockCloningWithScannedSecurity_SetScannedSecurity) {
+	if constexpr (std::is_same_v<TypeParam, DryRunBackupStrategy>) {
+		// no need to check function which is never called
+		return;
+	} else {
+		const Path src(this->m_name);
+		const Path dst(this->m_parent + LR"(\foo)");
+		const Path parent(this->m_parent);
+		ScannedFile file = CreateScannedFile(5000, false);
+
+		const PSID pOwner = reinterpret_cast<PSID>(11);
+		const PSID pGroup = reinterpret_cast<PSID>(13);
+		const PACL pDacl = reinterpret_cast<PACL>(17);
+		const PACL pSacl = reinterpret_cast<PACL>(19);
+		ScannedFile::Security& security = file.GetSecurity();
+		security.pOwner = pOwner;
+		security.pGroup = pGroup;
+		security.pDacl = pDacl;
+		security.pSacl = pSacl;
+		security.pSecurityDescriptor.reset(new std::string("bar"));
+
+		// handles are closed by the function under test
+		const HANDLE hTargetParent = CreateMutexW(nullptr, FALSE, nullptr);
+		const HANDLE hSourceParent = CreateMutexW(nullptr, FALSE, nullptr);
+		const HANDLE hTarget = CreateMutexW(nullptr, FALSE, nullptr);
+		ASSERT_NE(nullptr, hTargetParent);
+		ASSERT_NE(nullptr, hSourceParent);
+		ASSERT_NE(nullptr, hTarget);
+
+		EXPECT_CALL(this->m_path, GetParent())
+			.WillOnce(dtgm::WithAssert(&this->m_path, &dst, t::Return(parent)))
+			.WillOnce(dtgm::WithAssert(&this->m_path, &src, t::Return(parent)));
+		EXPECT_CALL(this->m_win32, CreateFileW(t::StrEq(parent.c_str()), DTGM_ARG6))
+			.WillOnce(t::Return(hTargetParent))
+			.WillOnce(t::Return(hSourceParent));
+		EXPECT_CALL(this->m_win32, GetVolumeInformationByHandleW(hTargetParent, DTGM_ARG7))
+			.WillOnce(VolumeFlags(FILE_SUPPORTS_BLOCK_REFCOUNTING));
+		EXPECT_CALL(this->m_win32, GetVolumeInformationByHandleW(hSourceParent, DTGM_ARG7))
+			.WillOnce(VolumeFlags(FILE_SUPPORTS_BLOCK_REFCOUNTING));
+		EXPECT_CALL(this->m_win32, GetFileInformationByHandleEx(this->m_hFile.get(), FileStandardInfo, DTGM_ARG2))
+			.WillOnce(EndOfFile(5000));
+		EXPECT_CALL(this->m_win32, DeviceIoControl(this->m_hFile.get(), FSCTL_GET_INTEGRITY_INFORMATION, DTGM_ARG6))
+			.WillOnce([](t::Unused, t::Unused, t::Unused, t::Unused, LPVOID lpOutBuffer, t::Unused, t::Unused, t::Unused) {
+				*static_cast<FSCTL_GET_INTEGRITY_INFORMATION_BUFFER*>(lpOutBuffer) = {.ChecksumAlgorithm = CHECKSUM_TYPE_NONE, .Reserved = 0, .Flags = 0, .ChecksumChunkSizeInBytes = 0, .ClusterSizeInBytes = 4096};
+				return TRUE;
+			});
+		EXPECT_CALL(this->m_win32, CreateFileW(t::StrEq(dst.c_str()), t::_, t::_, t::_, CREATE_NEW, t::_, t::_))
+			.WillOnce(t::Return(hTarget));
+		EXPECT_CALL(this->m_win32, SetFileInformationByHandle(hTarget, FileEndOfFileInfo, t::_, t::_))
+			.WillOnce(t::Return(TRUE));
+		EXPECT_CALL(this->m_win32, DeviceIoControl(hTarget, FSCTL_DUPLICATE_EXTENTS_TO_FILE, DTGM_ARG6))
+			.WillOnce(t::Return(TRUE));
+		EXPECT_CALL(this->m_win32, SetNamedSecurityInfoW(t::StrEq(dst.c_str()), SE_FILE_OBJECT, t::_, pOwner, pGroup, pDacl, pSacl))
+			.WillOnce(t::Return(ERROR_SUCCESS));
+
+		TypeParam strategy;
+		EXPECT_EQ(std::nullopt, strategy.Copy(src, dst, file, false));
+	}
+}
+
+TYPED_TEST(BackupStrategy_Test, Copy_BlockCloningSizeChanged_ThrowException) {
+	if constexpr (std::is_same_v<TypeParam, DryRunBackupStrategy>) {
+		// no need to check for error in function which is never called
+		return;
+	} else {
+		const Path src(this->m_name);
+		const Path dst(this->m_parent + LR"(\foo)");
+		const Path parent(this->m_parent);
+		const ScannedFile file = CreateScannedFile(5000, false);
+
+		// handles are closed by the function under test
+		const HANDLE hTargetParent = CreateMutexW(nullptr, FALSE, nullptr);
+		const HANDLE hSourceParent = CreateMutexW(nullptr, FALSE, nullptr);
+		ASSERT_NE(nullptr, hTargetParent);
+		ASSERT_NE(nullptr, hSourceParent);
+
+		EXPECT_CALL(this->m_path, GetParent())
+			.WillOnce(dtgm::WithAssert(&this->m_path, &dst, t::Return(parent)))
+			.WillOnce(dtgm::WithAssert(&this->m_path, &src, t::Return(parent)));
+		EXPECT_CALL(this->m_win32, CreateFileW(t::StrEq(parent.c_str()), DTGM_ARG6))
+			.WillOnce(t::Return(hTargetParent))
+			.WillOnce(t::Return(hSourceParent));
+		EXPECT_CALL(this->m_win32, GetVolumeInformationByHandleW(hTargetParent, DTGM_ARG7))
+			.WillOnce(VolumeFlags(FILE_SUPPORTS_BLOCK_REFCOUNTING));
+		EXPECT_CALL(this->m_win32, GetVolumeInformationByHandleW(hSourceParent, DTGM_ARG7))
+			.WillOnce(VolumeFlags(FILE_SUPPORTS_BLOCK_REFCOUNTING));
+		EXPECT_CALL(this->m_win32, GetFileInformationByHandleEx(this->m_hFile.get(), FileStandardInfo, DTGM_ARG2))
+			.WillOnce(EndOfFile(5001));
+		EXPECT_CALL(this->m_win32, DeviceIoControl(t::_, FSCTL_DUPLICATE_EXTENTS_TO_FILE, DTGM_ARG6))
+			.Times(0);
+		EXPECT_CALL(this->m_win32, CreateFileW(t::StrEq(dst.c_str()), DTGM_ARG6))
+			.Times(0);
+
+		TypeParam strategy;
+		EXPECT_THROW(strategy.Copy(src, dst, file, false), std::exception);
+	}
+}
+
+TYPED_TEST(BackupStrategy_Test, Copy_BlockCloningNotSupported_DeleteAndCopy) {
+	if constexpr (std::is_same_v<TypeParam, DryRunBackupStrategy>) {
+		// no need to check function which is never called
+		return;
+	} else {
+		const Path src(this->m_name);
+		const Path dst(this->m_parent + LR"(\foo)");
+		const Path parent(this->m_parent);
+		const ScannedFile file = CreateScannedFile(5000, false);
+
+		// handles are closed by the function under test
+		const HANDLE hTargetParent = CreateMutexW(nullptr, FALSE, nullptr);
+		const HANDLE hSourceParent = CreateMutexW(nullptr, FALSE, nullptr);
+		const HANDLE hTarget = CreateMutexW(nullptr, FALSE, nullptr);
+		ASSERT_NE(nullptr, hTargetParent);
+		ASSERT_NE(nullptr, hSourceParent);
+		ASSERT_NE(nullptr, hTarget);
+
+		EXPECT_CALL(this->m_path, GetParent())
+			.WillOnce(dtgm::WithAssert(&this->m_path, &dst, t::Return(parent)))
+			.WillOnce(dtgm::WithAssert(&this->m_path, &src, t::Return(parent)));
+		EXPECT_CALL(this->m_win32, CreateFileW(t::StrEq(parent.c_str()), DTGM_ARG6))
+			.WillOnce(t::Return(hTargetParent))
+			.WillOnce(t::Return(hSourceParent));
+		EXPECT_CALL(this->m_win32, GetVolumeInformationByHandleW(hTargetParent, DTGM_ARG7))
+			.WillOnce(VolumeFlags(FILE_SUPPORTS_BLOCK_REFCOUNTING));
+		EXPECT_CALL(this->m_win32, GetVolumeInformationByHandleW(hSourceParent, DTGM_ARG7))
+			.WillOnce(VolumeFlags(FILE_SUPPORTS_BLOCK_REFCOUNTING));
+		EXPECT_CALL(this->m_win32, GetFileInformationByHandleEx(this->m_hFile.get(), FileStandardInfo, DTGM_ARG2))
+			.WillOnce(EndOfFile(5000));
+		EXPECT_CALL(this->m_win32, DeviceIoControl(this->m_hFile.get(), FSCTL_GET_INTEGRITY_INFORMATION, DTGM_ARG6))
+			.WillOnce([](t::Unused, t::Unused, t::Unused, t::Unused, LPVOID lpOutBuffer, t::Unused, t::Unused, t::Unused) {
+				*static_cast<FSCTL_GET_INTEGRITY_INFORMATION_BUFFER*>(lpOutBuffer) = {.ChecksumAlgorithm = CHECKSUM_TYPE_NONE, .Reserved = 0, .Flags = 0, .ChecksumChunkSizeInBytes = 0, .ClusterSizeInBytes = 4096};
+				return TRUE;
+			});
+		EXPECT_CALL(this->m_win32, CreateFileW(t::StrEq(dst.c_str()), t::_, t::_, t::_, CREATE_NEW, t::_, t::_))
+			.WillOnce(t::Return(hTarget));
+		EXPECT_CALL(this->m_win32, SetFileInformationByHandle(hTarget, FileEndOfFileInfo, t::_, t::_))
+			.WillOnce(t::Return(TRUE));
+		EXPECT_CALL(this->m_win32, DeviceIoControl(hTarget, FSCTL_DUPLICATE_EXTENTS_TO_FILE, DTGM_ARG6))
+			.WillOnce(dtgm::SetLastErrorAndReturn(ERROR_NOT_SUPPORTED, FALSE));
+		EXPECT_CALL(this->m_win32, SetFileInformationByHandle(hTarget, FileDispositionInfo, t::_, t::_))
+			.WillOnce(t::Return(TRUE));
+		EXPECT_CALL(this->m_win32, CopyFileEx(t::StrEq(src.c_str()), t::StrEq(dst.c_str()), t::_, t::_, t::_, t::_))
+			.WillOnce(t::Return(TRUE));
+		EXPECT_CALL(this->m_win32, GetNamedSecurityInfoW(t::StrEq(src.c_str()), SE_FILE_OBJECT, t::_, DTGM_ARG5))
+			.WillOnce(NoSecurity());
+		EXPECT_CALL(this->m_win32, SetNamedSecurityInfoW(t::StrEq(dst.c_str()), SE_FILE_OBJECT, DTGM_ARG5))
+			.WillOnce(t::Return(ERROR_SUCCESS));
+
+		TypeParam strategy;
+		EXPECT_EQ(std::nullopt, strategy.Copy(src, dst, file, false));
+	}
+}
+
+TYPED_TEST(BackupStrategy_Test, Copy_NoBlockCloningInSameDirectory_QueryVolumeOnce) {
+	if constexpr (std::is_same_v<TypeParam, DryRunBackupStrategy>) {
+		// no need to check function which is never called
+		return;
+	} else {
+		const Path src(this->m_name);
+		const Path dst(this->m_parent + LR"(\foo)");
+		const Path parent(this->m_parent);
+		const ScannedFile file = CreateScannedFile(5000, false);
+
+		// handle is closed by the function under test
+		const HANDLE hTargetParent = CreateMutexW(nullptr, FALSE, nullptr);
+		ASSERT_NE(nullptr, hTargetParent);
+
+		EXPECT_CALL(this->m_path, GetParent())
+			.Times(2)
+			.WillRepeatedly(dtgm::WithAssert(&this->m_path, &dst, t::Return(parent)));
+		EXPECT_CALL(this->m_win32, CreateFileW(t::StrEq(parent.c_str()), DTGM_ARG6))
+			.WillOnce(t::Return(hTargetParent));
+		EXPECT_CALL(this->m_win32, GetVolumeInformationByHandleW(hTargetParent, DTGM_ARG7))
+			.WillOnce(VolumeFlags(0));
+		EXPECT_CALL(this->m_win32, CopyFileEx(t::StrEq(src.c_str()), t::StrEq(dst.c_str()), t::_, t::_, t::_, t::_))
+			.Times(2)
+			.WillRepeatedly(t::Return(TRUE));
+		EXPECT_CALL(this->m_win32, GetNamedSecurityInfoW(t::StrEq(src.c_str()), SE_FILE_OBJECT, t::_, DTGM_ARG5))
+			.Times(2)
+			.WillRepeatedly(NoSecurity());
+		EXPECT_CALL(this->m_win32, SetNamedSecurityInfoW(t::StrEq(dst.c_str()), SE_FILE_OBJECT, DTGM_ARG5))
+			.Times(2)
+			.WillRepeatedly(t::Return(ERROR_SUCCESS));
+
+		TypeParam strategy;
+		EXPECT_EQ(std::nullopt, strategy.Copy(src, dst, file, false));
+		EXPECT_EQ(std::nullopt, strategy.Copy(src, dst, file, false));
+	}
 }
 
 TYPED_TEST(BackupStrategy_Test, Copy_ErrorCopying_ThrowException) {
@@ -917,12 +1311,57 @@ TYPED_TEST(BackupStrategy_Test, Copy_ErrorCopying_ThrowException) {
 	} else {
 		const Path src(this->m_name);
 		const Path dst(this->m_parent + LR"(\foo)");
+		const ScannedFile file = CreateScannedFile(5000, true);
 
 		EXPECT_CALL(this->m_win32, CopyFileEx(t::StrEq(src.c_str()), t::StrEq(dst.c_str()), t::_, t::_, t::_, t::_))
 			.WillOnce(dtgm::SetLastErrorAndReturn(E_ACCESSDENIED, FALSE));
 
 		TypeParam strategy;
-		EXPECT_THROW(strategy.Copy(src, dst), m3c::windows_exception);
+		EXPECT_THROW(strategy.Copy(src, dst, file, false), m3c::windows_exception);
+	}
+}
+
+TYPED_TEST(BackupStrategy_Test, Clone_AlternateStreams_ReturnFalse) {
+	const Path src(this->m_name);
+	const Path dst(this->m_parent + LR"(\foo)");
+	const ScannedFile file = CreateScannedFile(5000, true);
+
+	TypeParam strategy;
+	EXPECT_FALSE(strategy.Clone(src, dst, file));
+}
+
+TYPED_TEST(BackupStrategy_Test, Update_Call_ReturnBytesWritten) {
+	const Path src(this->m_name);
+	const Path dst(this->m_parent + LR"(\foo)");
+	FileComparer fileComparer;
+
+	if constexpr (!std::is_same_v<TypeParam, DryRunBackupStrategy>) {
+		EXPECT_CALL(this->m_fileComparer, Update(PathIs(src), PathIs(dst)))
+			.WillOnce(dtgm::WithAssert(&this->m_fileComparer, &fileComparer, t::Return(std::optional<std::uint64_t>(1234))));
+	}
+
+	TypeParam strategy;
+	if constexpr (std::is_same_v<TypeParam, DryRunBackupStrategy>) {
+		EXPECT_EQ(std::nullopt, strategy.Update(src, dst, fileComparer));
+	} else {
+		EXPECT_EQ(1234, strategy.Update(src, dst, fileComparer));
+	}
+}
+
+TYPED_TEST(BackupStrategy_Test, Update_Error_ThrowException) {
+	if constexpr (std::is_same_v<TypeParam, DryRunBackupStrategy>) {
+		// no need to check for error in function which is never called
+		return;
+	} else {
+		const Path src(this->m_name);
+		const Path dst(this->m_parent + LR"(\foo)");
+		FileComparer fileComparer;
+
+		EXPECT_CALL(this->m_fileComparer, Update(PathIs(src), PathIs(dst)))
+			.WillOnce(dtgm::WithAssert(&this->m_fileComparer, &fileComparer, t::Throw(std::logic_error("test"))));
+
+		TypeParam strategy;
+		EXPECT_THROW(strategy.Update(src, dst, fileComparer), std::logic_error);
 	}
 }
 
@@ -1045,6 +1484,35 @@ TEST_P(BackupStrategy_RenameTest, Rename_Call_Rename) {
 	EXPECT_TRUE(kTempFileRenamed.Exists());
 }
 
+TEST_F(BackupStrategy_CopyTest, Copy_WithDigest_CopySecurity) {
+	ASSERT_THAT(GetSddl(kTempFile), t::HasSubstr(kAce));
+
+	// calculating the digest uses FileCopier (or block cloning) which creates the target with default security
+	// the security is read from the file if it was not scanned
+	const ScannedFile file = CreateScannedFile(5000, false);
+
+	WritingBackupStrategy strategy;
+	strategy.Copy(kTempFile, kTempFileCopy, file, true);
+
+	EXPECT_THAT(GetSddl(kTempFileCopy), t::HasSubstr(kAce));
+	EXPECT_EQ(GetSddl(kTempFile), GetSddl(kTempFileCopy));
+}
+
+TEST_F(BackupStrategy_CopyTest, Copy_SmallAndLargeFile_SameSecurity) {
+	// small files are copied using CopyFileEx, large files using FileCopier (or block cloning)
+	const ScannedFile smallFile = CreateScannedFile(5000, false);
+	const ScannedFile largeFile = CreateScannedFile(static_cast<std::int64_t>(FileCopier::kDefaultBufferSize) * FileCopier::kDefaultQueueDepth, false);
+
+	WritingBackupStrategy strategy;
+	strategy.Copy(kTempFile, kTempFileCopy, smallFile, false);
+	strategy.Copy(kTempFileLarge, kTempFileLargeCopy, largeFile, false);
+
+	EXPECT_THAT(GetSddl(kTempFileCopy), t::HasSubstr(kAce));
+	EXPECT_EQ(GetSddl(kTempFile), GetSddl(kTempFileCopy));
+	EXPECT_EQ(GetSddl(kTempFileLarge), GetSddl(kTempFileLargeCopy));
+	EXPECT_EQ(GetSddl(kTempFileCopy), GetSddl(kTempFileLargeCopy));
+}
+
 INSTANTIATE_TEST_SUITE_P(BackupStrategy_RenameTest, BackupStrategy_RenameTest, t::Combine(t::Values(Strategy::kWin, Strategy::kShell), t::Values(FileMode::kRegular, FileMode::kReadOnly)), [](const t::TestParamInfo<BackupStrategy_RenameTest::ParamType>& param) {
 	return fmt::format("{}_{}{}", param.index, std::get<0>(param.param) == Strategy::kShell ? "Shell" : "Win", std::get<1>(param.param) == FileMode::kReadOnly ? "_ReadOnly" : "");
 });
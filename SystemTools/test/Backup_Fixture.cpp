@@ -35,6 +35,7 @@ limitations under the License.
 #include <exception>
 #include <memory>
 #include <new>
+#include <optional>
 #include <string_view>
 #include <unordered_map>
 #include <utility>
@@ -121,8 +122,12 @@ void Backup_Fixture::SetUp() {
 		.WillByDefault(t::Invoke(&m_fileSystem, &BackupFileSystem_Fake::SetSecurity));
 	ON_CALL(m_strategy, Rename(t::_, t::_))
 		.WillByDefault(t::Invoke(&m_fileSystem, &BackupFileSystem_Fake::Rename));
-	ON_CALL(m_strategy, Copy(t::_, t::_))
-		.WillByDefault(t::Invoke(&m_fileSystem, &BackupFileSystem_Fake::Copy));
+	ON_CALL(m_strategy, Copy(t::_, t::_, t::_, t::_))
+		.WillByDefault(t::DoAll(t::WithArgs<0, 1>(t::Invoke(&m_fileSystem, &BackupFileSystem_Fake::Copy)), t::Return(std::nullopt)));
+	ON_CALL(m_strategy, Clone(t::_, t::_, t::_))
+		.WillByDefault(t::DoAll(t::WithArgs<0, 1>(t::Invoke(&m_fileSystem, &BackupFileSystem_Fake::Copy)), t::Return(true)));
+	ON_CALL(m_strategy, Update(t::_, t::_, t::_))
+		.WillByDefault(t::WithArgs<0, 1>(t::Invoke(&m_fileSystem, &BackupFileSystem_Fake::Update)));
 	ON_CALL(m_strategy, CreateHardLink(t::_, t::_))
 		.WillByDefault(t::Invoke(&m_fileSystem, &BackupFileSystem_Fake::CreateHardLink));
 	ON_CALL(m_strategy, Delete(t::_))
@@ -241,7 +246,7 @@ void Backup_Fixture::VerifyFileSystem(const std::vector<Path>& backupFolders, co
 	EXPECT_THAT(srcCompare, t::IsEmpty()) << "Files have not been copied";
 }
 
-const std::unordered_map<Path, BackupFileSystem_Fake::Entry>& Backup_Fixture::Files() const noexcept {
+std::unordered_map<Path, BackupFileSystem_Fake::Entry> Backup_Fixture::Files() const {
 	return m_fileSystem.GetFiles();
 }
 
@@ -511,7 +516,7 @@ FileBuilder& FileBuilder::build() {
 		}
 
 		if (m_inSrc && !srcRefIdentical && !srcDstIdentical) {
-			EXPECT_CALL(m_backupFixture.m_strategy, Copy(mySrcPath, PathWithExactFilename(myDstPath.GetParent(), m_srcEntry.filename))).RetiresOnSaturation();
+			EXPECT_CALL(m_backupFixture.m_strategy, Copy(mySrcPath, PathWithExactFilename(myDstPath.GetParent(), m_srcEntry.filename), t::_, false)).RetiresOnSaturation();
 			EXPECT_CALL(m_backupFixture.m_strategy, SetAttributes(myDstPath, t::AllOf(
 																				 t::Property(&ScannedFile::GetCreationTime, m_srcEntry.creationTime),
 																				 t::Property(&ScannedFile::GetLastWriteTime, m_srcEntry.lastWriteTime),
@@ -150,7 +150,7 @@ protected:
 			result = action(backupFolders);
 		}
 
-		const std::unordered_map<Path, BackupFileSystem_Fake::Entry>& after = Files();
+		const std::unordered_map<Path, BackupFileSystem_Fake::Entry> after = Files();
 		VerifyFileSystem(backupFolders, before, after);
 
 		return result;
@@ -158,7 +158,7 @@ protected:
 
 	virtual Backup::Statistics VerifyBackup(const std::vector<Path>& backupFolders);
 
-	const std::unordered_map<Path, BackupFileSystem_Fake::Entry>& Files() const noexcept;
+	std::unordered_map<Path, BackupFileSystem_Fake::Entry> Files() const;
 
 private:
 	void VerifyFileSystem(const std::vector<Path>& backupFolders, const std::unordered_map<Path, BackupFileSystem_Fake::Entry>& before, const std::unordered_map<Path, BackupFileSystem_Fake::Entry>& after) const;
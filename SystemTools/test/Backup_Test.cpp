@@ -19,9 +19,12 @@ limitations under the License.
 #include "BackupFileSystem_Fake.h"
 #include "Backup_Fixture.h"
 #include "TestUtils.h"  // IWYU pragma: keep
+#include "systools/BackupIndex.h"
 #include "systools/BackupStrategy.h"
+#include "systools/Digest.h"
 #include "systools/DirectoryScanner.h"
 #include "systools/Path.h"
+#include "systools/Progress.h"
 
 #include <llamalog/llamalog.h>
 
@@ -33,11 +36,14 @@ limitations under the License.
 
 #include <algorithm>
 #include <cassert>
+#include <chrono>
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
 #include <exception>
 #include <iterator>
 #include <memory>
+#include <optional>
 #include <ostream>
 #include <stdexcept>
 #include <string>
@@ -374,6 +380,13 @@ void PrintTo(const Change change, std::ostream* const os) {
 	}
 }
 
+/// @brief Create the `FILE_ID_128` which the fake file system reports for a file id.
+FILE_ID_128 ToFileId(const std::uint64_t id) {
+	FILE_ID_128 result{};
+	std::memcpy(&result.Identifier[sizeof(result.Identifier) - sizeof(id)], &id, sizeof(id));
+	return result;
+}
+
 }  // namespace
 
 class Backup_CustomRootTest : public Backup_Fixture {
@@ -383,6 +396,40 @@ protected:
 	}
 };
 
+class Backup_MovedTest : public Backup_Fixture {
+protected:
+	void TearDown() override {
+		for (const Path& path : {kPreviousIndex, kCurrentIndex}) {
+			if (path.Exists()) {
+				path.ForceDelete();
+			}
+		}
+		Backup_Fixture::TearDown();
+	}
+
+	/// @brief Write the index of the reference copy.
+	/// @param entries Tuples of file id, id of parent folder (0 for root) and name.
+	void WritePreviousIndex(const std::vector<std::tuple<std::uint32_t, std::uint32_t, std::wstring>>& entries) const {
+		BackupIndex index(kPreviousIndex);
+		for (const auto& [fileId, parentId, name] : entries) {
+			index.Set(ToFileId(fileId), {.parentId = parentId ? ToFileId(parentId) : FILE_ID_128{}, .name = Filename(name)});
+		}
+		index.Save();
+	}
+
+	Backup::Statistics VerifyBackup(const std::vector<Path>& backupFolders) override {
+		return RunVerified(backupFolders, [this](const auto& backupFolders) {
+			Backup backup(m_strategy);
+			backup.EnableMoveDetection(kPreviousIndex, kCurrentIndex);
+			return backup.CreateBackup(backupFolders, m_ref, m_dst);
+		});
+	}
+
+protected:
+	const Path kPreviousIndex = TestUtils::GetTempDirectory() / L"23220209-1205-1000-8000-0000001005.0.test";
+	const Path kCurrentIndex = TestUtils::GetTempDirectory() / L"23220209-1205-1000-8000-0000001005.1.test";
+};
+
 class Backup_DataDrivenTest : public Backup_Fixture
 	, public t::WithParamInterface<std::tuple<Mode, std::vector<std::pair<Layout, Change>>>> {
 protected:
@@ -1076,8 +1123,15 @@ private:
 		virtual void Rename(const Path& existingName, const Path& newName) const override {
 			m_fileSystem.Rename(existingName, newName);
 		}
-		virtual void Copy(const Path& source, const Path& target) const override {
+		virtual std::optional<Digest> Copy(const Path& source, const Path& target, const ScannedFile&, bool) const override {
 			m_fileSystem.Copy(source, target);
+			return std::nullopt;
+		}
+		virtual bool Clone(const Path&, const Path&, const ScannedFile&) const override {
+			return false;
+		}
+		virtual std::optional<std::uint64_t> Update(const Path& source, const Path& target, FileComparer&) const override {
+			return m_fileSystem.Update(source, target);
 		}
 		virtual void Delete(const Path& path) const override {
 			m_fileSystem.Delete(path);
@@ -1477,6 +1531,347 @@ TEST_F(Backup_Test, CreateBackup_RootIgnored_KeepFolder) {
 	EXPECT_THAT(Files(), t::Contains(t::Key(folder.dstPath())));
 }
 
+//
+// Renamed files
+//
+TEST_F(Backup_Test, CreateBackup_FileRenamedAndInRef_CreateHardLink) {
+	auto folder = Folder(L"Folder").src().enablePathFunctions().ref().dst();
+	auto file = File(L"Renamed").disableExpect().src().size(42).creationTime(1000001).lastWriteTime(1000002);
+	auto original = File(L"Original").disableExpect().ref().size(42).creationTime(1000001).lastWriteTime(1000002);
+	m_root.children(folder);
+	folder.children(file, original);
+
+	EXPECT_CALL(m_strategy, Compare(file.srcPath(), original.refPath(), t::_));
+	EXPECT_CALL(m_strategy, CreateHardLink(file.dstPath(), original.refPath()));
+
+	const Backup::Statistics statistics = VerifyBackup({folder.srcPath()});
+
+	EXPECT_THAT(Files(), t::Contains(t::Key(file.dstPath())));
+	EXPECT_EQ(1, statistics.GetAdded().GetFiles());
+	EXPECT_EQ(0, statistics.GetBytesCopied());
+	EXPECT_EQ(42, statistics.GetBytesCreatedInHardLinks());
+}
+
+TEST_F(Backup_Test, CreateBackup_FileRenamedAndInDst_Rename) {
+	auto folder = Folder(L"Folder").src().enablePathFunctions().ref().dst();
+	auto file = File(L"Renamed").disableExpect().src().size(42).creationTime(1000001).lastWriteTime(1000002);
+	auto original = File(L"Original").disableExpect().dst().size(42).creationTime(1000001).lastWriteTime(1000002);
+	m_root.children(folder);
+	folder.children(file, original);
+
+	EXPECT_CALL(m_strategy, Compare(file.srcPath(), original.dstPath(), t::_));
+	EXPECT_CALL(m_strategy, Rename(original.dstPath(), file.dstPath()));
+
+	const Backup::Statistics statistics = VerifyBackup({folder.srcPath()});
+
+	EXPECT_THAT(Files(), t::Contains(t::Key(file.dstPath())));
+	EXPECT_THAT(Files(), t::Not(t::Contains(t::Key(original.dstPath()))));
+	EXPECT_EQ(1, statistics.GetUpdated().GetFiles());
+	EXPECT_EQ(0, statistics.GetRemoved().GetFiles());
+	EXPECT_EQ(0, statistics.GetBytesCopied());
+}
+
+TEST_F(Backup_Test, CreateBackup_FileRenamedAndContentChanged_Copy) {
+	auto folder = Folder(L"Folder").src().enablePathFunctions().ref().dst();
+	auto file = File(L"Renamed").src().size(42).creationTime(1000001).lastWriteTime(1000002).content("changed");
+	auto original = File(L"Original").disableExpect().ref().size(42).creationTime(1000001).lastWriteTime(1000002);
+	m_root.children(folder);
+	folder.children(file, original);
+
+	EXPECT_CALL(m_strategy, Compare(file.srcPath(), original.refPath(), t::_));
+
+	const Backup::Statistics statistics = VerifyBackup({folder.srcPath()});
+
+	EXPECT_EQ(42, statistics.GetBytesCopied());
+	EXPECT_EQ(0, statistics.GetBytesCreatedInHardLinks());
+}
+
+TEST_F(Backup_Test, CreateBackup_FolderRenamedAndInDst_CreateAndDelete) {
+	auto folder = Folder(L"Folder").src().enablePathFunctions().ref().dst();
+	auto renamed = Folder(L"Renamed").src().creationTime(1000001);
+	auto original = Folder(L"Original").dst().creationTime(1000001);
+	m_root.children(folder);
+	folder.children(renamed, original);
+
+	const Backup::Statistics statistics = VerifyBackup({folder.srcPath()});
+
+	EXPECT_THAT(Files(), t::Contains(t::Key(renamed.dstPath())));
+	EXPECT_THAT(Files(), t::Not(t::Contains(t::Key(original.dstPath()))));
+	EXPECT_EQ(1, statistics.GetAdded().GetFolders());
+	EXPECT_EQ(1, statistics.GetRemoved().GetFolders());
+}
+
+//
+// Moved files
+//
+TEST_F(Backup_MovedTest, CreateBackup_FolderMovedAndInRef_CreateHardLink) {
+	auto folder = Folder(L"Folder").src().enablePathFunctions().ref().dst().change().src().fileId(0x7F000001);
+	auto moved = Folder(L"Moved").disableExpect().src().creationTime(1000001).fileId(0x7F000002);
+	auto file = File(L"File").disableExpect().src().size(42).creationTime(1000003).lastWriteTime(1000004);
+	auto old = Folder(L"Old").disableExpect().ref();
+	auto original = Folder(L"Original").disableExpect().ref().creationTime(1000001);
+	auto originalFile = File(L"File").disableExpect().ref().size(42).creationTime(1000003).lastWriteTime(1000004);
+	m_root.children(folder);
+	folder.children(moved, old);
+	moved.children(file);
+	old.children(original);
+	original.children(originalFile);
+	WritePreviousIndex({{0x7F000001, 0, L"Folder"}, {0x7F000003, 0x7F000001, L"Old"}, {0x7F000002, 0x7F000003, L"Original"}});
+
+	EXPECT_CALL(m_strategy, Exists(original.refPath()));
+	EXPECT_CALL(m_strategy, Scan(old.refPath(), t::_, t::_, t::_, t::_, t::_));
+	EXPECT_CALL(m_strategy, Scan(moved.srcPath(), t::_, t::_, t::_, t::_, t::_));
+	EXPECT_CALL(m_strategy, Scan(original.refPath(), t::_, t::_, t::_, t::_, t::_));
+	EXPECT_CALL(m_strategy, CreateDirectory(moved.dstPath(), moved.srcPath(), t::_));
+	EXPECT_CALL(m_strategy, SetAttributes(moved.dstPath(), t::_));
+	EXPECT_CALL(m_strategy, Compare(file.srcPath(), originalFile.refPath(), t::_));
+	EXPECT_CALL(m_strategy, CreateHardLink(file.dstPath(), originalFile.refPath()));
+
+	const Backup::Statistics statistics = VerifyBackup({folder.srcPath()});
+
+	EXPECT_EQ(1, statistics.GetAdded().GetFolders());
+	EXPECT_EQ(1, statistics.GetAdded().GetFiles());
+	EXPECT_EQ(0, statistics.GetBytesCopied());
+	EXPECT_EQ(42, statistics.GetBytesCreatedInHardLinks());
+
+	const BackupIndex index(kCurrentIndex);
+	EXPECT_THAT(index.GetLocation(ToFileId(0x7F000002)), t::ElementsAre(Filename(L"Folder"), Filename(L"Moved")));
+}
+
+TEST_F(Backup_MovedTest, CreateBackup_FileMovedToOtherFolderAndInRef_CreateHardLink) {
+	auto folder = Folder(L"Folder").src().enablePathFunctions().ref().dst().change().src().fileId(0x7F000011);
+	auto sub = Folder(L"Sub").src();
+	auto file = File(L"New.txt").disableExpect().src().size(42).creationTime(1000001).lastWriteTime(1000002).fileId(0x7F000012);
+	auto original = File(L"Old.txt").disableExpect().ref().size(42).creationTime(1000001).lastWriteTime(1000002);
+	m_root.children(folder);
+	folder.children(sub, original);
+	sub.children(file);
+	WritePreviousIndex({{0x7F000011, 0, L"Folder"}, {0x7F000012, 0x7F000011, L"Old.txt"}});
+
+	EXPECT_CALL(m_strategy, Exists(original.refPath()));
+	// the folder is scanned again for the moved file
+	EXPECT_CALL(m_strategy, Scan(folder.refPath(), t::_, t::_, t::_, t::_, t::_))
+		.RetiresOnSaturation();
+	EXPECT_CALL(m_strategy, Compare(file.srcPath(), original.refPath(), t::_));
+	EXPECT_CALL(m_strategy, CreateHardLink(file.dstPath(), original.refPath()));
+
+	const Backup::Statistics statistics = VerifyBackup({folder.srcPath()});
+
+	EXPECT_THAT(Files(), t::Contains(t::Key(file.dstPath())));
+	EXPECT_EQ(1, statistics.GetAdded().GetFiles());
+	EXPECT_EQ(0, statistics.GetBytesCopied());
+	EXPECT_EQ(42, statistics.GetBytesCreatedInHardLinks());
+}
+
+TEST_F(Backup_MovedTest, CreateBackup_FileMovedAndContentChanged_Copy) {
+	auto folder = Folder(L"Folder").src().enablePathFunctions().ref().dst().change().src().fileId(0x7F000021);
+	auto sub = Folder(L"Sub").src();
+	auto file = File(L"New.txt").src().size(42).creationTime(1000001).lastWriteTime(1000002).content("changed").fileId(0x7F000022);
+	auto original = File(L"Old.txt").disableExpect().ref().size(42).creationTime(1000001).lastWriteTime(1000002);
+	m_root.children(folder);
+	folder.children(sub, original);
+	sub.children(file);
+	WritePreviousIndex({{0x7F000021, 0, L"Folder"}, {0x7F000022, 0x7F000021, L"Old.txt"}});
+
+	EXPECT_CALL(m_strategy, Exists(original.refPath()));
+	// the folder is scanned again for the moved file
+	EXPECT_CALL(m_strategy, Scan(folder.refPath(), t::_, t::_, t::_, t::_, t::_))
+		.RetiresOnSaturation();
+	EXPECT_CALL(m_strategy, Compare(file.srcPath(), original.refPath(), t::_));
+
+	const Backup::Statistics statistics = VerifyBackup({folder.srcPath()});
+
+	EXPECT_EQ(42, statistics.GetBytesCopied());
+	EXPECT_EQ(0, statistics.GetBytesCreatedInHardLinks());
+}
+
+TEST_F(Backup_MovedTest, CreateBackup_FolderRenamedAndInDst_Rename) {
+	auto folder = Folder(L"Folder").src().enablePathFunctions().ref().dst().change().src().fileId(0x7F000031);
+	auto renamed = Folder(L"Renamed").disableExpect().src().creationTime(1000001).fileId(0x7F000032);
+	auto file = File(L"File").disableExpect().src().size(42).creationTime(1000003).lastWriteTime(1000004);
+	auto original = Folder(L"Original").disableExpect().dst().creationTime(1000001);
+	auto originalFile = File(L"File").disableExpect().dst().size(42).creationTime(1000003).lastWriteTime(1000004);
+	m_root.children(folder);
+	folder.children(renamed, original);
+	renamed.children(file);
+	original.children(originalFile);
+	WritePreviousIndex({{0x7F000031, 0, L"Folder"}, {0x7F000032, 0x7F000031, L"Original"}});
+
+	EXPECT_CALL(m_strategy, Scan(renamed.srcPath(), t::_, t::_, t::_, t::_, t::_));
+	EXPECT_CALL(m_strategy, Scan(original.dstPath(), t::_, t::_, t::_, t::_, t::_));
+	EXPECT_CALL(m_strategy, Rename(original.dstPath(), renamed.dstPath()));
+	EXPECT_CALL(m_strategy, SetAttributes(renamed.dstPath(), t::_));
+	EXPECT_CALL(m_strategy, Compare(file.srcPath(), originalFile.dstPath(), t::_));
+
+	const Backup::Statistics statistics = VerifyBackup({folder.srcPath()});
+
+	EXPECT_THAT(Files(), t::Contains(t::Key(file.dstPath())));
+	EXPECT_THAT(Files(), t::Not(t::Contains(t::Key(original.dstPath()))));
+	EXPECT_EQ(0, statistics.GetAdded().GetFolders());
+	EXPECT_EQ(0, statistics.GetRemoved().GetFolders());
+	EXPECT_EQ(1, statistics.GetRetained().GetFiles());
+	EXPECT_EQ(0, statistics.GetBytesCopied());
+}
+
+TEST_F(Backup_MovedTest, BackupIndex_SaveAndLoad_ReturnLocation) {
+	WritePreviousIndex({{0x7F000041, 0, L"Folder"}, {0x7F000042, 0x7F000041, L"Sub"}, {0x7F000043, 0x7F000042, L"File.txt"}});
+
+	const BackupIndex index(kPreviousIndex);
+
+	EXPECT_EQ(3, index.GetSize());
+	EXPECT_THAT(index.GetLocation(ToFileId(0x7F000043)), t::ElementsAre(Filename(L"Folder"), Filename(L"Sub"), Filename(L"File.txt")));
+	EXPECT_THAT(index.GetLocation(ToFileId(0x7F000044)), t::IsEmpty());
+}
+
+TEST_F(Backup_MovedTest, BackupIndex_ParentMissingOrCycle_ReturnEmpty) {
+	WritePreviousIndex({{0x7F000051, 0x7F000052, L"A"}, {0x7F000052, 0x7F000051, L"B"}, {0x7F000053, 0x7F000054, L"C"}});
+
+	const BackupIndex index(kPreviousIndex);
+
+	EXPECT_THAT(index.GetLocation(ToFileId(0x7F000051)), t::IsEmpty());
+	EXPECT_THAT(index.GetLocation(ToFileId(0x7F000053)), t::IsEmpty());
+}
+
+TEST_F(Backup_MovedTest, BackupIndex_CountExceedsFileSize_ThrowException) {
+	// magic, version and a count of 1000 entries without any entries
+	const std::uint32_t header[] = {0x49425453, 1, 1000, 0};
+	ASSERT_NO_THROW(TestUtils::WriteTestFile(kPreviousIndex, header, sizeof(header)));
+
+	EXPECT_THROW(BackupIndex index(kPreviousIndex), std::exception);
+}
+
+//
+// Progress
+//
+TEST_F(Backup_Test, CreateBackup_EnableProgress_ReportFinalProgress) {
+	using namespace std::literals::chrono_literals;
+
+	auto folder = Folder(L"Folder").src().enablePathFunctions().ref().dst();
+	auto file = File(L"Renamed").src().size(42).creationTime(1000001).lastWriteTime(1000002).content("changed");
+	auto original = File(L"Original").disableExpect().ref().size(42).creationTime(1000001).lastWriteTime(1000002);
+	m_root.children(folder);
+	folder.children(file, original);
+
+	EXPECT_CALL(m_strategy, Compare(file.srcPath(), original.refPath(), t::_));
+
+	std::vector<Progress::Snapshot> snapshots;
+	RunVerified({folder.srcPath()}, [this, &snapshots](const auto& backupFolders) {
+		Backup backup(m_strategy);
+		backup.EnableProgress(1h, [&snapshots](const Progress::Snapshot& snapshot) {
+			snapshots.push_back(snapshot);
+		});
+		return backup.CreateBackup(backupFolders, m_ref, m_dst);
+	});
+
+	ASSERT_THAT(snapshots, t::SizeIs(1));
+	EXPECT_EQ(1, snapshots[0].GetDirectories());
+	EXPECT_EQ(1, snapshots[0].GetFiles());
+	EXPECT_EQ(0, snapshots[0].GetFilesDeleted());
+	// the mocked strategy does not use the comparer which counts the bytes actually compared
+	EXPECT_EQ(0, snapshots[0].GetBytesCompared());
+	EXPECT_EQ(42, snapshots[0].GetBytesCopied());
+	EXPECT_EQ(0, snapshots[0].GetBytesLinked());
+}
+
+TEST_F(Backup_Test, CreateBackup_EnableProgressAndFileOnlyInDst_CountDeletedFile) {
+	using namespace std::literals::chrono_literals;
+
+	auto folder = Folder(L"Folder").src().enablePathFunctions().ref().dst();
+	auto file = File(L"Stale").dst().size(42);
+	m_root.children(folder);
+	folder.children(file);
+
+	std::vector<Progress::Snapshot> snapshots;
+	RunVerified({folder.srcPath()}, [this, &snapshots](const auto& backupFolders) {
+		Backup backup(m_strategy);
+		backup.EnableProgress(1h, [&snapshots](const Progress::Snapshot& snapshot) {
+			snapshots.push_back(snapshot);
+		});
+		return backup.CreateBackup(backupFolders, m_ref, m_dst);
+	});
+
+	EXPECT_THAT(Files(), t::Not(t::Contains(t::Key(file.dstPath()))));
+	ASSERT_THAT(snapshots, t::SizeIs(1));
+	EXPECT_EQ(0, snapshots[0].GetFiles());
+	EXPECT_EQ(1, snapshots[0].GetFilesDeleted());
+	EXPECT_EQ(0, snapshots[0].GetBytesCompared());
+}
+
+//
+// Large files
+//
+TEST_F(Backup_Test, CreateBackup_LargeFileChanged_Update) {
+	constexpr std::uint64_t kSize = 128ULL * 1024 * 1024;
+	auto folder = Folder(L"Folder").src().enablePathFunctions().ref().dst();
+	auto file = File(L"Large").disableExpect().src().dst().size(kSize).change().src().lastWriteTime(1000003).content("changed");
+	m_root.children(folder);
+	folder.children(file);
+
+	EXPECT_CALL(m_strategy, Update(file.srcPath(), file.dstPath(), t::_));
+	EXPECT_CALL(m_strategy, SetAttributes(file.dstPath(), t::Property(&ScannedFile::GetLastWriteTime, 1000003)));
+
+	const Backup::Statistics statistics = VerifyBackup({folder.srcPath()});
+
+	EXPECT_EQ(1, statistics.GetUpdated().GetFiles());
+	EXPECT_EQ(0, statistics.GetReplaced().GetFiles());
+	EXPECT_EQ(kSize, statistics.GetBytesCopied());
+}
+
+TEST_F(Backup_Test, CreateBackup_LargeFileChangedAndHardLink_CloneAndUpdate) {
+	constexpr std::uint64_t kSize = 128ULL * 1024 * 1024;
+	auto folder = Folder(L"Folder").src().enablePathFunctions().ref().dst();
+	auto file = File(L"Large").disableExpect().src().ref().dst().size(kSize).change().ref().dst().fileId(1000004).change().src().lastWriteTime(1000003).content("changed");
+	m_root.children(folder);
+	folder.children(file);
+
+	EXPECT_CALL(m_strategy, Delete(file.dstPath()));
+	EXPECT_CALL(m_strategy, Clone(file.refPath(), file.dstPath(), t::_));
+	EXPECT_CALL(m_strategy, Update(file.srcPath(), file.dstPath(), t::_));
+	EXPECT_CALL(m_strategy, SetAttributes(file.dstPath(), t::Property(&ScannedFile::GetLastWriteTime, 1000003)));
+
+	const Backup::Statistics statistics = VerifyBackup({folder.srcPath()});
+
+	EXPECT_EQ(1, statistics.GetReplaced().GetFiles());
+	EXPECT_EQ(kSize, statistics.GetBytesCopied());
+}
+
+TEST_F(Backup_Test, CreateBackup_LargeFileChangedSinceRef_CloneAndUpdate) {
+	constexpr std::uint64_t kSize = 128ULL * 1024 * 1024;
+	auto folder = Folder(L"Folder").src().enablePathFunctions().ref().dst();
+	auto file = File(L"Large").disableExpect().src().ref().size(kSize).change().src().lastWriteTime(1000003).content("changed");
+	m_root.children(folder);
+	folder.children(file);
+
+	EXPECT_CALL(m_strategy, Clone(file.refPath(), file.dstPath(), t::_));
+	EXPECT_CALL(m_strategy, Update(file.srcPath(), file.dstPath(), t::_));
+	EXPECT_CALL(m_strategy, SetAttributes(file.dstPath(), t::Property(&ScannedFile::GetLastWriteTime, 1000003)));
+
+	const Backup::Statistics statistics = VerifyBackup({folder.srcPath()});
+
+	EXPECT_EQ(1, statistics.GetAdded().GetFiles());
+	EXPECT_EQ(kSize, statistics.GetBytesCopied());
+}
+
+TEST_F(Backup_Test, CreateBackup_LargeFileChangedSinceRefAndCloneNotSupported_Copy) {
+	constexpr std::uint64_t kSize = 128ULL * 1024 * 1024;
+	auto folder = Folder(L"Folder").src().enablePathFunctions().ref().dst();
+	auto file = File(L"Large").disableExpect().src().ref().size(kSize).change().src().lastWriteTime(1000003).content("changed");
+	m_root.children(folder);
+	folder.children(file);
+
+	EXPECT_CALL(m_strategy, Clone(file.refPath(), file.dstPath(), t::_))
+		.WillOnce(t::Return(false));
+	EXPECT_CALL(m_strategy, Update(t::_, t::_, t::_))
+		.Times(0);
+	EXPECT_CALL(m_strategy, Copy(file.srcPath(), file.dstPath(), t::_, false));
+	EXPECT_CALL(m_strategy, SetAttributes(file.dstPath(), t::Property(&ScannedFile::GetLastWriteTime, 1000003)));
+
+	const Backup::Statistics statistics = VerifyBackup({folder.srcPath()});
+
+	EXPECT_EQ(1, statistics.GetAdded().GetFiles());
+	EXPECT_EQ(kSize, statistics.GetBytesCopied());
+}
+
 //
 // Missing root target folder
 //
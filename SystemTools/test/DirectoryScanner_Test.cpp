@@ -37,6 +37,7 @@ limitations under the License.
 #include <algorithm>
 #include <atomic>
 #include <chrono>
+#include <cstddef>
 #include <cstdint>
 #include <cstring>
 #include <functional>
@@ -75,9 +76,13 @@ namespace dtgm = detours_gmock;
 		(HANDLE hFindStream, LPVOID lpFindStreamData),                                                                                                                                                        \
 		(hFindStream, lpFindStreamData),                                                                                                                                                                      \
 		nullptr);                                                                                                                                                                                             \
-	fn_(1, DWORD, WINAPI, GetFileAttributesW,                                                                                                                                                                 \
-		(LPCWSTR lpFileName),                                                                                                                                                                                 \
-		(lpFileName),                                                                                                                                                                                         \
+	fn_(6, HANDLE, WINAPI, OpenFileById,                                                                                                                                                                      \
+		(HANDLE hVolumeHint, LPFILE_ID_DESCRIPTOR lpFileId, DWORD dwDesiredAccess, DWORD dwShareMode, LPSECURITY_ATTRIBUTES lpSecurityAttributes, DWORD dwFlagsAndAttributes),                                \
+		(hVolumeHint, lpFileId, dwDesiredAccess, dwShareMode, lpSecurityAttributes, dwFlagsAndAttributes),                                                                                                    \
+		nullptr);                                                                                                                                                                                             \
+	fn_(8, DWORD, WINAPI, GetSecurityInfo,                                                                                                                                                                    \
+		(HANDLE handle, SE_OBJECT_TYPE ObjectType, SECURITY_INFORMATION SecurityInfo, PSID * ppsidOwner, PSID * ppsidGroup, PACL * ppDacl, PACL * ppSacl, PSECURITY_DESCRIPTOR * ppSecurityDescriptor),       \
+		(handle, ObjectType, SecurityInfo, ppsidOwner, ppsidGroup, ppDacl, ppSacl, ppSecurityDescriptor),                                                                                                     \
 		nullptr);                                                                                                                                                                                             \
 	fn_(8, DWORD, WINAPI, GetNamedSecurityInfoW,                                                                                                                                                              \
 		(LPCWSTR pObjectName, SE_OBJECT_TYPE ObjectType, SECURITY_INFORMATION SecurityInfo, PSID * ppsidOwner, PSID * ppsidGroup, PACL * ppDacl, PACL * ppSacl, PSECURITY_DESCRIPTOR * ppSecurityDescriptor), \
@@ -144,6 +149,14 @@ MATCHER(ScannedFileHasSecurity, "") {
 	return !!arg.GetSecurity().pSecurityDescriptor;
 }
 
+#pragma warning(suppress : 4100)
+MATCHER_P(FileIdDescriptorIs, fileId, "") {
+	static_assert(std::is_convertible_v<arg_type, LPFILE_ID_DESCRIPTOR>);
+	static_assert(std::is_convertible_v<fileId_type, const FILE_ID_128 &>);
+
+	return arg->Type == ExtendedFileIdType && std::memcmp(&arg->ExtendedFileId, &fileId, sizeof(FILE_ID_128)) == 0;
+}
+
 enum class Flags {
 	kNone,
 	kFolderStreams,
@@ -207,6 +220,11 @@ protected:
 		}
 		m_hFind = handle;
 
+		if (!DuplicateHandle(GetCurrentProcess(), hMutex, GetCurrentProcess(), &handle, 0, FALSE, DUPLICATE_SAME_ACCESS)) {
+			THROW(m3c::windows_exception(GetLastError()), "DuplicateHandle");
+		}
+		m_hFile = handle;
+
 		ON_CALL(m_win32, CreateFileW(t::Eq(m_path), DTGM_ARG6))
 			.WillByDefault(WITH_LATENCY(5ms, 15ms, t::WithoutArgs([this]() noexcept {
 											++m_openHandles;
@@ -231,13 +249,19 @@ protected:
 				return FALSE;
 			}));
 
-		ON_CALL(m_win32, GetFileAttributesW(t::StartsWith(m_path)))
+		ON_CALL(m_win32, GetFileInformationByHandleEx(m_hFile.get(), FileStreamInfo, DTGM_ARG2))
+			.WillByDefault(t::InvokeWithoutArgs([]() noexcept {
+				SetLastError(ERROR_FILE_INVALID);
+				return FALSE;
+			}));
+
+		ON_CALL(m_win32, OpenFileById(m_hDirectory.get(), DTGM_ARG5))
 			.WillByDefault(t::InvokeWithoutArgs([]() noexcept {
 				SetLastError(ERROR_FILE_INVALID);
-				return INVALID_FILE_ATTRIBUTES;
+				return INVALID_HANDLE_VALUE;
 			}));
 
-		ON_CALL(m_win32, GetNamedSecurityInfoW(t::StartsWith(m_path), SE_FILE_OBJECT, DTGM_ARG6))
+		ON_CALL(m_win32, GetSecurityInfo(m_hFile.get(), SE_FILE_OBJECT, DTGM_ARG6))
 			.WillByDefault(t::InvokeWithoutArgs([]() noexcept {
 				return ERROR_FILE_INVALID;
 			}));
@@ -248,6 +272,12 @@ protected:
 											return TRUE;
 										})));
 
+		ON_CALL(m_win32, CloseHandle(m_hFile.get()))
+			.WillByDefault(t::WithoutArgs([this]() noexcept {
+				--m_openHandles;
+				return TRUE;
+			}));
+
 		ON_CALL(m_win32, FindClose(m_hFind.get()))
 			.WillByDefault(t::WithoutArgs([this]() noexcept {
 				--m_openHandles;
@@ -266,10 +296,60 @@ protected:
 	const std::wstring m_path = LR"(\\?\Volume{23220209-1205-1000-8000-0000000001}\test)";
 	m3c::Handle m_hDirectory;
 	m3c::Handle m_hFind;
+	m3c::Handle m_hFile;
 	std::atomic_uint32_t m_openHandles = 0;
 };
 
 using DirectoryScanner_ErrorTest = DirectoryScanner_Test;
+using DirectoryScanner_ChunkTest = DirectoryScanner_Test;
+
+
+//
+// ScannedFile
+//
+
+namespace {
+
+ScannedFile MakeScannedFile(const wchar_t* const name) {
+	return ScannedFile(Filename(name), {.QuadPart = 0}, {.QuadPart = 0}, {.QuadPart = 0}, FILE_ATTRIBUTE_NORMAL, FILE_ID_128{}, {});
+}
+
+}  // namespace
+
+TEST(ScannedFile_Test, CompareName_DifferentPrefix_CompareSameAsName) {
+	const ScannedFile file = MakeScannedFile(L"foo");
+
+	EXPECT_TRUE(file.CompareName(MakeScannedFile(L"bar")) > 0);
+	EXPECT_TRUE(file.CompareName(MakeScannedFile(L"zar")) < 0);
+	EXPECT_TRUE(file.CompareName(MakeScannedFile(L"fo")) > 0);
+	EXPECT_TRUE(file.CompareName(MakeScannedFile(L"fooo")) < 0);
+	EXPECT_TRUE(file.CompareName(MakeScannedFile(L"_")) < 0);
+	EXPECT_TRUE(MakeScannedFile(L"Z").CompareName(MakeScannedFile(L"[")) < 0);
+}
+
+TEST(ScannedFile_Test, CompareName_DifferentCase_CompareEqual) {
+	const ScannedFile file = MakeScannedFile(L"Foo-Bar.txt");
+
+	EXPECT_TRUE(file.CompareName(MakeScannedFile(L"fOO-bAR.TXT")) == 0);
+	EXPECT_TRUE(file.CompareName(file) == 0);
+}
+
+TEST(ScannedFile_Test, CompareName_SamePrefix_CompareSameAsName) {
+	const ScannedFile file = MakeScannedFile(L"foo-bar");
+
+	EXPECT_TRUE(file.CompareName(MakeScannedFile(L"FOO-BAZ")) < 0);
+	EXPECT_TRUE(file.CompareName(MakeScannedFile(L"FOO-BA")) > 0);
+	EXPECT_TRUE(file.CompareName(MakeScannedFile(L"foo-")) > 0);
+}
+
+TEST(ScannedFile_Test, CompareName_NonAsciiInPrefix_CompareSameAsName) {
+	const ScannedFile file = MakeScannedFile(L"\u00C4foo");  // C4 == A umlaut
+
+	EXPECT_TRUE(file.CompareName(MakeScannedFile(L"\u00E4FOO")) == 0);  // E4 == a umlaut
+	EXPECT_TRUE(file.CompareName(MakeScannedFile(L"zoo")) > 0);
+	EXPECT_TRUE(MakeScannedFile(L"zoo").CompareName(file) < 0);
+	EXPECT_TRUE(file.CompareName(MakeScannedFile(L"\u00C4fop")) < 0);
+}
 
 
 //
@@ -535,8 +615,9 @@ TEST_P(DirectoryScanner_Test, Scan_DirectoriesFiles_ReturnResult) {
 
 		std::uint16_t dirRemaining = dirCount;
 		std::uint16_t fileRemaining = fileCount;
-		std::unordered_map<Path, std::pair<std::size_t, std::vector<std::pair<std::wstring, std::uint64_t>>>> streams;
-		Path currentFindPath(L"Q:\\");
+		std::size_t securityCount = 0;
+		std::unordered_map<Path, std::vector<std::pair<std::wstring, std::uint64_t>>> streams;
+		Path currentPath(L"Q:\\");
 
 		for (std::size_t i = 0; i < size; ++i) {
 			const bool isDirectory = i < 2 || ((i % 2) && dirRemaining > 0) || fileRemaining == 0;
@@ -572,69 +653,74 @@ TEST_P(DirectoryScanner_Test, Scan_DirectoriesFiles_ReturnResult) {
 			}
 			const Path path(rootPath, name);
 
-			std::pair<std::size_t, std::vector<std::pair<std::wstring, std::uint64_t>>> &findEntries = streams[path];
+			std::vector<std::pair<std::wstring, std::uint64_t>> &streamEntries = streams[path];
 			if (!isDirectory) {
-				findEntries.second.emplace_back(L"::$DATA", dirInfo[i].EndOfFile.QuadPart);
-				if (fileRemaining % 3 == 1 && id != kSkipIndex + 5) {
-					findEntries.second.emplace_back(L":stream0:$DATA", 13);
-					EXPECT_CALL(m_win32, GetFileAttributesW(t::StrEq(path.c_str() + findEntries.second.back().first)))
-						.WillOnce(t::Return(FILE_ATTRIBUTE_COMPRESSED));
+				streamEntries.emplace_back(L"::$DATA", dirInfo[i].EndOfFile.QuadPart);
+				if (fileRemaining % 3 == 1) {
+					streamEntries.emplace_back(L":stream0:$DATA", 13);
 				}
-				if (fileRemaining % 4 == 1 && id != kSkipIndex + 5) {
-					findEntries.second.emplace_back(L":stream1:$DATA", 14);
-					EXPECT_CALL(m_win32, GetFileAttributesW(t::StrEq(path.c_str() + findEntries.second.back().first)))
-						.WillOnce(t::Return(FILE_ATTRIBUTE_NORMAL));
+				if (fileRemaining % 4 == 1) {
+					streamEntries.emplace_back(L":stream1:$DATA", 14);
 				}
-			} else if (dirRemaining % 3 == 1 && folderStreams && id != kSkipIndex + 5) {
-				findEntries.second.emplace_back(L":dirstream:$DATA", 10);
-				EXPECT_CALL(m_win32, GetFileAttributesW(t::StrEq(path.c_str() + findEntries.second.back().first)))
-					.WillOnce(t::Return(FILE_ATTRIBUTE_NORMAL));
-			}
-			if (((isDirectory && folderSecurity) || (!isDirectory && fileSecurity)) && id != kSkipIndex + 5) {
-				// security is read after filter
-				EXPECT_CALL(m_win32, GetNamedSecurityInfoW(t::StrEq(path.c_str()), SE_FILE_OBJECT, DTGM_ARG6))
-					.WillOnce(WITH_LATENCY(5ms, 10ms, ([](t::Unused, t::Unused, t::Unused, t::Unused, t::Unused, t::Unused, t::Unused, PSECURITY_DESCRIPTOR *ppSecurityDescriptor) -> DWORD {
-											   if (ConvertStringSecurityDescriptorToSecurityDescriptorA("O:BAG:BAD:(A;;FR;;;CO)", SDDL_REVISION_1, ppSecurityDescriptor, nullptr)) {
-												   return ERROR_SUCCESS;
-											   }
-											   return GetLastError();
-										   })));
+			} else if (dirRemaining % 3 == 1 && folderStreams) {
+				streamEntries.emplace_back(L":dirstream:$DATA", 10);
 			}
 
-			if (!isDirectory || folderStreams) {
-				EXPECT_CALL(m_win32, FindFirstStreamW(t::StrEq(path.c_str()), FindStreamInfoStandard, t::_, 0))
-					.WillRepeatedly(WITH_LATENCY(5ms, 10ms, ([this, &streams, &currentFindPath](LPCWSTR lpFileName, t::Unused, LPVOID lpFindStreamData, t::Unused) {
-													 // store current path and reset index
-													 currentFindPath = Path(lpFileName);
-													 std::pair<std::size_t, std::vector<std::pair<std::wstring, std::uint64_t>>> &findEntries = streams.at(currentFindPath);
-													 findEntries.first = 0;
-
-													 if (findEntries.first >= findEntries.second.size()) {
-														 SetLastError(ERROR_HANDLE_EOF);
-														 return INVALID_HANDLE_VALUE;
-													 }
-
-													 WIN32_FIND_STREAM_DATA *const pStream = reinterpret_cast<WIN32_FIND_STREAM_DATA *>(lpFindStreamData);
-													 pStream->StreamSize.QuadPart = findEntries.second[findEntries.first].second;
-													 COM_HR(StringCbCopyW(pStream->cStreamName, sizeof(WIN32_FIND_STREAM_DATA::cStreamName), findEntries.second[findEntries.first].first.c_str()), "StringCbCopyW");
-													 ++m_openHandles;
-													 return m_hFind.get();
-												 })));
+			const bool readStreams = !isDirectory || folderStreams;
+			const bool readSecurity = (isDirectory && folderSecurity) || (!isDirectory && fileSecurity);
+			if ((readStreams || readSecurity) && id != kSkipIndex + 5) {
+				// streams and security are read after filter using a single handle opened by id
+				EXPECT_CALL(m_win32, OpenFileById(m_hDirectory.get(), FileIdDescriptorIs(dirInfo[i].FileId), DTGM_ARG4))
+					.WillOnce(t::WithoutArgs([this, &currentPath, path]() {
+						// store current path for reading the streams
+						currentPath = path;
+						++m_openHandles;
+						return m_hFile.get();
+					}));
+				if (readSecurity) {
+					++securityCount;
+				}
 			}
 		}
 
-		EXPECT_CALL(m_win32, FindNextStreamW(m_hFind.get(), t::_))
-			.WillRepeatedly(WITH_LATENCY(5ms, 10ms, ([this, &streams, &currentFindPath](t::Unused, LPVOID lpFindStreamData) {
-											 std::pair<std::size_t, std::vector<std::pair<std::wstring, std::uint64_t>>> &findEntries = streams.at(currentFindPath);
-											 ++findEntries.first;
-											 if (findEntries.first >= findEntries.second.size()) {
+		EXPECT_CALL(m_win32, GetSecurityInfo(m_hFile.get(), SE_FILE_OBJECT, DTGM_ARG6))
+			.Times(static_cast<int>(securityCount))
+			.WillRepeatedly(WITH_LATENCY(5ms, 10ms, ([](t::Unused, t::Unused, t::Unused, t::Unused, t::Unused, t::Unused, t::Unused, PSECURITY_DESCRIPTOR *ppSecurityDescriptor) -> DWORD {
+											 if (ConvertStringSecurityDescriptorToSecurityDescriptorA("O:BAG:BAD:(A;;FR;;;CO)", SDDL_REVISION_1, ppSecurityDescriptor, nullptr)) {
+												 return ERROR_SUCCESS;
+											 }
+											 return GetLastError();
+										 })));
+
+		EXPECT_CALL(m_win32, GetFileInformationByHandleEx(m_hFile.get(), FileStreamInfo, DTGM_ARG2))
+			.WillRepeatedly(WITH_LATENCY(5ms, 10ms, ([&streams, &currentPath](t::Unused, t::Unused, LPVOID lpFileInformation, DWORD dwBufferSize) {
+											 const std::vector<std::pair<std::wstring, std::uint64_t>> &streamEntries = streams.at(currentPath);
+											 if (streamEntries.empty()) {
 												 SetLastError(ERROR_HANDLE_EOF);
 												 return FALSE;
 											 }
 
-											 WIN32_FIND_STREAM_DATA *const pStream = reinterpret_cast<WIN32_FIND_STREAM_DATA *>(lpFindStreamData);
-											 pStream->StreamSize.QuadPart = findEntries.second[findEntries.first].second;
-											 COM_HR(StringCbCopyW(pStream->cStreamName, sizeof(WIN32_FIND_STREAM_DATA::cStreamName), findEntries.second[findEntries.first].first.c_str()), "StringCbCopyW");
+											 std::size_t offset = 0;
+											 FILE_STREAM_INFO *pPrevious = nullptr;
+											 for (const auto &[name, size] : streamEntries) {
+												 // entries are aligned at 8 byte boundaries
+												 const std::size_t entrySize = (offsetof(FILE_STREAM_INFO, StreamName) + name.size() * sizeof(wchar_t) + 7) & ~std::size_t(7);
+												 if (offset + entrySize > dwBufferSize) {
+													 SetLastError(ERROR_MORE_DATA);
+													 return FALSE;
+												 }
+												 FILE_STREAM_INFO *const pStream = reinterpret_cast<FILE_STREAM_INFO *>(static_cast<std::byte *>(lpFileInformation) + offset);
+												 pStream->NextEntryOffset = 0;
+												 pStream->StreamNameLength = static_cast<DWORD>(name.size() * sizeof(wchar_t));
+												 pStream->StreamSize.QuadPart = static_cast<LONGLONG>(size);
+												 pStream->StreamAllocationSize.QuadPart = static_cast<LONGLONG>(size);
+												 std::memcpy(pStream->StreamName, name.data(), name.size() * sizeof(wchar_t));
+												 if (pPrevious) {
+													 pPrevious->NextEntryOffset = static_cast<DWORD>(reinterpret_cast<std::byte *>(pStream) - reinterpret_cast<std::byte *>(pPrevious));
+												 }
+												 pPrevious = pStream;
+												 offset += entrySize;
+											 }
 											 return TRUE;
 										 })));
 
@@ -773,6 +859,227 @@ TEST_P(DirectoryScanner_ErrorTest, Scan_ErrorReadingDirectory_ThrowException) {
 	}
 }
 
+TEST_P(DirectoryScanner_ErrorTest, Scan_OpenByIdNotSupported_ReadSecurityByPath) {
+	struct entry : FILE_ID_EXTD_DIR_INFO {
+		wchar_t paddingForName[0x1000];
+	};
+
+	const std::wstring name = L"dir_0";
+	const Path path(Path(m_path), name);
+	for (MaxRunsType run = 0, maxRuns = GetMaxRuns(); run < maxRuns; ++run) {
+		entry dirInfo;
+		ZeroMemory(&dirInfo, sizeof(entry));
+		dirInfo.FileAttributes = FILE_ATTRIBUTE_DIRECTORY;
+		COM_HR(StringCbCopyW(dirInfo.FileName, sizeof(entry::paddingForName) + sizeof(entry::FileName), name.c_str()), "StringCbCopyW {}", name);
+		dirInfo.FileNameLength = static_cast<ULONG>(name.size() * sizeof(wchar_t));
+
+		EXPECT_CALL(m_win32, GetFileInformationByHandleEx(m_hDirectory.get(), FileIdExtdDirectoryInfo, DTGM_ARG2))
+			.WillOnce([&dirInfo](t::Unused, t::Unused, LPVOID lpFileInformation, t::Unused) noexcept {
+				CopyMemory(lpFileInformation, &dirInfo, sizeof(entry));
+				return TRUE;
+			})
+			.WillOnce(dtgm::SetLastErrorAndReturn(ERROR_NO_MORE_FILES, FALSE));
+		EXPECT_CALL(m_win32, OpenFileById(m_hDirectory.get(), DTGM_ARG5))
+			.WillOnce(dtgm::SetLastErrorAndReturn(ERROR_INVALID_PARAMETER, INVALID_HANDLE_VALUE));
+		EXPECT_CALL(m_win32, GetNamedSecurityInfoW(t::StrEq(path.c_str()), SE_FILE_OBJECT, DTGM_ARG6))
+			.WillOnce([](t::Unused, t::Unused, t::Unused, t::Unused, t::Unused, t::Unused, t::Unused, PSECURITY_DESCRIPTOR *ppSecurityDescriptor) -> DWORD {
+				if (ConvertStringSecurityDescriptorToSecurityDescriptorA("O:BAG:BAD:(A;;FR;;;CO)", SDDL_REVISION_1, ppSecurityDescriptor, nullptr)) {
+					return ERROR_SUCCESS;
+				}
+				return GetLastError();
+			});
+
+		DirectoryScanner scanner;
+
+		DirectoryScanner::Result directories;
+		DirectoryScanner::Result files;
+		scanner.Scan(Path(m_path), directories, files, DirectoryScanner::Flags::kFolderSecurity, kAcceptAllScannerFilter);
+		scanner.Wait();
+
+		EXPECT_THAT(directories, t::ElementsAre(ScannedFileHasSecurity()));
+		EXPECT_THAT(files, t::IsEmpty());
+	}
+}
+
+TEST_P(DirectoryScanner_ErrorTest, Scan_OpenByIdNotSupported_ReadStreamsByPath) {
+	struct entry : FILE_ID_EXTD_DIR_INFO {
+		wchar_t paddingForName[0x1000];
+	};
+
+	const std::wstring name = L"file_0.ext";
+	const Path path(Path(m_path), name);
+	for (MaxRunsType run = 0, maxRuns = GetMaxRuns(); run < maxRuns; ++run) {
+		entry dirInfo;
+		ZeroMemory(&dirInfo, sizeof(entry));
+		dirInfo.FileAttributes = FILE_ATTRIBUTE_READONLY;
+		dirInfo.EndOfFile.QuadPart = 100;
+		COM_HR(StringCbCopyW(dirInfo.FileName, sizeof(entry::paddingForName) + sizeof(entry::FileName), name.c_str()), "StringCbCopyW {}", name);
+		dirInfo.FileNameLength = static_cast<ULONG>(name.size() * sizeof(wchar_t));
+
+		EXPECT_CALL(m_win32, GetFileInformationByHandleEx(m_hDirectory.get(), FileIdExtdDirectoryInfo, DTGM_ARG2))
+			.WillOnce([&dirInfo](t::Unused, t::Unused, LPVOID lpFileInformation, t::Unused) noexcept {
+				CopyMemory(lpFileInformation, &dirInfo, sizeof(entry));
+				return TRUE;
+			})
+			.WillOnce(dtgm::SetLastErrorAndReturn(ERROR_NO_MORE_FILES, FALSE));
+		EXPECT_CALL(m_win32, OpenFileById(m_hDirectory.get(), DTGM_ARG5))
+			.WillOnce(dtgm::SetLastErrorAndReturn(ERROR_INVALID_PARAMETER, INVALID_HANDLE_VALUE));
+		EXPECT_CALL(m_win32, FindFirstStreamW(t::StrEq(path.c_str()), FindStreamInfoStandard, t::_, 0))
+			.WillOnce([this](t::Unused, t::Unused, LPVOID lpFindStreamData, t::Unused) {
+				WIN32_FIND_STREAM_DATA *const pStream = reinterpret_cast<WIN32_FIND_STREAM_DATA *>(lpFindStreamData);
+				pStream->StreamSize.QuadPart = 100;
+				COM_HR(StringCbCopyW(pStream->cStreamName, sizeof(WIN32_FIND_STREAM_DATA::cStreamName), L"::$DATA"), "StringCbCopyW");
+				++m_openHandles;
+				return m_hFind.get();
+			});
+		EXPECT_CALL(m_win32, FindNextStreamW(m_hFind.get(), t::_))
+			.WillOnce([](t::Unused, LPVOID lpFindStreamData) {
+				WIN32_FIND_STREAM_DATA *const pStream = reinterpret_cast<WIN32_FIND_STREAM_DATA *>(lpFindStreamData);
+				pStream->StreamSize.QuadPart = 13;
+				COM_HR(StringCbCopyW(pStream->cStreamName, sizeof(WIN32_FIND_STREAM_DATA::cStreamName), L":stream:$DATA"), "StringCbCopyW");
+				return TRUE;
+			})
+			.WillOnce(dtgm::SetLastErrorAndReturn(ERROR_HANDLE_EOF, FALSE));
+
+		DirectoryScanner scanner;
+
+		DirectoryScanner::Result directories;
+		DirectoryScanner::Result files;
+		scanner.Scan(Path(m_path), directories, files, DirectoryScanner::Flags::kDefault, kAcceptAllScannerFilter);
+		scanner.Wait();
+
+		EXPECT_THAT(directories, t::IsEmpty());
+		ASSERT_THAT(files, t::SizeIs(1));
+		ASSERT_THAT(files[0].GetStreams(), t::SizeIs(1));
+		EXPECT_EQ(L":stream:$DATA", files[0].GetStreams()[0].GetName().sv());
+		EXPECT_EQ(13Ui64, files[0].GetStreams()[0].GetSize());
+		EXPECT_EQ(static_cast<std::uint32_t>(FILE_ATTRIBUTE_READONLY), files[0].GetStreams()[0].GetAttributes());
+	}
+}
+
+TEST_P(DirectoryScanner_ErrorTest, Scan_ErrorOpeningById_ThrowException) {
+	struct entry : FILE_ID_EXTD_DIR_INFO {
+		wchar_t paddingForName[0x1000];
+	};
+
+	const std::wstring name = L"dir_0";
+	for (MaxRunsType run = 0, maxRuns = GetMaxRuns(); run < maxRuns; ++run) {
+		entry dirInfo;
+		ZeroMemory(&dirInfo, sizeof(entry));
+		dirInfo.FileAttributes = FILE_ATTRIBUTE_DIRECTORY;
+		COM_HR(StringCbCopyW(dirInfo.FileName, sizeof(entry::paddingForName) + sizeof(entry::FileName), name.c_str()), "StringCbCopyW {}", name);
+		dirInfo.FileNameLength = static_cast<ULONG>(name.size() * sizeof(wchar_t));
+
+		EXPECT_CALL(m_win32, GetFileInformationByHandleEx(m_hDirectory.get(), FileIdExtdDirectoryInfo, DTGM_ARG2))
+			.WillOnce([&dirInfo](t::Unused, t::Unused, LPVOID lpFileInformation, t::Unused) noexcept {
+				CopyMemory(lpFileInformation, &dirInfo, sizeof(entry));
+				return TRUE;
+			});
+		EXPECT_CALL(m_win32, OpenFileById(m_hDirectory.get(), DTGM_ARG5))
+			.WillOnce(dtgm::SetLastErrorAndReturn(ERROR_ACCESS_DENIED, INVALID_HANDLE_VALUE));
+		EXPECT_CALL(m_win32, GetNamedSecurityInfoW(t::_, t::_, t::_, t::_, t::_, t::_, t::_, t::_))
+			.Times(0);
+
+		DirectoryScanner scanner;
+
+		DirectoryScanner::Result directories;
+		DirectoryScanner::Result files;
+		scanner.Scan(Path(m_path), directories, files, DirectoryScanner::Flags::kFolderSecurity, kAcceptAllScannerFilter);
+		EXPECT_THROW(scanner.Wait(), m3c::windows_exception);
+	}
+}
+
+TEST_P(DirectoryScanner_ChunkTest, Scan_Chunked_PauseAfterChunk) {
+	struct entry : FILE_ID_EXTD_DIR_INFO {
+		wchar_t paddingForName[0x1000];
+	};
+
+	for (MaxRunsType run = 0, maxRuns = GetMaxRuns(); run < maxRuns; ++run) {
+		entry dirInfo[2];
+		for (std::size_t i = 0; i < std::size(dirInfo); ++i) {
+			const std::wstring name = fmt::format(L"dir_{}", i);
+			ZeroMemory(&dirInfo[i], sizeof(entry));
+			dirInfo[i].FileAttributes = FILE_ATTRIBUTE_DIRECTORY;
+			COM_HR(StringCbCopyW(dirInfo[i].FileName, sizeof(entry::paddingForName) + sizeof(entry::FileName), name.c_str()), "StringCbCopyW {}", name);
+			dirInfo[i].FileNameLength = static_cast<ULONG>(name.size() * sizeof(wchar_t));
+		}
+
+		EXPECT_CALL(m_win32, GetFileInformationByHandleEx(m_hDirectory.get(), FileIdExtdDirectoryInfo, DTGM_ARG2))
+			.WillOnce([&dirInfo](t::Unused, t::Unused, LPVOID lpFileInformation, t::Unused) noexcept {
+				CopyMemory(lpFileInformation, &dirInfo[0], sizeof(entry));
+				return TRUE;
+			})
+			.WillOnce([&dirInfo](t::Unused, t::Unused, LPVOID lpFileInformation, t::Unused) noexcept {
+				CopyMemory(lpFileInformation, &dirInfo[1], sizeof(entry));
+				return TRUE;
+			})
+			.WillOnce(dtgm::SetLastErrorAndReturn(ERROR_NO_MORE_FILES, FALSE));
+
+		DirectoryScanner scanner(1);
+
+		DirectoryScanner::Result directories;
+		DirectoryScanner::Result files;
+		scanner.Scan(Path(m_path), directories, files, DirectoryScanner::Flags::kChunked, kAcceptAllScannerFilter);
+		scanner.Wait();
+
+		ASSERT_TRUE(scanner.IsPaused());
+		ASSERT_THAT(directories, t::SizeIs(1));
+		EXPECT_EQ(L"dir_0", directories[0].GetName().sv());
+		directories.clear();
+
+		// every call may return another chunk
+		scanner.Continue();
+		scanner.Wait();
+
+		ASSERT_TRUE(scanner.IsPaused());
+		ASSERT_THAT(directories, t::SizeIs(1));
+		EXPECT_EQ(L"dir_1", directories[0].GetName().sv());
+		directories.clear();
+
+		scanner.Continue();
+		scanner.Wait();
+
+		EXPECT_FALSE(scanner.IsPaused());
+		EXPECT_THAT(directories, t::IsEmpty());
+		EXPECT_THAT(files, t::IsEmpty());
+	}
+}
+
+TEST_P(DirectoryScanner_ChunkTest, Scan_ChunkedCancel_StopScan) {
+	struct entry : FILE_ID_EXTD_DIR_INFO {
+		wchar_t paddingForName[0x1000];
+	};
+
+	const std::wstring name = L"dir_0";
+	for (MaxRunsType run = 0, maxRuns = GetMaxRuns(); run < maxRuns; ++run) {
+		entry dirInfo;
+		ZeroMemory(&dirInfo, sizeof(entry));
+		dirInfo.FileAttributes = FILE_ATTRIBUTE_DIRECTORY;
+		COM_HR(StringCbCopyW(dirInfo.FileName, sizeof(entry::paddingForName) + sizeof(entry::FileName), name.c_str()), "StringCbCopyW {}", name);
+		dirInfo.FileNameLength = static_cast<ULONG>(name.size() * sizeof(wchar_t));
+
+		EXPECT_CALL(m_win32, GetFileInformationByHandleEx(m_hDirectory.get(), FileIdExtdDirectoryInfo, DTGM_ARG2))
+			.WillOnce([&dirInfo](t::Unused, t::Unused, LPVOID lpFileInformation, t::Unused) noexcept {
+				CopyMemory(lpFileInformation, &dirInfo, sizeof(entry));
+				return TRUE;
+			});
+		// the remaining entries are not read
+
+		DirectoryScanner scanner(1);
+
+		DirectoryScanner::Result directories;
+		DirectoryScanner::Result files;
+		scanner.Scan(Path(m_path), directories, files, DirectoryScanner::Flags::kChunked, kAcceptAllScannerFilter);
+		scanner.Wait();
+		ASSERT_TRUE(scanner.IsPaused());
+
+		scanner.Cancel();
+
+		EXPECT_FALSE(scanner.IsPaused());
+		EXPECT_THAT(directories, t::SizeIs(1));
+	}
+}
+
 INSTANTIATE_TEST_SUITE_P(DirectoryScanner_Test, DirectoryScanner_Test, t::Combine(t::Values(0, 1, 10, 50), t::Values(0, 1, 10, 50), t::Values(LatencyMode::kSingle, LatencyMode::kLatency, LatencyMode::kRepeat), t::Values(Flags::kNone)), [](const t::TestParamInfo<DirectoryScanner_Test::ParamType> &param) {
 	return fmt::format("{:02}_{}_Directories_{}_Files_{}",
 					   param.index,
@@ -788,6 +1095,10 @@ INSTANTIATE_TEST_SUITE_P(DirectoryScanner_FlagsTest, DirectoryScanner_Test, t::C
 					   std::get<2>(param.param) == LatencyMode::kSingle ? "Single" : (std::get<2>(param.param) == LatencyMode::kLatency ? "Latency" : "Repeat"));
 });
 
+INSTANTIATE_TEST_SUITE_P(DirectoryScanner_ChunkTest, DirectoryScanner_ChunkTest, t::Combine(t::Values(0), t::Values(0), t::Values(LatencyMode::kSingle, LatencyMode::kRepeat), t::Values(Flags::kNone)), [](const t::TestParamInfo<DirectoryScanner_ChunkTest::ParamType> &param) {
+	return fmt::format("{}_{}", param.index, std::get<2>(param.param) == LatencyMode::kSingle ? "Single" : "Repeat");
+});
+
 INSTANTIATE_TEST_SUITE_P(DirectoryScanner_ErrorTest, DirectoryScanner_ErrorTest, t::Combine(t::Values(0), t::Values(0), t::Values(LatencyMode::kSingle, LatencyMode::kRepeat), t::Values(Flags::kNone)), [](const t::TestParamInfo<DirectoryScanner_ErrorTest::ParamType> &param) {
 	return fmt::format("{}_{}", param.index, std::get<2>(param.param) == LatencyMode::kSingle ? "Single" : "Repeat");
 });
@@ -38,7 +38,9 @@ limitations under the License.
 #include <cmath>
 #include <cstdint>
 #include <new>
+#include <optional>
 #include <string>
+#include <thread>
 #include <tuple>
 
 
@@ -59,6 +61,18 @@ namespace dtgm = detours_gmock;
 	fn_(5, BOOL, WINAPI, ReadFile,                                                                                                                                                                 \
 		(HANDLE hFile, LPVOID lpBuffer, DWORD nNumberOfBytesToRead, LPDWORD lpNumberOfBytesRead, LPOVERLAPPED lpOverlapped),                                                                       \
 		(hFile, lpBuffer, nNumberOfBytesToRead, lpNumberOfBytesRead, lpOverlapped),                                                                                                                \
+		nullptr);                                                                                                                                                                                  \
+	fn_(5, BOOL, WINAPI, WriteFile,                                                                                                                                                                \
+		(HANDLE hFile, LPCVOID lpBuffer, DWORD nNumberOfBytesToWrite, LPDWORD lpNumberOfBytesWritten, LPOVERLAPPED lpOverlapped),                                                                  \
+		(hFile, lpBuffer, nNumberOfBytesToWrite, lpNumberOfBytesWritten, lpOverlapped),                                                                                                            \
+		nullptr);                                                                                                                                                                                  \
+	fn_(4, BOOL, WINAPI, GetFileInformationByHandleEx,                                                                                                                                             \
+		(HANDLE hFile, FILE_INFO_BY_HANDLE_CLASS FileInformationClass, LPVOID lpFileInformation, DWORD dwBufferSize),                                                                              \
+		(hFile, FileInformationClass, lpFileInformation, dwBufferSize),                                                                                                                            \
+		nullptr);                                                                                                                                                                                  \
+	fn_(4, BOOL, WINAPI, SetFileInformationByHandle,                                                                                                                                               \
+		(HANDLE hFile, FILE_INFO_BY_HANDLE_CLASS FileInformationClass, LPVOID lpFileInformation, DWORD dwBufferSize),                                                                              \
+		(hFile, FileInformationClass, lpFileInformation, dwBufferSize),                                                                                                                            \
 		nullptr);
 
 #define VOLUME_FUNCTIONS(fn_)                                       \
@@ -104,6 +118,24 @@ ACTION(Eof) {
 	return TRUE;
 }
 
+#pragma warning(suppress : 4100)
+ACTION(Write) {
+	*arg3 = arg2;
+	return TRUE;
+}
+
+#pragma warning(suppress : 4100)
+ACTION_P(NumberOfLinks, links) {
+	static_cast<FILE_STANDARD_INFO*>(arg2)->NumberOfLinks = links;
+	return TRUE;
+}
+
+auto AtOffset(const std::uint64_t offset) {
+	return t::Truly([offset](const OVERLAPPED* const pOverlapped) noexcept {
+		return pOverlapped && pOverlapped->Offset == static_cast<DWORD>(offset) && pOverlapped->OffsetHigh == static_cast<DWORD>(offset >> 32);
+	});
+}
+
 }  // namespace
 
 class FileComparer_BaseTest : public t::TestWithParam<std::tuple<std::uint32_t, std::uint32_t, LatencyMode>>
@@ -142,6 +174,9 @@ protected:
 					return FALSE;
 				}));
 
+			ON_CALL(m_win32, GetFileInformationByHandleEx(m_hFile[i].get(), FileStandardInfo, DTGM_ARG2))
+				.WillByDefault(NumberOfLinks(1));
+
 			ON_CALL(m_win32, CloseHandle(m_hFile[i].get()))
 				.WillByDefault(WITH_LATENCY(4ms, 10ms, t ::WithoutArgs([this]() noexcept {
 												--m_openHandles;
@@ -201,6 +236,8 @@ using FileComparer_EqualDataTest = FileComparer_BaseTest;
 using FileComparer_UnequalDataAtStartTest = FileComparer_BaseTest;
 using FileComparer_UnequalDataAtMiddleTest = FileComparer_BaseTest;
 using FileComparer_UnequalDataAtEndTest = FileComparer_BaseTest;
+using FileComparer_UpdateTest = FileComparer_BaseTest;
+using FileComparer_WaitTimeTest = FileComparer_BaseTest;
 
 //
 // Equal
@@ -234,6 +271,9 @@ TEST_P(FileComparer_EqualDataTest, Compare_EqualData_ReturnResult) {
 		cpyExpectation.WillOnce(WITH_LATENCY(10ms, 30ms, Eof()));
 
 		EXPECT_EQ(srcSize == cpySize, comparer.Compare(Path(kTestFile[0]), Path(kTestFile[1])));
+		if (srcSize == cpySize) {
+			EXPECT_EQ((srcSize + 9) / 10 * FileComparer::kDefaultBufferSize + (srcSize % 10 ? FileComparer::kDefaultBufferSize / 2 : 0), comparer.GetBytesCompared());
+		}
 	}
 }
 
@@ -320,6 +360,8 @@ TEST_P(FileComparer_UnequalDataAtStartTest, Compare_UnequalDataAtStart_ReturnFal
 
 	FileComparer comparer;
 	EXPECT_FALSE(comparer.Compare(Path(kTestFile[0]), Path(kTestFile[1])));
+	// stops after the first buffer
+	EXPECT_LE(comparer.GetBytesCompared(), FileComparer::kDefaultBufferSize);
 }
 
 TEST_P(FileComparer_UnequalDataAtMiddleTest, Compare_UnequalDataAtMiddle_ReturnFalse) {
@@ -380,6 +422,149 @@ TEST_P(FileComparer_UnequalDataAtEndTest, Compare_UnequalDataAtEnd_ReturnFalse)
 	EXPECT_FALSE(comparer.Compare(Path(kTestFile[0]), Path(kTestFile[1])));
 }
 
+//
+// Update
+//
+
+TEST_P(FileComparer_UpdateTest, Update_EqualData_WriteNothing) {
+	using namespace std::literals::chrono_literals;
+
+	const std::uint32_t size = std::get<0>(GetParam());
+
+	auto& srcExpectation = EXPECT_CALL(m_win32, ReadFile(m_hFile[0].get(), DTGM_ARG4))
+							   .Times(t::AnyNumber());
+	auto& cpyExpectation = EXPECT_CALL(m_win32, ReadFile(m_hFile[1].get(), DTGM_ARG4))
+							   .Times(t::AnyNumber());
+	for (std::uint32_t i = 0; i < size; i += 10) {
+		srcExpectation.WillOnce(WITH_LATENCY(10ms, 30ms, Read(0xDEADBEEF)));
+		cpyExpectation.WillOnce(WITH_LATENCY(10ms, 30ms, Read(0xDEADBEEF)));
+	}
+	srcExpectation.WillOnce(WITH_LATENCY(10ms, 30ms, Eof()));
+	cpyExpectation.WillOnce(WITH_LATENCY(10ms, 30ms, Eof()));
+
+	EXPECT_CALL(m_win32, WriteFile(DTGM_ARG5))
+		.Times(0);
+	EXPECT_CALL(m_win32, SetFileInformationByHandle(m_hFile[1].get(), FileEndOfFileInfo, DTGM_ARG2))
+		.WillOnce(t::Return(TRUE));
+
+	FileComparer comparer;
+	EXPECT_THAT(comparer.Update(Path(kTestFile[0]), Path(kTestFile[1])), t::Optional(0u));
+}
+
+TEST_P(FileComparer_UpdateTest, Update_UnequalDataAtMiddle_WriteBlock) {
+	using namespace std::literals::chrono_literals;
+
+	const std::uint32_t size = std::get<0>(GetParam());
+	const std::uint32_t changed = (size / 20) * 10;
+	constexpr std::uint32_t kBufferSize = 0x10000;
+
+	auto& srcExpectation = EXPECT_CALL(m_win32, ReadFile(m_hFile[0].get(), DTGM_ARG4))
+							   .Times(t::AnyNumber());
+	auto& cpyExpectation = EXPECT_CALL(m_win32, ReadFile(m_hFile[1].get(), DTGM_ARG4))
+							   .Times(t::AnyNumber());
+	for (std::uint32_t i = 0; i < size; i += 10) {
+		srcExpectation.WillOnce(WITH_LATENCY(10ms, 30ms, Read(0xDEADBEEF)));
+		cpyExpectation.WillOnce(WITH_LATENCY(10ms, 30ms, Read(i == changed ? 0xBEEFDEAD : 0xDEADBEEF)));
+	}
+	srcExpectation.WillOnce(WITH_LATENCY(10ms, 30ms, Eof()));
+	cpyExpectation.WillOnce(WITH_LATENCY(10ms, 30ms, Eof()));
+
+	EXPECT_CALL(m_win32, WriteFile(m_hFile[1].get(), t::_, kBufferSize, t::_, AtOffset(static_cast<std::uint64_t>(changed / 10) * kBufferSize)))
+		.WillOnce(Write());
+	EXPECT_CALL(m_win32, SetFileInformationByHandle(m_hFile[1].get(), FileEndOfFileInfo, DTGM_ARG2))
+		.WillOnce(t::Return(TRUE));
+
+	FileComparer comparer;
+	EXPECT_THAT(comparer.Update(Path(kTestFile[0]), Path(kTestFile[1])), t::Optional(kBufferSize));
+}
+
+TEST_P(FileComparer_UpdateTest, Update_UnequalDataAtMiddleWithSmallBuffer_WriteBlock) {
+	using namespace std::literals::chrono_literals;
+
+	const std::uint32_t size = std::get<0>(GetParam());
+	const std::uint32_t changed = (size / 20) * 10;
+	// a buffer smaller than the alignment uses a single chunk, i.e. the least common multiple of all alignments
+	constexpr std::uint32_t kBufferSize = 0x1000;
+
+	auto& srcExpectation = EXPECT_CALL(m_win32, ReadFile(m_hFile[0].get(), DTGM_ARG4))
+							   .Times(t::AnyNumber());
+	auto& cpyExpectation = EXPECT_CALL(m_win32, ReadFile(m_hFile[1].get(), DTGM_ARG4))
+							   .Times(t::AnyNumber());
+	for (std::uint32_t i = 0; i < size; i += 10) {
+		srcExpectation.WillOnce(WITH_LATENCY(10ms, 30ms, Read(0xDEADBEEF)));
+		cpyExpectation.WillOnce(WITH_LATENCY(10ms, 30ms, Read(i == changed ? 0xBEEFDEAD : 0xDEADBEEF)));
+	}
+	srcExpectation.WillOnce(WITH_LATENCY(10ms, 30ms, Eof()));
+	cpyExpectation.WillOnce(WITH_LATENCY(10ms, 30ms, Eof()));
+
+	EXPECT_CALL(m_win32, WriteFile(m_hFile[1].get(), t::_, kBufferSize, t::_, AtOffset(static_cast<std::uint64_t>(changed / 10) * kBufferSize)))
+		.WillOnce(Write());
+	EXPECT_CALL(m_win32, SetFileInformationByHandle(m_hFile[1].get(), FileEndOfFileInfo, DTGM_ARG2))
+		.WillOnce(t::Return(TRUE));
+
+	FileComparer comparer(1);
+	EXPECT_THAT(comparer.Update(Path(kTestFile[0]), Path(kTestFile[1])), t::Optional(kBufferSize));
+}
+
+TEST_P(FileComparer_UpdateTest, Update_ErrorReadingFile_DeleteTarget) {
+	using namespace std::literals::chrono_literals;
+
+	EXPECT_CALL(m_win32, ReadFile(m_hFile[0].get(), DTGM_ARG4))
+		.WillRepeatedly(WITH_LATENCY(10ms, 30ms, Read(0xDEADBEEF)));
+	EXPECT_CALL(m_win32, ReadFile(m_hFile[1].get(), DTGM_ARG4))
+		.WillOnce(t::DoDefault());
+	EXPECT_CALL(m_win32, SetFileInformationByHandle(m_hFile[1].get(), FileEndOfFileInfo, DTGM_ARG2))
+		.Times(0);
+	EXPECT_CALL(m_win32, SetFileInformationByHandle(m_hFile[1].get(), FileDispositionInfo, DTGM_ARG2))
+		.WillOnce(t::Return(TRUE));
+
+	FileComparer comparer;
+	EXPECT_THROW(comparer.Update(Path(kTestFile[0]), Path(kTestFile[1])), m3c::windows_exception);
+}
+
+TEST_P(FileComparer_UpdateTest, Update_HardLink_ReturnNullopt) {
+	EXPECT_CALL(m_win32, GetFileInformationByHandleEx(m_hFile[1].get(), FileStandardInfo, DTGM_ARG2))
+		.WillOnce(NumberOfLinks(2));
+	EXPECT_CALL(m_win32, ReadFile(DTGM_ARG5))
+		.Times(0);
+	EXPECT_CALL(m_win32, WriteFile(DTGM_ARG5))
+		.Times(0);
+
+	FileComparer comparer;
+	EXPECT_EQ(std::nullopt, comparer.Update(Path(kTestFile[0]), Path(kTestFile[1])));
+}
+
+//
+// Wait Time
+//
+
+TEST_P(FileComparer_WaitTimeTest, Compare_SlowRead_AddWaitTime) {
+	using namespace std::literals::chrono_literals;
+
+	const std::uint32_t size = std::get<0>(GetParam());
+	const auto slowRead = t::DoAll(t::InvokeWithoutArgs([]() {
+									   std::this_thread::sleep_for(10ms);
+								   }),
+								   Read(0xDEADBEEF));
+	for (std::uint_fast8_t index = 0; index < 2; ++index) {
+		auto& expectation = EXPECT_CALL(m_win32, ReadFile(m_hFile[index].get(), DTGM_ARG4));
+		for (std::uint32_t i = 0; i < size; i += 10) {
+			expectation.WillOnce(slowRead);
+		}
+		expectation.WillOnce(Eof());
+	}
+
+	FileComparer comparer;
+	EXPECT_TRUE(comparer.Compare(Path(kTestFile[0]), Path(kTestFile[1])));
+
+	EXPECT_GE(comparer.GetWaitTime(), 10ms);
+
+	comparer.ResetWaitTime();
+	EXPECT_EQ(0, comparer.GetWaitTime().count());
+	EXPECT_EQ(0, comparer.GetReaderWaitTime(0).count());
+	EXPECT_EQ(0, comparer.GetReaderWaitTime(1).count());
+}
+
 namespace {
 auto paramNameGenerator = [](const t::TestParamInfo<FileComparer_BaseTest::ParamType>& param) {
 	return fmt::format("{:03}_{}{}_{}{}_{}",
@@ -397,5 +582,7 @@ INSTANTIATE_TEST_SUITE_P(FileComparer_EqualDataTest, FileComparer_EqualDataTest,
 INSTANTIATE_TEST_SUITE_P(FileComparer_UnequalDataAtStartTest, FileComparer_UnequalDataAtStartTest, t::Combine(t::Values(5, 10, 15, 20, 25, 50), t::Values(5, 10, 15, 20, 25, 50), t::Values(LatencyMode::kSingle, LatencyMode::kLatency)), paramNameGenerator);
 INSTANTIATE_TEST_SUITE_P(FileComparer_UnequalDataAtMiddleTest, FileComparer_UnequalDataAtMiddleTest, t::Combine(t::Values(15, 30, 40), t::Values(15, 30, 40), t::Values(LatencyMode::kSingle, LatencyMode::kLatency)), paramNameGenerator);
 INSTANTIATE_TEST_SUITE_P(FileComparer_UnequalDataAtEndTest, FileComparer_UnequalDataAtEndTest, t::Combine(t::Values(15, 20, 25, 40), t::Values(15, 20, 25, 40), t::Values(LatencyMode::kSingle, LatencyMode::kLatency)), paramNameGenerator);
+INSTANTIATE_TEST_SUITE_P(FileComparer_UpdateTest, FileComparer_UpdateTest, t::Combine(t::Values(10, 30, 40), t::Values(0), t::Values(LatencyMode::kSingle, LatencyMode::kLatency)), paramNameGenerator);
+INSTANTIATE_TEST_SUITE_P(FileComparer_WaitTimeTest, FileComparer_WaitTimeTest, t::Combine(t::Values(20), t::Values(20), t::Values(LatencyMode::kSingle)), paramNameGenerator);
 
 }  // namespace systools::test
@@ -0,0 +1,138 @@
+/*
+Copyright 2020 Michael Beckh
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "systools/FileCopier.h"
+
+#include "TestUtils.h"
+#include "systools/Digest.h"
+#include "systools/Path.h"
+
+#include <llamalog/llamalog.h>
+#include <m3c/Handle.h>
+#include <m3c/exception.h>
+
+#include <gtest/gtest.h>
+
+#include <windows.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <tuple>
+#include <vector>
+
+
+namespace systools::test {
+
+namespace t = testing;
+
+namespace {
+
+std::vector<std::byte> ReadContent(const Path& path) {
+	const m3c::Handle hFile = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (!hFile) {
+		THROW(m3c::windows_exception(GetLastError()), "CreateFile {}", path);
+	}
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(hFile, &size)) {
+		THROW(m3c::windows_exception(GetLastError()), "GetFileSizeEx {}", path);
+	}
+	std::vector<std::byte> content(static_cast<std::size_t>(size.QuadPart));
+	DWORD bytesRead;  // NOLINT(cppcoreguidelines-init-variables): Initialized as out parameter.
+	if (!ReadFile(hFile, content.data(), static_cast<DWORD>(content.size()), &bytesRead, nullptr) || bytesRead != content.size()) {
+		THROW(m3c::windows_exception(GetLastError()), "ReadFile {}", path);
+	}
+	return content;
+}
+
+}  // namespace
+
+class FileCopier_Test : public t::TestWithParam<std::tuple<std::uint32_t, std::uint32_t, std::uint8_t>> {
+protected:
+	void SetUp() override {
+		std::mt19937 random(std::get<0>(GetParam()));
+		m_content.resize(std::get<0>(GetParam()));
+		for (std::byte& b : m_content) {
+			b = static_cast<std::byte>(random());
+		}
+
+		ASSERT_NO_THROW(TestUtils::WriteTestFile(kTempFile, m_content.data(), m_content.size()));
+	}
+
+	void TearDown() override {
+		if (kTempFile.Exists()) {
+			kTempFile.ForceDelete();
+		}
+		if (kTempFileCopy.Exists()) {
+			kTempFileCopy.ForceDelete();
+		}
+	}
+
+protected:
+	const Path kTempFile = TestUtils::GetTempDirectory() / L"23220209-1205-1000-8000-0000001002.0.test";
+	const Path kTempFileCopy = TestUtils::GetTempDirectory() / L"23220209-1205-1000-8000-0000001002.1.test";
+	std::vector<std::byte> m_content;
+};
+
+TEST_P(FileCopier_Test, Copy_NewFile_CopyContent) {
+	FileCopier fileCopier(std::get<1>(GetParam()), std::get<2>(GetParam()));
+	const std::uint64_t bytesCopied = fileCopier.Copy(kTempFile, kTempFileCopy, nullptr);
+
+	EXPECT_EQ(m_content.size(), bytesCopied);
+	EXPECT_EQ(m_content, ReadContent(kTempFileCopy));
+}
+
+TEST_P(FileCopier_Test, Copy_WithDigest_ReturnDigest) {
+	DigestBuilder digestBuilder;
+	digestBuilder.Update(m_content.data(), static_cast<std::uint32_t>(m_content.size()));
+	const Digest expected = digestBuilder.Finish();
+
+	FileCopier fileCopier(std::get<1>(GetParam()), std::get<2>(GetParam()));
+	Digest digest{};
+	fileCopier.Copy(kTempFile, kTempFileCopy, &digest);
+
+	EXPECT_EQ(expected, digest);
+	EXPECT_EQ(m_content, ReadContent(kTempFileCopy));
+}
+
+TEST_P(FileCopier_Test, Copy_TargetExists_ThrowException) {
+	{
+		const m3c::Handle hFile = CreateFileW(kTempFileCopy.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_NEW, FILE_ATTRIBUTE_NORMAL, nullptr);
+		ASSERT_TRUE(hFile);
+	}
+
+	FileCopier fileCopier(std::get<1>(GetParam()), std::get<2>(GetParam()));
+	EXPECT_THROW(fileCopier.Copy(kTempFile, kTempFileCopy, nullptr), m3c::windows_exception);
+
+	EXPECT_TRUE(kTempFileCopy.Exists());
+	EXPECT_TRUE(ReadContent(kTempFileCopy).empty());
+}
+
+TEST(FileCopier_DigestTest, Finish_NoData_ReturnDigestOfEmptyData) {
+	DigestBuilder digestBuilder;
+	const Digest digest = digestBuilder.Finish();
+
+	// SHA-256 of empty input
+	constexpr std::uint8_t kExpected[] = {0xe3, 0xb0, 0xc4, 0x42, 0x98, 0xfc, 0x1c, 0x14, 0x9a, 0xfb, 0xf4, 0xc8, 0x99, 0x6f, 0xb9, 0x24,
+										  0x27, 0xae, 0x41, 0xe4, 0x64, 0x9b, 0x93, 0x4c, 0xa4, 0x95, 0x99, 0x1b, 0x78, 0x52, 0xb8, 0x55};
+	for (std::size_t i = 0; i < digest.size(); ++i) {
+		EXPECT_EQ(kExpected[i], static_cast<std::uint8_t>(digest[i])) << "at index " << i;
+	}
+}
+
+INSTANTIATE_TEST_SUITE_P(FileCopier_Test, FileCopier_Test, t::Combine(t::Values(0, 1, 4095, 4096, 3 * 4096 + 17, 5 * 1024 * 1024 + 1), t::Values(4096, FileCopier::kDefaultBufferSize), t::Values(2, FileCopier::kDefaultQueueDepth)));
+
+}  // namespace systools::test
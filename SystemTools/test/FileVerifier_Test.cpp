@@ -0,0 +1,105 @@
+/*
+Copyright 2020 Michael Beckh
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "systools/FileVerifier.h"
+
+#include "TestUtils.h"
+#include "systools/Digest.h"
+#include "systools/Path.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+namespace systools::test {
+
+namespace t = testing;
+
+class FileVerifier_Test : public t::Test {
+protected:
+	void SetUp() override {
+		m_content.resize(3 * 4096 + 17);
+		for (std::size_t i = 0; i < m_content.size(); ++i) {
+			m_content[i] = static_cast<std::byte>(i * 7);
+		}
+
+		ASSERT_NO_THROW(TestUtils::WriteTestFile(kTempFile, m_content.data(), m_content.size()));
+
+		DigestBuilder digestBuilder;
+		digestBuilder.Update(m_content.data(), static_cast<std::uint32_t>(m_content.size()));
+		m_digest = digestBuilder.Finish();
+	}
+
+	void TearDown() override {
+		if (kTempFile.Exists()) {
+			kTempFile.ForceDelete();
+		}
+	}
+
+protected:
+	const Path kTempFile = TestUtils::GetTempDirectory() / L"23220209-1205-1000-8000-0000001003.0.test";
+	std::vector<std::byte> m_content;
+	Digest m_digest{};
+};
+
+TEST_F(FileVerifier_Test, Verify_SameContent_ReturnNoFailures) {
+	FileVerifier fileVerifier;
+	fileVerifier.Verify(kTempFile, m_digest);
+
+	EXPECT_THAT(fileVerifier.Wait(), t::IsEmpty());
+}
+
+TEST_F(FileVerifier_Test, Verify_DifferentContent_ReturnFailure) {
+	m_digest[0] ^= std::byte{1};
+
+	FileVerifier fileVerifier;
+	fileVerifier.Verify(kTempFile, m_digest);
+
+	EXPECT_THAT(fileVerifier.Wait(), t::ElementsAre(kTempFile));
+}
+
+TEST_F(FileVerifier_Test, Verify_FileMissing_ReturnFailure) {
+	const Path missing = TestUtils::GetTempDirectory() / L"23220209-1205-1000-8000-0000001003.1.test";
+
+	FileVerifier fileVerifier;
+	fileVerifier.Verify(missing, m_digest);
+	fileVerifier.Verify(kTempFile, m_digest);
+
+	EXPECT_THAT(fileVerifier.Wait(), t::ElementsAre(missing));
+}
+
+TEST_F(FileVerifier_Test, Wait_CalledTwice_ReturnFailuresOnce) {
+	m_digest[0] ^= std::byte{1};
+
+	FileVerifier fileVerifier;
+	fileVerifier.Verify(kTempFile, m_digest);
+
+	EXPECT_THAT(fileVerifier.Wait(), t::SizeIs(1));
+	EXPECT_THAT(fileVerifier.Wait(), t::IsEmpty());
+}
+
+TEST_F(FileVerifier_Test, Verify_WithRateLimit_ReturnNoFailures) {
+	FileVerifier fileVerifier(1024 * 1024);
+	fileVerifier.Verify(kTempFile, m_digest);
+
+	EXPECT_THAT(fileVerifier.Wait(), t::IsEmpty());
+}
+
+}  // namespace systools::test
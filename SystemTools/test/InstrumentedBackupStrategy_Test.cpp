@@ -0,0 +1,119 @@
+/*
+Copyright 2020 Michael Beckh
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "systools/InstrumentedBackupStrategy.h"
+
+#include "BackupStrategy_Mock.h"
+#include "systools/DirectoryScanner.h"
+#include "systools/LatencyHistogram.h"
+#include "systools/Path.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <optional>
+#include <thread>
+
+namespace systools::test {
+
+namespace t = testing;
+
+using Operation = InstrumentedBackupStrategy::Operation;
+
+TEST(InstrumentedBackupStrategy_Test, Rename_Call_Forward) {
+	using namespace std::literals::chrono_literals;
+
+	const Path existingName(LR"(Q:\foo)");
+	const Path newName(LR"(Q:\bar)");
+	t::StrictMock<BackupStrategy_Mock> strategy;
+	InstrumentedBackupStrategy instrumented(strategy);
+
+	EXPECT_CALL(strategy, Rename(existingName, newName))
+		.Times(2)
+		.WillRepeatedly(t::InvokeWithoutArgs([]() {
+			std::this_thread::sleep_for(5ms);
+		}));
+
+	instrumented.Rename(existingName, newName);
+	instrumented.Rename(existingName, newName);
+
+	const LatencyHistogram& histogram = instrumented.GetHistogram(Operation::kRename);
+	EXPECT_EQ(2, histogram.GetCount());
+	EXPECT_GE(histogram.GetTotal(), 10ms);
+	EXPECT_GE(histogram.GetMax(), 5ms);
+	EXPECT_EQ(0, instrumented.GetHistogram(Operation::kDelete).GetCount());
+}
+
+TEST(InstrumentedBackupStrategy_Test, Exists_Call_ReturnResult) {
+	const Path path(LR"(Q:\foo)");
+	t::StrictMock<BackupStrategy_Mock> strategy;
+	InstrumentedBackupStrategy instrumented(strategy);
+
+	EXPECT_CALL(strategy, Exists(path)).WillOnce(t::Return(true));
+
+	EXPECT_TRUE(instrumented.Exists(path));
+	EXPECT_EQ(1, instrumented.GetHistogram(Operation::kExists).GetCount());
+}
+
+TEST(InstrumentedBackupStrategy_Test, Copy_Call_ReturnResult) {
+	const Path source(LR"(Q:\foo)");
+	const Path target(LR"(Q:\bar)");
+	const LARGE_INTEGER size{.QuadPart = 1234};
+	const LARGE_INTEGER creationTime{.QuadPart = 100};
+	const LARGE_INTEGER lastWriteTime{.QuadPart = 300};
+	const FILE_ID_128 fileId = {};
+	const ScannedFile sourceFile(Filename(L"foo"), size, creationTime, lastWriteTime, FILE_ATTRIBUTE_NORMAL, fileId, {});
+	t::StrictMock<BackupStrategy_Mock> strategy;
+	InstrumentedBackupStrategy instrumented(strategy);
+
+	EXPECT_CALL(strategy, Copy(source, target, t::Ref(sourceFile), false)).WillOnce(t::Return(std::nullopt));
+
+	EXPECT_FALSE(instrumented.Copy(source, target, sourceFile, false).has_value());
+	EXPECT_EQ(1, instrumented.GetHistogram(Operation::kCopy).GetCount());
+}
+
+TEST(InstrumentedBackupStrategy_Test, Delete_Error_RecordAndThrow) {
+	const Path path(LR"(Q:\foo)");
+	t::StrictMock<BackupStrategy_Mock> strategy;
+	InstrumentedBackupStrategy instrumented(strategy);
+
+	EXPECT_CALL(strategy, Delete(path)).WillOnce(t::Throw(std::exception()));
+
+	EXPECT_THROW(instrumented.Delete(path), std::exception);
+	EXPECT_EQ(1, instrumented.GetHistogram(Operation::kDelete).GetCount());
+}
+
+TEST(InstrumentedBackupStrategy_Test, LogStatistics_Call_NoException) {
+	const Path path(LR"(Q:\foo)");
+	t::StrictMock<BackupStrategy_Mock> strategy;
+	InstrumentedBackupStrategy instrumented(strategy);
+
+	EXPECT_CALL(strategy, IsDirectory(path)).WillOnce(t::Return(false));
+	EXPECT_FALSE(instrumented.IsDirectory(path));
+
+	EXPECT_NO_THROW(instrumented.LogStatistics());
+}
+
+TEST(InstrumentedBackupStrategy_Test, GetName_All_ReturnName) {
+	for (std::uint_fast8_t i = 0; i < static_cast<std::uint_fast8_t>(Operation::kCount); ++i) {
+		EXPECT_STRNE("", InstrumentedBackupStrategy::GetName(static_cast<Operation>(i)));
+	}
+}
+
+}  // namespace systools::test
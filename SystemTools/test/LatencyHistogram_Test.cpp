@@ -0,0 +1,95 @@
+/*
+Copyright 2020 Michael Beckh
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "systools/LatencyHistogram.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+namespace systools::test {
+
+TEST(LatencyHistogram_Test, GetPercentile_Empty_ReturnZero) {
+	const LatencyHistogram histogram;
+
+	EXPECT_EQ(0, histogram.GetCount());
+	EXPECT_EQ(0, histogram.GetPercentile(50).count());
+	EXPECT_EQ(0, histogram.GetMax().count());
+}
+
+TEST(LatencyHistogram_Test, GetPercentile_SmallValues_ReturnExact) {
+	LatencyHistogram histogram;
+	for (std::int64_t i = 1; i <= 20; ++i) {
+		histogram.Record(std::chrono::nanoseconds(i));
+	}
+
+	EXPECT_EQ(20, histogram.GetCount());
+	EXPECT_EQ(210, histogram.GetTotal().count());
+	EXPECT_EQ(10, histogram.GetPercentile(50).count());
+	EXPECT_EQ(18, histogram.GetPercentile(90).count());
+	EXPECT_EQ(20, histogram.GetPercentile(100).count());
+	EXPECT_EQ(20, histogram.GetMax().count());
+}
+
+TEST(LatencyHistogram_Test, GetPercentile_LargeValues_ReturnWithinPrecision) {
+	LatencyHistogram histogram;
+	for (std::int64_t i = 1; i <= 1000; ++i) {
+		histogram.Record(std::chrono::microseconds(i));
+	}
+
+	const std::int64_t p50 = histogram.GetPercentile(50).count();
+	const std::int64_t p99 = histogram.GetPercentile(99).count();
+	EXPECT_GE(p50, 500'000);
+	EXPECT_LE(p50, 500'000 + 500'000 / 32);
+	EXPECT_GE(p99, 990'000);
+	EXPECT_LE(p99, 990'000 + 990'000 / 32);
+	EXPECT_EQ(1'000'000, histogram.GetPercentile(100).count());
+}
+
+TEST(LatencyHistogram_Test, Record_Negative_CountAsZero) {
+	LatencyHistogram histogram;
+	histogram.Record(std::chrono::nanoseconds(-5));
+
+	EXPECT_EQ(1, histogram.GetCount());
+	EXPECT_EQ(0, histogram.GetTotal().count());
+	EXPECT_EQ(0, histogram.GetPercentile(100).count());
+}
+
+TEST(LatencyHistogram_Test, Record_Concurrent_CountAll) {
+	constexpr std::uint32_t kThreads = 4;
+	constexpr std::uint32_t kValues = 10000;
+	LatencyHistogram histogram;
+
+	std::vector<std::thread> threads;
+	for (std::uint32_t i = 0; i < kThreads; ++i) {
+		threads.emplace_back([&histogram, i]() noexcept {
+			for (std::uint32_t j = 0; j < kValues; ++j) {
+				histogram.Record(std::chrono::nanoseconds(i * kValues + j));
+			}
+		});
+	}
+	for (std::thread& thread : threads) {
+		thread.join();
+	}
+
+	EXPECT_EQ(kThreads * kValues, histogram.GetCount());
+	EXPECT_EQ(kThreads * kValues - 1, histogram.GetMax().count());
+}
+
+}  // namespace systools::test
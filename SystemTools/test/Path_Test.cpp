@@ -33,6 +33,7 @@ limitations under the License.
 #include <cstddef>
 #include <cstdint>
 #include <functional>
+#include <memory>
 #include <ostream>
 #include <string>
 #include <string_view>
@@ -521,24 +522,58 @@ TEST_F(Filename_Test, opCompare_IsDifferentAccents_CompareNotEqual) {
 	EXPECT_NE(filename.hash(), Filename(L"fo\u00E1").hash());
 }
 
+TEST_F(Filename_Test, opCompare_IsLongAsciiWithDifferentCase_CompareEqualWithoutUnicodeComparison) {
+	EXPECT_CALL(m_win32, CompareStringOrdinal).Times(0);
+	const Filename filename(L"Foo-Bar_Baz.0123.txt");
+
+	EXPECT_TRUE(filename == Filename(L"fOO-bAR_bAZ.0123.TXT"));
+	EXPECT_FALSE(filename != Filename(L"fOO-bAR_bAZ.0123.TXT"));
+	EXPECT_FALSE(filename < Filename(L"fOO-bAR_bAZ.0123.TXT"));
+	EXPECT_FALSE(filename > Filename(L"fOO-bAR_bAZ.0123.TXT"));
+}
+
+TEST_F(Filename_Test, opCompare_IsLongAsciiAndDiffersAfterFirstBlock_CompareLessThan) {
+	const Filename filename(L"foo-bar-baz-0123");
+
+	EXPECT_TRUE(filename < Filename(L"FOO-BAR-BAZ-0124"));
+	EXPECT_TRUE(filename < Filename(L"FOO-BAR-BAZ-01234"));
+	EXPECT_TRUE(filename > Filename(L"FOO-BAR-BAZ-012"));
+}
+
+TEST_F(Filename_Test, opCompare_IsLetterAndUnderscore_CompareAsUpperCase) {
+	// CompareStringOrdinal maps to upper case, i.e. 'a' (0x61) becomes 'A' (0x41) which sorts before '_' (0x5F)
+	EXPECT_TRUE(Filename(L"a") < Filename(L"_"));
+	EXPECT_TRUE(Filename(L"0123456789a") < Filename(L"0123456789_"));
+	EXPECT_TRUE(Filename(L"Z") < Filename(L"["));
+	EXPECT_TRUE(Filename(L"z") < Filename(L"["));
+}
+
+TEST_F(Filename_Test, opCompare_IsLongWithUmlautAndDifferentCase_CompareEqual) {
+	const Filename filename(L"Foo-Bar-Baz-\u00C4-0123");  // C4 == A umlaut
+
+	EXPECT_TRUE(filename == Filename(L"foo-bar-baz-\u00E4-0123"));  // E4 == a umlaut
+	EXPECT_TRUE(filename < Filename(L"foo-bar-baz-\u00E4-0124"));
+	EXPECT_TRUE(filename > Filename(L"foo-bar-baz-\u00E4-0122"));
+}
+
 TEST_F(Filename_Test, opCompare_ErrorComparing_ThrowException) {
-	EXPECT_CALL(m_win32, CompareStringOrdinal(t::StrEq(L"foo"), t::_, t::StrEq(L"foo"), t::_, t::_))
+	EXPECT_CALL(m_win32, CompareStringOrdinal(t::StrEq(L"fo\u00F6"), t::_, t::StrEq(L"fo\u00F6"), t::_, t::_))
 		.Times(6)
 		.WillRepeatedly(dtgm::SetLastErrorAndReturn(ERROR_NOT_SUPPORTED, 0));
-	const Filename filename(L"foo");
+	const Filename filename(L"fo\u00F6");
 
 #pragma warning(suppress : 4834)
-	EXPECT_THROW(filename == Filename(L"foo"), m3c::windows_exception);
+	EXPECT_THROW(filename == Filename(L"fo\u00F6"), m3c::windows_exception);
 #pragma warning(suppress : 4552)
-	EXPECT_THROW(filename != Filename(L"foo"), m3c::windows_exception);
+	EXPECT_THROW(filename != Filename(L"fo\u00F6"), m3c::windows_exception);
 #pragma warning(suppress : 4834)
-	EXPECT_THROW(filename < Filename(L"foo"), m3c::windows_exception);
+	EXPECT_THROW(filename < Filename(L"fo\u00F6"), m3c::windows_exception);
 #pragma warning(suppress : 4834)
-	EXPECT_THROW(filename <= Filename(L"foo"), m3c::windows_exception);
+	EXPECT_THROW(filename <= Filename(L"fo\u00F6"), m3c::windows_exception);
 #pragma warning(suppress : 4834)
-	EXPECT_THROW(filename > Filename(L"foo"), m3c::windows_exception);
+	EXPECT_THROW(filename > Filename(L"fo\u00F6"), m3c::windows_exception);
 #pragma warning(suppress : 4834)
-	EXPECT_THROW(filename >= Filename(L"foo"), m3c::windows_exception);
+	EXPECT_THROW(filename >= Filename(L"fo\u00F6"), m3c::windows_exception);
 }
 
 TEST_F(Filename_Test, swap_ValueWithValue_ValueAndValue) {
@@ -593,6 +628,30 @@ TEST_F(Filename_Test, stdHash_DiffersInCaseWithUmlaut_HashEquals) {
 	EXPECT_EQ(o, h);
 }
 
+TEST_F(Filename_Test, stdHash_LongDiffersInCaseWithUmlaut_HashEquals) {
+	const std::wstring str(L"foo-bar-baz-\u00F6-0123.txt");
+	const std::wstring oth(L"FOO-BAR-BAZ-\u00D6-0123.TXT");
+	const Filename filename(str);
+	const Filename othFilename(oth);
+	const size_t h = std::hash<Filename>{}(filename);
+	const size_t o = std::hash<Filename>{}(othFilename);
+
+	ASSERT_TRUE(filename == othFilename);
+	EXPECT_EQ(o, h);
+}
+
+TEST_F(Filename_Test, stdHash_DiffersInLastCharacter_HashDiffers) {
+	const Filename filename(L"foo-bar-baz-0123.txt");
+	const Filename othFilename(L"foo-bar-baz-0123.txu");
+
+	EXPECT_NE(othFilename.hash(), filename.hash());
+}
+
+TEST_F(Filename_Test, stdHash_Empty_ReturnHash) {
+	EXPECT_EQ(Filename(L"").hash(), Filename(std::wstring()).hash());
+	EXPECT_NE(Filename(L"").hash(), Filename(L"a").hash());
+}
+
 //
 // Path
 //
@@ -883,23 +942,23 @@ TEST_F(Path_Test, opCompare_IsDifferentAccents_CompareNotEqual) {
 }
 
 TEST_F(Path_Test, opCompare_ErrorComparing_ThrowException) {
-	EXPECT_CALL(m_win32, CompareStringOrdinal(t::StrEq(L"Q:\\foo"), t::_, t::StrEq(L"Q:\\foo"), t::_, t::_))
+	EXPECT_CALL(m_win32, CompareStringOrdinal(t::StrEq(L"Q:\\fo\u00F6"), t::_, t::StrEq(L"Q:\\fo\u00F6"), t::_, t::_))
 		.Times(6)
 		.WillRepeatedly(dtgm::SetLastErrorAndReturn(ERROR_NOT_SUPPORTED, 0));
-	const Path path(LR"(Q:\foo)");
+	const Path path(L"Q:\\fo\u00F6");
 
 #pragma warning(suppress : 4834)
-	EXPECT_THROW(path == Path(LR"(Q:\foo)"), m3c::windows_exception);
+	EXPECT_THROW(path == Path(L"Q:\\fo\u00F6"), m3c::windows_exception);
 #pragma warning(suppress : 4552)
-	EXPECT_THROW(path != Path(LR"(Q:\foo)"), m3c::windows_exception);
+	EXPECT_THROW(path != Path(L"Q:\\fo\u00F6"), m3c::windows_exception);
 #pragma warning(suppress : 4834)
-	EXPECT_THROW(path < Path(LR"(Q:\foo)"), m3c::windows_exception);
+	EXPECT_THROW(path < Path(L"Q:\\fo\u00F6"), m3c::windows_exception);
 #pragma warning(suppress : 4834)
-	EXPECT_THROW(path <= Path(LR"(Q:\foo)"), m3c::windows_exception);
+	EXPECT_THROW(path <= Path(L"Q:\\fo\u00F6"), m3c::windows_exception);
 #pragma warning(suppress : 4834)
-	EXPECT_THROW(path > Path(LR"(Q:\foo)"), m3c::windows_exception);
+	EXPECT_THROW(path > Path(L"Q:\\fo\u00F6"), m3c::windows_exception);
 #pragma warning(suppress : 4834)
-	EXPECT_THROW(path >= Path(LR"(Q:\foo)"), m3c::windows_exception);
+	EXPECT_THROW(path >= Path(L"Q:\\fo\u00F6"), m3c::windows_exception);
 }
 
 TEST_F(Path_Test, opAppend_Directory_AppendDirectory) {
@@ -1059,6 +1118,114 @@ TEST_F(Path_Test, opConcat_DotDotToLong_ReturnWithDotDotRemoved) {
 	EXPECT_EQ(LR"(\\?\)" + name + LR"(\baz)", result.c_str());
 }
 
+TEST_F(Path_Test, opConcat_Filename_AppendWithoutShellApi) {
+	EXPECT_CALL(m_win32, PathCchAppendEx).Times(0);
+	const Path path(LR"(Q:\foo)");
+
+	const Path result = path / Filename(L"bar.txt");
+
+	EXPECT_STREQ(LR"(Q:\foo\bar.txt)", result.c_str());
+}
+
+TEST_F(Path_Test, opConcat_FilenameToRoot_AppendWithoutSeparator) {
+	EXPECT_CALL(m_win32, PathCchAppendEx).Times(0);
+	const Path path(LR"(Q:\)");
+
+	const Path result = path / Filename(L"bar.txt");
+
+	EXPECT_STREQ(LR"(Q:\bar.txt)", result.c_str());
+}
+
+TEST_F(Path_Test, opConcat_FilenameToVolumeRoot_AppendWithoutSeparator) {
+	EXPECT_CALL(m_win32, PathCchAppendEx).Times(0);
+	const Path path(kTestVolume + LR"(\)");
+
+	const Path result = path / Filename(L"bar.txt");
+
+	EXPECT_EQ(kTestVolume + LR"(\bar.txt)", result.c_str());
+}
+
+TEST_F(Path_Test, opConcat_FilenameResultIsLong_MakeLongPath) {
+	const Path path(LR"(Q:\foo)" + std::wstring(MAX_PATH / 2, L'y'));
+	const std::wstring name(MAX_PATH / 2, L'x');
+
+	const Path result = path / Filename(name);
+
+	EXPECT_EQ(LR"(\\?\Q:\foo)" + std::wstring(MAX_PATH / 2, L'y') + L'\\' + name, result.c_str());
+}
+
+TEST_F(Path_Test, opConcat_FilenameIsDotDot_RemoveDotDot) {
+	const Path path(LR"(Q:\foo\bar)");
+
+	const Path result = path / Filename(L"..");
+
+	EXPECT_STREQ(LR"(Q:\foo)", result.c_str());
+}
+
+TEST_F(Path_Test, opConcat_FilenameWithSeparator_UseShellApi) {
+	const Path path(LR"(Q:\foo)");
+
+	const Path result = path / Filename(LR"(bar\..\baz)");
+
+	EXPECT_STREQ(LR"(Q:\foo\baz)", result.c_str());
+}
+
+TEST_F(Path_Test, PathBuilder_Siblings_ReturnPaths) {
+	EXPECT_CALL(m_win32, PathCchAppendEx).Times(0);
+	PathBuilder builder(Path(LR"(Q:\foo)"));
+
+	EXPECT_STREQ(LR"(Q:\foo\bar.txt)", builder.GetChild(Filename(L"bar.txt")).c_str());
+	EXPECT_STREQ(LR"(Q:\foo\a)", builder.GetChild(Filename(L"a")).c_str());
+	EXPECT_STREQ(LR"(Q:\foo\baz.txt)", builder.GetChild(Filename(L"baz.txt")).c_str());
+}
+
+TEST_F(Path_Test, PathBuilder_SiblingAfterDotDot_ReturnPaths) {
+	PathBuilder builder(Path(LR"(Q:\foo\bar)"));
+
+	EXPECT_STREQ(LR"(Q:\foo)", builder.GetChild(Filename(L"..")).c_str());
+	EXPECT_STREQ(LR"(Q:\foo\bar\baz.txt)", builder.GetChild(Filename(L"baz.txt")).c_str());
+}
+
+TEST_F(Path_Test, PathNode_Root_ReturnRoot) {
+	const PathNode node(Path(LR"(Q:\foo)"));
+
+	EXPECT_EQ(nullptr, node.GetParent());
+	EXPECT_STREQ(LR"(Q:\foo)", node.GetPath().c_str());
+}
+
+TEST_F(Path_Test, PathNode_Nested_ReturnPath) {
+	EXPECT_CALL(m_win32, PathCchAppendEx).Times(0);
+	const std::shared_ptr<const PathNode> root = std::make_shared<const PathNode>(Path(LR"(Q:\foo)"));
+	const std::shared_ptr<const PathNode> bar = std::make_shared<const PathNode>(root, Filename(L"bar"));
+	const PathNode baz(bar, Filename(L"baz.txt"));
+
+	EXPECT_EQ(bar, baz.GetParent());
+	EXPECT_STREQ(LR"(Q:\foo\bar)", bar->GetPath().c_str());
+	EXPECT_STREQ(LR"(Q:\foo\bar\baz.txt)", baz.GetPath().c_str());
+}
+
+TEST_F(Path_Test, PathNode_RootWithBackslash_ReturnPath) {
+	const std::shared_ptr<const PathNode> root = std::make_shared<const PathNode>(Path(LR"(Q:\)"));
+	const PathNode node(std::make_shared<const PathNode>(root, Filename(L"bar")), Filename(L"baz.txt"));
+
+	EXPECT_STREQ(LR"(Q:\bar\baz.txt)", node.GetPath().c_str());
+}
+
+TEST_F(Path_Test, PathNode_ResultIsLong_MakeLongPath) {
+	const std::wstring name(MAX_PATH / 2, L'x');
+	const std::shared_ptr<const PathNode> root = std::make_shared<const PathNode>(Path(LR"(Q:\foo)"));
+	const PathNode node(std::make_shared<const PathNode>(root, Filename(name)), Filename(name));
+
+	EXPECT_EQ(LR"(\\?\Q:\foo\)" + name + L'\\' + name, node.GetPath().c_str());
+}
+
+TEST_F(Path_Test, PathNode_NameIsDotDot_RemoveDotDot) {
+	const std::shared_ptr<const PathNode> root = std::make_shared<const PathNode>(Path(LR"(Q:\foo)"));
+	const PathNode node(std::make_shared<const PathNode>(root, Filename(L"..")), Filename(L"bar"));
+
+	EXPECT_STREQ(LR"(Q:\bar)", node.GetPath().c_str());
+}
+
 TEST_F(Path_Test, str_call_ReturnString) {
 	const Path path(LR"(Q:\foo)");
 
@@ -0,0 +1,148 @@
+/*
+Copyright 2020 Michael Beckh
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "systools/Progress.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <thread>
+#include <vector>
+
+namespace systools::test {
+
+namespace t = testing;
+
+TEST(Progress_Test, GetSnapshot_Events_ReturnCounters) {
+	Progress progress;
+	progress.OnDirectory();
+	progress.OnFile();
+	progress.OnFile();
+	progress.OnDelete();
+	progress.OnCompare(10);
+	progress.OnCopy(20);
+	progress.OnCopy(5);
+	progress.OnHardLink(30);
+
+	const Progress::Snapshot snapshot = progress.GetSnapshot(7);
+
+	EXPECT_EQ(1, snapshot.GetDirectories());
+	EXPECT_EQ(2, snapshot.GetFiles());
+	EXPECT_EQ(1, snapshot.GetFilesDeleted());
+	EXPECT_EQ(10, snapshot.GetBytesCompared());
+	EXPECT_EQ(25, snapshot.GetBytesCopied());
+	EXPECT_EQ(30, snapshot.GetBytesLinked());
+	EXPECT_EQ(7, snapshot.GetVerificationPending());
+	EXPECT_EQ(0, snapshot.GetBytesPerSecond());
+	EXPECT_GE(snapshot.GetElapsed().count(), 0);
+}
+
+TEST(Progress_Test, Reset_Events_ReturnZero) {
+	Progress progress;
+	progress.OnDirectory();
+	progress.OnFile();
+	progress.OnDelete();
+	progress.OnCompare(10);
+	progress.OnCopy(20);
+	progress.OnHardLink(30);
+
+	progress.Reset();
+	const Progress::Snapshot snapshot = progress.GetSnapshot();
+
+	EXPECT_EQ(0, snapshot.GetDirectories());
+	EXPECT_EQ(0, snapshot.GetFiles());
+	EXPECT_EQ(0, snapshot.GetFilesDeleted());
+	EXPECT_EQ(0, snapshot.GetBytesCompared());
+	EXPECT_EQ(0, snapshot.GetBytesCopied());
+	EXPECT_EQ(0, snapshot.GetBytesLinked());
+}
+
+TEST(Progress_Test, OnCopy_Concurrent_CountAll) {
+	constexpr std::uint32_t kThreads = 4;
+	constexpr std::uint32_t kEvents = 10000;
+	Progress progress;
+
+	std::vector<std::thread> threads;
+	for (std::uint32_t i = 0; i < kThreads; ++i) {
+		threads.emplace_back([&progress]() noexcept {
+			for (std::uint32_t j = 0; j < kEvents; ++j) {
+				progress.OnFile();
+				progress.OnCopy(3);
+			}
+		});
+	}
+	for (std::thread& thread : threads) {
+		thread.join();
+	}
+
+	const Progress::Snapshot snapshot = progress.GetSnapshot();
+	EXPECT_EQ(kThreads * kEvents, snapshot.GetFiles());
+	EXPECT_EQ(kThreads * kEvents * 3ULL, snapshot.GetBytesCopied());
+}
+
+TEST(ProgressReporter_Test, dtor_Running_ReportFinalState) {
+	using namespace std::literals::chrono_literals;
+
+	Progress progress;
+	std::vector<Progress::Snapshot> snapshots;
+	{
+		ProgressReporter reporter([&progress]() noexcept {
+			return progress.GetSnapshot();
+		},
+								  10ms, [&snapshots](const Progress::Snapshot& snapshot) {
+									  snapshots.push_back(snapshot);
+								  });
+		progress.OnCopy(1000);
+		std::this_thread::sleep_for(50ms);
+		progress.OnFile();
+	}
+
+	ASSERT_THAT(snapshots, t::SizeIs(t::Gt(1)));
+	EXPECT_EQ(1, snapshots.back().GetFiles());
+	EXPECT_EQ(1000, snapshots.back().GetBytesCopied());
+
+	std::uint64_t bytesPerSecond = 0;
+	for (const Progress::Snapshot& snapshot : snapshots) {
+		bytesPerSecond = std::max(bytesPerSecond, snapshot.GetBytesPerSecond());
+	}
+	EXPECT_GT(bytesPerSecond, 0);
+}
+
+TEST(ProgressReporter_Test, dtor_CallbackThrows_NoException) {
+	using namespace std::literals::chrono_literals;
+
+	Progress progress;
+	std::atomic_uint32_t calls = 0;
+	{
+		ProgressReporter reporter([&progress]() noexcept {
+			return progress.GetSnapshot();
+		},
+								  1ms, [&calls](const Progress::Snapshot&) {
+									  ++calls;
+									  throw std::exception();
+								  });
+		std::this_thread::sleep_for(10ms);
+	}
+
+	EXPECT_GT(calls, 0);
+}
+
+}  // namespace systools::test
@@ -0,0 +1,160 @@
+/*
+Copyright 2020 Michael Beckh
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+/// @file
+
+#include "systools/Scrubber.h"
+
+#include "TestUtils.h"
+#include "systools/DigestCatalog.h"
+#include "systools/Path.h"
+
+#include <m3c/Handle.h>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <windows.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <string_view>
+
+namespace systools::test {
+
+namespace t = testing;
+
+class Scrubber_Test : public t::Test {
+protected:
+	void SetUp() override {
+		ASSERT_TRUE(CreateDirectoryW(kTempFolder.c_str(), nullptr));
+		ASSERT_TRUE(CreateDirectoryW((kTempFolder / L"sub").c_str(), nullptr));
+		WriteFile(kTempFolder / L"file0.txt", "abc");
+		WriteFile(kTempFolder / L"sub" / L"file1.txt", "0123456789");
+		ASSERT_TRUE(CreateHardLinkW((kTempFolder / L"link.txt").c_str(), (kTempFolder / L"file0.txt").c_str(), nullptr));
+	}
+
+	void TearDown() override {
+		for (const Path& path : {kTempFolder / L"link.txt", kTempFolder / L"file0.txt", kTempFolder / L"sub" / L"file1.txt", kTempFolder / L"sub", kTempFolder, kCatalog}) {
+			if (path.Exists()) {
+				path.ForceDelete();
+			}
+		}
+	}
+
+	static void WriteFile(const Path& path, const std::string_view& content) {
+		ASSERT_NO_THROW(TestUtils::WriteTestFile(path, content.data(), content.size()));
+	}
+
+	/// @brief Change the content of a file without changing its size or last write time.
+	static void CorruptFile(const Path& path) {
+		const m3c::Handle hFile = CreateFileW(path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		ASSERT_TRUE(hFile);
+		FILETIME lastWriteTime;  // NOLINT(cppcoreguidelines-pro-type-member-init): Initialized as out parameter.
+		ASSERT_TRUE(GetFileTime(hFile, nullptr, nullptr, &lastWriteTime));
+		DWORD bytesWritten;  // NOLINT(cppcoreguidelines-init-variables): Initialized as out parameter.
+		ASSERT_TRUE(::WriteFile(hFile, "x", 1, &bytesWritten, nullptr));
+		ASSERT_TRUE(SetFileTime(hFile, nullptr, nullptr, &lastWriteTime));
+	}
+
+protected:
+	const Path kTempFolder = TestUtils::GetTempDirectory() / L"23220209-1205-1000-8000-0000001004.0.test";
+	const Path kCatalog = TestUtils::GetTempDirectory() / L"23220209-1205-1000-8000-0000001004.1.test";
+};
+
+TEST_F(Scrubber_Test, Scrub_EmptyCatalog_AddFiles) {
+	DigestCatalog catalog(kCatalog);
+	Scrubber scrubber(catalog, 0);
+
+	const Scrubber::Statistics statistics = scrubber.Scrub(kTempFolder, 0);
+
+	EXPECT_EQ(2, statistics.GetFilesAdded());
+	EXPECT_EQ(0, statistics.GetFilesVerified());
+	EXPECT_EQ(0, statistics.GetFilesSkipped());
+	EXPECT_EQ(13, statistics.GetBytesRead());
+	EXPECT_THAT(statistics.GetFailed(), t::IsEmpty());
+	EXPECT_EQ(2, catalog.GetSize());
+	EXPECT_TRUE(kCatalog.Exists());
+}
+
+TEST_F(Scrubber_Test, Scrub_SavedCatalog_VerifyFiles) {
+	{
+		DigestCatalog catalog(kCatalog);
+		Scrubber scrubber(catalog, 0);
+		scrubber.Scrub(kTempFolder, 0);
+	}
+
+	DigestCatalog catalog(kCatalog);
+	ASSERT_EQ(2, catalog.GetSize());
+	Scrubber scrubber(catalog, 0);
+
+	const Scrubber::Statistics statistics = scrubber.Scrub(kTempFolder, INT64_MAX);
+
+	EXPECT_EQ(0, statistics.GetFilesAdded());
+	EXPECT_EQ(2, statistics.GetFilesVerified());
+	EXPECT_EQ(0, statistics.GetFilesSkipped());
+	EXPECT_THAT(statistics.GetFailed(), t::IsEmpty());
+}
+
+TEST_F(Scrubber_Test, Scrub_ContentChanged_ReturnFailure) {
+	DigestCatalog catalog(kCatalog);
+	Scrubber scrubber(catalog, 0);
+	scrubber.Scrub(kTempFolder, 0);
+
+	CorruptFile(kTempFolder / L"sub" / L"file1.txt");
+	const Scrubber::Statistics statistics = scrubber.Scrub(kTempFolder, INT64_MAX);
+
+	EXPECT_EQ(0, statistics.GetFilesAdded());
+	EXPECT_EQ(1, statistics.GetFilesVerified());
+	EXPECT_THAT(statistics.GetFailed(), t::ElementsAre(kTempFolder / L"sub" / L"file1.txt"));
+}
+
+TEST_F(Scrubber_Test, Scrub_FileModified_AddFile) {
+	DigestCatalog catalog(kCatalog);
+	Scrubber scrubber(catalog, 0);
+	scrubber.Scrub(kTempFolder, 0);
+
+	WriteFile(kTempFolder / L"sub" / L"file1.txt", "01234567890");
+	const Scrubber::Statistics statistics = scrubber.Scrub(kTempFolder, INT64_MAX);
+
+	EXPECT_EQ(1, statistics.GetFilesAdded());
+	EXPECT_EQ(1, statistics.GetFilesVerified());
+	EXPECT_THAT(statistics.GetFailed(), t::IsEmpty());
+}
+
+TEST_F(Scrubber_Test, Scrub_AlreadyVerified_SkipFiles) {
+	DigestCatalog catalog(kCatalog);
+	Scrubber scrubber(catalog, 0);
+	scrubber.Scrub(kTempFolder, 0);
+
+	const Scrubber::Statistics statistics = scrubber.Scrub(kTempFolder, 0);
+
+	EXPECT_EQ(0, statistics.GetFilesAdded());
+	EXPECT_EQ(0, statistics.GetFilesVerified());
+	EXPECT_EQ(2, statistics.GetFilesSkipped());
+	EXPECT_EQ(0, statistics.GetBytesRead());
+}
+
+TEST_F(Scrubber_Test, DigestCatalog_CountExceedsFileSize_ThrowException) {
+	// magic, version and a count of 1000 entries without any entries
+	const std::uint32_t header[] = {0x43445453, 1, 1000, 0};
+	WriteFile(kCatalog, std::string_view(reinterpret_cast<const char*>(header), sizeof(header)));  // NOLINT(cppcoreguidelines-pro-type-reinterpret-cast): Write raw data.
+
+	EXPECT_THROW(DigestCatalog catalog(kCatalog), std::exception);
+}
+
+}  // namespace systools::test
@@ -0,0 +1,102 @@
+/*
+Copyright 2020 Michael Beckh
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "SimulatedStorage.h"
+
+#include <llamalog/llamalog.h>
+#include <m3c/mutex.h>
+
+#include <windows.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <string_view>
+#include <utility>
+
+namespace systools::test {
+
+namespace {
+
+using namespace std::chrono_literals;
+
+[[nodiscard]] std::chrono::nanoseconds GetTransferTime(const std::uint64_t bytes, const std::uint64_t bytesPerSecond) noexcept {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::duration<double>(static_cast<double>(bytes) / static_cast<double>(bytesPerSecond)));
+}
+
+}  // namespace
+
+const SimulatedStorage::Profile SimulatedStorage::kHdd = {.queueDepth = 1, .requestTime = 20us, .accessTime = 8ms, .bytesPerSecond = 160'000'000};
+const SimulatedStorage::Profile SimulatedStorage::kSsd = {.queueDepth = 32, .requestTime = 10us, .accessTime = 80us, .bytesPerSecond = 500'000'000};
+const SimulatedStorage::Profile SimulatedStorage::kUsb = {.queueDepth = 1, .requestTime = 250us, .accessTime = 1ms, .bytesPerSecond = 30'000'000};
+
+SimulatedStorage::Device::Device(Path root, const Profile& profile)
+	: root(std::move(root))
+	, profile(profile)
+	, queue(std::max<std::uint32_t>(profile.queueDepth, 1)) {
+	// empty
+}
+
+void SimulatedStorage::AddDevice(Path root, const Profile& profile) {
+	m3c::scoped_lock lock(m_mutex);
+	m_devices.emplace_back(std::move(root), profile);
+}
+
+std::chrono::nanoseconds SimulatedStorage::GetTime() const {
+	m3c::shared_lock lock(m_mutex);
+	return m_time;
+}
+
+void SimulatedStorage::Reset() {
+	m3c::scoped_lock lock(m_mutex);
+	m_time = 0ns;
+	for (Device& device : m_devices) {
+		std::fill(device.queue.begin(), device.queue.end(), 0ns);
+		device.transferred = 0ns;
+	}
+}
+
+std::chrono::nanoseconds SimulatedStorage::Submit(const Path& path, const std::uint64_t bytes) {
+	m3c::scoped_lock lock(m_mutex);
+	Device& device = GetDevice(path);
+
+	const auto slot = std::min_element(device.queue.begin(), device.queue.end());
+	const std::chrono::nanoseconds ready = std::max(m_time, *slot) + device.profile.requestTime + device.profile.accessTime;
+	const std::chrono::nanoseconds complete = std::max(ready, device.transferred) + GetTransferTime(bytes, device.profile.bytesPerSecond);
+
+	*slot = complete;
+	device.transferred = complete;
+	return complete;
+}
+
+void SimulatedStorage::WaitUntil(const std::chrono::nanoseconds time) {
+	m3c::scoped_lock lock(m_mutex);
+	m_time = std::max(m_time, time);
+}
+
+SimulatedStorage::Device& SimulatedStorage::GetDevice(const Path& path) {
+	const std::wstring_view str = path.sv();
+	for (Device& device : m_devices) {
+		const std::wstring_view root = device.root.sv();
+		if (str.size() >= root.size() && CompareStringOrdinal(str.data(), static_cast<int>(root.size()), root.data(), static_cast<int>(root.size()), TRUE) == CSTR_EQUAL) {
+			return device;
+		}
+	}
+	THROW(std::exception(), "no device for {}", path);
+}
+
+}  // namespace systools::test
@@ -0,0 +1,114 @@
+/*
+Copyright 2020 Michael Beckh
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include "systools/Path.h"
+
+#include <m3c/mutex.h>
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+namespace systools::test {
+
+/// @brief A model of storage devices which calculates the duration of I/O requests on a virtual clock.
+/// @details Every request occupies one slot of the device queue for the fixed request overhead and the access time.
+/// The transfer of data is serialized on the device, i.e. all slots share the bandwidth. No real time passes, so results
+/// are deterministic and independent of the machine running the benchmark.
+class SimulatedStorage final {
+public:
+	/// @brief The characteristics of a device.
+	struct Profile {
+		/// @brief The number of requests which are processed concurrently.
+		std::uint32_t queueDepth;
+		/// @brief The fixed overhead of every request.
+		std::chrono::nanoseconds requestTime;
+		/// @brief The time for seeking to the data.
+		std::chrono::nanoseconds accessTime;
+		/// @brief The sustained transfer rate.
+		std::uint64_t bytesPerSecond;
+	};
+
+	/// @brief A 7200 rpm hard disk drive.
+	static const Profile kHdd;
+	/// @brief A SATA solid state drive.
+	static const Profile kSsd;
+	/// @brief A USB flash drive.
+	static const Profile kUsb;
+
+public:
+	SimulatedStorage() noexcept = default;
+	SimulatedStorage(const SimulatedStorage&) = delete;
+	SimulatedStorage(SimulatedStorage&&) = delete;
+	~SimulatedStorage() noexcept = default;
+
+public:
+	SimulatedStorage& operator=(const SimulatedStorage&) = delete;
+	SimulatedStorage& operator=(SimulatedStorage&&) = delete;
+
+public:
+	/// @brief Add a device.
+	/// @param root The root path of all files stored on the device.
+	/// @param profile The characteristics of the device.
+	void AddDevice(Path root, const Profile& profile);
+
+	/// @brief Get the current time of the virtual clock.
+	[[nodiscard]] std::chrono::nanoseconds GetTime() const;
+
+	/// @brief Reset the virtual clock and all device queues.
+	void Reset();
+
+	/// @brief Issue a request at the current virtual time without waiting for its completion.
+	/// @param path The path which is accessed. The path selects the device.
+	/// @param bytes The number of bytes to transfer.
+	/// @return The virtual time when the request is complete.
+	std::chrono::nanoseconds Submit(const Path& path, std::uint64_t bytes);
+
+	/// @brief Advance the virtual clock. The clock never goes backwards.
+	/// @param time The virtual time to wait for.
+	void WaitUntil(std::chrono::nanoseconds time);
+
+	/// @brief Issue a request and wait for its completion.
+	/// @param path The path which is accessed. The path selects the device.
+	/// @param bytes The number of bytes to transfer.
+	void Execute(const Path& path, const std::uint64_t bytes) {
+		WaitUntil(Submit(path, bytes));
+	}
+
+private:
+	struct Device {
+		Device(Path root, const Profile& profile);
+
+		Path root;
+		Profile profile;
+		/// @brief The virtual time when each slot of the queue is available.
+		std::vector<std::chrono::nanoseconds> queue;
+		/// @brief The virtual time when the transfer of all previous requests is complete.
+		std::chrono::nanoseconds transferred{0};
+	};
+
+private:
+	[[nodiscard]] Device& GetDevice(const Path& path);
+
+private:
+	mutable m3c::mutex m_mutex;
+	std::vector<Device> m_devices;
+	std::chrono::nanoseconds m_time{0};
+};
+
+}  // namespace systools::test
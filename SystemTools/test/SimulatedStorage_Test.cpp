@@ -0,0 +1,118 @@
+/*
+Copyright 2020 Michael Beckh
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "SimulatedStorage.h"
+
+#include "systools/Path.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <exception>
+
+namespace systools::test {
+
+namespace t = testing;
+
+namespace {
+
+using namespace std::chrono_literals;
+
+/// @brief A device which transfers one byte per nanosecond.
+constexpr SimulatedStorage::Profile kProfile = {.queueDepth = 2, .requestTime = 1us, .accessTime = 10us, .bytesPerSecond = 1'000'000'000};
+
+}  // namespace
+
+class SimulatedStorage_Test : public t::Test {
+protected:
+	void SetUp() override {
+		m_storage.AddDevice(m_device0, kProfile);
+		m_storage.AddDevice(m_device1, kProfile);
+	}
+
+protected:
+	const Path m_device0 = Path(LR"(\\?\Volume{00112233-4455-6677-8899-AABBCCDDEEF0}\)");
+	const Path m_device1 = Path(LR"(\\?\Volume{00112233-4455-6677-8899-AABBCCDDEEFA}\)");
+	SimulatedStorage m_storage;
+};
+
+TEST_F(SimulatedStorage_Test, Execute_Request_AdvanceClock) {
+	m_storage.Execute(m_device0 / L"file", 1000);
+
+	EXPECT_EQ(12'000, m_storage.GetTime().count());
+}
+
+TEST_F(SimulatedStorage_Test, Submit_Request_KeepClock) {
+	const std::chrono::nanoseconds complete = m_storage.Submit(m_device0 / L"file", 1000);
+
+	EXPECT_EQ(12'000, complete.count());
+	EXPECT_EQ(0, m_storage.GetTime().count());
+}
+
+TEST_F(SimulatedStorage_Test, Submit_WithinQueueDepth_OverlapAccess) {
+	const std::chrono::nanoseconds first = m_storage.Submit(m_device0 / L"first", 0);
+	const std::chrono::nanoseconds second = m_storage.Submit(m_device0 / L"second", 0);
+	const std::chrono::nanoseconds third = m_storage.Submit(m_device0 / L"third", 0);
+
+	EXPECT_EQ(11'000, first.count());
+	EXPECT_EQ(11'000, second.count());
+	EXPECT_EQ(22'000, third.count());
+}
+
+TEST_F(SimulatedStorage_Test, Submit_SameDevice_ShareBandwidth) {
+	const std::chrono::nanoseconds first = m_storage.Submit(m_device0 / L"first", 10'000);
+	const std::chrono::nanoseconds second = m_storage.Submit(m_device0 / L"second", 10'000);
+
+	EXPECT_EQ(21'000, first.count());
+	EXPECT_EQ(31'000, second.count());
+}
+
+TEST_F(SimulatedStorage_Test, Submit_DifferentDevices_RunInParallel) {
+	const std::chrono::nanoseconds first = m_storage.Submit(m_device0 / L"file", 10'000);
+	const std::chrono::nanoseconds second = m_storage.Submit(m_device1 / L"file", 10'000);
+
+	EXPECT_EQ(21'000, first.count());
+	EXPECT_EQ(21'000, second.count());
+}
+
+TEST_F(SimulatedStorage_Test, Submit_AfterWait_StartAtCurrentTime) {
+	m_storage.WaitUntil(100us);
+
+	const std::chrono::nanoseconds complete = m_storage.Submit(m_device0 / L"file", 0);
+
+	EXPECT_EQ(111'000, complete.count());
+}
+
+TEST_F(SimulatedStorage_Test, Submit_UnknownDevice_Throw) {
+	EXPECT_THROW(m_storage.Submit(Path(LR"(\\?\Volume{00112233-4455-6677-8899-AABBCCDDEEFF}\file)"), 0), std::exception);
+}
+
+TEST_F(SimulatedStorage_Test, WaitUntil_Earlier_KeepTime) {
+	m_storage.WaitUntil(100us);
+	m_storage.WaitUntil(50us);
+
+	EXPECT_EQ(100'000, m_storage.GetTime().count());
+}
+
+TEST_F(SimulatedStorage_Test, Reset_AfterRequests_StartAtZero) {
+	m_storage.Execute(m_device0 / L"file", 10'000);
+	m_storage.Reset();
+
+	EXPECT_EQ(0, m_storage.GetTime().count());
+	EXPECT_EQ(11'000, m_storage.Submit(m_device0 / L"file", 0).count());
+}
+
+}  // namespace systools::test
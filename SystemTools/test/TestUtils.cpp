@@ -17,6 +17,7 @@ limitations under the License.
 #include "TestUtils.h"
 
 #include <llamalog/llamalog.h>
+#include <m3c/Handle.h>
 #include <m3c/exception.h>
 #include <m3c/string_encode.h>
 
@@ -26,6 +27,8 @@ limitations under the License.
 
 #include <cassert>
 #include <cmath>
+#include <cstddef>
+#include <exception>
 #include <iomanip>
 #include <numeric>
 #include <ostream>
@@ -137,4 +140,18 @@ Path TestUtils::GetTempDirectory() {
 	return Path(tempDirectory);
 }
 
+void TestUtils::WriteTestFile(const Path& path, _In_reads_bytes_(size) const void* const pData, const std::size_t size) {
+	const m3c::Handle hFile = CreateFileW(path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (!hFile) {
+		THROW(m3c::windows_exception(GetLastError()), "CreateFile {}", path);
+	}
+	DWORD bytesWritten;  // NOLINT(cppcoreguidelines-init-variables): Initialized as out parameter.
+	if (!WriteFile(hFile, pData, static_cast<DWORD>(size), &bytesWritten, nullptr)) {
+		THROW(m3c::windows_exception(GetLastError()), "WriteFile {}", path);
+	}
+	if (bytesWritten != size) {
+		THROW(std::exception(), "WriteFile {}: {} of {} bytes written", path, bytesWritten, size);
+	}
+}
+
 }  // namespace systools::test
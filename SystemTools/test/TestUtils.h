@@ -21,6 +21,7 @@ limitations under the License.
 #include <sal.h>
 
 #include <chrono>
+#include <cstddef>
 #include <cstdint>
 #include <iosfwd>
 #include <random>
@@ -77,6 +78,9 @@ private:
 public:
 	static Path GetSystemDirectory();
 	static Path GetTempDirectory();
+
+	/// @brief Create or overwrite a file with the given content.
+	static void WriteTestFile(const Path& path, _In_reads_bytes_(size) const void* pData, std::size_t size);
 };
 
 }  // namespace systools::test
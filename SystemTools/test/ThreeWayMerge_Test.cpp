@@ -19,9 +19,17 @@ limitations under the License.
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
 #include <exception>
+#include <iterator>
+#include <memory>
+#include <numeric>
 #include <optional>
 #include <ostream>
+#include <random>
+#include <sstream>
 #include <utility>
 #include <vector>
 
@@ -88,6 +96,22 @@ TEST(ThreeWayMerge_Test, call_Values_ReturnResult) {
 	EXPECT_THAT(extra, t::ElementsAre(Match{std::nullopt, std::nullopt, 2}, Match{std::nullopt, std::nullopt, 5}, Match{std::nullopt, std::nullopt, 8}, Match{std::nullopt, std::nullopt, 9}));
 }
 
+TEST(ThreeWayMerge_Test, call_WithUnmatched_ReturnRefOnly) {
+	std::vector<int> src{3, 1, 4, 0};
+	std::vector<int> ref{5, 4, 7, 8, 1};
+	std::vector<int> dst{4, 2, 5, 3, 8, 9};
+
+	std::vector<Match> copy;
+	std::vector<Match> extra;
+	std::vector<int> unmatched;
+
+	ThreeWayMerge(src, ref, dst, copy, extra, unmatched, Compare);
+
+	EXPECT_THAT(copy, t::ElementsAre(Match{0, std::nullopt, std::nullopt}, Match{1, 1, std::nullopt}, Match{3, std::nullopt, 3}, Match{4, 4, 4}));
+	EXPECT_THAT(extra, t::ElementsAre(Match{std::nullopt, std::nullopt, 2}, Match{std::nullopt, std::nullopt, 5}, Match{std::nullopt, std::nullopt, 8}, Match{std::nullopt, std::nullopt, 9}));
+	EXPECT_THAT(unmatched, t::ElementsAre(7));
+}
+
 TEST(ThreeWayMerge_Test, call_CompareThrows_ThrowException) {
 	std::vector<int> src{3, 1, 4, 0};
 	std::vector<int> ref{5, 4, 7, 8, 1};
@@ -102,6 +126,129 @@ TEST(ThreeWayMerge_Test, call_CompareThrows_ThrowException) {
 				 std::exception);
 }
 
+TEST(ThreeWayMerge_Test, call_Sorted_ReturnResult) {
+	std::vector<int> src{0, 1, 3, 4};
+	std::vector<int> ref{1, 4, 5, 7, 8};
+	std::vector<int> dst{2, 3, 4, 5, 8, 9};
+
+	std::vector<Match> copy;
+	std::vector<Match> extra;
+
+	ThreeWayMerge(src, ref, dst, copy, extra, Compare);
+
+	EXPECT_THAT(copy, t::ElementsAre(Match{0, std::nullopt, std::nullopt}, Match{1, 1, std::nullopt}, Match{3, std::nullopt, 3}, Match{4, 4, 4}));
+	EXPECT_THAT(extra, t::ElementsAre(Match{std::nullopt, std::nullopt, 2}, Match{std::nullopt, std::nullopt, 5}, Match{std::nullopt, std::nullopt, 8}, Match{std::nullopt, std::nullopt, 9}));
+}
+
+TEST(ThreeWayMerge_Test, call_Large_ReturnResult) {
+	constexpr std::size_t kSize = internal::kParallelSortThreshold * 2;
+
+	// src has even values, ref has values divisible by 3, dst has all values
+	std::vector<int> src(kSize / 2);
+	std::vector<int> ref(kSize / 3 + 1);
+	std::vector<int> dst(kSize);
+	std::generate(src.begin(), src.end(), [i = 0]() mutable { return (i++) * 2; });
+	std::generate(ref.begin(), ref.end(), [i = 0]() mutable { return (i++) * 3; });
+	std::iota(dst.begin(), dst.end(), 0);
+
+	std::mt19937 rng(42);  // NOLINT(cert-msc32-c, cert-msc51-cpp): Deterministic sequence for test.
+	std::shuffle(src.begin(), src.end(), rng);
+	std::shuffle(ref.begin(), ref.end(), rng);
+	std::shuffle(dst.begin(), dst.end(), rng);
+
+	std::vector<Match> copy;
+	std::vector<Match> extra;
+
+	ThreeWayMerge(src, ref, dst, copy, extra, Compare);
+
+	ASSERT_THAT(copy, t::SizeIs(kSize / 2));
+	ASSERT_THAT(extra, t::SizeIs(kSize / 2));
+	for (std::size_t i = 0; i < kSize / 2; ++i) {
+		const int value = static_cast<int>(i * 2);
+		EXPECT_EQ((Match{value, value % 3 ? std::nullopt : std::optional<int>(value), value}), copy[i]);
+		EXPECT_EQ((Match{std::nullopt, std::nullopt, value + 1}), extra[i]);
+	}
+}
+
+TEST(ThreeWayMerge_Test, call_LargeCompareThrows_ThrowException) {
+	std::vector<int> src(internal::kParallelSortThreshold);
+	std::vector<int> ref(internal::kParallelSortThreshold);
+	std::vector<int> dst(internal::kParallelSortThreshold);
+	std::iota(src.rbegin(), src.rend(), 0);
+	std::iota(ref.rbegin(), ref.rend(), 0);
+	std::iota(dst.rbegin(), dst.rend(), 0);
+
+	std::vector<Match> copy;
+	std::vector<Match> extra;
+
+	// let checking for sorted input pass to throw while sorting asynchronously
+	std::atomic_uint32_t calls = 0;
+	EXPECT_THROW(ThreeWayMerge(src, ref, dst, copy, extra, [&calls](const int& lhs, const int& rhs) -> int {
+					 if (++calls > 3) {
+						 throw std::exception();
+					 }
+					 return lhs - rhs;
+				 }),
+				 std::exception);
+}
+
+TEST(ThreeWayMergeSorted_Test, call_InputIterators_ReturnResult) {
+	std::istringstream src("0 1 3 4");
+	std::istringstream ref("1 4 5 7 8");
+	std::istringstream dst("2 3 4 5 8 9");
+
+	std::vector<Match> copy;
+	std::vector<Match> extra;
+	std::vector<int> unmatched;
+
+	ThreeWayMergeSorted(std::istream_iterator<int>(src), std::istream_iterator<int>(), std::istream_iterator<int>(ref), std::istream_iterator<int>(), std::istream_iterator<int>(dst), std::istream_iterator<int>(), copy, extra, unmatched, Compare);
+
+	EXPECT_THAT(copy, t::ElementsAre(Match{0, std::nullopt, std::nullopt}, Match{1, 1, std::nullopt}, Match{3, std::nullopt, 3}, Match{4, 4, 4}));
+	EXPECT_THAT(extra, t::ElementsAre(Match{std::nullopt, std::nullopt, 2}, Match{std::nullopt, std::nullopt, 5}, Match{std::nullopt, std::nullopt, 8}, Match{std::nullopt, std::nullopt, 9}));
+	EXPECT_THAT(unmatched, t::ElementsAre(7));
+}
+
+TEST(ThreeWayMerge_Test, call_MoveOnly_MoveEntries) {
+	struct PtrMatch {
+		PtrMatch(std::optional<std::unique_ptr<int>> src, std::optional<std::unique_ptr<int>> ref, std::optional<std::unique_ptr<int>> dst) noexcept
+			: src(std::move(src))
+			, ref(std::move(ref))
+			, dst(std::move(dst)) {
+		}
+
+		std::optional<std::unique_ptr<int>> src;
+		std::optional<std::unique_ptr<int>> ref;
+		std::optional<std::unique_ptr<int>> dst;
+	};
+
+	std::vector<std::unique_ptr<int>> src;
+	src.push_back(std::make_unique<int>(1));
+	src.push_back(std::make_unique<int>(0));
+	std::vector<std::unique_ptr<int>> ref;
+	ref.push_back(std::make_unique<int>(1));
+	ref.push_back(std::make_unique<int>(2));
+	std::vector<std::unique_ptr<int>> dst;
+	dst.push_back(std::make_unique<int>(3));
+	const int* const pSrc = src[0].get();
+
+	std::vector<PtrMatch> copy;
+	std::vector<PtrMatch> extra;
+	std::vector<std::unique_ptr<int>> unmatched;
+
+	ThreeWayMerge(std::move(src), std::move(ref), std::move(dst), copy, extra, unmatched, [](const std::unique_ptr<int>& lhs, const std::unique_ptr<int>& rhs) noexcept {
+		return *lhs - *rhs;
+	});
+
+	ASSERT_THAT(copy, t::SizeIs(2));
+	ASSERT_THAT(extra, t::SizeIs(1));
+	ASSERT_THAT(unmatched, t::SizeIs(1));
+	EXPECT_EQ(pSrc, copy[1].src->get());
+	EXPECT_EQ(1, **copy[1].ref);
+	EXPECT_EQ(3, **extra[0].dst);
+	EXPECT_EQ(2, *unmatched[0]);
+	EXPECT_THAT(src, t::Each(t::IsNull()));  // NOLINT(bugprone-use-after-move): Entries are moved, not the container.
+}
+
 TEST(ThreeWayMerge_Test, call_Empty_ReturnEmpty) {
 	std::vector<int> src;
 	std::vector<int> ref;
@@ -116,4 +263,140 @@ TEST(ThreeWayMerge_Test, call_Empty_ReturnEmpty) {
 	EXPECT_THAT(extra, t::IsEmpty());
 }
 
+using Side = ThreeWayMergeStream<int>::Side;
+
+TEST(ThreeWayMergeStream_Test, Merge_Chunks_ReturnEntriesUpToLastOfOpenSides) {
+	ThreeWayMergeStream<int> stream(Compare);
+	ASSERT_TRUE(stream.Append(Side::kSrc, {0, 1, 3}));
+	ASSERT_TRUE(stream.Append(Side::kRef, {1, 4}));
+	ASSERT_TRUE(stream.Append(Side::kDst, {2, 3, 4, 5}));
+
+	std::vector<Match> copy;
+	std::vector<Match> extra;
+	std::vector<int> unmatched;
+
+	stream.Merge(copy, extra, unmatched);
+
+	EXPECT_THAT(copy, t::ElementsAre(Match{0, std::nullopt, std::nullopt}, Match{1, 1, std::nullopt}, Match{3, std::nullopt, 3}));
+	EXPECT_THAT(extra, t::ElementsAre(Match{std::nullopt, std::nullopt, 2}));
+	EXPECT_THAT(unmatched, t::IsEmpty());
+	EXPECT_TRUE(stream.NeedsMore(Side::kSrc));
+	EXPECT_FALSE(stream.NeedsMore(Side::kRef));
+	EXPECT_FALSE(stream.NeedsMore(Side::kDst));
+	EXPECT_FALSE(stream.IsClosed());
+
+	copy.clear();
+	extra.clear();
+	ASSERT_TRUE(stream.Append(Side::kSrc, {4}));
+	stream.Close(Side::kSrc);
+	stream.Close(Side::kRef);
+	ASSERT_TRUE(stream.Append(Side::kDst, {8, 9}));
+	stream.Close(Side::kDst);
+
+	stream.Merge(copy, extra, unmatched);
+
+	EXPECT_THAT(copy, t::ElementsAre(Match{4, 4, 4}));
+	EXPECT_THAT(extra, t::ElementsAre(Match{std::nullopt, std::nullopt, 5}, Match{std::nullopt, std::nullopt, 8}, Match{std::nullopt, std::nullopt, 9}));
+	EXPECT_THAT(unmatched, t::IsEmpty());
+	EXPECT_TRUE(stream.IsClosed());
+}
+
+TEST(ThreeWayMergeStream_Test, Merge_OpenSideWithoutEntries_ReturnEmpty) {
+	ThreeWayMergeStream<int> stream(Compare);
+	ASSERT_TRUE(stream.Append(Side::kSrc, {0, 1}));
+	stream.Close(Side::kSrc);
+	stream.Close(Side::kRef);
+
+	std::vector<Match> copy;
+	std::vector<Match> extra;
+
+	stream.Merge(copy, extra);
+
+	EXPECT_THAT(copy, t::IsEmpty());
+	EXPECT_THAT(extra, t::IsEmpty());
+	EXPECT_TRUE(stream.NeedsMore(Side::kDst));
+}
+
+TEST(ThreeWayMergeStream_Test, Merge_UnsortedChunks_ReturnSorted) {
+	ThreeWayMergeStream<int> stream(Compare);
+	ASSERT_TRUE(stream.Append(Side::kSrc, {5, 1}));
+	ASSERT_TRUE(stream.Append(Side::kSrc, {3, 0}));
+	stream.Close(Side::kSrc);
+	stream.Close(Side::kRef);
+	ASSERT_TRUE(stream.Append(Side::kDst, {3}));
+	stream.Close(Side::kDst);
+
+	std::vector<Match> copy;
+	std::vector<Match> extra;
+
+	stream.Merge(copy, extra);
+
+	EXPECT_THAT(copy, t::ElementsAre(Match{0, std::nullopt, std::nullopt}, Match{1, std::nullopt, std::nullopt}, Match{3, std::nullopt, 3}, Match{5, std::nullopt, std::nullopt}));
+	EXPECT_THAT(extra, t::IsEmpty());
+}
+
+TEST(ThreeWayMergeStream_Test, Append_EntryAlreadyMerged_ReturnFalse) {
+	ThreeWayMergeStream<int> stream(Compare);
+	ASSERT_TRUE(stream.Append(Side::kSrc, {0, 4}));
+	ASSERT_TRUE(stream.Append(Side::kRef, {2}));
+	stream.Close(Side::kDst);
+
+	std::vector<Match> copy;
+	std::vector<Match> extra;
+
+	stream.Merge(copy, extra);
+	ASSERT_THAT(copy, t::ElementsAre(Match{0, std::nullopt, std::nullopt}));
+
+	EXPECT_FALSE(stream.Append(Side::kRef, {1, 3}));
+	EXPECT_FALSE(stream.Append(Side::kRef, {2}));
+	EXPECT_TRUE(stream.Append(Side::kRef, {3}));
+}
+
+TEST(ThreeWayMergeStream_Test, Merge_LargeInChunks_ReturnSameAsThreeWayMerge) {
+	constexpr std::size_t kSize = 10000;
+	constexpr std::size_t kChunkSize = 100;
+
+	// src has even values, ref has values divisible by 3, dst has all values
+	std::vector<int> src(kSize / 2);
+	std::vector<int> ref(kSize / 3 + 1);
+	std::vector<int> dst(kSize);
+	std::generate(src.begin(), src.end(), [i = 0]() mutable { return (i++) * 2; });
+	std::generate(ref.begin(), ref.end(), [i = 0]() mutable { return (i++) * 3; });
+	std::iota(dst.begin(), dst.end(), 0);
+
+	std::vector<Match> expectedCopy;
+	std::vector<Match> expectedExtra;
+	std::vector<int> expectedUnmatched;
+	ThreeWayMerge(src, ref, dst, expectedCopy, expectedExtra, expectedUnmatched, Compare);
+
+	ThreeWayMergeStream<int> stream(Compare);
+	std::vector<Match> copy;
+	std::vector<Match> extra;
+	std::vector<int> unmatched;
+	std::size_t position[3] = {};
+	const std::vector<int>* const sides[3] = {&src, &ref, &dst};
+	while (!stream.IsClosed()) {
+		// only read sides which are behind like a caller with bounded memory
+		for (std::size_t i = 0; i < 3; ++i) {
+			const Side side = static_cast<Side>(i);
+			if (!stream.NeedsMore(side)) {
+				continue;
+			}
+			const std::size_t end = std::min(position[i] + kChunkSize, sides[i]->size());
+			ASSERT_TRUE(stream.Append(side, std::vector<int>(sides[i]->begin() + static_cast<std::ptrdiff_t>(position[i]), sides[i]->begin() + static_cast<std::ptrdiff_t>(end))));
+			position[i] = end;
+			if (end == sides[i]->size()) {
+				stream.Close(side);
+			}
+		}
+		const std::size_t size = copy.size() + extra.size() + unmatched.size();
+		stream.Merge(copy, extra, unmatched);
+		ASSERT_LE(copy.size() + extra.size() + unmatched.size() - size, kChunkSize * 3);
+	}
+
+	EXPECT_EQ(expectedCopy, copy);
+	EXPECT_EQ(expectedExtra, extra);
+	EXPECT_EQ(expectedUnmatched, unmatched);
+}
+
 }  // namespace systools::test
@@ -0,0 +1,179 @@
+/*
+Copyright 2020 Michael Beckh
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "systools/Trace.h"
+
+#include "TestUtils.h"
+#include "systools/Path.h"
+
+#include <fmt/core.h>
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <windows.h>
+
+#include <cstddef>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <thread>
+
+namespace systools::test {
+
+namespace t = testing;
+
+namespace {
+
+[[nodiscard]] std::string ReadTrace(const Path& path) {
+	std::ifstream file(path.c_str());
+	return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+class Trace_Test : public t::Test {
+protected:
+	void TearDown() override {
+		Trace::Stop();
+		if (m_path.Exists()) {
+			m_path.ForceDelete();
+		}
+	}
+
+	[[nodiscard]] std::string Stop() const {
+		Trace::Stop();
+		return ReadTrace(m_path);
+	}
+
+protected:
+	const Path m_path = TestUtils::GetTempDirectory() / L"23220209-1205-1000-8000-0000004301.json";
+};
+
+}  // namespace
+
+TEST_F(Trace_Test, Stop_NoSpans_WriteEmptyTrace) {
+	Trace::Start(m_path);
+	EXPECT_TRUE(Trace::IsEnabled());
+
+	const std::string json = Stop();
+
+	EXPECT_FALSE(Trace::IsEnabled());
+	EXPECT_EQ(R"({"traceEvents":[],"displayTimeUnit":"ms"})", json);
+}
+
+TEST_F(Trace_Test, Span_Disabled_DoNotRecord) {
+	{
+		const Trace::Span span("Test", "test");
+	}
+	Trace::Start(m_path);
+
+	const std::string json = Stop();
+
+	EXPECT_EQ(R"({"traceEvents":[],"displayTimeUnit":"ms"})", json);
+}
+
+TEST_F(Trace_Test, Span_Enabled_RecordCompleteEvent) {
+	Trace::Start(m_path);
+	{
+		const Trace::Span span("Test", "test");
+	}
+
+	const std::string json = Stop();
+
+	EXPECT_THAT(json, t::StartsWith(R"({"traceEvents":[{"name":"Test","cat":"test","ph":"X","ts":)"));
+	EXPECT_THAT(json, t::HasSubstr(fmt::format(R"("tid":{}}})", GetCurrentThreadId())));
+	EXPECT_THAT(json, t::Not(t::HasSubstr(R"("args")")));
+	EXPECT_THAT(json, t::EndsWith(R"(],"displayTimeUnit":"ms"})"));
+}
+
+TEST_F(Trace_Test, Span_WithPath_RecordEscapedStrings) {
+	Trace::Start(m_path);
+	{
+		const Trace::Span span("Te\"st", "test", Path(L"C:\\\u00E4"));
+	}
+
+	const std::string json = Stop();
+
+	EXPECT_THAT(json, t::HasSubstr(R"("name":"Te\"st")"));
+	EXPECT_THAT(json, t::HasSubstr(R"("args":{"path":"C:\\)"
+								   "\xC3\xA4"
+								   R"("})"));
+}
+
+TEST_F(Trace_Test, Span_OtherThread_RecordThreadId) {
+	Trace::Start(m_path);
+	DWORD threadId = 0;
+	std::thread thread([&threadId]() {
+		const Trace::Span span("Test", "test");
+		threadId = GetCurrentThreadId();
+	});
+	thread.join();
+
+	const std::string json = Stop();
+
+	EXPECT_THAT(json, t::HasSubstr(fmt::format(R"("tid":{}}})", threadId)));
+}
+
+TEST_F(Trace_Test, Span_StartedBeforeStart_DoNotRecord) {
+	{
+		const Trace::Span span("Test", "test");
+		Trace::Start(m_path);
+	}
+
+	const std::string json = Stop();
+
+	EXPECT_EQ(R"({"traceEvents":[],"displayTimeUnit":"ms"})", json);
+}
+
+TEST_F(Trace_Test, Span_BatchComplete_WriteBeforeStop) {
+	Trace::Start(m_path);
+	for (std::size_t i = 0; i < Trace::kBatchSize + 1; ++i) {
+		const Trace::Span span("Test", "test");
+	}
+
+	const std::string written = ReadTrace(m_path);
+	const std::string json = Stop();
+
+	const auto countEvents = [](const std::string& str) {
+		std::size_t count = 0;
+		for (std::size_t pos = str.find(R"("name":"Test")"); pos != std::string::npos; pos = str.find(R"("name":"Test")", pos + 1)) {
+			++count;
+		}
+		return count;
+	};
+	EXPECT_EQ(Trace::kBatchSize, countEvents(written));
+	EXPECT_EQ(Trace::kBatchSize + 1, countEvents(json));
+	EXPECT_THAT(json, t::StartsWith(R"({"traceEvents":[{"name":"Test")"));
+	EXPECT_THAT(json, t::Not(t::HasSubstr(",,")));
+	EXPECT_THAT(json, t::EndsWith(R"(],"displayTimeUnit":"ms"})"));
+}
+
+TEST_F(Trace_Test, Start_WhileRecording_CompletePreviousTrace) {
+	const Path path = TestUtils::GetTempDirectory() / L"23220209-1205-1000-8000-0000004302.json";
+	Trace::Start(path);
+	{
+		const Trace::Span span("Test", "test");
+	}
+
+	Trace::Start(m_path);
+	const std::string previous = ReadTrace(path);
+	path.ForceDelete();
+	const std::string json = Stop();
+
+	EXPECT_THAT(previous, t::StartsWith(R"({"traceEvents":[{"name":"Test")"));
+	EXPECT_THAT(previous, t::EndsWith(R"(],"displayTimeUnit":"ms"})"));
+	EXPECT_EQ(R"({"traceEvents":[],"displayTimeUnit":"ms"})", json);
+}
+
+}  // namespace systools::test